@@ -61,11 +61,12 @@ self._layers.wrappedValue = (0..<numLayers).map { idx in ${modelName}DecoderLaye
 self._norm.wrappedValue = ${normType}(dimensions: config.hiddenSize, eps: config.rmsNormEps)
 }
 
-func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+/// Runs only the first \`depth\` layers (skipping the final norm) if set.
+func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
 ${embedCall}
 ${maskHandling}
 ${layerLoop}
-return norm(hiddenStates)
+return depth == nil ? norm(hiddenStates) : hiddenStates
 }
 }
 `
@@ -89,7 +90,7 @@ let globalOffset = globalCache?.offset ?? 0
 let globalMask = createAttentionMask(n: hiddenStates.dim(1), offset: globalOffset, windowSize: nil)
 let slidingOffset = cache.first??.offset ?? 0
 let slidingMask = createAttentionMask(n: hiddenStates.dim(1), offset: slidingOffset, windowSize: slidingWindow)`,
-      layerLoop: `for i in 0..<layers.count {
+      layerLoop: `for i in 0..<(depth ?? layers.count) {
 let layerType = i < layerTypes.count ? layerTypes[i] : "sliding_attention"
 let isGlobal = layerType == "full_attention"
 let mask = isGlobal ? globalMask : slidingMask
@@ -115,7 +116,7 @@ slidingMask = createAttentionMask(n: hiddenStates.dim(1), offset: slidingOffset,
 } else {
 slidingMask = globalMask
 }`,
-      layerLoop: `for i in 0..<layers.count {
+      layerLoop: `for i in 0..<(depth ?? layers.count) {
 let isGlobal = (i % slidingWindowPattern) == (slidingWindowPattern - 1)
 let mask = isGlobal ? globalMask : slidingMask
 hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
@@ -128,9 +129,8 @@ self.slidingWindowPattern = config.slidingWindowPattern`
   }
 
   return {
-    maskHandling: `let offset = cache.first??.offset ?? 0
-let mask = createAttentionMask(n: hiddenStates.dim(1), offset: offset, windowSize: nil)`,
-    layerLoop: `for i in 0..<layers.count {
+    maskHandling: `let mask = createAttentionMask(n: hiddenStates.dim(1), cache: cache.first ?? nil)`,
+    layerLoop: `for i in 0..<(depth ?? layers.count) {
 hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
 }`,
     extraProps: "",
@@ -244,7 +244,8 @@ let sqrtTwoInv = Float(pow(2.0, -0.5))
 return (projection + perLayerInputs) * sqrtTwoInv
 }
 
-func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+/// Runs only the first \`depth\` layers (returning the main AltUp stream) if set.
+func hiddenStates(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
 var h = embedTokens(inputIds)
 h = h * sqrt(Float(hiddenSize))
 
@@ -269,7 +270,7 @@ let slidingCache = firstSlidingIdx < cache.count ? cache[firstSlidingIdx] : nil
 let slidingOffset = slidingCache?.offset ?? 0
 let slidingMask = createAttentionMask(n: h0.dim(1), offset: slidingOffset, windowSize: config.slidingWindow)
 
-for i in 0..<layers.count {
+for i in 0..<(depth ?? layers.count) {
 let isGlobal = config.isGlobalLayer(i)
 let mask = isGlobal ? globalMask : slidingMask
 let perLayerInput = perLayerInputs[0..., 0..., i, 0...]
@@ -281,6 +282,7 @@ var nilCache: KVCache? = nil
 hiddenStates = layers[i](hiddenStates, perLayerInput: perLayerInput, mask: mask, cache: &nilCache)
 }
 }
+if depth != nil { return hiddenStates[0] }
 
 let finalTargetMagnitude = pow(mean(hiddenStates[0].pow(2), axis: -1, keepDims: true), 0.5)
 var unembedded: [MLXArray] = [hiddenStates[0]]
@@ -291,10 +293,12 @@ let finalMags = pow(mean(finalStates[1...].pow(2), axis: -1, keepDims: true), 0.
 let normalizedFinal = finalStates[1...] * (finalTargetMagnitude / maximum(finalMags, minVal))
 finalStates = concatenated([finalStates[0..<1], normalizedFinal], axis: 0)
 
-var output = mean(finalStates, axis: 0)
-output = norm(output)
+let output = mean(finalStates, axis: 0)
+return norm(output)
+}
 
-let logits = embedTokens.asLinear(output)
+func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+let logits = embedTokens.asLinear(hiddenStates(inputIds, cache: &cache))
 if let cap = finalLogitSoftcapping { return cap * tanh(logits / cap) }
 return logits
 }
@@ -366,6 +370,11 @@ cache = layerCaches.compactMap { $0 }
 return lmHead(h)
 }
 
+public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+return model(inputIds, cache: &cache, depth: depth)
+}
+
 ${newCacheImpl}
 
 public func sanitize(weights: [String: MLXArray]) -> [String: MLXArray] {
@@ -419,6 +428,11 @@ cache = layerCaches.compactMap { $0 }
 return lmHead(hidden)
 }
 
+public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+return model(inputIds, cache: &cache, depth: depth)
+}
+
 ${newCacheImpl}
 
 ${generateMoeSanitizeMethodInline()}
@@ -521,6 +535,11 @@ cache = layerCaches.compactMap { $0 }
 return output
 }
 
+public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+return model.languageModel.hiddenStates(inputIds, cache: &cache, depth: depth)
+}
+
 public func newCache() -> [KVCache] {
 let numCaches = config.firstKVSharedLayerIdx
 return (0..<numCaches).map { i in
@@ -12,9 +12,19 @@ extern "C" {
 // Returns model handle (>0) on success, -1 on error
 int32_t node_mlx_load_model(const char* model_id);
 
-// Unload a model from memory
+// Load a model with options (options_json may be NULL)
+// options_json is a JSON object: {"prefixCacheBytes"} - memory budget for reusable prompt prefixes (0 disables)
+// Returns model handle (>0) on success, -1 on error
+int32_t node_mlx_load_model_with_options(const char* model_id, const char* options_json);
+
+// Unload a model from memory (returns once the memory is released)
 void node_mlx_unload_model(int32_t handle);
 
+// Limit the memory of all loaded models to bytes (0 = unlimited)
+// Loading a model that does not fit unloads the least recently used idle models first;
+// their handles then report "Model not found". Loads fail if idle models cannot make room.
+void node_mlx_set_memory_budget(int64_t bytes);
+
 // Generate text from a prompt
 // Returns JSON string - caller must free with node_mlx_free_string
 // JSON format: {"success":bool,"text":string,"tokenCount":int,"tokensPerSecond":float,"error":string}
@@ -26,6 +36,89 @@ char* node_mlx_generate(
   float top_p
 );
 
+// Token callback for node_mlx_generate_with_callback
+// Receives each decoded token (UTF-8) and user_data; return false to stop generation
+typedef bool (*node_mlx_token_callback)(const char* token, void* user_data);
+
+// Generate text, reporting each token through on_token (may be NULL)
+// options_json is a JSON object: {"maxTokens","temperature","topP","topK","minP","repetitionPenalty",
+//   "repetitionContextSize","frequencyPenalty","presencePenalty","timeout","maxPrefillTime","regex","jsonSchema",
+//   "logprobs"} - times in milliseconds, jsonSchema as JSON text
+// on_token is called sequentially (from a worker thread) and never after this function returns
+// cancel_flag (may be NULL) is polled once per step; storing non-zero stops generation
+// With "logprobs": k, logprobs (may be NULL, logprobs_length floats) receives the log-probabilities of the
+//   n generated tokens, packed as n floats, n * k int32 IDs of the most likely tokens (most likely first),
+//   then their n * k float log-probabilities; it needs maxTokens * (1 + 2k) floats, else the call fails
+// Returns JSON string - caller must free with node_mlx_free_string
+// JSON adds "finishReason": "stop" | "length" | "cancelled" | "timeout", and "logprobs": k if requested
+char* node_mlx_generate_with_callback(
+  int32_t handle,
+  const char* prompt,
+  const char* options_json,
+  node_mlx_token_callback on_token,
+  void* user_data,
+  const int32_t* cancel_flag,
+  float* logprobs,
+  int64_t logprobs_length
+);
+
+// Embed texts with the hidden states of a loaded model (no LM head)
+// texts_json is a JSON array of strings
+// options_json (may be NULL) is a JSON object: {"pooling": "mean"|"last"|"cls","layer","normalize"}
+//   - layer indexes the hidden states (0 = token embeddings, -1 = final normalized state)
+// On success *embeddings receives count * dimensions floats (row-major), freed with node_mlx_free_floats
+// Returns JSON string - caller must free with node_mlx_free_string
+// JSON format: {"success":bool,"count":int,"dimensions":int,"length":int,"error":string}
+char* node_mlx_embed(int32_t handle, const char* texts_json, const char* options_json, float** embeddings);
+
+// Score continuations of prompts: the log-probability of every continuation token
+// prompts_json and continuations_json are JSON arrays of strings of equal length
+// Continuations sharing a prompt share its forward pass (and the model's prefix cache)
+// On success *logprobs receives the natural-log probabilities, continuation after continuation,
+// freed with node_mlx_free_floats
+// Returns JSON string - caller must free with node_mlx_free_string
+// JSON format: {"success":bool,"count":int,"tokenCounts":[int],"length":int,"error":string}
+char* node_mlx_score(int32_t handle, const char* prompts_json, const char* continuations_json, float** logprobs);
+
+// Free a float buffer returned by node_mlx_embed or node_mlx_score
+void node_mlx_free_floats(float* values);
+
+// Chat sessions keep their KV cache between turns, so each turn only processes new tokens
+// Create a session on a loaded model - returns session handle (>0), -1 on error
+int32_t node_mlx_session_create(int32_t model_handle);
+
+// Tokenize text and append it to the session (processed by the next generate)
+// Returns the number of tokens added, -1 if the session is unknown or generating
+int32_t node_mlx_session_append(int32_t session, const char* text);
+
+// Generate the next turn; the generated tokens become part of the session
+// Parameters and result match node_mlx_generate_with_callback
+char* node_mlx_session_generate(
+  int32_t session,
+  const char* options_json,
+  node_mlx_token_callback on_token,
+  void* user_data,
+  const int32_t* cancel_flag,
+  float* logprobs,
+  int64_t logprobs_length
+);
+
+// Drop the last n_tokens tokens of the session (clamped to its length)
+// Returns the remaining token count, -1 if the session is unknown or generating
+int32_t node_mlx_session_rewind(int32_t session, int32_t n_tokens);
+
+// Save the session's tokens and KV cache to a safetensors file
+// Returns 0 on success, -1 on error (session unknown or generating, I/O error)
+int32_t node_mlx_session_save(int32_t session, const char* path);
+
+// Restore a session saved with node_mlx_session_save on a loaded model.
+// Also seeds the model's prefix cache, so prompts starting with the saved tokens skip their prefill.
+// Returns session handle (>0), -1 on error (including files saved with a different model)
+int32_t node_mlx_session_load(int32_t model_handle, const char* path);
+
+// Free a session and its KV cache
+void node_mlx_session_free(int32_t session);
+
 // Free a string allocated by this library
 void node_mlx_free_string(char* str);
 
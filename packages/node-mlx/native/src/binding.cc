@@ -1,12 +1,16 @@
 #include <napi.h>
 #include <dlfcn.h>
+#include <atomic>
+#include <functional>
 #include <string>
+#include <utility>
 #include "../include/node_mlx.h"
 
 // Function pointers for dynamic loading
 static void* dylib_handle = nullptr;
 
 typedef int32_t (*LoadModelFn)(const char*);
+typedef int32_t (*LoadModelWithOptionsFn)(const char*, const char*);
 typedef void (*UnloadModelFn)(int32_t);
 typedef char* (*GenerateFn)(int32_t, const char*, int32_t, float, float, float, int32_t);
 typedef void (*FreeStringFn)(char*);
@@ -16,18 +20,152 @@ typedef bool (*SetMetallibPathFn)(const char*);
 typedef char* (*GenerateStreamingFn)(int32_t, const char*, int32_t, float, float, float, int32_t);
 typedef char* (*GenerateWithImageFn)(int32_t, const char*, const char*, int32_t, float, float, float, int32_t);
 typedef bool (*IsVLMFn)(int32_t);
+typedef char* (*GenerateWithCallbackFn)(int32_t, const char*, const char*, node_mlx_token_callback, void*,
+                                        const int32_t*, float*, int64_t);
+typedef int32_t (*SessionCreateFn)(int32_t);
+typedef int32_t (*SessionAppendFn)(int32_t, const char*);
+typedef char* (*SessionGenerateFn)(int32_t, const char*, node_mlx_token_callback, void*, const int32_t*, float*,
+                                   int64_t);
+typedef int32_t (*SessionRewindFn)(int32_t, int32_t);
+typedef int32_t (*SessionSaveFn)(int32_t, const char*);
+typedef int32_t (*SessionLoadFn)(int32_t, const char*);
+typedef void (*SessionFreeFn)(int32_t);
+typedef void (*SetMemoryBudgetFn)(int64_t);
+typedef char* (*EmbedFn)(int32_t, const char*, const char*, float**);
+typedef char* (*ScoreFn)(int32_t, const char*, const char*, float**);
+typedef void (*FreeFloatsFn)(float*);
 
 static LoadModelFn fn_load_model = nullptr;
+static LoadModelWithOptionsFn fn_load_model_with_options = nullptr;
 static UnloadModelFn fn_unload_model = nullptr;
 static GenerateFn fn_generate = nullptr;
 static GenerateStreamingFn fn_generate_streaming = nullptr;
 static GenerateWithImageFn fn_generate_with_image = nullptr;
 static IsVLMFn fn_is_vlm = nullptr;
+static GenerateWithCallbackFn fn_generate_with_callback = nullptr;
+static SessionCreateFn fn_session_create = nullptr;
+static SessionAppendFn fn_session_append = nullptr;
+static SessionGenerateFn fn_session_generate = nullptr;
+static SessionRewindFn fn_session_rewind = nullptr;
+static SessionSaveFn fn_session_save = nullptr;
+static SessionLoadFn fn_session_load = nullptr;
+static SessionFreeFn fn_session_free = nullptr;
+static SetMemoryBudgetFn fn_set_memory_budget = nullptr;
+static EmbedFn fn_embed = nullptr;
+static ScoreFn fn_score = nullptr;
+static FreeFloatsFn fn_free_floats = nullptr;
 static FreeStringFn fn_free_string = nullptr;
 static IsAvailableFn fn_is_available = nullptr;
 static GetVersionFn fn_get_version = nullptr;
 static SetMetallibPathFn fn_set_metallib_path = nullptr;
 
+// Generation options shared by all generate exports
+struct GenerationOptions {
+  int32_t maxTokens = 256;
+  float temperature = 0.7f;
+  float topP = 0.9f;
+  float repetitionPenalty = 0.0f;  // 0 means disabled
+  int32_t repetitionContextSize = 20;
+};
+
+// Parse an optional options object into GenerationOptions (missing keys keep defaults)
+static GenerationOptions ParseGenerationOptions(const Napi::Value& value) {
+  GenerationOptions opts;
+
+  if (!value.IsObject()) {
+    return opts;
+  }
+
+  Napi::Object options = value.As<Napi::Object>();
+
+  if (options.Has("maxTokens")) {
+    opts.maxTokens = options.Get("maxTokens").As<Napi::Number>().Int32Value();
+  }
+  if (options.Has("temperature")) {
+    opts.temperature = options.Get("temperature").As<Napi::Number>().FloatValue();
+  }
+  if (options.Has("topP")) {
+    opts.topP = options.Get("topP").As<Napi::Number>().FloatValue();
+  }
+  if (options.Has("repetitionPenalty")) {
+    opts.repetitionPenalty = options.Get("repetitionPenalty").As<Napi::Number>().FloatValue();
+  }
+  if (options.Has("repetitionContextSize")) {
+    opts.repetitionContextSize = options.Get("repetitionContextSize").As<Napi::Number>().Int32Value();
+  }
+
+  return opts;
+}
+
+// Serialize an optional options object with JSON.stringify (non-objects become "{}")
+static std::string StringifyOptions(Napi::Env env, const Napi::Value& value) {
+  if (!value.IsObject()) {
+    return "{}";
+  }
+
+  Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+  Napi::Value result = json.Get("stringify").As<Napi::Function>().Call(json, {value});
+
+  return result.IsString() ? result.As<Napi::String>().Utf8Value() : "{}";
+}
+
+// Load a model, passing options when the library supports them
+static int32_t CallLoadModel(const std::string& modelId, const std::string& optionsJson) {
+  if (fn_load_model_with_options) {
+    return fn_load_model_with_options(modelId.c_str(), optionsJson.c_str());
+  }
+  return fn_load_model(modelId.c_str());
+}
+
+// Optional cancellation flag: an Int32Array whose first element the caller sets
+// to non-zero (via Atomics.store) to stop generation. The reference keeps the
+// backing store alive while a worker reads it.
+struct CancelFlag {
+  Napi::ObjectReference ref;
+  const int32_t* data = nullptr;
+};
+
+static CancelFlag ParseCancelFlag(const Napi::Value& value) {
+  CancelFlag flag;
+
+  if (!value.IsTypedArray()) {
+    return flag;
+  }
+
+  Napi::TypedArray array = value.As<Napi::TypedArray>();
+  if (array.TypedArrayType() != napi_int32_array || array.ElementLength() < 1) {
+    return flag;
+  }
+
+  flag.data = value.As<Napi::Int32Array>().Data();
+  flag.ref = Napi::Persistent(value.As<Napi::Object>());
+
+  return flag;
+}
+
+// Optional Float32Array that receives packed per-token logprobs. Referenced
+// like CancelFlag until the worker is done with it.
+struct LogprobsBuffer {
+  Napi::ObjectReference ref;
+  float* data = nullptr;
+  int64_t length = 0;
+};
+
+static LogprobsBuffer ParseLogprobsBuffer(const Napi::Value& value) {
+  LogprobsBuffer buffer;
+
+  if (!value.IsTypedArray() || value.As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) {
+    return buffer;
+  }
+
+  Napi::Float32Array array = value.As<Napi::Float32Array>();
+  buffer.data = array.Data();
+  buffer.length = static_cast<int64_t>(array.ElementLength());
+  buffer.ref = Napi::Persistent(value.As<Napi::Object>());
+
+  return buffer;
+}
+
 // Initialize the library
 Napi::Value Initialize(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
@@ -55,6 +193,7 @@ Napi::Value Initialize(const Napi::CallbackInfo& info) {
 
   // Load function pointers
   fn_load_model = (LoadModelFn)dlsym(dylib_handle, "node_mlx_load_model");
+  fn_load_model_with_options = (LoadModelWithOptionsFn)dlsym(dylib_handle, "node_mlx_load_model_with_options");
   fn_unload_model = (UnloadModelFn)dlsym(dylib_handle, "node_mlx_unload_model");
   fn_generate = (GenerateFn)dlsym(dylib_handle, "node_mlx_generate");
   fn_free_string = (FreeStringFn)dlsym(dylib_handle, "node_mlx_free_string");
@@ -64,6 +203,18 @@ Napi::Value Initialize(const Napi::CallbackInfo& info) {
   fn_generate_streaming = (GenerateStreamingFn)dlsym(dylib_handle, "node_mlx_generate_streaming");
   fn_generate_with_image = (GenerateWithImageFn)dlsym(dylib_handle, "node_mlx_generate_with_image");
   fn_is_vlm = (IsVLMFn)dlsym(dylib_handle, "node_mlx_is_vlm");
+  fn_generate_with_callback = (GenerateWithCallbackFn)dlsym(dylib_handle, "node_mlx_generate_with_callback");
+  fn_session_create = (SessionCreateFn)dlsym(dylib_handle, "node_mlx_session_create");
+  fn_session_append = (SessionAppendFn)dlsym(dylib_handle, "node_mlx_session_append");
+  fn_session_generate = (SessionGenerateFn)dlsym(dylib_handle, "node_mlx_session_generate");
+  fn_session_rewind = (SessionRewindFn)dlsym(dylib_handle, "node_mlx_session_rewind");
+  fn_session_save = (SessionSaveFn)dlsym(dylib_handle, "node_mlx_session_save");
+  fn_session_load = (SessionLoadFn)dlsym(dylib_handle, "node_mlx_session_load");
+  fn_session_free = (SessionFreeFn)dlsym(dylib_handle, "node_mlx_session_free");
+  fn_set_memory_budget = (SetMemoryBudgetFn)dlsym(dylib_handle, "node_mlx_set_memory_budget");
+  fn_embed = (EmbedFn)dlsym(dylib_handle, "node_mlx_embed");
+  fn_score = (ScoreFn)dlsym(dylib_handle, "node_mlx_score");
+  fn_free_floats = (FreeFloatsFn)dlsym(dylib_handle, "node_mlx_free_floats");
 
   if (!fn_load_model || !fn_generate || !fn_free_string) {
     std::string missing;
@@ -104,7 +255,7 @@ Napi::Value LoadModel(const Napi::CallbackInfo& info) {
   }
 
   std::string modelId = info[0].As<Napi::String>().Utf8Value();
-  int32_t handle = fn_load_model(modelId.c_str());
+  int32_t handle = CallLoadModel(modelId, StringifyOptions(env, info[1]));
 
   if (handle < 0) {
     Napi::Error::New(env, "Failed to load model: " + modelId).ThrowAsJavaScriptException();
@@ -151,35 +302,9 @@ Napi::Value Generate(const Napi::CallbackInfo& info) {
   int32_t handle = info[0].As<Napi::Number>().Int32Value();
   std::string prompt = info[1].As<Napi::String>().Utf8Value();
 
-  // Default options
-  int32_t maxTokens = 256;
-  float temperature = 0.7f;
-  float topP = 0.9f;
-  float repetitionPenalty = 0.0f;  // 0 means disabled
-  int32_t repetitionContextSize = 20;
-
-  // Parse options object if provided
-  if (info.Length() > 2 && info[2].IsObject()) {
-    Napi::Object options = info[2].As<Napi::Object>();
-
-    if (options.Has("maxTokens")) {
-      maxTokens = options.Get("maxTokens").As<Napi::Number>().Int32Value();
-    }
-    if (options.Has("temperature")) {
-      temperature = options.Get("temperature").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("topP")) {
-      topP = options.Get("topP").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionPenalty")) {
-      repetitionPenalty = options.Get("repetitionPenalty").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionContextSize")) {
-      repetitionContextSize = options.Get("repetitionContextSize").As<Napi::Number>().Int32Value();
-    }
-  }
+  GenerationOptions opts = ParseGenerationOptions(info[2]);
 
-  char* jsonResult = fn_generate(handle, prompt.c_str(), maxTokens, temperature, topP, repetitionPenalty, repetitionContextSize);
+  char* jsonResult = fn_generate(handle, prompt.c_str(), opts.maxTokens, opts.temperature, opts.topP, opts.repetitionPenalty, opts.repetitionContextSize);
 
   if (!jsonResult) {
     Napi::Error::New(env, "Generate returned null").ThrowAsJavaScriptException();
@@ -210,38 +335,12 @@ Napi::Value GenerateStreaming(const Napi::CallbackInfo& info) {
   int32_t handle = info[0].As<Napi::Number>().Int32Value();
   std::string prompt = info[1].As<Napi::String>().Utf8Value();
 
-  // Default options
-  int32_t maxTokens = 256;
-  float temperature = 0.7f;
-  float topP = 0.9f;
-  float repetitionPenalty = 0.0f;  // 0 means disabled
-  int32_t repetitionContextSize = 20;
-
-  // Parse options object if provided
-  if (info.Length() > 2 && info[2].IsObject()) {
-    Napi::Object options = info[2].As<Napi::Object>();
-
-    if (options.Has("maxTokens")) {
-      maxTokens = options.Get("maxTokens").As<Napi::Number>().Int32Value();
-    }
-    if (options.Has("temperature")) {
-      temperature = options.Get("temperature").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("topP")) {
-      topP = options.Get("topP").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionPenalty")) {
-      repetitionPenalty = options.Get("repetitionPenalty").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionContextSize")) {
-      repetitionContextSize = options.Get("repetitionContextSize").As<Napi::Number>().Int32Value();
-    }
-  }
+  GenerationOptions opts = ParseGenerationOptions(info[2]);
 
   // Flush stdout before calling streaming generate
   fflush(stdout);
 
-  char* jsonResult = fn_generate_streaming(handle, prompt.c_str(), maxTokens, temperature, topP, repetitionPenalty, repetitionContextSize);
+  char* jsonResult = fn_generate_streaming(handle, prompt.c_str(), opts.maxTokens, opts.temperature, opts.topP, opts.repetitionPenalty, opts.repetitionContextSize);
 
   // Flush again after generation
   fflush(stdout);
@@ -276,38 +375,12 @@ Napi::Value GenerateWithImage(const Napi::CallbackInfo& info) {
   std::string prompt = info[1].As<Napi::String>().Utf8Value();
   std::string imagePath = info[2].As<Napi::String>().Utf8Value();
 
-  // Default options
-  int32_t maxTokens = 256;
-  float temperature = 0.7f;
-  float topP = 0.9f;
-  float repetitionPenalty = 0.0f;  // 0 means disabled
-  int32_t repetitionContextSize = 20;
-
-  // Parse options object if provided
-  if (info.Length() > 3 && info[3].IsObject()) {
-    Napi::Object options = info[3].As<Napi::Object>();
-
-    if (options.Has("maxTokens")) {
-      maxTokens = options.Get("maxTokens").As<Napi::Number>().Int32Value();
-    }
-    if (options.Has("temperature")) {
-      temperature = options.Get("temperature").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("topP")) {
-      topP = options.Get("topP").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionPenalty")) {
-      repetitionPenalty = options.Get("repetitionPenalty").As<Napi::Number>().FloatValue();
-    }
-    if (options.Has("repetitionContextSize")) {
-      repetitionContextSize = options.Get("repetitionContextSize").As<Napi::Number>().Int32Value();
-    }
-  }
+  GenerationOptions opts = ParseGenerationOptions(info[3]);
 
   // Flush stdout before calling streaming generate
   fflush(stdout);
 
-  char* jsonResult = fn_generate_with_image(handle, prompt.c_str(), imagePath.c_str(), maxTokens, temperature, topP, repetitionPenalty, repetitionContextSize);
+  char* jsonResult = fn_generate_with_image(handle, prompt.c_str(), imagePath.c_str(), opts.maxTokens, opts.temperature, opts.topP, opts.repetitionPenalty, opts.repetitionContextSize);
 
   // Flush again after generation
   fflush(stdout);
@@ -324,6 +397,638 @@ Napi::Value GenerateWithImage(const Napi::CallbackInfo& info) {
   return Napi::String::New(env, jsonStr);
 }
 
+// Async exports
+//
+// The Swift entry points block until generation is complete. These workers run
+// them on the libuv thread pool so the JS event loop keeps serving other work.
+
+// Load a model off the main thread - resolves with the model handle
+class LoadModelWorker : public Napi::AsyncWorker {
+ public:
+  LoadModelWorker(Napi::Env env, std::string modelId, std::string optionsJson)
+      : Napi::AsyncWorker(env),
+        deferred_(Napi::Promise::Deferred::New(env)),
+        modelId_(std::move(modelId)),
+        optionsJson_(std::move(optionsJson)) {}
+
+  Napi::Promise Promise() { return deferred_.Promise(); }
+
+ protected:
+  void Execute() override {
+    handle_ = CallLoadModel(modelId_, optionsJson_);
+
+    if (handle_ < 0) {
+      SetError("Failed to load model: " + modelId_);
+    }
+  }
+
+  void OnOK() override { deferred_.Resolve(Napi::Number::New(Env(), handle_)); }
+
+  void OnError(const Napi::Error& error) override { deferred_.Reject(error.Value()); }
+
+ private:
+  Napi::Promise::Deferred deferred_;
+  std::string modelId_;
+  std::string optionsJson_;
+  int32_t handle_ = -1;
+};
+
+// Run a native call that returns a handle or status code off the main thread -
+// resolves with its result, rejects with `message` when it returns -1
+class StatusWorker : public Napi::AsyncWorker {
+ public:
+  StatusWorker(Napi::Env env, std::function<int32_t()> call, std::string message)
+      : Napi::AsyncWorker(env),
+        deferred_(Napi::Promise::Deferred::New(env)),
+        call_(std::move(call)),
+        message_(std::move(message)) {}
+
+  Napi::Promise Promise() { return deferred_.Promise(); }
+
+ protected:
+  void Execute() override {
+    result_ = call_();
+
+    if (result_ < 0) {
+      SetError(message_);
+    }
+  }
+
+  void OnOK() override { deferred_.Resolve(Napi::Number::New(Env(), result_)); }
+
+  void OnError(const Napi::Error& error) override { deferred_.Reject(error.Value()); }
+
+ private:
+  Napi::Promise::Deferred deferred_;
+  std::function<int32_t()> call_;
+  std::string message_;
+  int32_t result_ = -1;
+};
+
+// A native generate call: (on_token, user_data, cancel_flag, logprobs, logprobs_length) -> JSON result string.
+// Lets the workers below drive both one-shot and session generation.
+using GenerateCall = std::function<char*(node_mlx_token_callback, void*, const int32_t*, float*, int64_t)>;
+
+// Generate text off the main thread - resolves with the JSON result string
+class GenerateWorker : public Napi::AsyncWorker {
+ public:
+  GenerateWorker(Napi::Env env, GenerateCall call, CancelFlag cancelFlag, LogprobsBuffer logprobs)
+      : Napi::AsyncWorker(env),
+        deferred_(Napi::Promise::Deferred::New(env)),
+        call_(std::move(call)),
+        cancelFlag_(std::move(cancelFlag)),
+        logprobs_(std::move(logprobs)) {}
+
+  Napi::Promise Promise() { return deferred_.Promise(); }
+
+ protected:
+  void Execute() override {
+    char* jsonResult = call_(nullptr, nullptr, cancelFlag_.data, logprobs_.data, logprobs_.length);
+
+    if (!jsonResult) {
+      SetError("Generate returned null");
+      return;
+    }
+
+    result_ = jsonResult;
+    fn_free_string(jsonResult);
+  }
+
+  void OnOK() override { deferred_.Resolve(Napi::String::New(Env(), result_)); }
+
+  void OnError(const Napi::Error& error) override { deferred_.Reject(error.Value()); }
+
+ private:
+  Napi::Promise::Deferred deferred_;
+  GenerateCall call_;
+  CancelFlag cancelFlag_;
+  LogprobsBuffer logprobs_;
+  std::string result_;
+};
+
+// Runs a call that returns JSON and a float buffer - e.g. node_mlx_embed
+using FloatsCall = std::function<char*(float**)>;
+
+// Run a FloatsCall off the main thread - resolves with its parsed JSON result plus
+// `values`, a Float32Array of `length` floats that adopts the native buffer instead of copying it.
+class FloatsWorker : public Napi::AsyncWorker {
+ public:
+  FloatsWorker(Napi::Env env, FloatsCall call)
+      : Napi::AsyncWorker(env), deferred_(Napi::Promise::Deferred::New(env)), call_(std::move(call)) {}
+
+  ~FloatsWorker() override {
+    if (values_) {
+      fn_free_floats(values_);
+    }
+  }
+
+  Napi::Promise Promise() { return deferred_.Promise(); }
+
+ protected:
+  void Execute() override {
+    char* jsonResult = call_(&values_);
+
+    if (!jsonResult) {
+      SetError("Native call returned null");
+      return;
+    }
+
+    result_ = jsonResult;
+    fn_free_string(jsonResult);
+  }
+
+  void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+    Napi::Object result =
+        json.Get("parse").As<Napi::Function>().Call(json, {Napi::String::New(env, result_)}).As<Napi::Object>();
+
+    if (!values_) {
+      Napi::Value error = result.Get("error");
+      std::string message = error.IsString() ? error.As<Napi::String>().Utf8Value() : "Native call failed";
+      deferred_.Reject(Napi::Error::New(env, message).Value());
+      return;
+    }
+
+    size_t length = static_cast<size_t>(result.Get("length").As<Napi::Number>().Int64Value());
+
+    // The ArrayBuffer owns the values from here on
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, values_, length * sizeof(float),
+                                                      [](Napi::Env, void* data) {
+                                                        fn_free_floats(static_cast<float*>(data));
+                                                      });
+    values_ = nullptr;
+
+    result.Set("values", Napi::Float32Array::New(env, length, buffer, 0));
+    deferred_.Resolve(result);
+  }
+
+  void OnError(const Napi::Error& error) override { deferred_.Reject(error.Value()); }
+
+ private:
+  Napi::Promise::Deferred deferred_;
+  FloatsCall call_;
+  std::string result_;
+  float* values_ = nullptr;
+};
+
+// State shared between a streaming generation and the JS thread. Owned by the
+// thread-safe function and freed in its finalizer, which runs only after every
+// queued token has been delivered - so the promise always settles last.
+struct StreamContext {
+  explicit StreamContext(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+
+  Napi::Promise::Deferred deferred;
+  std::atomic<bool> stopped{false};
+  std::string result;
+  std::string error;
+  Napi::Reference<Napi::Value> callbackError;
+};
+
+// A single token on its way from the worker thread to the JS callback
+struct TokenMessage {
+  StreamContext* context;
+  std::string token;
+};
+
+// Runs on the JS thread: hand one token to the callback. Returning false or
+// throwing from the callback stops generation; a thrown error rejects the promise.
+static void DeliverToken(Napi::Env env, Napi::Function callback, TokenMessage* message) {
+  StreamContext* context = message->context;
+
+  if (env != nullptr && !context->stopped.load()) {
+    Napi::Value ret = callback.Call({Napi::String::New(env, message->token)});
+
+    if (env.IsExceptionPending()) {
+      context->callbackError = Napi::Persistent(env.GetAndClearPendingException().Value());
+      context->stopped.store(true);
+    } else if (ret.IsBoolean() && !ret.As<Napi::Boolean>().Value()) {
+      context->stopped.store(true);
+    }
+  }
+
+  delete message;
+}
+
+// Runs on the JS thread once the stream is released and drained: settle the promise
+static void FinalizeStream(Napi::Env env, StreamContext* context) {
+  if (!context->callbackError.IsEmpty()) {
+    context->deferred.Reject(context->callbackError.Value());
+  } else if (!context->error.empty()) {
+    context->deferred.Reject(Napi::Error::New(env, context->error).Value());
+  } else {
+    context->deferred.Resolve(Napi::String::New(env, context->result));
+  }
+
+  delete context;
+}
+
+// Generate text off the main thread, forwarding each token to a JS callback
+// through a thread-safe function. The promise is settled by FinalizeStream.
+class StreamingGenerateWorker : public Napi::AsyncWorker {
+ public:
+  StreamingGenerateWorker(Napi::Env env, GenerateCall call, CancelFlag cancelFlag, LogprobsBuffer logprobs,
+                          Napi::ThreadSafeFunction tsfn, StreamContext* context)
+      : Napi::AsyncWorker(env),
+        call_(std::move(call)),
+        cancelFlag_(std::move(cancelFlag)),
+        logprobs_(std::move(logprobs)),
+        tsfn_(tsfn),
+        context_(context) {}
+
+ protected:
+  void Execute() override {
+    char* jsonResult = call_(OnToken, this, cancelFlag_.data, logprobs_.data, logprobs_.length);
+
+    if (jsonResult) {
+      context_->result = jsonResult;
+      fn_free_string(jsonResult);
+    } else {
+      context_->error = "Generate returned null";
+    }
+
+    // Last use of the context from this thread - the finalizer may run right after
+    tsfn_.Release();
+  }
+
+  void OnOK() override {}
+
+  void OnError(const Napi::Error&) override {}
+
+ private:
+  // Called from the generating thread for every token
+  static bool OnToken(const char* token, void* userData) {
+    auto* self = static_cast<StreamingGenerateWorker*>(userData);
+
+    if (self->context_->stopped.load()) {
+      return false;
+    }
+
+    auto* message = new TokenMessage{self->context_, token ? token : ""};
+    if (self->tsfn_.NonBlockingCall(message, DeliverToken) != napi_ok) {
+      delete message;
+      return false;
+    }
+
+    return true;
+  }
+
+  GenerateCall call_;
+  CancelFlag cancelFlag_;
+  LogprobsBuffer logprobs_;
+  Napi::ThreadSafeFunction tsfn_;
+  StreamContext* context_;
+};
+
+// Build the native call for generateAsync/generateStreamAsync from (handle, prompt, options)
+static GenerateCall MakeGenerateCall(Napi::Env env, const Napi::CallbackInfo& info) {
+  int32_t handle = info[0].As<Napi::Number>().Int32Value();
+  std::string prompt = info[1].As<Napi::String>().Utf8Value();
+  std::string optionsJson = StringifyOptions(env, info[2]);
+
+  return [handle, prompt = std::move(prompt), optionsJson = std::move(optionsJson)](
+             node_mlx_token_callback onToken, void* userData, const int32_t* cancelFlag, float* logprobs,
+             int64_t logprobsLength) {
+    return fn_generate_with_callback(handle, prompt.c_str(), optionsJson.c_str(), onToken, userData, cancelFlag,
+                                     logprobs, logprobsLength);
+  };
+}
+
+// Start a streaming generation that forwards tokens to onToken - returns the result promise
+static Napi::Promise QueueStreamingGenerate(Napi::Env env, GenerateCall call, Napi::Function onToken,
+                                            const Napi::Value& cancelFlag, const Napi::Value& logprobs) {
+  auto* context = new StreamContext(env);
+  Napi::Promise promise = context->deferred.Promise();
+
+  // Unbounded queue, one producer (the worker thread)
+  Napi::ThreadSafeFunction tsfn =
+      Napi::ThreadSafeFunction::New(env, onToken, "node-mlx token stream", 0, 1, context, FinalizeStream);
+
+  auto* worker = new StreamingGenerateWorker(env, std::move(call), ParseCancelFlag(cancelFlag),
+                                             ParseLogprobsBuffer(logprobs), tsfn, context);
+  worker->Queue();
+
+  return promise;
+}
+
+// Load a model asynchronously - returns Promise<number>
+Napi::Value LoadModelAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_load_model) {
+    Napi::Error::New(env, "Library not initialized. Call initialize() first.").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Model ID string required").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto* worker = new LoadModelWorker(env, info[0].As<Napi::String>().Utf8Value(), StringifyOptions(env, info[1]));
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Unload a model asynchronously - returns Promise<number> that resolves once the memory is released
+Napi::Value UnloadModelAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_unload_model) {
+    Napi::Error::New(env, "Library not initialized").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Model handle number required").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t handle = info[0].As<Napi::Number>().Int32Value();
+  auto* worker = new StatusWorker(
+      env,
+      [handle]() {
+        fn_unload_model(handle);
+        return 0;
+      },
+      "Failed to unload model");
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Generate text asynchronously - returns Promise<string> with the JSON result
+Napi::Value GenerateAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_generate_with_callback) {
+    Napi::Error::New(env, "Library not initialized").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+    Napi::TypeError::New(env, "Usage: generateAsync(handle, prompt, options?, cancelFlag?, logprobs?)")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto* worker =
+      new GenerateWorker(env, MakeGenerateCall(env, info), ParseCancelFlag(info[3]), ParseLogprobsBuffer(info[4]));
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Generate text asynchronously, calling onToken(token) for each token as it is
+// produced - returns Promise<string> with the JSON result. An optional Int32Array
+// cancelFlag stops generation once its first element is non-zero.
+Napi::Value GenerateStreamAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_generate_with_callback) {
+    Napi::Error::New(env, "Callback streaming not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 4 || !info[0].IsNumber() || !info[1].IsString() || !info[3].IsFunction()) {
+    Napi::TypeError::New(env, "Usage: generateStreamAsync(handle, prompt, options, onToken, cancelFlag?, logprobs?)")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return QueueStreamingGenerate(env, MakeGenerateCall(env, info), info[3].As<Napi::Function>(), info[4], info[5]);
+}
+
+// Embed texts asynchronously - returns Promise<{count, dimensions, length, values: Float32Array}>
+Napi::Value EmbedAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_embed || !fn_free_floats) {
+    Napi::Error::New(env, "Embeddings not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray()) {
+    Napi::TypeError::New(env, "Usage: embedAsync(handle, texts, options?)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t handle = info[0].As<Napi::Number>().Int32Value();
+  std::string textsJson = StringifyOptions(env, info[1]);
+  std::string optionsJson = StringifyOptions(env, info[2]);
+  auto* worker = new FloatsWorker(env, [handle, textsJson, optionsJson](float** values) {
+    return fn_embed(handle, textsJson.c_str(), optionsJson.c_str(), values);
+  });
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Score continuations asynchronously - returns Promise<{count, tokenCounts, length, values: Float32Array}>
+Napi::Value ScoreAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_score || !fn_free_floats) {
+    Napi::Error::New(env, "Scoring not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsArray() || !info[2].IsArray()) {
+    Napi::TypeError::New(env, "Usage: scoreAsync(handle, prompts, continuations)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t handle = info[0].As<Napi::Number>().Int32Value();
+  std::string promptsJson = StringifyOptions(env, info[1]);
+  std::string continuationsJson = StringifyOptions(env, info[2]);
+  auto* worker = new FloatsWorker(env, [handle, promptsJson, continuationsJson](float** values) {
+    return fn_score(handle, promptsJson.c_str(), continuationsJson.c_str(), values);
+  });
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Create a chat session on a loaded model - returns the session handle
+Napi::Value CreateSession(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_create) {
+    Napi::Error::New(env, "Sessions not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Model handle number required").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t session = fn_session_create(info[0].As<Napi::Number>().Int32Value());
+
+  if (session < 0) {
+    Napi::Error::New(env, "Failed to create session (model not loaded?)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, session);
+}
+
+// Append text to a session - returns the number of tokens added
+Napi::Value SessionAppend(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_append) {
+    Napi::Error::New(env, "Sessions not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+    Napi::TypeError::New(env, "Usage: sessionAppend(session, text)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::string text = info[1].As<Napi::String>().Utf8Value();
+  int32_t count = fn_session_append(info[0].As<Napi::Number>().Int32Value(), text.c_str());
+
+  if (count < 0) {
+    Napi::Error::New(env, "Cannot append to session (freed or generating)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, count);
+}
+
+// Generate the next turn of a session asynchronously - returns Promise<string>
+// with the JSON result. With an onToken function, tokens are streamed to it.
+Napi::Value SessionGenerateAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_generate) {
+    Napi::Error::New(env, "Sessions not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Usage: sessionGenerateAsync(session, options?, onToken?, cancelFlag?, logprobs?)")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t session = info[0].As<Napi::Number>().Int32Value();
+  std::string optionsJson = StringifyOptions(env, info[1]);
+
+  GenerateCall call = [session, optionsJson = std::move(optionsJson)](
+                          node_mlx_token_callback onToken, void* userData, const int32_t* cancelFlag,
+                          float* logprobs, int64_t logprobsLength) {
+    return fn_session_generate(session, optionsJson.c_str(), onToken, userData, cancelFlag, logprobs,
+                               logprobsLength);
+  };
+
+  if (info[2].IsFunction()) {
+    return QueueStreamingGenerate(env, std::move(call), info[2].As<Napi::Function>(), info[3], info[4]);
+  }
+
+  auto* worker = new GenerateWorker(env, std::move(call), ParseCancelFlag(info[3]), ParseLogprobsBuffer(info[4]));
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Drop the last nTokens tokens of a session - returns the remaining token count
+Napi::Value SessionRewind(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_rewind) {
+    Napi::Error::New(env, "Sessions not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+    Napi::TypeError::New(env, "Usage: sessionRewind(session, nTokens)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t remaining =
+      fn_session_rewind(info[0].As<Napi::Number>().Int32Value(), info[1].As<Napi::Number>().Int32Value());
+
+  if (remaining < 0) {
+    Napi::Error::New(env, "Cannot rewind session (freed or generating)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, remaining);
+}
+
+// Save a session's tokens and KV cache to a file asynchronously - returns Promise<number>
+Napi::Value SessionSaveAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_save) {
+    Napi::Error::New(env, "Session files not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+    Napi::TypeError::New(env, "Usage: sessionSaveAsync(session, path)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t session = info[0].As<Napi::Number>().Int32Value();
+  std::string path = info[1].As<Napi::String>().Utf8Value();
+
+  auto* worker = new StatusWorker(
+      env, [session, path]() { return fn_session_save(session, path.c_str()); },
+      "Failed to save session to " + path + " (freed, generating or not writable)");
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Restore a saved session on a loaded model asynchronously - returns Promise<number> with the session handle
+Napi::Value SessionLoadAsync(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_session_load) {
+    Napi::Error::New(env, "Session files not available").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+    Napi::TypeError::New(env, "Usage: sessionLoadAsync(handle, path)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t handle = info[0].As<Napi::Number>().Int32Value();
+  std::string path = info[1].As<Napi::String>().Utf8Value();
+
+  auto* worker = new StatusWorker(
+      env, [handle, path]() { return fn_session_load(handle, path.c_str()); },
+      "Failed to load session from " + path + " (missing file or saved with a different model?)");
+  Napi::Promise promise = worker->Promise();
+  worker->Queue();
+
+  return promise;
+}
+
+// Free a session and its KV cache
+Napi::Value FreeSession(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (fn_session_free && info.Length() >= 1 && info[0].IsNumber()) {
+    fn_session_free(info[0].As<Napi::Number>().Int32Value());
+  }
+
+  return env.Undefined();
+}
+
 // Check if model is a VLM (Vision-Language Model)
 Napi::Value IsVLM(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
@@ -373,6 +1078,25 @@ Napi::Value GetVersion(const Napi::CallbackInfo& info) {
   return Napi::String::New(env, "0.1.0");
 }
 
+// Limit the memory of all loaded models (0 = unlimited)
+Napi::Value SetMemoryBudget(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!fn_set_memory_budget) {
+    Napi::Error::New(env, "Memory budget not available").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "Budget in bytes required").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  fn_set_memory_budget(info[0].As<Napi::Number>().Int64Value());
+
+  return env.Undefined();
+}
+
 // Check if library is initialized
 Napi::Value IsInitialized(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
@@ -386,9 +1110,23 @@ Napi::Object Init(Napi::Env env, Napi::Object exports) {
   exports.Set("loadModel", Napi::Function::New(env, LoadModel));
   exports.Set("unloadModel", Napi::Function::New(env, UnloadModel));
   exports.Set("generate", Napi::Function::New(env, Generate));
+  exports.Set("loadModelAsync", Napi::Function::New(env, LoadModelAsync));
+  exports.Set("unloadModelAsync", Napi::Function::New(env, UnloadModelAsync));
+  exports.Set("generateAsync", Napi::Function::New(env, GenerateAsync));
+  exports.Set("generateStreamAsync", Napi::Function::New(env, GenerateStreamAsync));
+  exports.Set("embedAsync", Napi::Function::New(env, EmbedAsync));
+  exports.Set("scoreAsync", Napi::Function::New(env, ScoreAsync));
+  exports.Set("createSession", Napi::Function::New(env, CreateSession));
+  exports.Set("sessionAppend", Napi::Function::New(env, SessionAppend));
+  exports.Set("sessionGenerateAsync", Napi::Function::New(env, SessionGenerateAsync));
+  exports.Set("sessionRewind", Napi::Function::New(env, SessionRewind));
+  exports.Set("sessionSaveAsync", Napi::Function::New(env, SessionSaveAsync));
+  exports.Set("sessionLoadAsync", Napi::Function::New(env, SessionLoadAsync));
+  exports.Set("freeSession", Napi::Function::New(env, FreeSession));
   exports.Set("generateStreaming", Napi::Function::New(env, GenerateStreaming));
   exports.Set("generateWithImage", Napi::Function::New(env, GenerateWithImage));
   exports.Set("isVLM", Napi::Function::New(env, IsVLM));
+  exports.Set("setMemoryBudget", Napi::Function::New(env, SetMemoryBudget));
   exports.Set("isAvailable", Napi::Function::New(env, IsAvailable));
   exports.Set("getVersion", Napi::Function::New(env, GetVersion));
 
@@ -261,26 +261,35 @@ function runInteractive(initialModel: string): void {
 
     try {
       let result
+      let content: string
 
       // Check if we have an image to send
       if (state.imagePath && state.model.isVLM()) {
         result = state.model.generateWithImage(fullPrompt, state.imagePath, state.options)
         state.imagePath = null // Clear after use
+        // VLM output goes straight to stdout, so the text is not available here
+        content = "[streamed response]"
       } else {
-        // Use streaming - tokens are written directly to stdout
-        result = state.model.generateStreaming(fullPrompt, state.options)
+        // Stream tokens through the callback so the response can be kept in history
+        const generated = await state.model.generateStreamAsync(
+          fullPrompt,
+          (token) => {
+            process.stdout.write(token)
+          },
+          state.options
+        )
+
+        result = generated
+        content = generated.text
       }
 
-      // Note: text already streamed, we only have stats
       log("")
       log(
         `${colors.dim}(${String(result.tokenCount)} tokens, ${result.tokensPerSecond.toFixed(1)} tok/s)${colors.reset}`
       )
       log("")
 
-      // For history we'd need to capture the text, but streaming writes to stdout
-      // For now, history won't track assistant responses in streaming mode
-      state.history.push({ role: "assistant", content: "[streamed response]" })
+      state.history.push({ role: "assistant", content })
     } catch (err) {
       log("")
       error(err instanceof Error ? err.message : String(err))
@@ -294,7 +303,7 @@ function runInteractive(initialModel: string): void {
     log(`${colors.dim}Goodbye!${colors.reset}`)
 
     if (state.model) {
-      state.model.unload()
+      void state.model.unload()
     }
 
     process.exit(0)
@@ -357,7 +366,7 @@ async function handleCommand(input: string, state: ChatState, rl: readline.Inter
         log(`${colors.dim}Loading ${arg}...${colors.reset}`)
 
         if (state.model) {
-          state.model.unload()
+          await state.model.unload()
         }
 
         try {
@@ -479,7 +488,7 @@ function runOneShot(
     if (imagePath) {
       if (!model.isVLM()) {
         error(`Model ${modelName} doesn't support images. Use a VLM like gemma-3-4b.`)
-        model.unload()
+        void model.unload()
         process.exit(1)
       }
 
@@ -495,7 +504,7 @@ function runOneShot(
       `${colors.dim}(${String(result.tokenCount)} tokens, ${result.tokensPerSecond.toFixed(1)} tok/s)${colors.reset}`
     )
 
-    model.unload()
+    void model.unload()
   } catch (err) {
     error(err instanceof Error ? err.message : String(err))
     process.exit(1)
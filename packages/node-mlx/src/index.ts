@@ -15,47 +15,114 @@ const packageJson = JSON.parse(readFileSync(packageJsonPath, "utf-8")) as { vers
 /** Package version */
 export const VERSION = packageJson.version
 
+// Options passed to the native generate functions
+interface NativeGenerationOptions {
+  maxTokens?: number
+  temperature?: number
+  topP?: number
+  topK?: number
+  minP?: number
+  repetitionPenalty?: number
+  repetitionContextSize?: number
+  frequencyPenalty?: number
+  presencePenalty?: number
+  timeout?: number
+  maxPrefillTime?: number
+  prefillStepSize?: number
+  numDraftTokens?: number
+  promptLookupNgramSize?: number
+  kvBits?: number
+  kvGroupSize?: number
+  quantizedKvStart?: number
+  regex?: string
+  jsonSchema?: string
+  logprobs?: number
+}
+
+// Options passed to the native load functions
+interface NativeLoadOptions {
+  prefixCacheBytes?: number
+  batchCacheBytes?: number
+  draftModel?: string
+  compiledCacheDir?: string
+}
+
+// Options passed to the native embed function
+interface NativeEmbedOptions {
+  pooling?: Pooling
+  layer?: number
+  normalize?: boolean
+}
+
+// Results of the native embed and score functions, with their floats in one buffer
+interface NativeEmbeddings {
+  count: number
+  dimensions: number
+  values: Float32Array
+}
+
+interface NativeScores {
+  count: number
+  tokenCounts: number[]
+  values: Float32Array
+}
+
 // Native binding interface
 interface NativeBinding {
   initialize(dylibPath: string): boolean
   isInitialized(): boolean
-  loadModel(modelId: string): number
+  loadModel(modelId: string, options?: NativeLoadOptions): number
   unloadModel(handle: number): void
   generate(
     handle: number,
     prompt: string,
-    options?: {
-      maxTokens?: number
-      temperature?: number
-      topP?: number
-      repetitionPenalty?: number
-      repetitionContextSize?: number
-    }
+    options?: NativeGenerationOptions
   ): string // Returns JSON string
+  loadModelAsync(modelId: string, options?: NativeLoadOptions): Promise<number>
+  unloadModelAsync(handle: number): Promise<number> // Resolves once the memory is released
+  generateAsync(
+    handle: number,
+    prompt: string,
+    options?: NativeGenerationOptions,
+    cancelFlag?: Int32Array,
+    logprobs?: Float32Array
+  ): Promise<string> // Resolves with JSON string
+  generateStreamAsync(
+    handle: number,
+    prompt: string,
+    options: NativeGenerationOptions,
+    onToken: TokenCallback,
+    cancelFlag?: Int32Array,
+    logprobs?: Float32Array
+  ): Promise<string> // Calls onToken per token, resolves with JSON string after the last one
+  embedAsync(handle: number, texts: string[], options?: NativeEmbedOptions): Promise<NativeEmbeddings>
+  scoreAsync(handle: number, prompts: string[], continuations: string[]): Promise<NativeScores>
+  createSession(handle: number): number
+  sessionAppend(session: number, text: string): number // Returns tokens added
+  sessionGenerateAsync(
+    session: number,
+    options?: NativeGenerationOptions,
+    onToken?: TokenCallback,
+    cancelFlag?: Int32Array,
+    logprobs?: Float32Array
+  ): Promise<string> // Resolves with JSON string
+  sessionRewind(session: number, nTokens: number): number // Returns remaining tokens
+  sessionSaveAsync(session: number, path: string): Promise<number>
+  sessionLoadAsync(handle: number, path: string): Promise<number> // Resolves with the session handle
+  freeSession(session: number): void
   generateStreaming(
     handle: number,
     prompt: string,
-    options?: {
-      maxTokens?: number
-      temperature?: number
-      topP?: number
-      repetitionPenalty?: number
-      repetitionContextSize?: number
-    }
+    options?: NativeGenerationOptions
   ): string // Streams to stdout, returns JSON stats
   generateWithImage(
     handle: number,
     prompt: string,
     imagePath: string,
-    options?: {
-      maxTokens?: number
-      temperature?: number
-      topP?: number
-      repetitionPenalty?: number
-      repetitionContextSize?: number
-    }
+    options?: NativeGenerationOptions
   ): string // VLM: Streams to stdout, returns JSON stats
   isVLM(handle: number): boolean
+  setMemoryBudget(bytes: number): void
   isAvailable(): boolean
   getVersion(): string
 }
@@ -67,6 +134,9 @@ interface JSONGenerationResult {
   tokenCount?: number
   tokensPerSecond?: number
   error?: string
+  finishReason?: FinishReason
+  speculative?: SpeculativeStats
+  logprobs?: number // Alternatives per token written to the logprobs buffer
 }
 
 // Load the native addon
@@ -168,22 +238,201 @@ function loadBinding(): NativeBinding {
 
 // MARK: - Public Types
 
+export interface LoadOptions {
+  /**
+   * Memory budget in bytes for keeping the KV state of processed prompts, so
+   * requests that repeat a prefix (system prompt, chat history) skip
+   * re-processing it. Least recently used prefixes are evicted first.
+   * Default: 1 GiB; 0 disables prefix reuse.
+   */
+  prefixCacheBytes?: number
+  /**
+   * Memory budget in bytes for the KV state of concurrent requests that are
+   * decoded together. Together with `prefixCacheBytes` it sizes a fixed pool
+   * of KV blocks; requests wait for blocks when it is full.
+   * Default: 1 GiB; 0 runs every request on its own.
+   */
+  batchCacheBytes?: number
+  /**
+   * Smaller model of the same family (HuggingFace ID, local path or RECOMMENDED_MODELS
+   * alias) for speculative decoding. It drafts tokens that the main model verifies
+   * several at a time, which speeds up long completions. Both models must share a
+   * tokenizer; requests on the model then run one at a time instead of batched.
+   */
+  draftModel?: string
+  /**
+   * Directory for compiled models. The first load of a model stores its final,
+   * sanitized and quantized weights there (about the size of the model); later
+   * loads map that file directly and skip all weight conversion.
+   */
+  compiledCacheDir?: string
+}
+
 export interface GenerationOptions {
   maxTokens?: number
   temperature?: number
   topP?: number
+  /** Sample only from the k most likely tokens (default: 0 = all, async methods only) */
+  topK?: number
+  /**
+   * Drop tokens less likely than this fraction of the most likely token
+   * (e.g. 0.05; default: 0 = off, async methods only)
+   */
+  minP?: number
   /** Penalty for repeating tokens (1.0 = no penalty, 1.1-1.2 recommended) */
   repetitionPenalty?: number
-  /** Number of recent tokens to consider for penalty (default: 20) */
+  /** Number of recent tokens, prompt included, the penalties look at (default: 20) */
   repetitionContextSize?: number
+  /**
+   * Lower a token's logit by this much per occurrence in the penalty window
+   * (default: 0, async methods only)
+   */
+  frequencyPenalty?: number
+  /** Lower the logit of every token in the penalty window by this much (default: 0, async methods only) */
+  presencePenalty?: number
+  /**
+   * Abort an in-flight generation (async methods only). The promise rejects with
+   * `signal.reason`; the device is released within one decode step.
+   */
+  signal?: AbortSignal
+  /** Wall-clock limit in milliseconds; generation ends with finishReason "timeout" (async methods only) */
+  timeout?: number
+  /** Limit for processing the prompt in milliseconds (async methods only) */
+  maxPrefillTime?: number
+  /**
+   * Maximum prompt tokens processed per forward pass (default: 2048, async methods only).
+   * Smaller chunks lower peak memory for long prompts and let concurrent requests
+   * keep decoding while a long prompt is processed.
+   */
+  prefillStepSize?: number
+  /** Tokens drafted per verification step with a `draftModel` or prompt lookup (default: 3) */
+  numDraftTokens?: number
+  /**
+   * Enable prompt-lookup speculative decoding without a draft model: the last n tokens are
+   * matched against the prompt and earlier output, and what followed is proposed as the
+   * continuation. Pays off when the output copies spans of the prompt (code edits, RAG).
+   * Typical values: 2-4. Default: 0 (off, async methods only).
+   */
+  promptLookupNgramSize?: number
+  /**
+   * Store the KV cache quantized to this many bits (4 or 8, async methods only).
+   * A 4-bit cache takes about a quarter of the memory, so much longer contexts fit.
+   * Default: full precision.
+   */
+  kvBits?: number
+  /** Quantization group size of the KV cache (default: 64) */
+  kvGroupSize?: number
+  /** Number of cached tokens after which the KV cache is quantized (default: 0) */
+  quantizedKvStart?: number
+  /**
+   * Constrain the output to match this regular expression as a whole (async methods only).
+   * Supports classes, groups, alternation and the usual quantifiers; no anchors or backreferences.
+   */
+  regex?: string
+  /**
+   * Constrain the output to JSON matching this schema, as an object or JSON text
+   * (async methods only). Properties are written in schema order with `, ` and `: `
+   * separators; recursive schemas are not supported. Takes precedence over `regex`.
+   */
+  jsonSchema?: object | string
+  /**
+   * Report the log-probability of each generated token and of the `logprobs` most
+   * likely tokens at its position (async methods only, 0 for the chosen tokens alone).
+   * Values come from the model's logits before penalties and sampling parameters.
+   */
+  logprobs?: number
+}
+
+/** How the hidden states of a text's tokens are combined into one vector */
+export type Pooling = "mean" | "last" | "cls"
+
+export interface EmbedOptions {
+  /**
+   * How token states are combined (default: "mean"). "last" uses the last token,
+   * which has attended to the whole text; "cls" the first one (usually BOS)
+   */
+  pooling?: Pooling
+  /**
+   * Hidden state to read, indexed like Hugging Face's `hidden_states`: 0 is the
+   * token embeddings, `i` the output of layer `i`, negative values count from the
+   * end (default: -1, the final normalized state)
+   */
+  layer?: number
+  /** Scale each vector to unit length, so dot products are cosine similarities (default: true) */
+  normalize?: boolean
+}
+
+export interface Embeddings {
+  /** All vectors in one buffer: text `i` occupies `[i * dimensions, (i + 1) * dimensions)` */
+  data: Float32Array
+  /** Number of texts */
+  count: number
+  /** Length of each vector (the model's hidden size) */
+  dimensions: number
+}
+
+export interface Scores {
+  /**
+   * Natural-log probability of every continuation token given the prompt and the
+   * tokens before it: continuation `i` occupies `[offsets[i], offsets[i + 1])`
+   */
+  logprobs: Float32Array
+  /** Start of each continuation in `logprobs`, plus the total length (count + 1 entries) */
+  offsets: Uint32Array
+  /** Log-probability of each whole continuation (the sum of its tokens) */
+  totals: Float32Array
+  /** Number of continuations */
+  count: number
 }
 
+/** Why a generation finished */
+export type FinishReason = "stop" | "length" | "cancelled" | "timeout"
+
 export interface GenerationResult {
   text: string
   tokenCount: number
   tokensPerSecond: number
+  /** Why generation finished (async methods only) */
+  finishReason?: FinishReason
+  /** Acceptance stats when speculative decoding was used */
+  speculative?: SpeculativeStats
+  /** Per-token log-probabilities when `logprobs` was requested */
+  logprobs?: Logprobs
+}
+
+/** Natural-log probabilities of generated tokens and their most likely alternatives */
+export interface Logprobs {
+  /** Log-probability of each generated token */
+  tokens: Float32Array
+  /** Alternatives per token */
+  top: number
+  /**
+   * IDs of the `top` most likely tokens at each position, most likely first:
+   * token `i` occupies `[i * top, (i + 1) * top)`. Unused slots hold -1
+   */
+  topTokens: Int32Array
+  /** Log-probabilities of `topTokens` (-Infinity for unused slots) */
+  topLogprobs: Float32Array
 }
 
+/** How many drafted tokens the model accepted during speculative decoding */
+export interface SpeculativeStats {
+  /** Tokens proposed for verification */
+  draftTokens: number
+  /** Proposed tokens the model agreed with */
+  acceptedTokens: number
+  /** acceptedTokens / draftTokens */
+  acceptanceRate: number
+  /** Forward passes of the main model that verified proposals */
+  verificationSteps: number
+}
+
+/**
+ * Receives each generated token as soon as it is decoded.
+ * Return `false` to stop generation early.
+ */
+export type TokenCallback = (token: string) => boolean | void
+
 export interface StreamingResult {
   tokenCount: number
   tokensPerSecond: number
@@ -193,22 +442,98 @@ export interface Model {
   /** Generate text from a prompt */
   generate(prompt: string, options?: GenerationOptions): GenerationResult
 
+  /** Generate text without blocking the event loop - runs on a worker thread */
+  generateAsync(prompt: string, options?: GenerationOptions): Promise<GenerationResult>
+
+  /**
+   * Generate text without blocking the event loop, calling `onToken` for each token.
+   * Resolves after the last token has been delivered.
+   */
+  generateStreamAsync(
+    prompt: string,
+    onToken: TokenCallback,
+    options?: GenerationOptions
+  ): Promise<GenerationResult>
+
+  /**
+   * Stream tokens as an async iterator. Breaking out of the loop stops generation;
+   * the iterator's return value holds the final result.
+   */
+  stream(prompt: string, options?: GenerationOptions): AsyncGenerator<string, GenerationResult>
+
   /** Generate text with streaming - tokens are written directly to stdout */
   generateStreaming(prompt: string, options?: GenerationOptions): StreamingResult
 
   /** Generate text from a prompt with an image (VLM only) */
   generateWithImage(prompt: string, imagePath: string, options?: GenerationOptions): StreamingResult
 
+  /**
+   * Embed texts with the model's hidden states (no LM head) - runs on a worker thread.
+   * Texts are batched by length, so one call with many texts is much faster than
+   * many calls with one.
+   */
+  embed(texts: string[], options?: EmbedOptions): Promise<Embeddings>
+
+  /**
+   * Score continuations of prompts in batched forward passes - runs on a worker thread.
+   * `prompts` holds one prompt per continuation, or a single prompt for all of them.
+   * Continuations of the same prompt share its prefill (and the prefix cache), so
+   * ranking many candidates or labels costs little more than reading the prompt once.
+   * Continuations are tokenized on their own, so start them with a space where the
+   * tokenizer expects one.
+   */
+  score(prompts: string | string[], continuations: string[]): Promise<Scores>
+
   /** Check if this model supports images (is a Vision-Language Model) */
   isVLM(): boolean
 
-  /** Unload the model from memory */
-  unload(): void
+  /** Start a multi-turn session that keeps its KV cache between turns */
+  createSession(): Session
+
+  /**
+   * Restore a session saved with `Session.save()`. Prompts that start with its
+   * tokens also skip their prefill in `generateAsync()`. Rejects if the file was
+   * saved with a different model.
+   */
+  loadSession(path: string): Promise<Session>
+
+  /**
+   * Unload the model from memory. Generations still running or queued on it
+   * finish as cancelled; resolves once the memory is released.
+   */
+  unload(): Promise<void>
 
   /** Model handle (internal use) */
   readonly handle: number
 }
 
+/**
+ * A multi-turn conversation that keeps its KV cache alive between turns.
+ * Each turn only processes the tokens appended since the previous one.
+ */
+export interface Session {
+  /** Append text (e.g. a formatted chat turn); returns the number of tokens added */
+  append(text: string): number
+
+  /** Generate the next turn; the reply becomes part of the session */
+  generate(options?: GenerationOptions): Promise<GenerationResult>
+
+  /** Like `generate`, calling `onToken` for each token as it is produced */
+  generateStream(onToken: TokenCallback, options?: GenerationOptions): Promise<GenerationResult>
+
+  /** Drop the last `nTokens` tokens (e.g. to retry a reply); returns the remaining token count */
+  rewind(nTokens: number): number
+
+  /** Save the tokens and KV cache to a file, to restore with `Model.loadSession()` */
+  save(path: string): Promise<void>
+
+  /** Release the session and its KV cache */
+  free(): void
+
+  /** Session handle (internal use) */
+  readonly handle: number
+}
+
 // MARK: - Recommended Models
 
 export const RECOMMENDED_MODELS = {
@@ -295,21 +620,30 @@ export function getVersion(): string {
 }
 
 /**
- * Load a model from HuggingFace or local path
+ * Limit the memory all loaded models may take together
  *
- * @param modelId - HuggingFace model ID (e.g., "mlx-community/gemma-3n-E2B-it-4bit") or local path
- * @returns Model instance
+ * Each model counts with its weights, the KV cache budgets from its load
+ * options and the KV caches of its sessions after their last turn. Caches of
+ * single requests live only while the request runs and are not counted.
+ * Loading a model that does not fit unloads the least recently used models
+ * that are not serving a request; using an unloaded model afterwards throws.
+ * A load that cannot make enough room fails instead.
+ *
+ * @param bytes - Budget in bytes, or 0 for no limit (the default)
  *
  * @example
  * ```typescript
- * import { loadModel, RECOMMENDED_MODELS } from "node-mlx"
- *
- * const model = loadModel(RECOMMENDED_MODELS["gemma-3n"])
- * const result = model.generate("Hello, world!")
- * console.log(result.text)
- * model.unload()
+ * setMemoryBudget(24 * 1024 ** 3)
+ * const chat = await loadModelAsync("qwen")
+ * const code = await loadModelAsync("phi4") // May unload "qwen" if idle
  * ```
  */
+export function setMemoryBudget(bytes: number): void {
+  const b = loadBinding()
+
+  b.setMemoryBudget(bytes)
+}
+
 /**
  * Resolve a model ID or alias to a full HuggingFace model ID
  * @param modelId - Either a full HuggingFace model ID (e.g., "mlx-community/phi-4-4bit") or a short alias (e.g., "phi4")
@@ -325,56 +659,299 @@ function resolveModelId(modelId: string): string {
   return modelId
 }
 
-export function loadModel(modelId: string): Model {
-  const b = loadBinding()
-  const resolvedId = resolveModelId(modelId)
-  const handle = b.loadModel(resolvedId)
+/**
+ * Apply defaults and map public generation options to the native options object
+ */
+function toNativeOptions(options?: GenerationOptions): NativeGenerationOptions {
+  return {
+    maxTokens: options?.maxTokens ?? 256,
+    temperature: options?.temperature ?? 0.7,
+    topP: options?.topP ?? 0.9,
+    topK: options?.topK,
+    minP: options?.minP,
+    repetitionPenalty: options?.repetitionPenalty ?? 1.1,
+    repetitionContextSize: options?.repetitionContextSize ?? 20,
+    frequencyPenalty: options?.frequencyPenalty,
+    presencePenalty: options?.presencePenalty,
+    timeout: options?.timeout,
+    maxPrefillTime: options?.maxPrefillTime,
+    prefillStepSize: options?.prefillStepSize,
+    numDraftTokens: options?.numDraftTokens,
+    promptLookupNgramSize: options?.promptLookupNgramSize,
+    kvBits: options?.kvBits,
+    kvGroupSize: options?.kvGroupSize,
+    quantizedKvStart: options?.quantizedKvStart,
+    regex: options?.regex,
+    jsonSchema:
+      typeof options?.jsonSchema === "object" ? JSON.stringify(options.jsonSchema) : options?.jsonSchema,
+    logprobs: options?.logprobs === undefined ? undefined : Math.floor(options.logprobs)
+  }
+}
+
+/**
+ * Allocate the buffer Swift writes log-probabilities into when they are requested:
+ * one value, `top` IDs and `top` values per token, for up to `maxTokens` tokens
+ */
+function allocateLogprobs(options: NativeGenerationOptions): Float32Array | undefined {
+  if (options.logprobs === undefined || options.logprobs < 0) {
+    return undefined
+  }
+
+  return new Float32Array(Math.max(options.maxTokens ?? 0, 0) * (1 + 2 * options.logprobs))
+}
 
+/**
+ * Map public load options to the native options object
+ */
+function toNativeLoadOptions(options: LoadOptions): NativeLoadOptions {
   return {
-    handle,
+    prefixCacheBytes: options.prefixCacheBytes,
+    batchCacheBytes: options.batchCacheBytes,
+    draftModel: options.draftModel === undefined ? undefined : resolveModelId(options.draftModel),
+    compiledCacheDir: options.compiledCacheDir
+  }
+}
 
-    generate(prompt: string, options?: GenerationOptions): GenerationResult {
-      const jsonStr = b.generate(handle, prompt, {
-        maxTokens: options?.maxTokens ?? 256,
-        temperature: options?.temperature ?? 0.7,
-        topP: options?.topP ?? 0.9,
-        repetitionPenalty: options?.repetitionPenalty ?? 1.1,
-        repetitionContextSize: options?.repetitionContextSize ?? 20
-      })
+/**
+ * Run a native generation that observes an AbortSignal through a shared
+ * cancellation flag, which Swift polls once per decode step. Rejects with
+ * `signal.reason` if the signal aborts before or during generation.
+ */
+async function withAbortSignal(
+  signal: AbortSignal | undefined,
+  run: (cancelFlag?: Int32Array) => Promise<string>
+): Promise<string> {
+  if (!signal) {
+    return run()
+  }
+
+  signal.throwIfAborted()
+
+  const cancelFlag = new Int32Array(new SharedArrayBuffer(Int32Array.BYTES_PER_ELEMENT))
+  const onAbort = (): void => {
+    Atomics.store(cancelFlag, 0, 1)
+  }
+
+  signal.addEventListener("abort", onAbort, { once: true })
+
+  try {
+    const jsonStr = await run(cancelFlag)
+
+    signal.throwIfAborted()
+
+    return jsonStr
+  } finally {
+    signal.removeEventListener("abort", onAbort)
+  }
+}
+
+/**
+ * Parse a JSON result from Swift, throwing on failure
+ */
+function parseResult(jsonStr: string): JSONGenerationResult {
+  const result = JSON.parse(jsonStr) as JSONGenerationResult
+
+  if (!result.success) {
+    throw new Error(result.error ?? "Generation failed")
+  }
+
+  return result
+}
+
+function toGenerationResult(result: JSONGenerationResult, logprobs?: Float32Array): GenerationResult {
+  return {
+    text: result.text ?? "",
+    tokenCount: result.tokenCount ?? 0,
+    tokensPerSecond: result.tokensPerSecond ?? 0,
+    finishReason: result.finishReason,
+    speculative: result.speculative,
+    logprobs: logprobs && toLogprobs(result, logprobs)
+  }
+}
+
+/**
+ * Unpack the buffer written by Swift: the chosen tokens' values, then all
+ * alternative IDs (stored as int32), then all alternative values
+ */
+function toLogprobs(result: JSONGenerationResult, buffer: Float32Array): Logprobs | undefined {
+  if (result.logprobs === undefined) {
+    return undefined
+  }
+
+  const count = result.tokenCount ?? 0
+  const top = result.logprobs
+
+  return {
+    tokens: buffer.subarray(0, count),
+    top,
+    topTokens: new Int32Array(buffer.buffer, buffer.byteOffset + count * 4, count * top),
+    topLogprobs: buffer.subarray(count + count * top, count + 2 * count * top)
+  }
+}
 
-      const result = JSON.parse(jsonStr) as JSONGenerationResult
+function toStreamingResult(result: JSONGenerationResult): StreamingResult {
+  return {
+    tokenCount: result.tokenCount ?? 0,
+    tokensPerSecond: result.tokensPerSecond ?? 0
+  }
+}
+
+/**
+ * Adapt the callback-based native stream to an async iterator
+ */
+async function* streamTokens(
+  b: NativeBinding,
+  handle: number,
+  prompt: string,
+  options?: GenerationOptions
+): AsyncGenerator<string, GenerationResult> {
+  const queue: string[] = []
+  let finished = false
+  let stopped = false
+  let wake: (() => void) | null = null
+
+  const notify = (): void => {
+    wake?.()
+    wake = null
+  }
 
-      if (!result.success) {
-        throw new Error(result.error ?? "Generation failed")
+  const nativeOptions = toNativeOptions(options)
+  const logprobs = allocateLogprobs(nativeOptions)
+  const completion = withAbortSignal(options?.signal, (cancelFlag) =>
+    b.generateStreamAsync(
+      handle,
+      prompt,
+      nativeOptions,
+      (token) => {
+        queue.push(token)
+        notify()
+
+        return !stopped
+      },
+      cancelFlag,
+      logprobs
+    )
+  ).finally(() => {
+    finished = true
+    notify()
+  })
+
+  // Errors surface through `await completion` below; don't report them twice
+  // when the consumer stops iterating early
+  completion.catch(() => undefined)
+
+  try {
+    for (;;) {
+      const token = queue.shift()
+
+      if (token !== undefined) {
+        yield token
+        continue
       }
 
-      return {
-        text: result.text ?? "",
-        tokenCount: result.tokenCount ?? 0,
-        tokensPerSecond: result.tokensPerSecond ?? 0
+      if (finished) {
+        break
       }
-    },
 
-    generateStreaming(prompt: string, options?: GenerationOptions): StreamingResult {
-      // Tokens are written directly to stdout by Swift
-      const jsonStr = b.generateStreaming(handle, prompt, {
-        maxTokens: options?.maxTokens ?? 256,
-        temperature: options?.temperature ?? 0.7,
-        topP: options?.topP ?? 0.9,
-        repetitionPenalty: options?.repetitionPenalty ?? 1.1,
-        repetitionContextSize: options?.repetitionContextSize ?? 20
+      await new Promise<void>((resolve) => {
+        wake = resolve
       })
+    }
 
-      const result = JSON.parse(jsonStr) as JSONGenerationResult
+    return toGenerationResult(parseResult(await completion), logprobs)
+  } finally {
+    stopped = true
+  }
+}
 
-      if (!result.success) {
-        throw new Error(result.error ?? "Generation failed")
-      }
+/**
+ * Wrap a native session handle in the public Session interface
+ */
+function createSession(b: NativeBinding, handle: number): Session {
+  const generate = async (
+    options: GenerationOptions | undefined,
+    onToken?: TokenCallback
+  ): Promise<GenerationResult> => {
+    const nativeOptions = toNativeOptions(options)
+    const logprobs = allocateLogprobs(nativeOptions)
+    const jsonStr = await withAbortSignal(options?.signal, (cancelFlag) =>
+      b.sessionGenerateAsync(handle, nativeOptions, onToken, cancelFlag, logprobs)
+    )
+
+    return toGenerationResult(parseResult(jsonStr), logprobs)
+  }
 
-      return {
-        tokenCount: result.tokenCount ?? 0,
-        tokensPerSecond: result.tokensPerSecond ?? 0
-      }
+  return {
+    handle,
+
+    append(text: string): number {
+      return b.sessionAppend(handle, text)
+    },
+
+    generate(options?: GenerationOptions): Promise<GenerationResult> {
+      return generate(options)
+    },
+
+    generateStream(onToken: TokenCallback, options?: GenerationOptions): Promise<GenerationResult> {
+      return generate(options, onToken)
+    },
+
+    rewind(nTokens: number): number {
+      return b.sessionRewind(handle, nTokens)
+    },
+
+    async save(path: string): Promise<void> {
+      await b.sessionSaveAsync(handle, path)
+    },
+
+    free(): void {
+      b.freeSession(handle)
+    }
+  }
+}
+
+/**
+ * Wrap a native model handle in the public Model interface
+ */
+function createModel(b: NativeBinding, handle: number): Model {
+  return {
+    handle,
+
+    generate(prompt: string, options?: GenerationOptions): GenerationResult {
+      return toGenerationResult(parseResult(b.generate(handle, prompt, toNativeOptions(options))))
+    },
+
+    async generateAsync(prompt: string, options?: GenerationOptions): Promise<GenerationResult> {
+      const nativeOptions = toNativeOptions(options)
+      const logprobs = allocateLogprobs(nativeOptions)
+      const jsonStr = await withAbortSignal(options?.signal, (cancelFlag) =>
+        b.generateAsync(handle, prompt, nativeOptions, cancelFlag, logprobs)
+      )
+
+      return toGenerationResult(parseResult(jsonStr), logprobs)
+    },
+
+    async generateStreamAsync(
+      prompt: string,
+      onToken: TokenCallback,
+      options?: GenerationOptions
+    ): Promise<GenerationResult> {
+      const nativeOptions = toNativeOptions(options)
+      const logprobs = allocateLogprobs(nativeOptions)
+      const jsonStr = await withAbortSignal(options?.signal, (cancelFlag) =>
+        b.generateStreamAsync(handle, prompt, nativeOptions, onToken, cancelFlag, logprobs)
+      )
+
+      return toGenerationResult(parseResult(jsonStr), logprobs)
+    },
+
+    stream(prompt: string, options?: GenerationOptions): AsyncGenerator<string, GenerationResult> {
+      return streamTokens(b, handle, prompt, options)
+    },
+
+    generateStreaming(prompt: string, options?: GenerationOptions): StreamingResult {
+      // Tokens are written directly to stdout by Swift
+      return toStreamingResult(parseResult(b.generateStreaming(handle, prompt, toNativeOptions(options))))
     },
 
     generateWithImage(
@@ -383,36 +960,122 @@ export function loadModel(modelId: string): Model {
       options?: GenerationOptions
     ): StreamingResult {
       // VLM generation with image - tokens are written directly to stdout by Swift
-      const jsonStr = b.generateWithImage(handle, prompt, imagePath, {
-        maxTokens: options?.maxTokens ?? 256,
-        temperature: options?.temperature ?? 0.7,
-        topP: options?.topP ?? 0.9,
-        repetitionPenalty: options?.repetitionPenalty ?? 1.1,
-        repetitionContextSize: options?.repetitionContextSize ?? 20
+      const jsonStr = b.generateWithImage(handle, prompt, imagePath, toNativeOptions(options))
+
+      return toStreamingResult(parseResult(jsonStr))
+    },
+
+    async embed(texts: string[], options?: EmbedOptions): Promise<Embeddings> {
+      if (texts.length === 0) {
+        return { data: new Float32Array(0), count: 0, dimensions: 0 }
+      }
+
+      const result = await b.embedAsync(handle, texts, {
+        pooling: options?.pooling,
+        layer: options?.layer,
+        normalize: options?.normalize
       })
 
-      const result = JSON.parse(jsonStr) as JSONGenerationResult
+      return { data: result.values, count: result.count, dimensions: result.dimensions }
+    },
+
+    async score(prompts: string | string[], continuations: string[]): Promise<Scores> {
+      const promptList = typeof prompts === "string" ? continuations.map(() => prompts) : prompts
 
-      if (!result.success) {
-        throw new Error(result.error ?? "Generation failed")
+      if (promptList.length !== continuations.length) {
+        throw new Error(`Got ${promptList.length} prompts for ${continuations.length} continuations`)
       }
 
-      return {
-        tokenCount: result.tokenCount ?? 0,
-        tokensPerSecond: result.tokensPerSecond ?? 0
+      if (continuations.length === 0) {
+        return { logprobs: new Float32Array(0), offsets: new Uint32Array(1), totals: new Float32Array(0), count: 0 }
       }
+
+      const result = await b.scoreAsync(handle, promptList, continuations)
+      const offsets = new Uint32Array(result.count + 1)
+      const totals = new Float32Array(result.count)
+
+      for (let i = 0; i < result.count; i++) {
+        let total = 0
+
+        offsets[i + 1] = offsets[i]! + result.tokenCounts[i]!
+
+        for (let j = offsets[i]!; j < offsets[i + 1]!; j++) {
+          total += result.values[j]!
+        }
+
+        totals[i] = total
+      }
+
+      return { logprobs: result.values, offsets, totals, count: result.count }
     },
 
     isVLM(): boolean {
       return b.isVLM(handle)
     },
 
-    unload(): void {
-      b.unloadModel(handle)
+    createSession(): Session {
+      return createSession(b, b.createSession(handle))
+    },
+
+    async loadSession(path: string): Promise<Session> {
+      return createSession(b, await b.sessionLoadAsync(handle, path))
+    },
+
+    async unload(): Promise<void> {
+      await b.unloadModelAsync(handle)
     }
   }
 }
 
+/**
+ * Load a model from HuggingFace or local path
+ *
+ * @param modelId - HuggingFace model ID (e.g., "mlx-community/gemma-3n-E2B-it-4bit") or local path
+ * @param options - Load options
+ * @returns Model instance
+ *
+ * @example
+ * ```typescript
+ * import { loadModel, RECOMMENDED_MODELS } from "node-mlx"
+ *
+ * const model = loadModel(RECOMMENDED_MODELS["gemma-3n"])
+ * const result = model.generate("Hello, world!")
+ * console.log(result.text)
+ * await model.unload()
+ * ```
+ */
+export function loadModel(modelId: string, options: LoadOptions = {}): Model {
+  const b = loadBinding()
+
+  return createModel(b, b.loadModel(resolveModelId(modelId), toNativeLoadOptions(options)))
+}
+
+/**
+ * Load a model without blocking the event loop
+ *
+ * Downloading and loading weights runs on a worker thread, so the process
+ * keeps serving other requests while a model is being loaded.
+ *
+ * A model that is already loaded from the same files shares its weights with
+ * the new handle; only its sessions and prefix cache are separate.
+ *
+ * @param modelId - HuggingFace model ID or local path (or a RECOMMENDED_MODELS alias)
+ * @param options - Load options
+ * @returns Promise resolving to the loaded Model
+ *
+ * @example
+ * ```typescript
+ * const model = await loadModelAsync("qwen")
+ * const result = await model.generateAsync("Hello!")
+ * ```
+ */
+export async function loadModelAsync(modelId: string, options: LoadOptions = {}): Promise<Model> {
+  const b = loadBinding()
+  const handle = await b.loadModelAsync(resolveModelId(modelId), toNativeLoadOptions(options))
+
+  return createModel(b, handle)
+}
+
 /**
  * Generate text using a model (one-shot, loads and unloads model)
  *
@@ -443,6 +1106,7 @@ export function generate(
   try {
     return model.generate(prompt, options)
   } finally {
-    model.unload()
+    // Unloading must not block this synchronous call
+    void model.unload()
   }
 }
@@ -25,6 +25,7 @@ describe("node-mlx", () => {
 
       // Core API
       expect(typeof exports.loadModel).toBe("function")
+      expect(typeof exports.loadModelAsync).toBe("function")
       expect(typeof exports.generate).toBe("function")
       expect(typeof exports.isSupported).toBe("function")
       expect(typeof exports.getVersion).toBe("function")
@@ -68,8 +69,8 @@ describe("node-mlx", () => {
       model = loadModel(RECOMMENDED_MODELS["qwen"])
     })
 
-    afterAll(() => {
-      model?.unload()
+    afterAll(async () => {
+      await model?.unload()
     })
 
     it("generates text", () => {
@@ -79,5 +80,91 @@ describe("node-mlx", () => {
       expect(result.tokenCount).toBeGreaterThan(0)
       expect(result.tokensPerSecond).toBeGreaterThan(0)
     })
+
+    it("generates text without blocking the event loop", async () => {
+      let ticks = 0
+      const timer = setInterval(() => ticks++, 10)
+
+      try {
+        const result = await model.generateAsync("Count to ten:", { maxTokens: 32 })
+
+        expect(result.text.length).toBeGreaterThan(0)
+        expect(ticks).toBeGreaterThan(0)
+      } finally {
+        clearInterval(timer)
+      }
+    })
+
+    it("streams tokens in order through the async iterator", async () => {
+      const tokens: string[] = []
+      const iterator = model.stream("Count to ten:", { maxTokens: 16 })
+      let next = await iterator.next()
+
+      while (!next.done) {
+        tokens.push(next.value)
+        next = await iterator.next()
+      }
+
+      expect(tokens.length).toBeGreaterThan(0)
+      expect(next.value.tokenCount).toBe(tokens.length)
+    })
+
+    it("stops streaming when the callback returns false", async () => {
+      let calls = 0
+      const result = await model.generateStreamAsync(
+        "Count to one hundred:",
+        () => {
+          calls++
+
+          return calls < 3
+        },
+        { maxTokens: 64 }
+      )
+
+      expect(calls).toBe(3)
+      expect(result.tokenCount).toBeLessThan(64)
+    })
+
+    it("embeds a batch of texts into one buffer", async () => {
+      const texts = ["The cat sat on the mat.", "A feline rested on a rug.", "Stock prices fell today."]
+      const { data, count, dimensions } = await model.embed(texts)
+      const similarity = (a: number, b: number): number => {
+        let dot = 0
+
+        for (let i = 0; i < dimensions; i++) {
+          dot += data[a * dimensions + i]! * data[b * dimensions + i]!
+        }
+
+        return dot
+      }
+
+      expect(count).toBe(3)
+      expect(data.length).toBe(count * dimensions)
+      expect(similarity(0, 0)).toBeCloseTo(1, 3)
+      expect(similarity(0, 1)).toBeGreaterThan(similarity(0, 2))
+    })
+
+    it("scores continuations of a shared prompt", async () => {
+      const labels = [" Paris", " Berlin", " a large city in France"]
+      const { logprobs, offsets, totals, count } = await model.score("The capital of France is", labels)
+
+      expect(count).toBe(3)
+      expect(offsets[3]).toBe(logprobs.length)
+      expect(offsets[3]).toBeGreaterThan(3)
+      expect(totals[0]).toBeLessThan(0)
+      expect(totals[0]).toBeGreaterThan(totals[1]!)
+    })
+
+    it("returns logprobs of generated tokens", async () => {
+      const result = await model.generateAsync("Hello", { maxTokens: 8, temperature: 0, repetitionPenalty: 1, logprobs: 3 })
+      const logprobs = result.logprobs!
+
+      expect(logprobs.top).toBe(3)
+      expect(logprobs.tokens.length).toBe(result.tokenCount)
+      expect(logprobs.topTokens.length).toBe(result.tokenCount * 3)
+      // Greedy decoding picks the most likely token
+      expect(logprobs.tokens[0]).toBeCloseTo(logprobs.topLogprobs[0]!, 4)
+      expect(logprobs.topLogprobs[0]).toBeGreaterThanOrEqual(logprobs.topLogprobs[1]!)
+    })
   })
 })
@@ -99,23 +99,226 @@ actor EngineManager {
     private var engines: [Int: LLMEngine] = [:]
     private var nextId = 1
 
-    func loadModel(id: String) async throws -> Int {
-        let engine = LLMEngine()
-        try await engine.loadModel(modelId: id)
+    /// Handles loaded from the same model files share one set of weights.
+    /// The weights count once against the memory budget, under the ID of the
+    /// handle that loaded them, together with each handle's KV block pool
+    /// and the KV caches of its sessions.
+    private struct SharedWeights {
+        let residencyId: Int
+        var engineIds: Set<Int>
+    }
+
+    private var sharedWeights: [String: SharedWeights] = [:]
+    private var weightsKeys: [Int: String] = [:]
+    private var pendingLoads: [String: Task<Void, Error>] = [:]
+
+    /// Footprints of loaded (and loading) models against the memory budget
+    private var residency = ResidencyManager()
+    private var loadingEngines: Set<Int> = []
+    private var activeRequests: [Int: Int] = [:]
+
+    private var sessions: [Int: (engineId: Int, session: ChatSession)] = [:]
+    /// KV cache bytes of each session as of its last turn, charged to its model
+    private var sessionBytes: [Int: Int] = [:]
+    private var busySessions: Set<Int> = []
+    private var nextSessionId = 1
+
+    func loadModel(id: String, options: JSONLoadOptions = JSONLoadOptions()) async throws -> Int {
+        let prefixCacheBytes = options.prefixCacheBytes ?? LLMEngine.defaultPrefixCacheBytes
+        let batchCacheBytes = options.batchCacheBytes ?? LLMEngine.defaultBatchCacheBytes
+        let engine = LLMEngine(
+            prefixCacheBytes: prefixCacheBytes,
+            batchCacheBytes: batchCacheBytes,
+            compiledCacheDir: options.compiledCacheDir.map { URL(fileURLWithPath: $0) }
+        )
+        let path = try await engine.resolvePath(modelId: id)
+        var draftPath: String?
+        if let draftModel = options.draftModel {
+            draftPath = try await engine.resolvePath(modelId: draftModel)
+        }
+        let key = try weightsKey(path: path, draftPath: draftPath)
+
+        // A load of the same weights is in flight; share its result
+        while let pending = pendingLoads[key] {
+            _ = await pending.result
+        }
 
         let engineId = nextId
         nextId += 1
-        engines[engineId] = engine
+        weightsKeys[engineId] = key
+        loadingEngines.insert(engineId)
+        defer { loadingEngines.remove(engineId) }
+
+        if let shared = sharedWeights[key], let source = shared.engineIds.lazy.compactMap({ self.engines[$0] }).first {
+            let view = LLMEngine(
+                sharingWeightsOf: source,
+                prefixCacheBytes: prefixCacheBytes,
+                batchCacheBytes: batchCacheBytes
+            )
+            do {
+                try await reserve(view.cacheFootprint, for: shared.residencyId)
+            } catch {
+                weightsKeys[engineId] = nil
+                throw error
+            }
+
+            // The weights may have been evicted while making room
+            guard var current = sharedWeights[key], current.residencyId == shared.residencyId else {
+                weightsKeys[engineId] = nil
+                throw NodeMLXError.memoryBudgetExceeded
+            }
+            current.engineIds.insert(engineId)
+            sharedWeights[key] = current
+            engines[engineId] = view
+            return engineId
+        }
+
+        let load = Task {
+            try await self.loadWeights(into: engine, engineId: engineId, key: key, path: path, draftPath: draftPath)
+        }
+        pendingLoads[key] = load
+        try await load.value
 
         return engineId
     }
 
-    func unloadModel(id: Int) {
-        if let engine = engines.removeValue(forKey: id) {
+    /// Loads a model's weights for a new handle and registers them for sharing.
+    private func loadWeights(
+        into engine: LLMEngine,
+        engineId: Int,
+        key: String,
+        path: String,
+        draftPath: String?
+    ) async throws {
+        defer { pendingLoads[key] = nil }
+
+        do {
+            try await reserve(engine.estimatedFootprint(ofModelAt: path, draftModelAt: draftPath), for: engineId)
+            try await engine.loadModel(modelId: path)
+            if let draftPath {
+                try await engine.loadDraftModel(modelId: draftPath)
+            }
+        } catch {
+            residency.remove(engineId)
+            weightsKeys[engineId] = nil
+            throw error
+        }
+
+        engines[engineId] = engine
+        sharedWeights[key] = SharedWeights(residencyId: engineId, engineIds: [engineId])
+        residency.resize(engineId, bytes: engine.memoryFootprint)
+    }
+
+    /// Identifies the weights of a model (and draft model) by path and revision.
+    private func weightsKey(path: String, draftPath: String?) throws -> String {
+        try [path, draftPath].compactMap { $0 }.map { path in
+            let url = URL(fileURLWithPath: path).resolvingSymlinksInPath()
+            return "\(url.path)@\(try modelRevision(at: url))"
+        }.joined(separator: "+")
+    }
+
+    /// Unloads a model and waits until its memory is released.
+    ///
+    /// Weights shared with other handles stay loaded until the last one is unloaded.
+    func unloadModel(id: Int) async {
+        for (sessionId, entry) in sessions where entry.engineId == id {
+            freeSession(id: sessionId)
+        }
+
+        guard let engine = engines.removeValue(forKey: id) else {
+            return
+        }
+        if let key = weightsKeys.removeValue(forKey: id), var shared = sharedWeights[key] {
+            shared.engineIds.remove(id)
+            if shared.engineIds.isEmpty {
+                sharedWeights[key] = nil
+                residency.remove(shared.residencyId)
+            } else {
+                sharedWeights[key] = shared
+                residency.resize(
+                    shared.residencyId,
+                    bytes: residency.footprint(of: shared.residencyId) - engine.cacheFootprint
+                )
+            }
+        }
+
+        // Solo generations would otherwise run to the end before the unload job
+        engine.cancelScheduledWork()
+
+        // Runs between decode steps, cancelling requests still in the batch
+        _ = try? await GenerationScheduler.shared.perform {
             engine.unload()
+            MLX.GPU.clearCache()
+        }
+    }
+
+    /// Sets the memory budget for all loaded models (nil = unlimited).
+    ///
+    /// A lower budget takes effect at the next load.
+    func setMemoryBudget(_ bytes: Int?) {
+        residency.budget = bytes
+    }
+
+    /// Reserves memory for a model about to be loaded, evicting least
+    /// recently used weights until it fits into the budget.
+    ///
+    /// The reservation is made before unloading, so concurrent loads cannot
+    /// overcommit the budget together. Weights used by a handle that is
+    /// loading or serving a request are never evicted.
+    ///
+    /// - Parameters:
+    ///   - bytes: Bytes to add
+    ///   - residencyId: Residency entry to charge them to (created if new)
+    private func reserve(_ bytes: Int, for residencyId: Int) async throws {
+        let busyEngines = busySessions.compactMap { sessions[$0]?.engineId }
+        let pinned = Set((loadingEngines.union(activeRequests.keys).union(busyEngines)).map(residencyId(of:)))
+
+        guard let victims = residency.victims(toFit: bytes, pinned: pinned) else {
+            throw NodeMLXError.memoryBudgetExceeded
+        }
+        for id in victims {
+            residency.remove(id)
+        }
+        residency.insert(residencyId, bytes: residency.footprint(of: residencyId) + bytes)
+
+        for victim in victims {
+            let handles = sharedWeights.values.first { $0.residencyId == victim }?.engineIds ?? [victim]
+            for id in handles {
+                await unloadModel(id: id)
+            }
         }
     }
 
+    /// Residency entry of a handle: the one of the weights it shares, or its own while loading.
+    private func residencyId(of engineId: Int) -> Int {
+        weightsKeys[engineId].flatMap { sharedWeights[$0]?.residencyId } ?? engineId
+    }
+
+    /// Returns a loaded engine and marks its weights as recently used.
+    private func useEngine(_ id: Int) throws -> LLMEngine {
+        guard let engine = engines[id] else {
+            throw NodeMLXError.modelNotFound
+        }
+        residency.touch(residencyId(of: id))
+        return engine
+    }
+
+    /// Runs a request on a loaded engine, keeping the engine from being
+    /// evicted until it finishes.
+    private func withPinnedEngine<T>(_ engineId: Int, _ body: (LLMEngine) async throws -> T) async throws -> T {
+        let engine = try useEngine(engineId)
+
+        activeRequests[engineId, default: 0] += 1
+        defer {
+            activeRequests[engineId]! -= 1
+            if activeRequests[engineId] == 0 {
+                activeRequests.removeValue(forKey: engineId)
+            }
+        }
+
+        return try await body(engine)
+    }
+
     func getEngine(id: Int) -> LLMEngine? {
         engines[id]
     }
@@ -129,22 +332,65 @@ actor EngineManager {
         repetitionPenalty: Float? = nil,
         repetitionContextSize: Int = 20,
         onToken: @escaping (String) -> Bool
-    ) throws -> NodeMLXCore.GenerationResult {
-        guard let engine = engines[engineId] else {
-            throw NodeMLXError.modelNotFound
-        }
-
-        return try engine.generateStream(
+    ) async throws -> NodeMLXCore.GenerationResult {
+        try await generate(
+            engineId: engineId,
             prompt: prompt,
-            maxTokens: maxTokens,
-            temperature: temperature,
-            topP: topP,
-            repetitionPenalty: repetitionPenalty,
-            repetitionContextSize: repetitionContextSize,
+            config: GenerationConfig(
+                maxTokens: maxTokens,
+                temperature: temperature,
+                topP: topP,
+                repetitionPenalty: repetitionPenalty ?? 1.0,
+                repetitionContextSize: repetitionContextSize
+            ),
             onToken: onToken
         )
     }
 
+    func generate(
+        engineId: Int,
+        prompt: String,
+        config: GenerationConfig,
+        onToken: @escaping (String) -> Bool
+    ) async throws -> NodeMLXCore.GenerationResult {
+        try await withPinnedEngine(engineId) { engine in
+            // Concurrent requests on the same model share decode steps
+            try await engine.scheduleGeneration(prompt: prompt, config: config, onToken: onToken)
+        }
+    }
+
+    /// Embeds texts with a loaded model.
+    ///
+    /// - Returns: Row-major float32 embeddings in a buffer the caller must
+    ///   deallocate, and their dimension
+    func embed(
+        engineId: Int,
+        texts: [String],
+        config: EmbeddingConfig
+    ) async throws -> (values: UnsafeMutableBufferPointer<Float>, dimensions: Int) {
+        try await withPinnedEngine(engineId) { engine in
+            try await GenerationScheduler.shared.perform {
+                let embeddings = try engine.embed(texts: texts, config: config)
+                return (makeFloatBuffer(embeddings), embeddings.dim(1))
+            }
+        }
+    }
+
+    /// Scores continuations of prompts with a loaded model.
+    ///
+    /// - Returns: Per-token log-probabilities of each continuation
+    func score(
+        engineId: Int,
+        prompts: [String],
+        continuations: [String]
+    ) async throws -> [[Float]] {
+        try await withPinnedEngine(engineId) { engine in
+            try await GenerationScheduler.shared.perform {
+                try engine.score(prompts: prompts, continuations: continuations)
+            }
+        }
+    }
+
     func generateWithImage(
         engineId: Int,
         prompt: String,
@@ -155,25 +401,129 @@ actor EngineManager {
         repetitionPenalty: Float? = nil,
         repetitionContextSize: Int = 20,
         onToken: @escaping (String) -> Bool
-    ) throws -> NodeMLXCore.GenerationResult {
-        guard let engine = engines[engineId] else {
-            throw NodeMLXError.modelNotFound
+    ) async throws -> NodeMLXCore.GenerationResult {
+        try await withPinnedEngine(engineId) { engine in
+            guard engine.isVLM else {
+                throw NodeMLXError.notAVLM
+            }
+
+            // Image prompts are not batched, so they run as a job of their own
+            return try await GenerationScheduler.shared.perform {
+                try engine.generateStreamWithImage(
+                    prompt: prompt,
+                    imagePath: imagePath,
+                    maxTokens: maxTokens,
+                    temperature: temperature,
+                    topP: topP,
+                    repetitionPenalty: repetitionPenalty,
+                    repetitionContextSize: repetitionContextSize,
+                    onToken: onToken
+                )
+            }
         }
+    }
+
+    // MARK: Sessions
+
+    func createSession(engineId: Int) throws -> Int {
+        let engine = try useEngine(engineId)
+
+        let sessionId = nextSessionId
+        nextSessionId += 1
+        sessions[sessionId] = (engineId, try engine.makeSession())
+
+        return sessionId
+    }
+
+    func appendToSession(id: Int, text: String) throws -> Int {
+        try idleSession(id).append(text)
+    }
 
-        guard engine.isVLM else {
-            throw NodeMLXError.notAVLM
+    func rewindSession(id: Int, count: Int) throws -> Int {
+        try idleSession(id).rewind(count)
+    }
+
+    func generateInSession(
+        id: Int,
+        config: GenerationConfig,
+        onToken: @escaping (String) -> Bool
+    ) async throws -> NodeMLXCore.GenerationResult {
+        let session = try idleSession(id)
+        let engine = sessions[id].flatMap { engines[$0.engineId] }
+        if let engineId = sessions[id]?.engineId {
+            residency.touch(residencyId(of: engineId))
         }
 
-        return try engine.generateStreamWithImage(
-            prompt: prompt,
-            imagePath: imagePath,
-            maxTokens: maxTokens,
-            temperature: temperature,
-            topP: topP,
-            repetitionPenalty: repetitionPenalty,
-            repetitionContextSize: repetitionContextSize,
-            onToken: onToken
-        )
+        // The session is used on the compute queue; reject other calls meanwhile
+        busySessions.insert(id)
+        defer { busySessions.remove(id) }
+
+        // Unloading the model stops the session's generation too
+        let config = engine?.cancellable(config) ?? config
+
+        let (result, bytes) = try await GenerationScheduler.shared.perform {
+            // A grammar is bound to the tokenizer of the session's model
+            let sessionConfig = try engine.map { try $0.resolvingGrammar(config) } ?? config
+            return (session.generate(config: sessionConfig, onToken: onToken), session.cacheBytes)
+        }
+        chargeSession(id, bytes: bytes)
+        return result
+    }
+
+    func saveSession(id: Int, path: String) async throws {
+        let session = try idleSession(id)
+
+        busySessions.insert(id)
+        defer { busySessions.remove(id) }
+
+        try await GenerationScheduler.shared.perform {
+            try session.save(to: URL(fileURLWithPath: path))
+        }
+    }
+
+    func loadSession(engineId: Int, path: String) async throws -> Int {
+        let engine = try useEngine(engineId)
+
+        let (session, bytes) = try await GenerationScheduler.shared.perform {
+            let session = try engine.loadSession(from: path)
+            return (session, session.cacheBytes)
+        }
+
+        let sessionId = nextSessionId
+        nextSessionId += 1
+        sessions[sessionId] = (engineId, session)
+        chargeSession(sessionId, bytes: bytes)
+
+        return sessionId
+    }
+
+    func freeSession(id: Int) {
+        chargeSession(id, bytes: 0)
+        sessions.removeValue(forKey: id)
+        sessionBytes.removeValue(forKey: id)
+    }
+
+    /// Charges a session's KV cache to the memory of its model.
+    ///
+    /// Caches grow during a turn; the budget sees their size after it and
+    /// enforces it at the next load.
+    private func chargeSession(_ id: Int, bytes: Int) {
+        guard let engineId = sessions[id]?.engineId else { return }
+        let residencyId = residencyId(of: engineId)
+        let added = bytes - (sessionBytes[id] ?? 0)
+
+        sessionBytes[id] = bytes
+        residency.resize(residencyId, bytes: residency.footprint(of: residencyId) + added)
+    }
+
+    private func idleSession(_ id: Int) throws -> ChatSession {
+        guard let entry = sessions[id] else {
+            throw NodeMLXError.sessionNotFound
+        }
+        guard !busySessions.contains(id) else {
+            throw NodeMLXError.sessionBusy
+        }
+        return entry.session
     }
 
     func isVLM(engineId: Int) -> Bool {
@@ -191,6 +541,9 @@ enum NodeMLXError: Error, LocalizedError {
     case generationFailed(String)
     case notAVLM
     case imageLoadFailed(String)
+    case sessionNotFound
+    case sessionBusy
+    case memoryBudgetExceeded
 
     var errorDescription: String? {
         switch self {
@@ -202,6 +555,12 @@ enum NodeMLXError: Error, LocalizedError {
             "Model does not support images (not a VLM)"
         case let .imageLoadFailed(msg):
             "Failed to load image: \(msg)"
+        case .sessionNotFound:
+            "Session not found"
+        case .sessionBusy:
+            "Session is already generating"
+        case .memoryBudgetExceeded:
+            "Model does not fit into the memory budget, even after unloading idle models"
         }
     }
 }
@@ -214,6 +573,217 @@ struct JSONGenerationResult: Codable {
     let tokenCount: Int?
     let tokensPerSecond: Float?
     let error: String?
+    var finishReason: String? = nil
+    var speculative: JSONSpeculativeStats? = nil
+    /// Alternatives per token written to the logprobs buffer (absent unless requested)
+    var logprobs: Int? = nil
+}
+
+/// Speculative decoding acceptance stats, for tuning `numDraftTokens` and the n-gram size
+struct JSONSpeculativeStats: Codable {
+    let draftTokens: Int
+    let acceptedTokens: Int
+    let acceptanceRate: Double
+    let verificationSteps: Int
+
+    init(_ stats: SpeculativeStats) {
+        draftTokens = stats.proposedTokens
+        acceptedTokens = stats.acceptedTokens
+        acceptanceRate = stats.acceptanceRate
+        verificationSteps = stats.verificationSteps
+    }
+}
+
+/// Generation options passed as JSON to the callback-based entry points.
+/// Missing keys fall back to the same defaults as the positional C API.
+struct JSONGenerationOptions: Decodable {
+    var maxTokens: Int = 256
+    var temperature: Float = 0.7
+    var topP: Float = 0.9
+    /// Number of most likely tokens to sample from (0 = all)
+    var topK: Int = 0
+    /// Minimum probability relative to the most likely token (0 = disabled)
+    var minP: Float = 0
+    var repetitionPenalty: Float = 0
+    var repetitionContextSize: Int = 20
+    /// Subtracted from a token's logit per occurrence in the penalty window
+    var frequencyPenalty: Float = 0
+    /// Subtracted from the logit of every token in the penalty window
+    var presencePenalty: Float = 0
+    /// Wall-clock limit for the whole generation in milliseconds
+    var timeout: Double?
+    /// Limit for prompt processing in milliseconds
+    var maxPrefillTime: Double?
+    /// Maximum prompt tokens per forward pass
+    var prefillStepSize: Int?
+    /// Tokens proposed per speculative decoding step
+    var numDraftTokens: Int?
+    /// N-gram length for prompt-lookup speculative decoding
+    var promptLookupNgramSize: Int?
+    /// Bits per element of the quantized KV cache (nil = full precision)
+    var kvBits: Int?
+    /// Quantization group size of the KV cache
+    var kvGroupSize: Int?
+    /// Cached tokens after which the KV cache is quantized
+    var quantizedKvStart: Int?
+    /// Regular expression the output must match
+    var regex: String?
+    /// JSON schema (as JSON text) the output must match
+    var jsonSchema: String?
+    /// Report per-token log-probabilities with this many alternatives
+    var logprobs: Int?
+
+    enum CodingKeys: String, CodingKey {
+        case maxTokens, temperature, topP, topK, minP
+        case repetitionPenalty, repetitionContextSize, frequencyPenalty, presencePenalty
+        case timeout, maxPrefillTime, prefillStepSize, numDraftTokens, promptLookupNgramSize
+        case kvBits, kvGroupSize, quantizedKvStart
+        case regex, jsonSchema, logprobs
+    }
+
+    init() {}
+
+    init(from decoder: Decoder) throws {
+        let container = try decoder.container(keyedBy: CodingKeys.self)
+        maxTokens = try container.decodeIfPresent(Int.self, forKey: .maxTokens) ?? maxTokens
+        temperature = try container.decodeIfPresent(Float.self, forKey: .temperature) ?? temperature
+        topP = try container.decodeIfPresent(Float.self, forKey: .topP) ?? topP
+        topK = try container.decodeIfPresent(Int.self, forKey: .topK) ?? topK
+        minP = try container.decodeIfPresent(Float.self, forKey: .minP) ?? minP
+        repetitionPenalty = try container.decodeIfPresent(Float.self, forKey: .repetitionPenalty) ?? repetitionPenalty
+        repetitionContextSize = try container.decodeIfPresent(Int.self, forKey: .repetitionContextSize)
+            ?? repetitionContextSize
+        frequencyPenalty = try container.decodeIfPresent(Float.self, forKey: .frequencyPenalty) ?? frequencyPenalty
+        presencePenalty = try container.decodeIfPresent(Float.self, forKey: .presencePenalty) ?? presencePenalty
+        timeout = try container.decodeIfPresent(Double.self, forKey: .timeout)
+        maxPrefillTime = try container.decodeIfPresent(Double.self, forKey: .maxPrefillTime)
+        prefillStepSize = try container.decodeIfPresent(Int.self, forKey: .prefillStepSize)
+        numDraftTokens = try container.decodeIfPresent(Int.self, forKey: .numDraftTokens)
+        promptLookupNgramSize = try container.decodeIfPresent(Int.self, forKey: .promptLookupNgramSize)
+        kvBits = try container.decodeIfPresent(Int.self, forKey: .kvBits)
+        kvGroupSize = try container.decodeIfPresent(Int.self, forKey: .kvGroupSize)
+        quantizedKvStart = try container.decodeIfPresent(Int.self, forKey: .quantizedKvStart)
+        regex = try container.decodeIfPresent(String.self, forKey: .regex)
+        jsonSchema = try container.decodeIfPresent(String.self, forKey: .jsonSchema)
+        logprobs = try container.decodeIfPresent(Int.self, forKey: .logprobs)
+    }
+
+    /// Converts to a core generation config (penalties of 0 or 1 mean no penalty).
+    /// Throws `GrammarError` if the regex or JSON schema cannot be compiled.
+    func makeConfig(cancellation: CancellationToken?) throws -> GenerationConfig {
+        var config = GenerationConfig(
+            maxTokens: maxTokens,
+            temperature: temperature,
+            topP: topP,
+            topK: max(topK, 0),
+            minP: max(minP, 0),
+            repetitionPenalty: repetitionPenalty > 1.0 ? repetitionPenalty : 1.0,
+            repetitionContextSize: repetitionContextSize,
+            frequencyPenalty: frequencyPenalty,
+            presencePenalty: presencePenalty,
+            timeLimit: timeout.map { $0 / 1000 },
+            maxPrefillTime: maxPrefillTime.map { $0 / 1000 },
+            cancellation: cancellation
+        )
+        if let prefillStepSize, prefillStepSize > 0 {
+            config.prefillStepSize = prefillStepSize
+        }
+        if let numDraftTokens, numDraftTokens >= 0 {
+            config.numDraftTokens = numDraftTokens
+        }
+        if let promptLookupNgramSize {
+            config.promptLookupNgramSize = promptLookupNgramSize
+        }
+        if let kvBits, kvBits > 0 {
+            config.kvBits = kvBits
+        }
+        if let kvGroupSize, kvGroupSize > 0 {
+            config.kvGroupSize = kvGroupSize
+        }
+        if let quantizedKvStart, quantizedKvStart >= 0 {
+            config.quantizedKvStart = quantizedKvStart
+        }
+        if let logprobs, logprobs >= 0 {
+            config.logprobs = logprobs
+        }
+        if let jsonSchema {
+            config.grammar = try Grammar(jsonSchema: jsonSchema)
+        } else if let regex {
+            config.grammar = try Grammar(regex: regex)
+        }
+        return config
+    }
+
+    /// Decodes options from a C string, using defaults for a null pointer.
+    static func decode(_ json: UnsafePointer<CChar>?) throws -> JSONGenerationOptions {
+        guard let json else { return JSONGenerationOptions() }
+        return try JSONDecoder().decode(JSONGenerationOptions.self, from: Data(String(cString: json).utf8))
+    }
+}
+
+/// Model load options passed as JSON from the binding
+struct JSONLoadOptions: Decodable {
+    /// Memory budget for reusable prompt prefixes in bytes (0 disables)
+    var prefixCacheBytes: Int?
+    /// Memory budget for the KV state of batched requests in bytes (0 disables batching)
+    var batchCacheBytes: Int?
+    /// Model ID or path of a draft model for speculative decoding
+    var draftModel: String?
+    /// Directory for compiled models (nil disables)
+    var compiledCacheDir: String?
+
+    /// Decodes options from a C string, using defaults for a null pointer.
+    static func decode(_ json: UnsafePointer<CChar>?) throws -> JSONLoadOptions {
+        guard let json else { return JSONLoadOptions() }
+        return try JSONDecoder().decode(JSONLoadOptions.self, from: Data(String(cString: json).utf8))
+    }
+}
+
+/// Embedding options passed as JSON from the binding
+struct JSONEmbeddingOptions: Decodable {
+    /// "mean", "last" or "cls"
+    var pooling: String?
+    /// Hidden state index, negative counts from the end
+    var layer: Int?
+    var normalize: Bool?
+
+    /// Converts to a core embedding config.
+    /// Throws `LLMEngineError.invalidConfig` for an unknown pooling.
+    func makeConfig() throws -> EmbeddingConfig {
+        var config = EmbeddingConfig()
+        if let pooling {
+            guard let mode = Pooling(rawValue: pooling) else {
+                throw LLMEngineError.invalidConfig("unknown pooling '\(pooling)'")
+            }
+            config.pooling = mode
+        }
+        config.layer = layer ?? config.layer
+        config.normalize = normalize ?? config.normalize
+        return config
+    }
+
+    /// Decodes options from a C string, using defaults for a null pointer.
+    static func decode(_ json: UnsafePointer<CChar>?) throws -> JSONEmbeddingOptions {
+        guard let json else { return JSONEmbeddingOptions() }
+        return try JSONDecoder().decode(JSONEmbeddingOptions.self, from: Data(String(cString: json).utf8))
+    }
+}
+
+struct JSONEmbeddingResult: Codable {
+    let success: Bool
+    let count: Int
+    let dimensions: Int
+    /// Number of floats in the buffer (count x dimensions)
+    let length: Int
+}
+
+struct JSONScoringResult: Codable {
+    let success: Bool
+    let count: Int
+    /// Scored tokens of each continuation, in buffer order
+    let tokenCounts: [Int]
+    /// Number of floats in the buffer (sum of tokenCounts)
+    let length: Int
 }
 
 struct JSONModelInfo: Codable {
@@ -227,9 +797,24 @@ struct JSONModelInfo: Codable {
 /// Returns model ID on success, -1 on error
 @_cdecl("node_mlx_load_model")
 public func loadModel(modelId: UnsafePointer<CChar>?) -> Int32 {
+    loadModelWithOptions(modelId: modelId, optionsJSON: nil)
+}
+
+/// Load a model with JSON options and return its handle (ID)
+/// Returns model ID on success, -1 on error
+@_cdecl("node_mlx_load_model_with_options")
+public func loadModelWithOptions(modelId: UnsafePointer<CChar>?, optionsJSON: UnsafePointer<CChar>?) -> Int32 {
     guard let modelId else { return -1 }
     let modelIdString = String(cString: modelId)
 
+    let options: JSONLoadOptions
+    do {
+        options = try JSONLoadOptions.decode(optionsJSON)
+    } catch {
+        print("Error loading model: invalid options: \(error)")
+        return -1
+    }
+
     // Ensure metallib is loaded before any MLX operations
     ensureMetalLibBundle()
 
@@ -238,7 +823,7 @@ public func loadModel(modelId: UnsafePointer<CChar>?) -> Int32 {
 
     Task {
         do {
-            let id = try await EngineManager.shared.loadModel(id: modelIdString)
+            let id = try await EngineManager.shared.loadModel(id: modelIdString, options: options)
             result = Int32(id)
         } catch {
             print("Error loading model: \(error)")
@@ -254,9 +839,29 @@ public func loadModel(modelId: UnsafePointer<CChar>?) -> Int32 {
 /// Unload a model from memory
 @_cdecl("node_mlx_unload_model")
 public func unloadModel(handle: Int32) {
+    let semaphore = DispatchSemaphore(value: 0)
+
+    // Wait until the memory is released, so a following load can use it
     Task {
         await EngineManager.shared.unloadModel(id: Int(handle))
+        semaphore.signal()
     }
+
+    semaphore.wait()
+}
+
+/// Set the memory budget for all loaded models in bytes (0 = unlimited)
+/// Loading a model that does not fit unloads the least recently used idle models first
+@_cdecl("node_mlx_set_memory_budget")
+public func setMemoryBudget(bytes: Int64) {
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        await EngineManager.shared.setMemoryBudget(bytes > 0 ? Int(bytes) : nil)
+        semaphore.signal()
+    }
+
+    semaphore.wait()
 }
 
 /// Generate text from a prompt (non-streaming)
@@ -299,7 +904,9 @@ public func generate(
                 text: result.text,
                 tokenCount: result.tokenCount,
                 tokensPerSecond: result.tokensPerSecond,
-                error: nil
+                error: nil,
+                finishReason: result.finishReason.rawValue,
+                speculative: result.speculative.map(JSONSpeculativeStats.init)
             )
             jsonResult = encodeJSON(response)
         } catch NodeMLXError.modelNotFound {
@@ -361,7 +968,9 @@ public func generateStreaming(
                 text: nil, // Already streamed
                 tokenCount: result.tokenCount,
                 tokensPerSecond: result.tokensPerSecond,
-                error: nil
+                error: nil,
+                finishReason: result.finishReason.rawValue,
+                speculative: result.speculative.map(JSONSpeculativeStats.init)
             )
             jsonResult = encodeJSON(response)
         } catch NodeMLXError.modelNotFound {
@@ -376,6 +985,410 @@ public func generateStreaming(
     return jsonResult
 }
 
+/// Token callback for `node_mlx_generate_with_callback`.
+/// Receives each decoded token (UTF-8) and the caller's user data; return false to stop generating.
+public typealias TokenCallback = @convention(c) (UnsafePointer<CChar>?, UnsafeMutableRawPointer?) -> Bool
+
+/// Generate text and report each token through a C callback
+/// Options are passed as a JSON object string (see JSONGenerationOptions).
+/// The callback is invoked on the generating thread, never concurrently for one call.
+/// `cancelFlag` (optional) is polled once per step - set it to non-zero to stop;
+/// it must stay valid until this function returns.
+/// With the "logprobs" option, `logprobs` (optional, `logprobsLength` floats) receives
+/// the packed log-probabilities of the generated tokens (see writeLogprobs).
+/// Returns JSON string with text, stats and finishReason - caller must free with node_mlx_free_string
+@_cdecl("node_mlx_generate_with_callback")
+public func generateWithCallback(
+    handle: Int32,
+    prompt: UnsafePointer<CChar>?,
+    optionsJSON: UnsafePointer<CChar>?,
+    onToken: TokenCallback?,
+    userData: UnsafeMutableRawPointer?,
+    cancelFlag: UnsafePointer<Int32>?,
+    logprobs: UnsafeMutablePointer<Float>?,
+    logprobsLength: Int64
+) -> UnsafeMutablePointer<CChar>? {
+    guard let prompt else {
+        return makeJSONError("Invalid prompt")
+    }
+
+    let promptString = String(cString: prompt)
+
+    return runGeneration(
+        optionsJSON: optionsJSON,
+        onToken: onToken,
+        userData: userData,
+        cancelFlag: cancelFlag,
+        logprobs: logprobs.map { UnsafeMutableBufferPointer(start: $0, count: Int(logprobsLength)) }
+    ) {
+        try await EngineManager.shared.generate(engineId: Int(handle), prompt: promptString, config: $0, onToken: $1)
+    }
+}
+
+/// Shared body of the callback-based generate exports: decodes options, runs
+/// `generate` with a config and token callback, and encodes the JSON result.
+private func runGeneration(
+    optionsJSON: UnsafePointer<CChar>?,
+    onToken: TokenCallback?,
+    userData: UnsafeMutableRawPointer?,
+    cancelFlag: UnsafePointer<Int32>?,
+    logprobs: UnsafeMutableBufferPointer<Float>?,
+    generate: @escaping (GenerationConfig, @escaping (String) -> Bool) async throws -> NodeMLXCore.GenerationResult
+) -> UnsafeMutablePointer<CChar>? {
+    let config: GenerationConfig
+    do {
+        let options = try JSONGenerationOptions.decode(optionsJSON)
+        config = try options.makeConfig(cancellation: cancelFlag.map { CancellationToken(externalFlag: $0) })
+    } catch {
+        return makeJSONError("Invalid options: \(error.localizedDescription)")
+    }
+
+    var jsonResult: UnsafeMutablePointer<CChar>?
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        do {
+            let result = try await generate(config) { token in
+                guard let onToken else { return true }
+                return token.withCString { onToken($0, userData) }
+            }
+            if let values = result.logprobs {
+                try writeLogprobs(values, to: logprobs)
+            }
+
+            let response = JSONGenerationResult(
+                success: true,
+                text: result.text,
+                tokenCount: result.tokenCount,
+                tokensPerSecond: result.tokensPerSecond,
+                error: nil,
+                finishReason: result.finishReason.rawValue,
+                speculative: result.speculative.map(JSONSpeculativeStats.init),
+                logprobs: result.logprobs?.topCount
+            )
+            jsonResult = encodeJSON(response)
+        } catch NodeMLXError.modelNotFound {
+            jsonResult = makeJSONError("Model not found")
+        } catch NodeMLXError.sessionNotFound {
+            jsonResult = makeJSONError("Session not found")
+        } catch NodeMLXError.sessionBusy {
+            jsonResult = makeJSONError("Session is already generating")
+        } catch let NodeMLXError.generationFailed(message) {
+            jsonResult = makeJSONError("Generation failed: \(message)")
+        } catch {
+            jsonResult = makeJSONError("Generation failed: \(error.localizedDescription)")
+        }
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return jsonResult
+}
+
+/// Packs the log-probabilities of n generated tokens with k alternatives each into
+/// `buffer`: n float log-probabilities, then n x k int32 token IDs, then their
+/// n x k float log-probabilities (both row-major, most likely first).
+/// Throws without writing anything if there is no buffer or it is too small.
+private func writeLogprobs(_ logprobs: GenerationLogprobs, to buffer: UnsafeMutableBufferPointer<Float>?) throws {
+    let count = logprobs.count
+    let topCount = count * logprobs.topCount
+    guard let base = buffer?.baseAddress, count + 2 * topCount <= buffer?.count ?? 0 else {
+        throw NodeMLXError.generationFailed(
+            "logprobs buffer holds \(buffer?.count ?? 0) floats, \(count + 2 * topCount) needed"
+        )
+    }
+
+    base.update(from: logprobs.tokens, count: count)
+    logprobs.topTokens.withUnsafeBytes { ids in
+        if let ids = ids.baseAddress {
+            UnsafeMutableRawPointer(base + count).copyMemory(from: ids, byteCount: topCount * MemoryLayout<Int32>.size)
+        }
+    }
+    (base + count + topCount).update(from: logprobs.topLogprobs, count: topCount)
+}
+
+// MARK: - Embeddings
+
+/// Embed texts (a JSON array of strings) with a loaded model
+/// `optionsJSON` (optional): {"pooling": "mean" | "last" | "cls", "layer", "normalize"}
+/// On success `embeddings` receives count x dimensions floats in row-major order - caller
+/// must free them with node_mlx_free_floats.
+/// Returns JSON string with count, dimensions and length - caller must free with node_mlx_free_string
+@_cdecl("node_mlx_embed")
+public func embed(
+    handle: Int32,
+    textsJSON: UnsafePointer<CChar>?,
+    optionsJSON: UnsafePointer<CChar>?,
+    embeddings: UnsafeMutablePointer<UnsafeMutablePointer<Float>?>?
+) -> UnsafeMutablePointer<CChar>? {
+    guard let textsJSON, let embeddings else {
+        return makeJSONError("Invalid arguments")
+    }
+
+    let texts: [String]
+    let config: EmbeddingConfig
+    do {
+        texts = try JSONDecoder().decode([String].self, from: Data(String(cString: textsJSON).utf8))
+        config = try JSONEmbeddingOptions.decode(optionsJSON).makeConfig()
+    } catch {
+        return makeJSONError("Invalid options: \(error.localizedDescription)")
+    }
+
+    var jsonResult: UnsafeMutablePointer<CChar>?
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        do {
+            let (values, dimensions) = try await EngineManager.shared.embed(
+                engineId: Int(handle),
+                texts: texts,
+                config: config
+            )
+
+            // Handed to the binding, which wraps it in an ArrayBuffer without copying
+            embeddings.pointee = values.baseAddress
+
+            jsonResult = encodeJSON(JSONEmbeddingResult(
+                success: true,
+                count: texts.count,
+                dimensions: dimensions,
+                length: values.count
+            ))
+        } catch NodeMLXError.modelNotFound {
+            jsonResult = makeJSONError("Model not found")
+        } catch {
+            jsonResult = makeJSONError("Embedding failed: \(error.localizedDescription)")
+        }
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return jsonResult
+}
+
+// MARK: - Scoring
+
+/// Score continuations of prompts (JSON arrays of strings of equal length) with a loaded model
+/// On success `logprobs` receives the natural-log probability of every continuation token,
+/// continuation after continuation - caller must free them with node_mlx_free_floats.
+/// Returns JSON string with count, tokenCounts and length - caller must free with node_mlx_free_string
+@_cdecl("node_mlx_score")
+public func score(
+    handle: Int32,
+    promptsJSON: UnsafePointer<CChar>?,
+    continuationsJSON: UnsafePointer<CChar>?,
+    logprobs: UnsafeMutablePointer<UnsafeMutablePointer<Float>?>?
+) -> UnsafeMutablePointer<CChar>? {
+    guard let promptsJSON, let continuationsJSON, let logprobs else {
+        return makeJSONError("Invalid arguments")
+    }
+
+    let prompts: [String]
+    let continuations: [String]
+    do {
+        prompts = try JSONDecoder().decode([String].self, from: Data(String(cString: promptsJSON).utf8))
+        continuations = try JSONDecoder().decode([String].self, from: Data(String(cString: continuationsJSON).utf8))
+    } catch {
+        return makeJSONError("Invalid options: \(error.localizedDescription)")
+    }
+
+    var jsonResult: UnsafeMutablePointer<CChar>?
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        do {
+            let scores = try await EngineManager.shared.score(
+                engineId: Int(handle),
+                prompts: prompts,
+                continuations: continuations
+            )
+
+            // Handed to the binding, which wraps it in an ArrayBuffer without copying
+            let length = scores.reduce(0) { $0 + $1.count }
+            let buffer = UnsafeMutableBufferPointer<Float>.allocate(capacity: length)
+            var offset = 0
+            for values in scores {
+                _ = UnsafeMutableBufferPointer(rebasing: buffer[offset...]).initialize(from: values)
+                offset += values.count
+            }
+            logprobs.pointee = buffer.baseAddress
+
+            jsonResult = encodeJSON(JSONScoringResult(
+                success: true,
+                count: scores.count,
+                tokenCounts: scores.map(\.count),
+                length: length
+            ))
+        } catch NodeMLXError.modelNotFound {
+            jsonResult = makeJSONError("Model not found")
+        } catch {
+            jsonResult = makeJSONError("Scoring failed: \(error.localizedDescription)")
+        }
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return jsonResult
+}
+
+/// Copies an evaluated float32 array into a new buffer for node_mlx_free_floats,
+/// reading the array's memory in place (MLX only copies it first if it is strided).
+private func makeFloatBuffer(_ array: MLXArray) -> UnsafeMutableBufferPointer<Float> {
+    let buffer = UnsafeMutableBufferPointer<Float>.allocate(capacity: array.size)
+    _ = array.asData(access: .noCopyIfContiguous).data.copyBytes(to: buffer)
+    return buffer
+}
+
+/// Free a float buffer returned by node_mlx_embed or node_mlx_score
+@_cdecl("node_mlx_free_floats")
+public func freeFloats(values: UnsafeMutablePointer<Float>?) {
+    values?.deallocate()
+}
+
+// MARK: - Sessions
+
+/// Create a chat session on a loaded model
+/// Returns session ID on success, -1 on error
+@_cdecl("node_mlx_session_create")
+public func createSession(handle: Int32) -> Int32 {
+    var result: Int32 = -1
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        let sessionId = try? await EngineManager.shared.createSession(engineId: Int(handle))
+        result = sessionId.map { Int32($0) } ?? -1
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return result
+}
+
+/// Append text to a session
+/// Returns the number of tokens added, -1 if the session is unknown or generating
+@_cdecl("node_mlx_session_append")
+public func sessionAppend(session: Int32, text: UnsafePointer<CChar>?) -> Int32 {
+    guard let text else { return -1 }
+    let textString = String(cString: text)
+
+    var result: Int32 = -1
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        let added = try? await EngineManager.shared.appendToSession(id: Int(session), text: textString)
+        result = added.map { Int32($0) } ?? -1
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return result
+}
+
+/// Generate the next turn of a session (see node_mlx_generate_with_callback)
+/// Returns JSON string with text, stats and finishReason - caller must free with node_mlx_free_string
+@_cdecl("node_mlx_session_generate")
+public func sessionGenerate(
+    session: Int32,
+    optionsJSON: UnsafePointer<CChar>?,
+    onToken: TokenCallback?,
+    userData: UnsafeMutableRawPointer?,
+    cancelFlag: UnsafePointer<Int32>?,
+    logprobs: UnsafeMutablePointer<Float>?,
+    logprobsLength: Int64
+) -> UnsafeMutablePointer<CChar>? {
+    runGeneration(
+        optionsJSON: optionsJSON,
+        onToken: onToken,
+        userData: userData,
+        cancelFlag: cancelFlag,
+        logprobs: logprobs.map { UnsafeMutableBufferPointer(start: $0, count: Int(logprobsLength)) }
+    ) {
+        try await EngineManager.shared.generateInSession(id: Int(session), config: $0, onToken: $1)
+    }
+}
+
+/// Drop the last tokens of a session
+/// Returns the remaining token count, -1 if the session is unknown or generating
+@_cdecl("node_mlx_session_rewind")
+public func sessionRewind(session: Int32, count: Int32) -> Int32 {
+    var result: Int32 = -1
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        let remaining = try? await EngineManager.shared.rewindSession(id: Int(session), count: Int(count))
+        result = remaining.map { Int32($0) } ?? -1
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return result
+}
+
+/// Save a session's tokens and KV cache to a safetensors file
+/// Returns 0 on success, -1 on error
+@_cdecl("node_mlx_session_save")
+public func sessionSave(session: Int32, path: UnsafePointer<CChar>?) -> Int32 {
+    guard let path else { return -1 }
+    let pathString = String(cString: path)
+
+    var result: Int32 = -1
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        do {
+            try await EngineManager.shared.saveSession(id: Int(session), path: pathString)
+            result = 0
+        } catch {
+            print("Error saving session: \(error)")
+            result = -1
+        }
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return result
+}
+
+/// Restore a session saved with node_mlx_session_save on a loaded model
+/// Returns session ID on success, -1 on error (e.g. file saved with another model)
+@_cdecl("node_mlx_session_load")
+public func sessionLoad(handle: Int32, path: UnsafePointer<CChar>?) -> Int32 {
+    guard let path else { return -1 }
+    let pathString = String(cString: path)
+
+    var result: Int32 = -1
+    let semaphore = DispatchSemaphore(value: 0)
+
+    Task {
+        do {
+            let sessionId = try await EngineManager.shared.loadSession(engineId: Int(handle), path: pathString)
+            result = Int32(sessionId)
+        } catch {
+            print("Error loading session: \(error)")
+            result = -1
+        }
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+    return result
+}
+
+/// Free a session and its KV cache
+@_cdecl("node_mlx_session_free")
+public func freeSession(session: Int32) {
+    let semaphore = DispatchSemaphore(value: 0)
+
+    // Only waits for the manager, never for the compute queue: a session in
+    // use keeps its cache until the running request returns
+    Task {
+        await EngineManager.shared.freeSession(id: Int(session))
+        semaphore.signal()
+    }
+
+    semaphore.wait()
+}
+
 /// Generate text with image input (VLM) - writes tokens to stdout as they're generated
 /// Returns JSON string with stats when complete - caller must free with node_mlx_free_string
 @_cdecl("node_mlx_generate_with_image")
@@ -429,7 +1442,9 @@ public func generateWithImage(
                 text: nil, // Already streamed
                 tokenCount: result.tokenCount,
                 tokensPerSecond: result.tokensPerSecond,
-                error: nil
+                error: nil,
+                finishReason: result.finishReason.rawValue,
+                speculative: result.speculative.map(JSONSpeculativeStats.init)
             )
             jsonResult = encodeJSON(response)
         } catch NodeMLXError.modelNotFound {
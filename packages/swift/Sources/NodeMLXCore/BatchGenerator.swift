@@ -0,0 +1,461 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Continuous batching: sequences join and leave a shared decode batch
+// at step boundaries, each streaming its own tokens.
+
+import Foundation
+import MLX
+import MLXNN
+
+// MARK: - Batch Request
+
+/// A generation request handled by a `BatchGenerator`.
+public struct BatchRequest {
+    /// Prompt token IDs.
+    public let inputIds: [Int]
+
+    /// Generation configuration (sampling, limits, cancellation).
+    public let config: GenerationConfig
+
+    /// Called for each generated token; return false to stop.
+    public let onToken: (Int) -> Bool
+
+    /// Called once when the request finishes.
+    public let completion: (GenerationOutput) -> Void
+
+    /// Creates a batch request.
+    public init(
+        inputIds: [Int],
+        config: GenerationConfig,
+        onToken: @escaping (Int) -> Bool,
+        completion: @escaping (GenerationOutput) -> Void
+    ) {
+        self.inputIds = inputIds
+        self.config = config
+        self.onToken = onToken
+        self.completion = completion
+    }
+}
+
+// MARK: - Batch Generator
+
+/// Decodes many sequences of one model in a single batch.
+///
+/// Each call to `step()` first prefills newly inserted requests one at a time
+/// and merges them into the running batch, then runs one decode step for every
+/// active sequence. Finished sequences are removed before the next step, so
+/// requests join and leave without waiting for each other.
+///
+/// Prompts longer than their `prefillStepSize` are prefilled one chunk per
+/// `step()`, so a long prompt delays the running batch by at most one chunk
+/// per token instead of stalling it for the whole prefill.
+///
+/// Only models whose layers all use `StandardKVCache` are supported (see
+/// `supports(_:)`); their per-layer caches are replaced by `PagedKVCache`.
+/// Not thread-safe: all calls must come from the same thread.
+///
+/// Keys and values live in the blocks of a fixed-size `KVBlockPool`, so the
+/// batch takes memory in block steps as rows grow and returns it as soon as a
+/// row leaves. A request is admitted once the pool has blocks for its whole
+/// prompt. When a decode step runs out of blocks, the most recently admitted
+/// rows go back to the queue and are prefilled again with the tokens they
+/// have generated so far; a single row that outgrows the pool on its own
+/// finishes with `.length`.
+///
+/// With a `PrefixCache` on the same pool, rows whose positions start at 0
+/// (those that start an idle batch) begin with the blocks of a cached prompt
+/// prefix and hand their blocks to it on finish. Rows joining a busy batch
+/// are prefilled at shifted positions and bypass it.
+public final class BatchGenerator {
+    /// Memory for the keys and values of a generator without a pool (1 GiB).
+    public static let defaultCacheBytes = 1 << 30
+
+    private let model: any LLMModel
+    private let pool: KVBlockPool
+    private let prefixCache: PrefixCache?
+
+    private var pending: [BatchRequest] = []
+    private var prefilling: PrefillState?
+    private var active: [ActiveSequence] = []
+    private var batch: PagedBatch?
+
+    /// Sequences waiting for blocks, admitted before new requests.
+    private var waiting: [ActiveSequence] = []
+
+    /// Creates a generator for a model that `supports(_:)` batching.
+    ///
+    /// - Parameters:
+    ///   - model: Model to decode with
+    ///   - pool: Blocks for the keys and values of the batch. Defaults to the
+    ///     prefix cache's pool, or a pool of `defaultCacheBytes`
+    ///   - prefixCache: Optional cache of prompt prefixes shared with solo
+    ///     generation, stored in `pool`
+    public init(model: any LLMModel, pool: KVBlockPool? = nil, prefixCache: PrefixCache? = nil) {
+        precondition(
+            pool == nil || prefixCache == nil || prefixCache?.pool === pool,
+            "BatchGenerator and its prefix cache must share a pool"
+        )
+        self.model = model
+        self.pool = pool ?? prefixCache?.pool ?? KVBlockPool(model: model, maxBytes: Self.defaultCacheBytes)
+        self.prefixCache = prefixCache
+    }
+
+    /// Whether a model can be decoded by a `BatchGenerator`.
+    public static func supports(_ model: any LLMModel) -> Bool {
+        let cache = model.newCache()
+        return !cache.isEmpty && cache.allSatisfy { $0 is StandardKVCache }
+    }
+
+    /// Whether there are queued or running requests.
+    public var hasWork: Bool { !pending.isEmpty || !waiting.isEmpty || prefilling != nil || !active.isEmpty }
+
+    /// Number of sequences in the decode batch.
+    public var batchSize: Int { active.count }
+
+    /// Queues a request; it joins the batch on the next `step()`.
+    public func insert(_ request: BatchRequest) {
+        pending.append(request)
+    }
+
+    /// Advances the prefill of queued requests and runs one decode step for the batch.
+    public func step() {
+        admitPending()
+        decode()
+    }
+
+    /// Finishes all queued and running requests as cancelled.
+    public func cancelAll() {
+        let queued = pending
+        let resumable = waiting
+        let admitting = prefilling
+        let running = active
+        pending.removeAll()
+        waiting.removeAll()
+        prefilling = nil
+        active.removeAll()
+        batch = nil
+
+        for request in queued {
+            request.completion(GenerationOutput(tokens: [], finishReason: .cancelled))
+        }
+        for sequence in resumable {
+            sequence.finish(.cancelled)
+        }
+        admitting?.sequence.finish(.cancelled)
+        for sequence in running {
+            sequence.finish(.cancelled)
+        }
+    }
+
+    // MARK: - Private
+
+    /// Prefills queued requests in order, one at a time.
+    ///
+    /// Requests whose prompt fits into one chunk are merged right away, so
+    /// several short requests join in the same step. A longer prompt stops
+    /// admission after each chunk and continues on the next step, and so
+    /// does a request that waits for blocks.
+    private func admitPending() {
+        while true {
+            if prefilling == nil {
+                let sequence: ActiveSequence
+                if !waiting.isEmpty {
+                    sequence = waiting.removeFirst()
+                } else if !pending.isEmpty {
+                    sequence = ActiveSequence(request: pending.removeFirst())
+                } else {
+                    return
+                }
+                guard startPrefill(sequence) else { return }
+                continue
+            }
+            guard advancePrefill() else { return }
+        }
+    }
+
+    /// Reserves the blocks of a sequence's prompt and looks up its cached prefix.
+    ///
+    /// A sequence that was sent back to the queue prefills its generated
+    /// tokens along with the prompt.
+    ///
+    /// - Returns: False if the sequence waits for running rows to free blocks
+    private func startPrefill(_ sequence: ActiveSequence) -> Bool {
+        let request = sequence.request
+
+        if let reason = sequence.interruption() {
+            sequence.finish(reason)
+            return true
+        }
+        if request.config.maxTokens <= 0 || request.inputIds.isEmpty {
+            sequence.finish(.length)
+            return true
+        }
+
+        // Prefill at positions that end at the batch's offset when the row is
+        // merged, so it shares the batch's RoPE frame. The batch advances by one
+        // position per step while the remaining chunks are processed.
+        let tokens = request.inputIds + sequence.tokens
+        let chunkCount = (tokens.count + sequence.prefillStepSize - 1) / sequence.prefillStepSize
+        sequence.startPosition = batch.map { $0.offset + chunkCount - 1 - tokens.count } ?? 0
+
+        // Cached prefixes were computed at positions from 0
+        var row = PagedSequence(pool: pool)
+        var cachedCount = 0
+        if batch == nil, let hit = prefixCache?.lookup(tokens) {
+            row = hit.sequence
+            cachedCount = hit.length
+        }
+
+        // Reserving the whole prompt up front keeps the planned positions valid
+        guard row.reserve(cachedCount ..< tokens.count) else {
+            if active.isEmpty {
+                // Nothing else holds blocks, so the prompt never fits
+                sequence.finish(.length)
+                return true
+            }
+            waiting.insert(sequence, at: 0)
+            return false
+        }
+
+        prefilling = PrefillState(
+            sequence: sequence,
+            batch: PagedBatch(row: row, length: cachedCount, offset: sequence.startPosition),
+            remaining: tokens[cachedCount...]
+        )
+        return true
+    }
+
+    /// Runs the next prefill chunk and merges the row into the batch after the last one.
+    ///
+    /// - Returns: Whether the request has left the prefill stage
+    private func advancePrefill() -> Bool {
+        guard let state = prefilling else { return true }
+        let sequence = state.sequence
+
+        if let reason = sequence.interruption() ?? sequence.prefillTimeout() {
+            prefilling = nil
+            storePrefix(of: sequence, row: 0, in: state.batch)
+            sequence.finish(reason)
+            return true
+        }
+
+        let chunk = state.remaining.prefix(sequence.prefillStepSize)
+        state.remaining = state.remaining.dropFirst(chunk.count)
+
+        var layerCaches: [KVCacheProtocol]? = state.batch.caches
+        let inputs = MLXArray(chunk.map { Int32($0) }).reshaped([1, chunk.count])
+        let output = model(inputs, cache: &layerCaches)
+
+        guard state.remaining.isEmpty else {
+            evalCache(state.batch.caches)
+            return false
+        }
+        prefilling = nil
+
+        let logits = output[0..., -1, 0...]
+        eval(logits)
+
+        if let reason = sequence.prefillTimeout() {
+            storePrefix(of: sequence, row: 0, in: state.batch)
+            sequence.finish(reason)
+            return true
+        }
+
+        let token = sampleTokens(logits: sequence.processors.process(logits), configs: [sequence.request.config])[0]
+        if let reason = sequence.accept(token) {
+            storePrefix(of: sequence, row: 0, in: state.batch)
+            sequence.finish(reason)
+            return true
+        }
+
+        if let batch {
+            batch.extend(state.batch)
+        } else {
+            batch = state.batch
+        }
+        active.append(sequence)
+        return true
+    }
+
+    /// Runs one forward pass for every active sequence.
+    private func decode() {
+        removeFinished { $0.interruption() }
+        reserveDecodeBlocks()
+        guard let batch, !active.isEmpty else { return }
+
+        let inputs = MLXArray(active.map { Int32($0.lastToken) }).reshaped([active.count, 1])
+        var layerCaches: [KVCacheProtocol]? = batch.caches
+        var logits = model(inputs, cache: &layerCaches)[0..., -1, 0...]
+
+        // Each row has its own processors (penalty window, grammar state)
+        if active.contains(where: { !$0.processors.isEmpty }) {
+            logits = concatenated(active.enumerated().map { row, sequence in
+                sequence.processors.process(logits[row ..< row + 1].asType(.float32))
+            }, axis: 0)
+        }
+
+        let tokens = sampleTokens(logits: logits, configs: active.map(\.request.config))
+        var reasons: [ObjectIdentifier: FinishReason] = [:]
+        for (sequence, token) in zip(active, tokens) {
+            reasons[ObjectIdentifier(sequence)] = sequence.accept(token)
+        }
+        removeFinished { reasons[ObjectIdentifier($0)] }
+    }
+
+    /// Reserves a block position for the next token of every row.
+    ///
+    /// When the pool runs out, the most recently admitted row releases its
+    /// blocks and goes back to the queue, until the remaining rows fit.
+    private func reserveDecodeBlocks() {
+        var row = 0
+        while let batch, row < active.count {
+            if batch.reserve(1, row: row) {
+                row += 1
+                continue
+            }
+
+            let newest = active.count - 1
+            if newest == 0, prefilling == nil {
+                // Nothing else holds blocks, so the row has outgrown the pool
+                let sequence = active[0]
+                removeFinished { $0 === sequence ? .length : nil }
+            } else {
+                let sequence = active.removeLast()
+                if active.isEmpty {
+                    self.batch = nil
+                } else {
+                    batch.filter(Array(active.indices))
+                }
+                waiting.insert(sequence, at: 0)
+            }
+        }
+    }
+
+    /// Removes and completes every sequence for which `reason` returns a value.
+    private func removeFinished(_ reason: (ActiveSequence) -> FinishReason?) {
+        var keep: [Int] = []
+        var finished: [(ActiveSequence, FinishReason)] = []
+
+        for (row, sequence) in active.enumerated() {
+            if let finishReason = reason(sequence) {
+                finished.append((sequence, finishReason))
+            } else {
+                keep.append(row)
+            }
+        }
+        guard !finished.isEmpty else { return }
+
+        if let batch {
+            for (row, sequence) in active.enumerated() where !keep.contains(row) {
+                storePrefix(of: sequence, row: row, in: batch)
+            }
+        }
+
+        active = keep.map { active[$0] }
+        if active.isEmpty {
+            batch = nil
+        } else {
+            batch?.filter(keep)
+        }
+
+        for (sequence, finishReason) in finished {
+            sequence.finish(finishReason)
+        }
+    }
+
+    /// Hands the blocks of a finished row to the prefix cache.
+    private func storePrefix(of sequence: ActiveSequence, row: Int, in batch: PagedBatch) {
+        guard let prefixCache, sequence.startPosition == 0 else { return }
+
+        // Tokens fed to the model so far; the last sampled token never was
+        let length = batch.length(ofRow: row)
+        let processed = Array((sequence.request.inputIds + sequence.tokens).prefix(length))
+        guard length > 0, processed.count == length else { return }
+
+        prefixCache.insert(processed, sequence: batch.rows[row])
+    }
+}
+
+// MARK: - Active Sequence
+
+/// Per-request state while a request is in the batch.
+private final class ActiveSequence {
+    let request: BatchRequest
+    let startTime = CFAbsoluteTimeGetCurrent()
+    private(set) var tokens: [Int] = []
+    private(set) var lastToken = 0
+
+    /// RoPE position of the first prompt token.
+    var startPosition = 0
+
+    /// Logits processors over the prompt and the accepted tokens.
+    let processors: [any LogitsProcessor]
+
+    init(request: BatchRequest) {
+        self.request = request
+        processors = makeLogitsProcessors(config: request.config, prompt: request.inputIds)
+    }
+
+    /// Cancellation or deadline, checked before each model call.
+    func interruption() -> FinishReason? {
+        if request.config.cancellation?.isCancelled == true {
+            return .cancelled
+        }
+        if let timeLimit = request.config.timeLimit, CFAbsoluteTimeGetCurrent() - startTime >= timeLimit {
+            return .timeout
+        }
+        return nil
+    }
+
+    /// Maximum prompt tokens per prefill chunk.
+    var prefillStepSize: Int { max(request.config.prefillStepSize, 1) }
+
+    /// `.timeout` once `maxPrefillTime` has elapsed since admission.
+    func prefillTimeout() -> FinishReason? {
+        guard let maxPrefillTime = request.config.maxPrefillTime else { return nil }
+        return CFAbsoluteTimeGetCurrent() - startTime > maxPrefillTime ? .timeout : nil
+    }
+
+    /// Records a sampled token; returns a finish reason if the sequence is done.
+    func accept(_ token: Int) -> FinishReason? {
+        if request.config.stopTokens.contains(token) {
+            return .stop
+        }
+
+        tokens.append(token)
+        lastToken = token
+        if !processors.isEmpty {
+            processors.didSample(MLXArray([Int32(token)]))
+        }
+
+        if !request.onToken(token) {
+            return .cancelled
+        }
+        if tokens.count >= request.config.maxTokens {
+            return .length
+        }
+        return nil
+    }
+
+    func finish(_ reason: FinishReason) {
+        request.completion(GenerationOutput(tokens: tokens, finishReason: reason))
+    }
+}
+
+// MARK: - Prefill State
+
+/// A request whose prompt is being prefilled into a batch of its own.
+private final class PrefillState {
+    let sequence: ActiveSequence
+    let batch: PagedBatch
+
+    /// Prompt tokens not yet run through the model.
+    var remaining: ArraySlice<Int>
+
+    init(sequence: ActiveSequence, batch: PagedBatch, remaining: ArraySlice<Int>) {
+        self.sequence = sequence
+        self.batch = batch
+        self.remaining = remaining
+    }
+}
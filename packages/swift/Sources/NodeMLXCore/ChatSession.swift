@@ -0,0 +1,209 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Multi-turn sessions that keep their KV cache between turns.
+
+import Foundation
+import MLX
+
+// MARK: - Chat Session
+
+/// A conversation whose KV cache stays alive between turns.
+///
+/// Text is appended as it arrives; `generate` processes only the tokens the
+/// cache has not seen yet and adds the reply to the session. `rewind` drops
+/// trailing tokens, e.g. to retry or edit the last turn.
+///
+/// Not thread-safe: all calls must come from the same thread (or be serialized).
+public final class ChatSession {
+    private let model: any LLMModel
+    private let tokenizer: any TokenizerProtocol
+    private var cache: [KVCacheProtocol]
+
+    /// All tokens of the session: appended text and generated replies.
+    public private(set) var tokens: [Int] = []
+
+    /// Number of tokens already held by the KV cache.
+    public var cachedTokenCount: Int { cache.first?.offset ?? 0 }
+
+    /// Bytes of the keys and values held by the KV cache.
+    public var cacheBytes: Int {
+        cacheArrays(cache).reduce(0) { $0 + $1.nbytes }
+    }
+
+    /// Creates an empty session.
+    public init(model: any LLMModel, tokenizer: any TokenizerProtocol) {
+        self.model = model
+        self.tokenizer = tokenizer
+        cache = model.newCache()
+    }
+
+    /// Tokenizes text and appends it to the session.
+    ///
+    /// Special tokens (such as BOS) are only added at the start of the session.
+    ///
+    /// - Parameter text: Text to append (usually a formatted chat turn)
+    /// - Returns: Number of tokens added
+    @discardableResult
+    public func append(_ text: String) -> Int {
+        let newTokens = tokenizer.encode(text: text, addSpecialTokens: tokens.isEmpty)
+        tokens += newTokens
+        return newTokens.count
+    }
+
+    /// Appends token IDs to the session.
+    public func append(tokens newTokens: [Int]) {
+        tokens += newTokens
+    }
+
+    /// Generates the next turn and appends it to the session.
+    ///
+    /// - Parameters:
+    ///   - config: Generation configuration
+    ///   - onToken: Callback for each generated token (return false to stop)
+    /// - Returns: Generation result for this turn
+    public func generate(
+        config: GenerationConfig,
+        onToken: @escaping (String) -> Bool
+    ) -> GenerationResult {
+        let startTime = CFAbsoluteTimeGetCurrent()
+        var firstTokenTime: CFAbsoluteTime?
+
+        var config = config
+        if let eosId = tokenizer.eosTokenId {
+            config.stopTokens.insert(eosId)
+        }
+
+        guard !tokens.isEmpty else {
+            return GenerationResult(
+                text: "", tokenCount: 0, tokensPerSecond: 0, timeToFirstToken: 0, totalTime: 0, finishReason: .length
+            )
+        }
+
+        // The model needs at least one unprocessed token to produce logits
+        if cachedTokenCount >= tokens.count {
+            syncCache(to: tokens.count - 1)
+        }
+
+        // generate() swaps in quantized caches when a layer passes quantizedKvStart,
+        // which the session would not see. Quantize up front if this turn may get there.
+        if config.kvBits != nil, tokens.count + config.maxTokens > config.quantizedKvStart {
+            var quantizeNow = config
+            quantizeNow.quantizedKvStart = 0
+            var layers: [KVCacheProtocol]? = cache
+            maybeQuantizeKVCache(&layers, config: quantizeNow)
+            cache = layers ?? cache
+        }
+
+        let output = NodeMLXCore.generate(
+            model: model,
+            inputIds: tokens,
+            config: config,
+            promptCache: cache,
+            onToken: { tokenId in
+                if firstTokenTime == nil {
+                    firstTokenTime = CFAbsoluteTimeGetCurrent()
+                }
+                return onToken(self.tokenizer.decode(tokens: [tokenId]))
+            }
+        )
+        tokens += output.tokens
+
+        let endTime = CFAbsoluteTimeGetCurrent()
+        let totalTime = endTime - startTime
+        let generatedIds = output.tokens
+
+        return GenerationResult(
+            text: tokenizer.decode(tokens: generatedIds),
+            tokenCount: generatedIds.count,
+            tokensPerSecond: generatedIds.count > 0 ? Float(generatedIds.count) / Float(totalTime) : 0,
+            timeToFirstToken: (firstTokenTime ?? endTime) - startTime,
+            totalTime: totalTime,
+            finishReason: output.finishReason,
+            logprobs: output.logprobs
+        )
+    }
+
+    /// Drops the last tokens of the session.
+    ///
+    /// - Parameter count: Number of tokens to drop (clamped to the session length)
+    /// - Returns: Number of tokens left
+    @discardableResult
+    public func rewind(_ count: Int) -> Int {
+        tokens.removeLast(min(max(count, 0), tokens.count))
+        if cachedTokenCount > tokens.count {
+            syncCache(to: tokens.count)
+        }
+        return tokens.count
+    }
+
+    /// Clears all tokens and the KV cache.
+    public func reset() {
+        tokens.removeAll()
+        cache = model.newCache()
+    }
+
+    // MARK: - Persistence
+
+    /// Saves the session's tokens and KV cache to a safetensors file.
+    ///
+    /// The file records a fingerprint of the model, so it can only be loaded
+    /// back into the same model. Use it to skip prefill of long, recurring
+    /// prompts after a restart.
+    ///
+    /// - Parameter url: Destination file
+    public func save(to url: URL) throws {
+        try savePromptCache(url: url, cache: cache, metadata: [
+            "session.tokens": tokens.map(String.init).joined(separator: ","),
+            "model.fingerprint": modelFingerprint(model),
+        ])
+    }
+
+    /// Restores a session saved with `save(to:)`.
+    ///
+    /// - Parameters:
+    ///   - url: File written by `save(to:)`
+    ///   - model: Model the session was saved with
+    ///   - tokenizer: Tokenizer of the model
+    /// - Returns: Session with the saved tokens and KV cache
+    /// - Throws: `PromptCacheError.modelMismatch` if the file belongs to another model
+    public static func load(
+        from url: URL,
+        model: any LLMModel,
+        tokenizer: any TokenizerProtocol
+    ) throws -> ChatSession {
+        let (cache, metadata) = try loadPromptCache(url: url)
+        guard metadata["model.fingerprint"] == modelFingerprint(model) else {
+            throw PromptCacheError.modelMismatch
+        }
+        guard let tokenList = metadata["session.tokens"] else {
+            throw PromptCacheError.invalidFile("missing session.tokens")
+        }
+        let tokens = tokenList.split(separator: ",").compactMap { Int($0) }
+        guard cache.count == model.newCache().count, cacheLength(cache) <= tokens.count else {
+            throw PromptCacheError.invalidFile("cache does not match the session tokens")
+        }
+
+        let session = ChatSession(model: model, tokenizer: tokenizer)
+        session.tokens = tokens
+        session.cache = cache
+        return session
+    }
+
+    /// Tokens held by the KV cache and the cache itself, e.g. to seed a `PrefixCache`.
+    var cachedPrefix: (tokens: [Int], cache: [KVCacheProtocol]) {
+        (Array(tokens.prefix(cachedTokenCount)), cache)
+    }
+
+    // MARK: - Private
+
+    /// Shrinks the cache to `length` tokens, rebuilding it if it cannot be trimmed.
+    private func syncCache(to length: Int) {
+        let excess = cachedTokenCount - length
+        if canTrimPromptCache(cache), trimPromptCache(cache, numTokens: excess) == excess {
+            return
+        }
+        // Sliding-window caches cannot be trimmed; the next turn re-processes everything
+        cache = model.newCache()
+    }
+}
@@ -0,0 +1,193 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Compiled model cache: the final, sanitized and quantized parameters of a
+// model, stored so later loads can apply them without any transforms.
+
+import Foundation
+import MLX
+import MLXNN
+
+// MARK: - Compiled Model Cache
+
+/// Directory of compiled models, one safetensors file per model.
+///
+/// A compiled model holds the parameter tree exactly as the model uses it:
+/// keys already renamed by `sanitize`, MoE tensors already repacked, and the
+/// names and settings of quantized layers in the file metadata. Loading one
+/// maps a single file and applies it as is.
+///
+/// Entries are keyed by the model's `config.json` and the names, sizes and
+/// modification dates of its weight files, so a changed model gets a new
+/// entry. Stale entries are never removed automatically.
+public struct CompiledModelCache {
+    /// Bumped when the file layout changes, which invalidates all entries.
+    static let formatVersion = "2"
+
+    /// Directory holding the compiled models.
+    public let directory: URL
+
+    public init(directory: URL) {
+        self.directory = directory
+    }
+
+    /// Location of the compiled model for a model directory.
+    ///
+    /// - Parameter modelDirectory: Directory with `config.json` and the original weights
+    /// - Returns: File URL inside `directory` (may not exist yet)
+    public func url(forModelAt modelDirectory: URL) throws -> URL {
+        var hasher = StableHasher()
+        hasher.combine(Self.formatVersion.utf8)
+        hasher.combine(try modelRevision(at: modelDirectory).utf8)
+
+        return directory.appendingPathComponent("\(hasher.hexDigest).safetensors")
+    }
+}
+
+// MARK: - Model Revision
+
+/// Identifies the files of a model directory without reading its weights.
+///
+/// Hashes `config.json` and the names, sizes and modification dates of the
+/// weight files, so it changes whenever a new revision is downloaded.
+///
+/// - Parameter modelDirectory: Directory with `config.json` and the weights
+/// - Returns: Hex digest
+public func modelRevision(at modelDirectory: URL) throws -> String {
+    let fileManager = FileManager.default
+    var hasher = StableHasher()
+    hasher.combine(try Data(contentsOf: modelDirectory.appendingPathComponent("config.json")))
+
+    let weightFiles = try fileManager.contentsOfDirectory(at: modelDirectory, includingPropertiesForKeys: nil)
+        .filter { ["safetensors", "npz"].contains($0.pathExtension) }
+        .sorted { $0.lastPathComponent < $1.lastPathComponent }
+    for file in weightFiles {
+        // Hub snapshots are symlinks into the blob store; describe the blob
+        let attributes = try fileManager.attributesOfItem(atPath: file.resolvingSymlinksInPath().path)
+        let size = (attributes[.size] as? NSNumber)?.int64Value ?? 0
+        let modified = (attributes[.modificationDate] as? Date)?.timeIntervalSince1970 ?? 0
+        hasher.combine("\(file.lastPathComponent):\(size):\(modified)".utf8)
+    }
+
+    return hasher.hexDigest
+}
+
+// MARK: - Saving
+
+/// Writes a model's parameters and quantized layers to a compiled model file.
+///
+/// The file is written next to its destination and then moved into place,
+/// so concurrent loads never see a partial file. Parameters that share one
+/// array (tied embeddings) are stored once.
+///
+/// - Parameters:
+///   - model: Model with its weights applied
+///   - url: Destination, usually from `CompiledModelCache.url(forModelAt:)`
+func saveCompiledModel(_ model: any LLMModel, to url: URL) throws {
+    var arrays: [String: MLXArray] = [:]
+    var aliases: [String: String] = [:]
+    var seen: [ObjectIdentifier: String] = [:]
+    for (name, value) in model.parameters().flattened().sorted(by: { $0.0 < $1.0 }) {
+        if let original = seen[ObjectIdentifier(value)] {
+            aliases[name] = original
+        } else {
+            seen[ObjectIdentifier(value)] = name
+            arrays[name] = value
+        }
+    }
+
+    // Every quantized layer type (linear layers, embeddings) has to be recreated on load
+    var quantized: [String: [Int]] = [:]
+    for (path, module) in model.leafModules().flattened() {
+        if let layer = module as? Quantized {
+            quantized[path] = [layer.groupSize, layer.bits]
+        }
+    }
+
+    let encoder = JSONEncoder()
+    let metadata = try [
+        "node_mlx.format": CompiledModelCache.formatVersion,
+        "node_mlx.quantized": String(decoding: encoder.encode(quantized), as: UTF8.self),
+        "node_mlx.aliases": String(decoding: encoder.encode(aliases), as: UTF8.self),
+    ]
+
+    let fileManager = FileManager.default
+    try fileManager.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+    let partial = url.deletingLastPathComponent()
+        .appendingPathComponent(".\(UUID().uuidString).partial.safetensors")
+    defer { try? fileManager.removeItem(at: partial) }
+
+    try MLX.save(arrays: arrays, metadata: metadata, url: partial)
+    if fileManager.fileExists(atPath: url.path) {
+        // Another process compiled the same model meanwhile
+        return
+    }
+    try fileManager.moveItem(at: partial, to: url)
+}
+
+// MARK: - Loading
+
+/// Contents of a compiled model file, read but not yet applied to a model.
+struct CompiledModelFile {
+    /// Group size and bits of each quantized layer, by module path
+    let quantized: [String: [Int]]
+
+    /// All parameters, including the names of shared arrays
+    let parameters: [String: MLXArray]
+}
+
+/// Reads a compiled model file.
+///
+/// Only copies the tensors out of the file; nothing is computed, so this
+/// can run off the compute queue.
+///
+/// - Parameter url: File written by `saveCompiledModel`
+/// - Throws: `LLMEngineError.invalidWeights` if the file is not a compiled model
+func readCompiledModel(from url: URL) async throws -> CompiledModelFile {
+    let file = try SafetensorsFile(url: url)
+    guard file.metadata["node_mlx.format"] == CompiledModelCache.formatVersion,
+          let quantizedJSON = file.metadata["node_mlx.quantized"],
+          let aliasesJSON = file.metadata["node_mlx.aliases"]
+    else {
+        throw LLMEngineError.invalidWeights("\(url.lastPathComponent): not a compiled model")
+    }
+    let decoder = JSONDecoder()
+    let quantized = try decoder.decode([String: [Int]].self, from: Data(quantizedJSON.utf8))
+    let aliases = try decoder.decode([String: String].self, from: Data(aliasesJSON.utf8))
+
+    var parameters = await file.loadAll()
+    for (name, original) in aliases {
+        parameters[name] = parameters[original]
+    }
+    return CompiledModelFile(quantized: quantized, parameters: parameters)
+}
+
+/// Applies a compiled model to a freshly created model.
+///
+/// Replaces the layers recorded as quantized, then sets all parameters
+/// without sanitizing. The arrays are not evaluated yet.
+///
+/// - Parameters:
+///   - compiled: File read with `readCompiledModel(from:)`
+///   - model: Model created from the same configuration
+/// - Throws: An error if the parameters do not match the model
+func applyCompiledModel(_ compiled: CompiledModelFile, to model: any LLMModel) throws {
+    let quantized = compiled.quantized
+    if !quantized.isEmpty {
+        quantizeLayers(in: model, settings: { path, _ in
+            guard let settings = quantized[path], settings.count == 2 else { return nil }
+            return (settings[0], settings[1], .affine)
+        })
+    }
+    try model.update(parameters: ModuleParameters.unflattened(compiled.parameters), verify: .all)
+}
+
+/// Reads a compiled model file and applies it to a freshly created model.
+///
+/// - Parameters:
+///   - model: Model created from the same configuration
+///   - url: File written by `saveCompiledModel`
+/// - Throws: `LLMEngineError.invalidWeights` if the file is not a compiled model
+func loadCompiledModel(_ model: any LLMModel, from url: URL) async throws {
+    try applyCompiledModel(await readCompiledModel(from: url), to: model)
+}
@@ -0,0 +1,161 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Text embeddings from the hidden states of a language model.
+
+import Foundation
+import MLX
+
+// MARK: - Embedding Configuration
+
+/// How the hidden states of a text's tokens are combined into one vector.
+public enum Pooling: String, CaseIterable, Sendable {
+    /// Average over all tokens.
+    case mean
+    /// The last token, which has attended to the whole text.
+    case last
+    /// The first token (usually BOS), as in BERT-style `[CLS]` pooling.
+    case cls
+}
+
+/// Configuration for `embed(model:sequences:config:)`.
+public struct EmbeddingConfig: Sendable {
+    /// How token states are combined (default: mean)
+    public var pooling: Pooling
+
+    /// Hidden state to read, indexed like Hugging Face's `hidden_states`:
+    /// 0 is the token embeddings, `i` the output of decoder layer `i`, and
+    /// negative values count from the end. -1 (the default) is the final,
+    /// normalized state that feeds the LM head.
+    public var layer: Int
+
+    /// Scale each vector to unit length (default: true)
+    public var normalize: Bool
+
+    /// Upper bound on tokens (including padding) per forward pass
+    public var maxBatchTokens: Int
+
+    public init(
+        pooling: Pooling = .mean,
+        layer: Int = -1,
+        normalize: Bool = true,
+        maxBatchTokens: Int = 8192
+    ) {
+        self.pooling = pooling
+        self.layer = layer
+        self.normalize = normalize
+        self.maxBatchTokens = maxBatchTokens
+    }
+
+    /// Decoder layers to run for `layer`; nil runs all of them and the final norm.
+    ///
+    /// - Throws: `LLMEngineError.invalidConfig` if `layer` is out of range
+    func depth(numLayers: Int) throws -> Int? {
+        let index = layer < 0 ? layer + numLayers + 1 : layer
+        guard (0 ... numLayers).contains(index) else {
+            throw LLMEngineError.invalidConfig("layer \(layer) is out of range for \(numLayers) layers")
+        }
+        return index == numLayers ? nil : index
+    }
+}
+
+// MARK: - Embedding
+
+/// Embeds token sequences with the hidden states of a model (without its LM head).
+///
+/// Sequences are sorted by length and run in batches of up to
+/// `config.maxBatchTokens` tokens, right-padded to the longest one in the
+/// batch. Causal attention keeps real tokens from attending to the padding
+/// after them, so no padding mask is needed and every architecture
+/// (including sliding-window attention) gets exact results; padded positions
+/// are left out of the pooling.
+///
+/// - Parameters:
+///   - model: The model
+///   - sequences: Token IDs of each text (not empty)
+///   - config: Pooling, layer and normalization
+/// - Returns: Float32 embeddings, shape [sequences.count, hidden_size], in input order
+/// - Throws: `LLMEngineError.invalidConfig` for empty input or an invalid layer
+public func embed(
+    model: any LLMModel,
+    sequences: [[Int]],
+    config: EmbeddingConfig = EmbeddingConfig()
+) throws -> MLXArray {
+    guard !sequences.isEmpty else {
+        throw LLMEngineError.invalidConfig("no texts to embed")
+    }
+    if let empty = sequences.firstIndex(where: \.isEmpty) {
+        throw LLMEngineError.invalidConfig("text \(empty) has no tokens")
+    }
+    let depth = try config.depth(numLayers: model.numLayers)
+
+    // Longest first, so each batch pads to similar lengths
+    let order = sequences.indices.sorted { sequences[$0].count > sequences[$1].count }
+
+    var batches: [MLXArray] = []
+    var start = 0
+    while start < order.count {
+        let width = sequences[order[start]].count
+        let rows = max(1, min(order.count - start, config.maxBatchTokens / width))
+        let batch = order[start ..< start + rows]
+
+        var ids = [Int32](repeating: 0, count: rows * width)
+        for (row, index) in batch.enumerated() {
+            for (column, token) in sequences[index].enumerated() {
+                ids[row * width + column] = Int32(token)
+            }
+        }
+
+        let hidden = model.hiddenStates(MLXArray(ids).reshaped([rows, width]), depth: depth)
+        var vectors = poolHiddenStates(
+            hidden.asType(.float32),
+            lengths: batch.map { sequences[$0].count },
+            pooling: config.pooling
+        )
+        if config.normalize {
+            let norms = sqrt((vectors * vectors).sum(axis: -1, keepDims: true))
+            vectors = vectors / maximum(norms, MLXArray(Float(1e-12)))
+        }
+
+        // Release the batch's activations before the next one
+        eval(vectors)
+        batches.append(vectors)
+        start += rows
+    }
+
+    // Back to input order
+    var positions = [Int32](repeating: 0, count: order.count)
+    for (position, index) in order.enumerated() {
+        positions[index] = Int32(position)
+    }
+    let embeddings = batches.count == 1 ? batches[0] : concatenated(batches, axis: 0)
+    return take(embeddings, MLXArray(positions), axis: 0)
+}
+
+/// Pools right-padded hidden states into one vector per row.
+///
+/// - Parameters:
+///   - hidden: Hidden states, shape [batch, seq, hidden]
+///   - lengths: Number of real (unpadded) tokens in each row, at least 1
+///   - pooling: How token states are combined
+/// - Returns: Pooled states, shape [batch, hidden]
+func poolHiddenStates(_ hidden: MLXArray, lengths: [Int], pooling: Pooling) -> MLXArray {
+    let batch = hidden.dim(0)
+    let width = hidden.dim(1)
+
+    switch pooling {
+    case .cls:
+        return hidden[0..., 0, 0...]
+
+    case .last:
+        let positions = MLXArray(lengths.map { Int32($0 - 1) }).reshaped([batch, 1, 1])
+        let indices = broadcast(positions, to: [batch, 1, hidden.dim(2)])
+        return takeAlong(hidden, indices, axis: 1).squeezed(axis: 1)
+
+    case .mean:
+        let counts = MLXArray(lengths.map { Int32($0) }).reshaped([batch, 1])
+        let columns = MLXArray(Array(0 ..< Int32(width))).reshaped([1, width])
+        let mask = (columns .< counts).expandedDimensions(axis: -1).asType(hidden.dtype)
+        return (hidden * mask).sum(axis: 1) / counts.asType(hidden.dtype)
+    }
+}
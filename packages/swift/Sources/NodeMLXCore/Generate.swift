@@ -20,30 +20,242 @@ public struct GenerationConfig {
     /// Top-p nucleus sampling threshold.
     public var topP: Float
 
+    /// Number of most likely tokens to sample from (0 = all).
+    public var topK: Int
+
+    /// Minimum probability relative to the most likely token (0 = disabled).
+    public var minP: Float
+
     /// Repetition penalty (1.0 = no penalty).
     public var repetitionPenalty: Float
 
+    /// Number of recent tokens (prompt included) the penalties look at.
+    public var repetitionContextSize: Int
+
+    /// Subtracted from a token's logit once per occurrence in the window (0 = no penalty).
+    public var frequencyPenalty: Float
+
+    /// Subtracted from the logit of every token in the window (0 = no penalty).
+    public var presencePenalty: Float
+
+    /// Creates the logits processors of each generation, applied in order
+    /// after the penalties.
+    ///
+    /// Every generation calls each factory once with its prompt, so the
+    /// processors can keep per-request state. Speculative decoding does not
+    /// apply them; `LLMEngine` generates without speculation when any are set.
+    public var logitsProcessors: [LogitsProcessorFactory]
+
+    /// Grammar the output must match (nil = unconstrained).
+    ///
+    /// `LLMEngine` binds it to its tokenizer and adds the resulting processor
+    /// to `logitsProcessors` (see `LLMEngine.resolvingGrammar(_:)`).
+    public var grammar: Grammar?
+
+    /// Report the log-probability of every generated token together with this
+    /// many most likely alternatives (nil = off). See `GenerationLogprobs`.
+    ///
+    /// Computed on the device in the same graph as sampling; speculative
+    /// decoding does not support it, so `LLMEngine` generates without it.
+    public var logprobs: Int?
+
     /// Token IDs that signal end of generation.
     public var stopTokens: Set<Int>
 
+    /// Wall-clock limit for the whole generation in seconds (nil = no limit).
+    public var timeLimit: TimeInterval?
+
+    /// Limit for processing the prompt in seconds (nil = no limit).
+    public var maxPrefillTime: TimeInterval?
+
+    /// Checked before every step; cancelling stops generation after the current step.
+    public var cancellation: CancellationToken?
+
+    /// Maximum number of prompt tokens processed per forward pass.
+    ///
+    /// Long prompts are fed through the cache in chunks of this size, which
+    /// bounds peak activation memory by one chunk instead of the whole prompt.
+    public var prefillStepSize: Int
+
+    /// Tokens proposed per verification step in speculative decoding.
+    public var numDraftTokens: Int
+
+    /// N-gram length for prompt-lookup speculative decoding (0 = off).
+    ///
+    /// Used when no draft model is loaded: continuations are proposed by
+    /// matching the last tokens against the prompt and earlier output.
+    public var promptLookupNgramSize: Int
+
+    /// Bits per element for quantized KV cache storage (nil = full precision).
+    ///
+    /// Once a layer's cache holds `quantizedKvStart` tokens it is converted to
+    /// a `QuantizedKVCache`, cutting its memory by roughly 16 / bits.
+    public var kvBits: Int?
+
+    /// Quantization group size for the KV cache.
+    public var kvGroupSize: Int
+
+    /// Number of cached tokens after which the KV cache is quantized.
+    public var quantizedKvStart: Int
+
     /// Creates a generation configuration.
     public init(
         maxTokens: Int = 256,
         temperature: Float = 0.7,
         topP: Float = 0.9,
+        topK: Int = 0,
+        minP: Float = 0,
         repetitionPenalty: Float = 1.0,
-        stopTokens: Set<Int> = []
+        repetitionContextSize: Int = 20,
+        frequencyPenalty: Float = 0,
+        presencePenalty: Float = 0,
+        logitsProcessors: [LogitsProcessorFactory] = [],
+        grammar: Grammar? = nil,
+        logprobs: Int? = nil,
+        stopTokens: Set<Int> = [],
+        timeLimit: TimeInterval? = nil,
+        maxPrefillTime: TimeInterval? = nil,
+        cancellation: CancellationToken? = nil,
+        prefillStepSize: Int = 2048,
+        numDraftTokens: Int = 3,
+        promptLookupNgramSize: Int = 0,
+        kvBits: Int? = nil,
+        kvGroupSize: Int = 64,
+        quantizedKvStart: Int = 0
     ) {
         self.maxTokens = maxTokens
         self.temperature = temperature
         self.topP = topP
+        self.topK = topK
+        self.minP = minP
         self.repetitionPenalty = repetitionPenalty
+        self.repetitionContextSize = repetitionContextSize
+        self.frequencyPenalty = frequencyPenalty
+        self.presencePenalty = presencePenalty
+        self.logitsProcessors = logitsProcessors
+        self.grammar = grammar
+        self.logprobs = logprobs
         self.stopTokens = stopTokens
+        self.timeLimit = timeLimit
+        self.maxPrefillTime = maxPrefillTime
+        self.cancellation = cancellation
+        self.prefillStepSize = prefillStepSize
+        self.numDraftTokens = numDraftTokens
+        self.promptLookupNgramSize = promptLookupNgramSize
+        self.kvBits = kvBits
+        self.kvGroupSize = kvGroupSize
+        self.quantizedKvStart = quantizedKvStart
+    }
+}
+
+// MARK: - Cancellation
+
+/// Cooperative cancellation flag, checked once per generation step.
+///
+/// Cancel from any thread with `cancel()`, or let the token observe an
+/// external 32-bit flag (e.g. shared memory written by the Node.js binding)
+/// that counts as cancelled once it is non-zero. A token can also follow
+/// other tokens, so one request stops when either its caller or its engine
+/// cancels.
+public final class CancellationToken: @unchecked Sendable {
+    private let lock = NSLock()
+    private var cancelled = false
+    private let externalFlag: UnsafePointer<Int32>?
+    private let linked: [CancellationToken]
+
+    /// Creates a token, optionally backed by an external flag that must
+    /// outlive every generation using this token.
+    ///
+    /// - Parameters:
+    ///   - externalFlag: Flag that cancels the token once it is non-zero
+    ///   - linked: Tokens whose cancellation also cancels this one
+    public init(externalFlag: UnsafePointer<Int32>? = nil, linkedTo linked: [CancellationToken] = []) {
+        self.externalFlag = externalFlag
+        self.linked = linked
+    }
+
+    /// Requests cancellation.
+    public func cancel() {
+        lock.lock()
+        cancelled = true
+        lock.unlock()
+    }
+
+    /// Whether cancellation has been requested.
+    public var isCancelled: Bool {
+        lock.lock()
+        let cancelled = self.cancelled
+        lock.unlock()
+
+        // Aligned 32-bit loads are single-copy atomic on arm64
+        if cancelled || externalFlag.map({ $0.pointee != 0 }) == true {
+            return true
+        }
+        return linked.contains { $0.isCancelled }
     }
 }
 
+// MARK: - Generation Output
+
+/// Why a generation finished.
+public enum FinishReason: String, Sendable {
+    /// A stop token was sampled.
+    case stop
+    /// `maxTokens` tokens were generated.
+    case length
+    /// The cancellation token fired or the token callback returned false.
+    case cancelled
+    /// `timeLimit` or `maxPrefillTime` was exceeded.
+    case timeout
+}
+
+/// Tokens produced by `generate` and the reason it stopped.
+public struct GenerationOutput: Sendable {
+    /// Generated token IDs (excluding input).
+    public let tokens: [Int]
+
+    /// Why generation finished.
+    public let finishReason: FinishReason
+
+    /// Acceptance stats if speculative decoding was used.
+    public var speculative: SpeculativeStats?
+
+    /// Log-probabilities of `tokens` if `GenerationConfig.logprobs` was set.
+    public var logprobs: GenerationLogprobs?
+}
+
 // MARK: - Token Sampling
 
+/// Samples the next token on the device, without waiting for the result.
+///
+/// The returned array can feed the next forward pass directly, so the host
+/// only has to read it (`item`) once it needs the token ID.
+///
+/// - Parameters:
+///   - logits: Model output logits [..., vocab_size]
+///   - temperature: Sampling temperature (0 = greedy)
+///   - topP: Nucleus sampling threshold
+///   - topK: Number of most likely tokens to sample from (0 = all)
+///   - minP: Minimum probability relative to the most likely token
+/// - Returns: Sampled token IDs, shape of `logits` without the last axis
+public func sample(
+    logits: MLXArray,
+    temperature: Float,
+    topP: Float = 1.0,
+    topK: Int = 0,
+    minP: Float = 0
+) -> MLXArray {
+    // Greedy decoding for temperature 0
+    if temperature == 0 {
+        return argMax(logits, axis: -1)
+    }
+
+    let shape = Array(logits.shape.dropLast())
+    let rows = logits.reshaped([-1, logits.dim(-1)])
+    let config = GenerationConfig(temperature: temperature, topP: topP, topK: topK, minP: minP)
+    return sample(logits: rows, configs: Array(repeating: config, count: rows.dim(0))).reshaped(shape)
+}
+
 /// Samples the next token from logits.
 ///
 /// - Parameters:
@@ -56,47 +268,90 @@ public func sampleToken(
     temperature: Float,
     topP: Float = 1.0
 ) -> Int {
-    // Greedy decoding for temperature 0
-    if temperature == 0 {
-        return argMax(logits).item(Int.self)
-    }
+    sample(logits: logits, temperature: temperature, topP: topP).item(Int.self)
+}
 
-    // Apply temperature
-    var scaledLogits = logits / temperature
+// MARK: - Prefill
 
-    // Apply top-p (nucleus) sampling if needed
-    if topP < 1.0 {
-        scaledLogits = applyTopP(scaledLogits, topP: topP)
+/// Runs prompt tokens through the model in chunks of at most `stepSize` tokens.
+///
+/// Every chunk but the last is evaluated on its own (see `evalCache`), so
+/// peak memory stays flat for long prompts instead of growing with them.
+///
+/// - Parameters:
+///   - model: The language model to use
+///   - inputIds: Prompt tokens not yet held by `cache`
+///   - cache: Per-layer caches, updated in place
+///   - stepSize: Maximum tokens per forward pass
+///   - quantizeCache: Applied after every chunk, e.g. to switch layers to quantized storage
+///   - shouldStop: Checked between chunks; returning true abandons the prefill
+/// - Returns: Logits of the last chunk [1, chunk, vocab_size], or nil if stopped
+public func prefill(
+    model: any LLMModel,
+    inputIds: ArraySlice<Int>,
+    cache: inout [KVCacheProtocol]?,
+    stepSize: Int,
+    quantizeCache: (inout [KVCacheProtocol]?) -> Void = { _ in },
+    shouldStop: () -> Bool = { false }
+) -> MLXArray? {
+    let stepSize = max(stepSize, 1)
+    var remaining = inputIds
+
+    while remaining.count > stepSize {
+        let chunk = remaining.prefix(stepSize)
+        _ = model(MLXArray(chunk.map { Int32($0) }).reshaped([1, chunk.count]), cache: &cache)
+        quantizeCache(&cache)
+        evalCache(cache ?? [])
+
+        remaining = remaining.dropFirst(stepSize)
+        if shouldStop() {
+            return nil
+        }
     }
 
-    // Sample from the distribution
-    let probs = softmax(scaledLogits)
-    let token = categorical(probs)
-    return token.item(Int.self)
+    let logits = model(MLXArray(remaining.map { Int32($0) }).reshaped([1, remaining.count]), cache: &cache)
+    quantizeCache(&cache)
+    return logits
 }
 
-/// Applies top-p (nucleus) sampling by zeroing low-probability tokens.
-private func applyTopP(_ logits: MLXArray, topP: Float) -> MLXArray {
-    let probs = softmax(logits)
-    let sortedIndices = argSort(probs)
-    let sortedProbs = probs[sortedIndices]
-
-    // Find cumulative probabilities
-    let cumProbs = cumsum(sortedProbs)
-
-    // Find tokens below threshold
-    let belowThreshold = cumProbs .<= (1.0 - topP)
+/// Evaluates the keys and values of per-layer caches and releases buffers
+/// the allocator kept around from the forward pass.
+///
+/// Only the cache is evaluated, so the logits of intermediate prefill chunks
+/// (the largest activation for big vocabularies) are never materialized.
+func evalCache(_ cache: [KVCacheProtocol]) {
+    eval(cacheArrays(cache))
+    GPU.clearCache()
+}
 
-    // Mask out tokens below threshold
-    var result = logits
-    let maskValue = Float.leastNormalMagnitude
-    result = which(belowThreshold, MLXArray(maskValue), sortedProbs)
+/// Arrays that store the keys and values of per-layer caches.
+func cacheArrays(_ cache: [KVCacheProtocol]) -> [MLXArray] {
+    cache.flatMap { layer in
+        // The state of a quantized cache is a dequantized copy
+        if let quantized = layer as? QuantizedKVCache {
+            return quantized.arrays
+        }
+        // The state of a paged cache is gathered from the pool
+        if let paged = layer as? PagedKVCache {
+            return paged.arrays
+        }
+        return layer.state.map { [$0.keys, $0.values] } ?? []
+    }
+}
 
-    // Unsort back to original order
-    let unsorted = MLXArray.zeros(like: logits)
-    unsorted[sortedIndices] = result
+/// Replaces `StandardKVCache` layers with quantized copies once they hold
+/// `config.quantizedKvStart` tokens, if `config.kvBits` is set.
+///
+/// Other cache types (sliding window, batch) are left as they are.
+func maybeQuantizeKVCache(_ cache: inout [KVCacheProtocol]?, config: GenerationConfig) {
+    guard let bits = config.kvBits, let layers = cache else { return }
 
-    return unsorted
+    cache = layers.map { layer in
+        guard let standard = layer as? StandardKVCache, standard.offset >= config.quantizedKvStart else {
+            return layer
+        }
+        return standard.toQuantized(groupSize: config.kvGroupSize, bits: bits)
+    }
 }
 
 // MARK: - Generation Loop
@@ -107,61 +362,185 @@ private func applyTopP(_ logits: MLXArray, topP: Float) -> MLXArray {
 ///   - model: The language model to use
 ///   - inputIds: Initial token IDs
 ///   - config: Generation configuration
-///   - onToken: Callback for each generated token
-/// - Returns: Array of generated token IDs (excluding input)
+///   - promptCache: Per-layer caches to use and update in place. If they already
+///     hold a prefix of `inputIds` (shorter than `inputIds`), only the rest is prefilled.
+///     With `config.kvBits`, layers are replaced by quantized copies once they pass
+///     `config.quantizedKvStart`; the replaced caches keep the prefix processed so far.
+///   - onToken: Callback for each generated token (return false to stop)
+/// - Returns: Generated token IDs (excluding input) and the finish reason
+///
+/// Cancellation and the time limit are checked before every model call, so a
+/// cancelled generation releases the device after at most one more step. The
+/// prompt is prefilled in chunks of `config.prefillStepSize` tokens.
 public func generate(
     model: any LLMModel,
     inputIds: [Int],
     config: GenerationConfig = GenerationConfig(),
+    promptCache: [KVCacheProtocol]? = nil,
     onToken: ((Int) -> Bool)? = nil
-) -> [Int] {
+) -> GenerationOutput {
+    let startTime = CFAbsoluteTimeGetCurrent()
+    let deadline = config.timeLimit.map { startTime + $0 }
+
+    func interruption() -> FinishReason? {
+        if config.cancellation?.isCancelled == true {
+            return .cancelled
+        }
+        if let deadline, CFAbsoluteTimeGetCurrent() >= deadline {
+            return .timeout
+        }
+        return nil
+    }
+
+    if let reason = interruption() {
+        return GenerationOutput(tokens: [], finishReason: reason)
+    }
+
     var generatedTokens: [Int] = []
-    var cache: [KVCacheProtocol]? = model.newCache()
+    var finishReason = FinishReason.length
+    var cache: [KVCacheProtocol]? = promptCache ?? model.newCache()
+
+    // Skip the prefix the cache already holds
+    let cachedCount = promptCache?.first?.offset ?? 0
+    precondition(cachedCount == 0 || cachedCount < inputIds.count, "promptCache must leave a token to process")
+    let uncachedIds = inputIds[cachedCount...]
+
+    // Allocate room for the whole sequence once instead of growing during decoding.
+    // Caches that get quantized are left alone: the quantized copy would keep the room.
+    if config.kvBits == nil {
+        for layer in cache ?? [] {
+            (layer as? StandardKVCache)?.reserve(inputIds.count + config.maxTokens)
+        }
+    }
 
-    // Convert input to MLXArray
-    var currentIds = MLXArray(inputIds.map { Int32($0) }).reshaped([1, inputIds.count])
+    func prefillInterruption() -> FinishReason? {
+        if let maxPrefillTime = config.maxPrefillTime, CFAbsoluteTimeGetCurrent() - startTime > maxPrefillTime {
+            return .timeout
+        }
+        return interruption()
+    }
 
     // Process prompt (prefill)
-    var logits = model(currentIds, cache: &cache)
-    eval(logits, cache as Any)
+    var stopReason: FinishReason?
+    guard let logits = prefill(
+        model: model,
+        inputIds: uncachedIds,
+        cache: &cache,
+        stepSize: config.prefillStepSize,
+        quantizeCache: { maybeQuantizeKVCache(&$0, config: config) },
+        shouldStop: {
+            stopReason = prefillInterruption()
+            return stopReason != nil
+        }
+    ) else {
+        return GenerationOutput(tokens: [], finishReason: stopReason ?? .cancelled)
+    }
+
+    // Processors see the prompt and every sampled token, including ones the
+    // host has not read yet
+    let processors = makeLogitsProcessors(config: config, prompt: inputIds)
+
+    let topCount = config.logprobs.map { min(max($0, 0), model.vocabularySize) }
+    var logprobs = topCount.map { GenerationLogprobs(topCount: $0) }
+
+    // Samples the next token, or takes the tokens a processor forces. With
+    // logprobs, their rows are built in the same graph as the sampled token.
+    func sampleNext(_ logits: MLXArray) -> (tokens: MLXArray, logprobs: MLXArray?) {
+        let forced = processors.forcedTokens()
+        guard forced.isEmpty else {
+            let tokens = MLXArray(forced.map { Int32($0) })
+            processors.didSample(tokens)
+            return (tokens, nil)
+        }
+
+        let last = logits[0..., -1, 0...]
+        let tokens = sample(logits: processors.process(last), configs: [config])
+        processors.didSample(tokens)
+        return (tokens, topCount.map { logprobRows(logits: last, tokens: tokens, topCount: $0) })
+    }
+
+    func enqueue(_ step: (tokens: MLXArray, logprobs: MLXArray?)) {
+        asyncEval([step.tokens] + (step.logprobs.map { [$0] } ?? []))
+    }
 
-    // Get logits for last token
-    var nextLogits = logits[0..., -1, 0...]
+    // Decoding is pipelined: the graph for step n + 1 is built from the lazily
+    // sampled token of step n and queued with asyncEval before the host reads
+    // token n, so the device keeps working during callbacks and token decoding.
+    // Forced tokens (e.g. the fixed text of a grammar) skip sampling and are
+    // fed to the model together in one step.
+    var step = sampleNext(logits)
+    enqueue(step)
 
     // Generation loop
-    for _ in 0 ..< config.maxTokens {
-        // Sample next token
-        let nextToken = sampleToken(
-            logits: nextLogits,
-            temperature: config.temperature,
-            topP: config.topP
-        )
+    var isFirstRead = true
+    decoding: while generatedTokens.count < config.maxTokens {
+        if let reason = interruption() {
+            finishReason = reason
+            break
+        }
+
+        // Queue the next step before materializing this one
+        var nextStep: (tokens: MLXArray, logprobs: MLXArray?)?
+        if generatedTokens.count + step.tokens.dim(0) < config.maxTokens {
+            let nextLogits = model(step.tokens.reshaped([1, -1]), cache: &cache)
+            maybeQuantizeKVCache(&cache, config: config)
+            nextStep = sampleNext(nextLogits)
+            enqueue(nextStep!)
+        }
+
+        let tokenIds = step.tokens.asArray(Int32.self).map { Int($0) }
+
+        // Evaluated together with the tokens, so reading them does not wait again
+        let rows = step.logprobs?.asArray(Float.self)
 
-        // Check for stop token
-        if config.stopTokens.contains(nextToken) {
+        // The first read waits for the prefill
+        if isFirstRead, let maxPrefillTime = config.maxPrefillTime,
+           CFAbsoluteTimeGetCurrent() - startTime > maxPrefillTime
+        {
+            finishReason = .timeout
             break
         }
+        isFirstRead = false
 
-        generatedTokens.append(nextToken)
+        for (index, tokenId) in tokenIds.prefix(config.maxTokens - generatedTokens.count).enumerated() {
+            // Check for stop token
+            if config.stopTokens.contains(tokenId) {
+                finishReason = .stop
+                break decoding
+            }
 
-        // Callback for streaming
-        if let onToken {
-            if !onToken(nextToken) {
-                break
+            generatedTokens.append(tokenId)
+            if let topCount, let rows {
+                let width = 1 + 2 * topCount
+                logprobs?.append(row: rows[(index * width) ..< ((index + 1) * width)])
+            } else {
+                logprobs?.appendForced(tokenId)
             }
-        }
 
-        // Prepare next input
-        currentIds = MLXArray([Int32(nextToken)]).reshaped([1, 1])
+            // Callback for streaming
+            if let onToken {
+                if !onToken(tokenId) {
+                    finishReason = .cancelled
+                    break decoding
+                }
+            }
+        }
 
-        // Generate next logits
-        logits = model(currentIds, cache: &cache)
-        eval(logits, cache as Any)
+        if let nextStep {
+            step = nextStep
+        }
+    }
 
-        nextLogits = logits[0..., -1, 0...]
+    // A step queued for tokens that were not emitted (stop token, prefill
+    // timeout) leaves positions too many in the cache
+    if let cache, let offset = cache.first?.offset {
+        let excess = offset - (inputIds.count + generatedTokens.count)
+        if excess > 0 {
+            trimPromptCache(cache, numTokens: excess)
+        }
     }
 
-    return generatedTokens
+    return GenerationOutput(tokens: generatedTokens, finishReason: finishReason, logprobs: logprobs)
 }
 
 // MARK: - Streaming Generation
@@ -183,6 +562,7 @@ public class StreamingGenerator {
     private let model: any LLMModel
     private let config: GenerationConfig
     private var cache: [KVCacheProtocol]?
+    private var processors: [any LogitsProcessor] = []
     private var tokenCount: Int = 0
 
     /// Creates a streaming generator.
@@ -194,17 +574,14 @@ public class StreamingGenerator {
     /// Processes the initial prompt and returns the first token.
     public func processPrompt(_ inputIds: [Int]) -> GenerationStep {
         cache = model.newCache()
+        processors = makeLogitsProcessors(config: config, prompt: inputIds)
 
-        let currentIds = MLXArray(inputIds.map { Int32($0) }).reshaped([1, inputIds.count])
-        let logits = model(currentIds, cache: &cache)
+        let logits = prefill(
+            model: model, inputIds: inputIds[...], cache: &cache, stepSize: config.prefillStepSize
+        )!
         eval(logits, cache as Any)
 
-        let nextLogits = logits[0..., -1, 0...]
-        let nextToken = sampleToken(
-            logits: nextLogits,
-            temperature: config.temperature,
-            topP: config.topP
-        )
+        let nextToken = sampleNext(logits)
 
         tokenCount = 1
 
@@ -225,12 +602,7 @@ public class StreamingGenerator {
         let logits = model(currentIds, cache: &cache)
         eval(logits, cache as Any)
 
-        let nextLogits = logits[0..., -1, 0...]
-        let nextToken = sampleToken(
-            logits: nextLogits,
-            temperature: config.temperature,
-            topP: config.topP
-        )
+        let nextToken = sampleNext(logits)
 
         tokenCount += 1
 
@@ -244,6 +616,13 @@ public class StreamingGenerator {
     /// Resets the generator state.
     public func reset() {
         cache = nil
+        processors = []
         tokenCount = 0
     }
+
+    private func sampleNext(_ logits: MLXArray) -> Int {
+        let token = sample(logits: processors.process(logits[0..., -1, 0...]), configs: [config])
+        processors.didSample(token)
+        return token.item(Int.self)
+    }
 }
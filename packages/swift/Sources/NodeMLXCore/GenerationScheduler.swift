@@ -0,0 +1,110 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Serializes all model work onto one compute queue and interleaves
+// batched decode steps of every loaded model.
+
+import Foundation
+
+// MARK: - Generation Scheduler
+
+/// Runs generation work for all engines on a single serial compute queue.
+///
+/// Two kinds of work are accepted:
+/// - Exclusive jobs (`submit`), such as solo generation or unloading, which
+///   run to completion between decode steps.
+/// - Batched requests (`enqueue`), which join a `BatchGenerator` and advance
+///   one token per scheduler round.
+///
+/// Each round runs pending jobs, then gives every generator with work one
+/// `step()`, so concurrent requests on one or several models make progress
+/// together. The loop exits when there is nothing left to do.
+public final class GenerationScheduler: @unchecked Sendable {
+    /// Scheduler shared by all engines of the process.
+    public static let shared = GenerationScheduler()
+
+    private let queue = DispatchQueue(label: "node-mlx.compute", qos: .userInitiated)
+    private let lock = NSLock()
+
+    private var jobs: [() -> Void] = []
+    private var incoming: [(BatchGenerator, BatchRequest)] = []
+    private var generators: [BatchGenerator] = []
+    private var running = false
+
+    /// Creates a scheduler with its own compute queue.
+    public init() {}
+
+    /// Runs a closure exclusively on the compute queue.
+    public func submit(_ job: @escaping () -> Void) {
+        lock.lock()
+        jobs.append(job)
+        lock.unlock()
+        wake()
+    }
+
+    /// Runs a closure exclusively on the compute queue and returns its result.
+    public func perform<T>(_ body: @escaping () throws -> T) async throws -> T {
+        try await withCheckedThrowingContinuation { continuation in
+            submit {
+                continuation.resume(with: Result(catching: body))
+            }
+        }
+    }
+
+    /// Adds a request to a generator's batch.
+    public func enqueue(_ request: BatchRequest, on generator: BatchGenerator) {
+        lock.lock()
+        incoming.append((generator, request))
+        lock.unlock()
+        wake()
+    }
+
+    // MARK: - Private
+
+    private func wake() {
+        lock.lock()
+        let shouldStart = !running
+        running = true
+        lock.unlock()
+
+        if shouldStart {
+            queue.async { [self] in run() }
+        }
+    }
+
+    private func run() {
+        while true {
+            lock.lock()
+            let roundJobs = jobs
+            let roundRequests = incoming
+            jobs.removeAll()
+            incoming.removeAll()
+            lock.unlock()
+
+            for (generator, request) in roundRequests {
+                generator.insert(request)
+                if !generators.contains(where: { $0 === generator }) {
+                    generators.append(generator)
+                }
+            }
+
+            for job in roundJobs {
+                job()
+            }
+
+            generators.removeAll { !$0.hasWork }
+            for generator in generators {
+                generator.step()
+            }
+            generators.removeAll { !$0.hasWork }
+
+            lock.lock()
+            if generators.isEmpty, jobs.isEmpty, incoming.isEmpty {
+                running = false
+                lock.unlock()
+                return
+            }
+            lock.unlock()
+        }
+    }
+}
@@ -0,0 +1,653 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Grammars for constrained decoding: regular expressions compiled to
+// deterministic automata over UTF-8 bytes.
+
+import Foundation
+
+// MARK: - Grammar
+
+/// A regular language that generated text must match.
+///
+/// Compiled once from a regular expression or a JSON schema into a
+/// deterministic automaton over UTF-8 bytes. The grammar does not depend on
+/// a tokenizer; `TokenGrammar` binds it to a vocabulary.
+///
+/// Supported syntax: literals and escapes, `.`, character classes (with
+/// `\d`, `\w`, `\s` and negation), `(...)`, `(?:...)`, `|` and the
+/// quantifiers `*`, `+`, `?`, `{n}`, `{n,}` and `{n,m}`. Patterns always match
+/// the whole output. Non-ASCII characters are allowed as literals and class
+/// members, but not as range bounds; negated classes and `.` accept every
+/// non-ASCII character.
+public final class Grammar {
+    /// The regular expression the grammar was compiled from.
+    public let pattern: String
+
+    let automaton: ByteAutomaton
+
+    /// Compiles a regular expression.
+    ///
+    /// - Throws: `GrammarError` if the pattern is invalid or its automaton too large
+    public init(regex pattern: String) throws {
+        var parser = RegexParser(pattern)
+        self.pattern = pattern
+        automaton = try ByteAutomaton(parser.parse())
+    }
+
+    /// Compiles a JSON schema (see `jsonSchemaRegex(_:)` for the supported subset).
+    ///
+    /// - Throws: `GrammarError` if the schema is invalid or unsupported
+    public convenience init(jsonSchema: String) throws {
+        try self.init(regex: jsonSchemaRegex(jsonSchema))
+    }
+
+    /// Whether `text` matches the grammar as a whole.
+    public func matches(_ text: String) -> Bool {
+        automaton.walk(from: automaton.start, text.utf8).map { automaton.accepting[$0] } ?? false
+    }
+}
+
+// MARK: - Errors
+
+/// Errors raised while compiling a grammar.
+public enum GrammarError: Error, LocalizedError {
+    case invalidPattern(String)
+    case invalidSchema(String)
+    case tooComplex
+
+    public var errorDescription: String? {
+        switch self {
+        case let .invalidPattern(msg):
+            "Invalid pattern: \(msg)"
+        case let .invalidSchema(msg):
+            "Invalid JSON schema: \(msg)"
+        case .tooComplex:
+            "Grammar is too complex"
+        }
+    }
+}
+
+// MARK: - Byte Sets
+
+/// A set of byte values.
+struct ByteSet: Hashable {
+    private var words: [UInt64] = [0, 0, 0, 0]
+
+    static let ascii = ByteSet(0 ... 0x7F)
+
+    init() {}
+
+    init(_ range: ClosedRange<UInt8>) {
+        insert(range)
+    }
+
+    var isEmpty: Bool { words.allSatisfy { $0 == 0 } }
+
+    func contains(_ byte: UInt8) -> Bool {
+        words[Int(byte >> 6)] & (1 << UInt64(byte & 63)) != 0
+    }
+
+    mutating func insert(_ byte: UInt8) {
+        words[Int(byte >> 6)] |= 1 << UInt64(byte & 63)
+    }
+
+    mutating func insert(_ range: ClosedRange<UInt8>) {
+        for byte in range {
+            insert(byte)
+        }
+    }
+
+    mutating func formUnion(_ other: ByteSet) {
+        for i in 0 ..< 4 {
+            words[i] |= other.words[i]
+        }
+    }
+
+    func subtracting(_ other: ByteSet) -> ByteSet {
+        var result = self
+        for i in 0 ..< 4 {
+            result.words[i] &= ~other.words[i]
+        }
+        return result
+    }
+}
+
+// MARK: - Regular Expressions
+
+/// Syntax tree of a regular expression over bytes.
+indirect enum RegexNode {
+    /// One byte from the set.
+    case bytes(ByteSet)
+    /// The nodes one after another (empty: the empty string).
+    case sequence([RegexNode])
+    /// Any one of the nodes.
+    case choice([RegexNode])
+    /// The node repeated `min` to `max` times (nil: unbounded).
+    case repetition(RegexNode, min: Int, max: Int?)
+
+    /// The UTF-8 bytes of a character.
+    static func literal(_ scalar: Unicode.Scalar) -> RegexNode {
+        let nodes = String(scalar).utf8.map { RegexNode.bytes(ByteSet($0 ... $0)) }
+        return nodes.count == 1 ? nodes[0] : .sequence(nodes)
+    }
+
+    /// Any non-ASCII character: a well-formed multi-byte UTF-8 sequence.
+    static let nonASCII: RegexNode = {
+        let continuation = RegexNode.bytes(ByteSet(0x80 ... 0xBF))
+        return .choice([
+            .sequence([.bytes(ByteSet(0xC2 ... 0xDF)), continuation]),
+            .sequence([.bytes(ByteSet(0xE0 ... 0xEF)), continuation, continuation]),
+            .sequence([.bytes(ByteSet(0xF0 ... 0xF4)), continuation, continuation, continuation]),
+        ])
+    }()
+
+    /// Any character whose ASCII form is not in `excluded`.
+    static func anyCharacter(except excluded: ByteSet) -> RegexNode {
+        .choice([.bytes(ByteSet.ascii.subtracting(excluded)), nonASCII])
+    }
+}
+
+/// Recursive-descent parser for the supported regular expression syntax.
+struct RegexParser {
+    private let scalars: [Unicode.Scalar]
+    private var position = 0
+
+    init(_ pattern: String) {
+        scalars = Array(pattern.unicodeScalars)
+    }
+
+    /// Parses the whole pattern; leading `^` and trailing `$` are accepted and ignored.
+    mutating func parse() throws -> RegexNode {
+        if peek == "^" {
+            position += 1
+        }
+        let node = try parseAlternation()
+        if peek == "$", position == scalars.count - 1 {
+            position += 1
+        }
+        guard position == scalars.count else {
+            throw GrammarError.invalidPattern("unexpected '\(scalars[position])' at offset \(position)")
+        }
+        return node
+    }
+
+    private var peek: Unicode.Scalar? {
+        position < scalars.count ? scalars[position] : nil
+    }
+
+    private mutating func next() throws -> Unicode.Scalar {
+        guard let scalar = peek else {
+            throw GrammarError.invalidPattern("unexpected end of pattern")
+        }
+        position += 1
+        return scalar
+    }
+
+    private mutating func parseAlternation() throws -> RegexNode {
+        var branches = [try parseSequence()]
+        while peek == "|" {
+            position += 1
+            branches.append(try parseSequence())
+        }
+        return branches.count == 1 ? branches[0] : .choice(branches)
+    }
+
+    private mutating func parseSequence() throws -> RegexNode {
+        var items: [RegexNode] = []
+        while let scalar = peek, scalar != "|", scalar != ")" {
+            if scalar == "$", position == scalars.count - 1 {
+                break
+            }
+            items.append(try parseQuantifiers(of: parseAtom()))
+        }
+        return items.count == 1 ? items[0] : .sequence(items)
+    }
+
+    private mutating func parseAtom() throws -> RegexNode {
+        let scalar = try next()
+        switch scalar {
+        case "(":
+            if peek == "?" {
+                position += 1
+                guard try next() == ":" else {
+                    throw GrammarError.invalidPattern("only non-capturing groups (?:...) are supported")
+                }
+            }
+            let node = try parseAlternation()
+            guard try next() == ")" else {
+                throw GrammarError.invalidPattern("missing ')'")
+            }
+            return node
+        case "[":
+            return try parseClass()
+        case ".":
+            return .anyCharacter(except: ByteSet(0x0A ... 0x0A))
+        case "\\":
+            switch try parseEscape() {
+            case let .scalar(scalar):
+                return .literal(scalar)
+            case let .set(set, negated):
+                return negated ? .anyCharacter(except: set) : .bytes(set)
+            }
+        case "*", "+", "?", "{":
+            throw GrammarError.invalidPattern("nothing to repeat at offset \(position - 1)")
+        default:
+            return .literal(scalar)
+        }
+    }
+
+    /// A character or a shorthand class such as `\d`.
+    private enum ClassItem {
+        case scalar(Unicode.Scalar)
+        case set(ByteSet, negated: Bool)
+    }
+
+    private mutating func parseEscape() throws -> ClassItem {
+        let scalar = try next()
+        switch scalar {
+        case "d", "D":
+            return .set(ByteSet(0x30 ... 0x39), negated: scalar == "D")
+        case "w", "W":
+            var set = ByteSet(0x30 ... 0x39)
+            set.insert(0x41 ... 0x5A)
+            set.insert(0x61 ... 0x7A)
+            set.insert(0x5F)
+            return .set(set, negated: scalar == "W")
+        case "s", "S":
+            var set = ByteSet(0x09 ... 0x0D)
+            set.insert(0x20)
+            return .set(set, negated: scalar == "S")
+        case "n": return .scalar("\n")
+        case "t": return .scalar("\t")
+        case "r": return .scalar("\r")
+        case "f": return .scalar("\u{0C}")
+        case "v": return .scalar("\u{0B}")
+        case "0": return .scalar("\0")
+        case "x":
+            return try .scalar(parseHexScalar(digits: 2))
+        case "u":
+            return try .scalar(parseHexScalar(digits: 4))
+        default:
+            if scalar.properties.isAlphabetic || ("1" ... "9").contains(scalar) {
+                throw GrammarError.invalidPattern("unsupported escape '\\\(scalar)'")
+            }
+            return .scalar(scalar)
+        }
+    }
+
+    private mutating func parseHexScalar(digits: Int) throws -> Unicode.Scalar {
+        var value: UInt32 = 0
+        for _ in 0 ..< digits {
+            guard let digit = try hexValue(next()) else {
+                throw GrammarError.invalidPattern("invalid hex escape")
+            }
+            value = value * 16 + digit
+        }
+        guard let scalar = Unicode.Scalar(value) else {
+            throw GrammarError.invalidPattern("invalid code point \\u\(String(value, radix: 16))")
+        }
+        return scalar
+    }
+
+    private func hexValue(_ scalar: Unicode.Scalar) -> UInt32? {
+        switch scalar {
+        case "0" ... "9": scalar.value - 0x30
+        case "a" ... "f": scalar.value - 0x61 + 10
+        case "A" ... "F": scalar.value - 0x41 + 10
+        default: nil
+        }
+    }
+
+    private mutating func parseClass() throws -> RegexNode {
+        let negated = peek == "^"
+        if negated {
+            position += 1
+        }
+
+        var ascii = ByteSet()
+        var others: [Unicode.Scalar] = []
+        var allowsNonASCII = false
+        var isFirst = true
+
+        while true {
+            let scalar = try next()
+            if scalar == "]", !isFirst {
+                break
+            }
+            isFirst = false
+
+            let item: ClassItem = try scalar == "\\" ? parseEscape() : .scalar(scalar)
+
+            // Range, unless the '-' is the last member
+            if case let .scalar(low) = item, peek == "-", position + 1 < scalars.count, scalars[position + 1] != "]" {
+                position += 1
+                let bound = try next()
+                let boundItem: ClassItem = try bound == "\\" ? parseEscape() : .scalar(bound)
+                guard case let .scalar(high) = boundItem, low.value <= high.value else {
+                    throw GrammarError.invalidPattern("invalid class range")
+                }
+                guard high.isASCII else {
+                    throw GrammarError.invalidPattern("non-ASCII class ranges are not supported")
+                }
+                ascii.insert(UInt8(low.value) ... UInt8(high.value))
+                continue
+            }
+
+            switch item {
+            case let .scalar(member):
+                if member.isASCII {
+                    ascii.insert(UInt8(member.value))
+                } else {
+                    others.append(member)
+                }
+            case let .set(set, negated: true):
+                ascii.formUnion(ByteSet.ascii.subtracting(set))
+                allowsNonASCII = true
+            case let .set(set, negated: false):
+                ascii.formUnion(set)
+            }
+        }
+
+        // Non-ASCII members of a negated class are not excluded
+        if negated {
+            return .anyCharacter(except: ascii)
+        }
+
+        var branches: [RegexNode] = ascii.isEmpty ? [] : [.bytes(ascii)]
+        if allowsNonASCII {
+            branches.append(.nonASCII)
+        } else {
+            branches += others.map(RegexNode.literal)
+        }
+        return branches.count == 1 ? branches[0] : .choice(branches)
+    }
+
+    private mutating func parseQuantifiers(of atom: RegexNode) throws -> RegexNode {
+        var node = atom
+        while let scalar = peek {
+            let bounds: (min: Int, max: Int?)
+            switch scalar {
+            case "*": bounds = (0, nil)
+            case "+": bounds = (1, nil)
+            case "?": bounds = (0, 1)
+            case "{": bounds = try parseBounds()
+            default: return node
+            }
+            if scalar != "{" {
+                position += 1
+            }
+            // Lazy and possessive forms match the same language
+            if peek == "?" || peek == "+" {
+                position += 1
+            }
+            node = .repetition(node, min: bounds.min, max: bounds.max)
+        }
+        return node
+    }
+
+    /// Parses `{n}`, `{n,}` or `{n,m}`.
+    private mutating func parseBounds() throws -> (min: Int, max: Int?) {
+        position += 1
+        let lower = parseNumber()
+        var upper = lower
+        if peek == "," {
+            position += 1
+            upper = parseNumber()
+        } else if lower == nil {
+            throw GrammarError.invalidPattern("invalid repetition bounds")
+        }
+        guard try next() == "}", let lower, upper.map({ $0 >= lower }) ?? true else {
+            throw GrammarError.invalidPattern("invalid repetition bounds")
+        }
+        return (lower, upper)
+    }
+
+    private mutating func parseNumber() -> Int? {
+        var value: Int?
+        while let scalar = peek, ("0" ... "9").contains(scalar) {
+            value = (value ?? 0) * 10 + Int(scalar.value - 0x30)
+            position += 1
+        }
+        return value
+    }
+}
+
+// MARK: - Automaton
+
+/// Deterministic automaton over bytes, built from a regular expression.
+///
+/// Bytes that no pattern element tells apart share a class, so transitions
+/// are stored per class. Transitions into states from which no accepting
+/// state can be reached are removed: every byte the automaton accepts keeps
+/// a match possible.
+struct ByteAutomaton {
+    /// Upper bound on the number of states of the intermediate NFA and of the automaton.
+    static let maxStates = 50000
+
+    let start = 0
+
+    /// Class of each byte value.
+    let byteClasses: [Int]
+
+    /// Byte values of each class.
+    let classBytes: [[UInt8]]
+
+    /// Target of each state and class (`state * classCount + class`), -1 if none.
+    let transitions: [Int32]
+
+    /// Whether each state accepts.
+    let accepting: [Bool]
+
+    var classCount: Int { classBytes.count }
+    var stateCount: Int { accepting.count }
+
+    init(_ node: RegexNode) throws {
+        var nfa = NFA()
+        let (nfaStart, nfaEnd) = try nfa.build(node)
+
+        // Partition the bytes by the sets they belong to
+        let sets = Array(Set(nfa.edges.joined().map { $0.set }))
+        var classOfSignature: [[Bool]: Int] = [:]
+        var byteClasses = [Int](repeating: 0, count: 256)
+        var classBytes: [[UInt8]] = []
+        for byte in 0 ... 255 {
+            let signature = sets.map { $0.contains(UInt8(byte)) }
+            let byteClass = classOfSignature[signature] ?? classBytes.count
+            if byteClass == classBytes.count {
+                classOfSignature[signature] = byteClass
+                classBytes.append([])
+            }
+            classBytes[byteClass].append(UInt8(byte))
+            byteClasses[byte] = byteClass
+        }
+        let classCount = classBytes.count
+
+        // Subset construction
+        var stateSets = [nfa.closure([nfaStart])]
+        var stateIds = [stateSets[0]: 0]
+        var transitions: [Int32] = []
+        var accepting: [Bool] = []
+
+        var index = 0
+        while index < stateSets.count {
+            let current = stateSets[index]
+            accepting.append(current.contains(nfaEnd))
+
+            for byteClass in 0 ..< classCount {
+                let byte = classBytes[byteClass][0]
+                let targets = current.flatMap { state in
+                    nfa.edges[state].filter { $0.set.contains(byte) }.map { $0.target }
+                }
+                guard !targets.isEmpty else {
+                    transitions.append(-1)
+                    continue
+                }
+
+                let target = nfa.closure(targets)
+                if let id = stateIds[target] {
+                    transitions.append(Int32(id))
+                } else {
+                    guard stateSets.count < Self.maxStates else {
+                        throw GrammarError.tooComplex
+                    }
+                    stateIds[target] = stateSets.count
+                    transitions.append(Int32(stateSets.count))
+                    stateSets.append(target)
+                }
+            }
+            index += 1
+        }
+
+        // Keep only states that can still reach an accepting state
+        var predecessors = [[Int]](repeating: [], count: accepting.count)
+        for (offset, target) in transitions.enumerated() where target >= 0 {
+            predecessors[Int(target)].append(offset / classCount)
+        }
+        var live = accepting
+        var pending = accepting.indices.filter { accepting[$0] }
+        while let state = pending.popLast() {
+            for predecessor in predecessors[state] where !live[predecessor] {
+                live[predecessor] = true
+                pending.append(predecessor)
+            }
+        }
+        guard live[0] else {
+            throw GrammarError.invalidPattern("pattern matches nothing")
+        }
+        for offset in transitions.indices where transitions[offset] >= 0 && !live[Int(transitions[offset])] {
+            transitions[offset] = -1
+        }
+
+        self.byteClasses = byteClasses
+        self.classBytes = classBytes
+        self.transitions = transitions
+        self.accepting = accepting
+    }
+
+    /// The state after `byte`, or nil if the byte is not allowed.
+    func next(_ state: Int, _ byte: UInt8) -> Int? {
+        let target = transitions[state * classCount + byteClasses[Int(byte)]]
+        return target < 0 ? nil : Int(target)
+    }
+
+    /// The state after `bytes`, or nil if they leave the language.
+    func walk(from state: Int, _ bytes: some Sequence<UInt8>) -> Int? {
+        var state = state
+        for byte in bytes {
+            guard let target = next(state, byte) else { return nil }
+            state = target
+        }
+        return state
+    }
+
+    /// The only byte allowed in a non-accepting state, if there is exactly one.
+    func forcedByte(_ state: Int) -> UInt8? {
+        guard !accepting[state] else { return nil }
+
+        var forced: UInt8?
+        for byteClass in 0 ..< classCount where transitions[state * classCount + byteClass] >= 0 {
+            guard forced == nil, classBytes[byteClass].count == 1 else { return nil }
+            forced = classBytes[byteClass][0]
+        }
+        return forced
+    }
+}
+
+/// Thompson NFA with byte-set and epsilon edges.
+private struct NFA {
+    var edges: [[(set: ByteSet, target: Int)]] = []
+    var epsilons: [[Int]] = []
+
+    // Reused by `closure` to avoid allocating per call
+    private var visited: [Int] = []
+    private var generation = 0
+
+    mutating func addState() throws -> Int {
+        guard edges.count < ByteAutomaton.maxStates else {
+            throw GrammarError.tooComplex
+        }
+        edges.append([])
+        epsilons.append([])
+        return edges.count - 1
+    }
+
+    /// Adds states for `node`; returns its start and end state.
+    mutating func build(_ node: RegexNode) throws -> (start: Int, end: Int) {
+        switch node {
+        case let .bytes(set):
+            let start = try addState()
+            let end = try addState()
+            edges[start].append((set, end))
+            return (start, end)
+
+        case let .sequence(items):
+            let start = try addState()
+            var end = start
+            for item in items {
+                let fragment = try build(item)
+                epsilons[end].append(fragment.start)
+                end = fragment.end
+            }
+            return (start, end)
+
+        case let .choice(branches):
+            let start = try addState()
+            let end = try addState()
+            for branch in branches {
+                let fragment = try build(branch)
+                epsilons[start].append(fragment.start)
+                epsilons[fragment.end].append(end)
+            }
+            return (start, end)
+
+        case let .repetition(item, min, max):
+            let start = try addState()
+            var end = start
+            for _ in 0 ..< min {
+                let fragment = try build(item)
+                epsilons[end].append(fragment.start)
+                end = fragment.end
+            }
+            if let max {
+                // Each optional copy may be skipped to the end
+                var skips: [Int] = []
+                for _ in min ..< max {
+                    let fragment = try build(item)
+                    epsilons[end].append(fragment.start)
+                    skips.append(end)
+                    end = fragment.end
+                }
+                for skip in skips {
+                    epsilons[skip].append(end)
+                }
+            } else {
+                let loop = try addState()
+                let fragment = try build(item)
+                epsilons[end].append(loop)
+                epsilons[loop].append(fragment.start)
+                epsilons[fragment.end].append(loop)
+                end = loop
+            }
+            return (start, end)
+        }
+    }
+
+    /// States reachable from `states` through epsilon edges, sorted.
+    mutating func closure(_ states: [Int]) -> [Int] {
+        if visited.count < edges.count {
+            visited = [Int](repeating: 0, count: edges.count)
+        }
+        generation += 1
+
+        var result: [Int] = []
+        var pending = states
+        while let state = pending.popLast() {
+            guard visited[state] != generation else { continue }
+            visited[state] = generation
+            result.append(state)
+            pending += epsilons[state]
+        }
+        return result.sorted()
+    }
+}
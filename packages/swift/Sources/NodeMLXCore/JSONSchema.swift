@@ -0,0 +1,432 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Conversion of JSON schemas to regular expressions for constrained decoding.
+
+import Foundation
+
+// MARK: - JSON Schema
+
+/// Converts a JSON schema to a regular expression matching the JSON
+/// documents it describes.
+///
+/// Supported keywords: `type` (a name or a list of names), `properties` and
+/// `required`, `items`, `minItems` and `maxItems`, `minLength`, `maxLength`,
+/// `pattern`, `format` (`date`, `time`, `date-time` and `uuid`), `enum`,
+/// `const`, `anyOf`, `oneOf`, a single-element `allOf` and local `$ref`s.
+/// Documents use the separators `, ` and `: ` and no other whitespace, and
+/// list object properties in schema order without additional properties,
+/// so every fixed part of the output is known in advance. Recursive schemas
+/// are not regular and are rejected.
+///
+/// - Parameter schema: The schema as JSON text
+/// - Returns: A pattern for `Grammar(regex:)`
+/// - Throws: `GrammarError.invalidSchema` if the schema is invalid or unsupported
+public func jsonSchemaRegex(_ schema: String) throws -> String {
+    var parser = JSONParser(schema)
+    let root = try parser.parse()
+    return try JSONSchemaConverter(root: root).regex(for: root, depth: 0)
+}
+
+/// Builds regular expressions for (sub)schemas, resolving references against the root.
+private struct JSONSchemaConverter {
+    /// Maximum nesting of referenced schemas; deeper nesting is treated as recursion.
+    static let maxDepth = 32
+
+    static let stringCharacter = #"(?:[^"\\\x00-\x1F]|\\["\\/bfnrt]|\\u[0-9a-fA-F]{4})"#
+    static let integer = #"-?(?:0|[1-9][0-9]*)"#
+    static let number = #"-?(?:0|[1-9][0-9]*)(?:\.[0-9]+)?(?:[eE][+-]?[0-9]+)?"#
+    static let formats = [
+        "date": #"[0-9]{4}-[0-9]{2}-[0-9]{2}"#,
+        "time": #"[0-9]{2}:[0-9]{2}:[0-9]{2}(?:\.[0-9]+)?(?:Z|[+-][0-9]{2}:[0-9]{2})?"#,
+        "date-time": #"[0-9]{4}-[0-9]{2}-[0-9]{2}T[0-9]{2}:[0-9]{2}:[0-9]{2}(?:\.[0-9]+)?(?:Z|[+-][0-9]{2}:[0-9]{2})?"#,
+        "uuid": #"[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}"#,
+    ]
+
+    let root: JSONValue
+
+    func regex(for schema: JSONValue, depth: Int) throws -> String {
+        guard depth < Self.maxDepth else {
+            throw GrammarError.invalidSchema("recursive or too deeply nested schema")
+        }
+        guard case let .object(members) = schema else {
+            throw GrammarError.invalidSchema("a schema must be an object")
+        }
+        let keywords = Dictionary(members, uniquingKeysWith: { _, last in last })
+
+        if case let .string(reference)? = keywords["$ref"] {
+            return try regex(for: resolve(reference), depth: depth + 1)
+        }
+        if let value = keywords["const"] {
+            return escapeRegex(value.serialized)
+        }
+        if case let .array(values)? = keywords["enum"] {
+            return alternation(values.map { escapeRegex($0.serialized) })
+        }
+        if case let .array(schemas)? = keywords["anyOf"] ?? keywords["oneOf"] {
+            return try alternation(schemas.map { try regex(for: $0, depth: depth + 1) })
+        }
+        if case let .array(schemas)? = keywords["allOf"] {
+            guard schemas.count == 1 else {
+                throw GrammarError.invalidSchema("allOf is only supported with a single schema")
+            }
+            return try regex(for: schemas[0], depth: depth + 1)
+        }
+
+        switch keywords["type"] {
+        case let .string(type)?:
+            return try regex(forType: type, keywords: keywords, depth: depth)
+        case let .array(types)?:
+            return try alternation(types.map { type in
+                guard case let .string(name) = type else {
+                    throw GrammarError.invalidSchema("type names must be strings")
+                }
+                return try regex(forType: name, keywords: keywords, depth: depth)
+            })
+        default:
+            if keywords["properties"] != nil {
+                return try regex(forType: "object", keywords: keywords, depth: depth)
+            }
+            if keywords["items"] != nil {
+                return try regex(forType: "array", keywords: keywords, depth: depth)
+            }
+            throw GrammarError.invalidSchema("schema without a type")
+        }
+    }
+
+    private func regex(forType type: String, keywords: [String: JSONValue], depth: Int) throws -> String {
+        switch type {
+        case "string":
+            if case let .string(format)? = keywords["format"], let pattern = Self.formats[format] {
+                return "\"\(pattern)\""
+            }
+            if case let .string(pattern)? = keywords["pattern"] {
+                var body = Substring(pattern)
+                if body.hasPrefix("^") { body = body.dropFirst() }
+                if body.hasSuffix("$") { body = body.dropLast() }
+                return "\"(?:\(body))\""
+            }
+            let minLength = keywords["minLength"]?.integer ?? 0
+            let maxLength = keywords["maxLength"]?.integer
+            return "\"\(Self.stringCharacter)\(quantifier(min: minLength, max: maxLength))\""
+
+        case "integer":
+            return Self.integer
+
+        case "number":
+            return Self.number
+
+        case "boolean":
+            return "(?:true|false)"
+
+        case "null":
+            return "null"
+
+        case "array":
+            guard let items = keywords["items"] else {
+                throw GrammarError.invalidSchema("arrays need an items schema")
+            }
+            let item = try regex(for: items, depth: depth + 1)
+            let minItems = keywords["minItems"]?.integer ?? 0
+            let maxItems = keywords["maxItems"]?.integer
+            if maxItems == 0 {
+                return #"\[\]"#
+            }
+            let elements = "\(item)(?:, \(item))\(quantifier(min: max(minItems - 1, 0), max: maxItems.map { $0 - 1 }))"
+            return #"\["# + (minItems > 0 ? elements : "(?:\(elements))?") + #"\]"#
+
+        case "object":
+            guard case let .object(properties)? = keywords["properties"], !properties.isEmpty else {
+                return #"\{\}"#
+            }
+            var required: Set<String> = []
+            if case let .array(names)? = keywords["required"] {
+                for case let .string(name) in names {
+                    required.insert(name)
+                }
+            }
+            let entries = try properties.map { name, schema in
+                let value = try regex(for: schema, depth: depth + 1)
+                return "\(escapeRegex(JSONValue.string(name).serialized)): \(value)"
+            }
+            return #"\{"# + objectBody(entries, required: properties.map { required.contains($0.0) }) + #"\}"#
+
+        default:
+            throw GrammarError.invalidSchema("unsupported type '\(type)'")
+        }
+    }
+
+    /// Properties in order, separated by commas, where optional ones may be left out.
+    private func objectBody(_ entries: [String], required: [Bool]) -> String {
+        guard let first = required.firstIndex(of: true) else {
+            // Everything is optional: pick the first property present
+            let alternatives = entries.indices.map { start in
+                entries[start] + entries[(start + 1)...].map { "(?:, \($0))?" }.joined()
+            }
+            return "(?:\(alternatives.joined(separator: "|")))?"
+        }
+
+        var body = entries[..<first].map { "(?:\($0), )?" }.joined() + entries[first]
+        for index in (first + 1) ..< entries.count {
+            body += required[index] ? ", \(entries[index])" : "(?:, \(entries[index]))?"
+        }
+        return body
+    }
+
+    /// Resolves a local reference such as `#/$defs/Name`.
+    private func resolve(_ reference: String) throws -> JSONValue {
+        guard reference.hasPrefix("#") else {
+            throw GrammarError.invalidSchema("only local references are supported: \(reference)")
+        }
+        var value = root
+        for component in reference.dropFirst().split(separator: "/") {
+            let key = component.replacingOccurrences(of: "~1", with: "/").replacingOccurrences(of: "~0", with: "~")
+            guard case let .object(members) = value, let member = members.last(where: { $0.0 == key }) else {
+                throw GrammarError.invalidSchema("unresolved reference \(reference)")
+            }
+            value = member.1
+        }
+        return value
+    }
+
+    private func alternation(_ branches: [String]) -> String {
+        "(?:\(branches.joined(separator: "|")))"
+    }
+
+    private func quantifier(min: Int, max: Int?) -> String {
+        switch (min, max) {
+        case (0, nil): "*"
+        case (1, nil): "+"
+        case let (min, nil): "{\(min),}"
+        case let (min, max?) where min == max: "{\(min)}"
+        case let (min, max?): "{\(min),\(max)}"
+        }
+    }
+}
+
+/// Escapes the characters that have a meaning in a regular expression.
+func escapeRegex(_ text: String) -> String {
+    var result = ""
+    for character in text {
+        if "\\^$.|?*+()[]{}".contains(character) {
+            result.append("\\")
+        }
+        result.append(character)
+    }
+    return result
+}
+
+// MARK: - JSON Values
+
+/// A parsed JSON value that keeps the order of object members.
+enum JSONValue {
+    case null
+    case bool(Bool)
+    /// A number in its original notation.
+    case number(String)
+    case string(String)
+    case array([JSONValue])
+    case object([(String, JSONValue)])
+
+    /// The value of an integral number.
+    var integer: Int? {
+        if case let .number(text) = self {
+            return Int(text) ?? Double(text).flatMap { $0.rounded() == $0 ? Int(exactly: $0) : nil }
+        }
+        return nil
+    }
+
+    /// Compact JSON text with `, ` and `: ` separators.
+    var serialized: String {
+        switch self {
+        case .null:
+            return "null"
+        case let .bool(value):
+            return value ? "true" : "false"
+        case let .number(text):
+            return text
+        case let .string(text):
+            var result = "\""
+            for scalar in text.unicodeScalars {
+                switch scalar {
+                case "\"": result += "\\\""
+                case "\\": result += "\\\\"
+                case "\n": result += "\\n"
+                case "\r": result += "\\r"
+                case "\t": result += "\\t"
+                case "\u{08}": result += "\\b"
+                case "\u{0C}": result += "\\f"
+                case _ where scalar.value < 0x20:
+                    result += String(format: "\\u%04x", scalar.value)
+                default:
+                    result.unicodeScalars.append(scalar)
+                }
+            }
+            return result + "\""
+        case let .array(values):
+            return "[" + values.map(\.serialized).joined(separator: ", ") + "]"
+        case let .object(members):
+            return "{" + members.map { "\(JSONValue.string($0.0).serialized): \($0.1.serialized)" }
+                .joined(separator: ", ") + "}"
+        }
+    }
+}
+
+/// Minimal JSON parser; unlike `JSONSerialization` it keeps member order,
+/// which decides the property order of generated objects.
+struct JSONParser {
+    private let bytes: [UInt8]
+    private var position = 0
+
+    init(_ text: String) {
+        bytes = Array(text.utf8)
+    }
+
+    mutating func parse() throws -> JSONValue {
+        let value = try parseValue()
+        skipWhitespace()
+        guard position == bytes.count else {
+            throw GrammarError.invalidSchema("unexpected data at offset \(position)")
+        }
+        return value
+    }
+
+    private mutating func skipWhitespace() {
+        while position < bytes.count, [0x20, 0x09, 0x0A, 0x0D].contains(bytes[position]) {
+            position += 1
+        }
+    }
+
+    private mutating func expect(_ byte: UInt8) throws {
+        skipWhitespace()
+        guard position < bytes.count, bytes[position] == byte else {
+            throw GrammarError.invalidSchema("expected '\(Character(Unicode.Scalar(byte)))' at offset \(position)")
+        }
+        position += 1
+    }
+
+    private mutating func consume(_ literal: String) -> Bool {
+        let literalBytes = Array(literal.utf8)
+        guard bytes[position...].starts(with: literalBytes) else { return false }
+        position += literalBytes.count
+        return true
+    }
+
+    private mutating func parseValue() throws -> JSONValue {
+        skipWhitespace()
+        guard position < bytes.count else {
+            throw GrammarError.invalidSchema("unexpected end of input")
+        }
+
+        switch bytes[position] {
+        case UInt8(ascii: "{"):
+            position += 1
+            var members: [(String, JSONValue)] = []
+            skipWhitespace()
+            if position < bytes.count, bytes[position] == UInt8(ascii: "}") {
+                position += 1
+                return .object(members)
+            }
+            repeat {
+                skipWhitespace()
+                guard case let .string(key) = try parseValue() else {
+                    throw GrammarError.invalidSchema("object keys must be strings")
+                }
+                try expect(UInt8(ascii: ":"))
+                members.append((key, try parseValue()))
+                skipWhitespace()
+            } while consume(",")
+            try expect(UInt8(ascii: "}"))
+            return .object(members)
+
+        case UInt8(ascii: "["):
+            position += 1
+            var values: [JSONValue] = []
+            skipWhitespace()
+            if position < bytes.count, bytes[position] == UInt8(ascii: "]") {
+                position += 1
+                return .array(values)
+            }
+            repeat {
+                values.append(try parseValue())
+                skipWhitespace()
+            } while consume(",")
+            try expect(UInt8(ascii: "]"))
+            return .array(values)
+
+        case UInt8(ascii: "\""):
+            position += 1
+            return try .string(parseString())
+
+        default:
+            if consume("true") { return .bool(true) }
+            if consume("false") { return .bool(false) }
+            if consume("null") { return .null }
+
+            let start = position
+            while position < bytes.count, "+-.eE0123456789".utf8.contains(bytes[position]) {
+                position += 1
+            }
+            let text = String(decoding: bytes[start ..< position], as: UTF8.self)
+            guard !text.isEmpty, Double(text) != nil else {
+                throw GrammarError.invalidSchema("invalid value at offset \(start)")
+            }
+            return .number(text)
+        }
+    }
+
+    /// Parses the rest of a string after its opening quote.
+    private mutating func parseString() throws -> String {
+        var result: [UInt8] = []
+        while position < bytes.count {
+            let byte = bytes[position]
+            position += 1
+
+            if byte == UInt8(ascii: "\"") {
+                return String(decoding: result, as: UTF8.self)
+            }
+            guard byte == UInt8(ascii: "\\") else {
+                result.append(byte)
+                continue
+            }
+
+            guard position < bytes.count else { break }
+            let escape = bytes[position]
+            position += 1
+            switch escape {
+            case UInt8(ascii: "b"): result.append(0x08)
+            case UInt8(ascii: "f"): result.append(0x0C)
+            case UInt8(ascii: "n"): result.append(0x0A)
+            case UInt8(ascii: "r"): result.append(0x0D)
+            case UInt8(ascii: "t"): result.append(0x09)
+            case UInt8(ascii: "u"):
+                var value = try parseHex()
+                // Surrogate pair
+                if (0xD800 ..< 0xDC00).contains(value), consume("\\u") {
+                    let low = try parseHex()
+                    guard (0xDC00 ..< 0xE000).contains(low) else {
+                        throw GrammarError.invalidSchema("invalid surrogate pair")
+                    }
+                    value = 0x10000 + ((value - 0xD800) << 10) + (low - 0xDC00)
+                }
+                guard let scalar = Unicode.Scalar(value) else {
+                    throw GrammarError.invalidSchema("invalid \\u escape")
+                }
+                result += Array(String(scalar).utf8)
+            default:
+                result.append(escape)
+            }
+        }
+        throw GrammarError.invalidSchema("unterminated string")
+    }
+
+    private mutating func parseHex() throws -> UInt32 {
+        guard position + 4 <= bytes.count,
+              let value = UInt32(String(decoding: bytes[position ..< position + 4], as: UTF8.self), radix: 16)
+        else {
+            throw GrammarError.invalidSchema("invalid \\u escape")
+        }
+        position += 4
+        return value
+    }
+}
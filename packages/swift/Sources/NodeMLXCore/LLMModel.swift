@@ -38,6 +38,14 @@ public protocol LLMModel: Module {
     /// Forward pass with optional cache
     func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCacheProtocol]?) -> MLXArray
 
+    /// Hidden states without the LM head, shape [batch, seq, hidden_size]
+    ///
+    /// - Parameters:
+    ///   - inputIds: Token IDs, shape [batch, seq]
+    ///   - depth: Number of decoder layers to run (0: token embeddings);
+    ///     nil runs all of them and the final norm
+    func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray
+
     /// Creates a new cache for generation
     func newCache() -> [any KVCacheProtocol]
 
@@ -45,6 +53,49 @@ public protocol LLMModel: Module {
     func sanitize(weights: [String: MLXArray]) -> [String: MLXArray]
 }
 
+// MARK: - Model Fingerprint
+
+/// Identifies a model's architecture and weights, e.g. to reject KV caches
+/// saved with a different model.
+///
+/// Combines the type and cache geometry with a checksum over the names,
+/// shapes and first elements of all parameters. Reading only a few elements
+/// per parameter keeps it cheap for large models while still telling
+/// fine-tunes of the same architecture apart.
+public func modelFingerprint(_ model: any LLMModel) -> String {
+    let parameters = model.parameters().flattened().sorted { $0.0 < $1.0 }
+    let samples = parameters.map { _, value in
+        value.reshaped([-1])[..<min(value.size, 64)].asType(.float32).sum()
+    }
+    let sums = samples.isEmpty ? [] : stacked(samples).asArray(Float.self)
+
+    var hasher = StableHasher()
+    for ((name, value), sum) in zip(parameters, sums) {
+        hasher.combine("\(name)\(value.shape)\(value.dtype)".utf8)
+        withUnsafeBytes(of: sum.bitPattern) { hasher.combine($0) }
+    }
+
+    return [
+        String(describing: type(of: model)),
+        "\(model.numLayers)x\(model.numKVHeads)x\(model.headDim)",
+        String(model.vocabularySize),
+        hasher.hexDigest,
+    ].joined(separator: "-")
+}
+
+/// FNV-1a hash that, unlike `Hasher`, is stable across processes.
+struct StableHasher {
+    private(set) var value: UInt64 = 0xCBF2_9CE4_8422_2325
+
+    mutating func combine(_ bytes: some Sequence<UInt8>) {
+        for byte in bytes {
+            value = (value ^ UInt64(byte)) &* 0x100_0000_01B3
+        }
+    }
+
+    var hexDigest: String { String(value, radix: 16) }
+}
+
 // MARK: - Model Architecture Registry
 
 /// Supported model architectures
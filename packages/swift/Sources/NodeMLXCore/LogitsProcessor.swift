@@ -0,0 +1,73 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Pluggable logits processors applied before sampling.
+
+import Foundation
+import MLX
+
+// MARK: - Logits Processor
+
+/// Adjusts the logits of one request before each token is sampled.
+///
+/// A processor belongs to a single generation: it is created when the
+/// generation starts (see `GenerationConfig.logitsProcessors`) and told about
+/// every token that is added to the output.
+public protocol LogitsProcessor: AnyObject {
+    /// Adjusts the logits of the next position, shape [1, vocab_size].
+    func process(_ logits: MLXArray) -> MLXArray
+
+    /// Records tokens added to the output, shape [n].
+    ///
+    /// The tokens may not be evaluated yet; reading them waits for the device.
+    func didSample(_ tokens: MLXArray)
+
+    /// Tokens that must come next, if the processor allows only one continuation.
+    ///
+    /// Asked before sampling. The generation loop may add these tokens
+    /// without sampling and feed them to the model in a single forward pass;
+    /// they are then passed to `didSample`. Loops that sample every token
+    /// (batches, streaming) do not ask, so `process` must still enforce them.
+    func forcedTokens() -> [Int]
+}
+
+public extension LogitsProcessor {
+    func forcedTokens() -> [Int] {
+        []
+    }
+}
+
+/// Creates the processor of one generation from its prompt.
+public typealias LogitsProcessorFactory = (_ prompt: [Int]) -> any LogitsProcessor
+
+/// Creates the processors of one generation: penalties first (if `config`
+/// sets any), then `config.logitsProcessors` in order.
+func makeLogitsProcessors(config: GenerationConfig, prompt: [Int]) -> [any LogitsProcessor] {
+    let penalties: [any LogitsProcessor] = PenaltyProcessor(config: config, context: prompt).map { [$0] } ?? []
+    return penalties + config.logitsProcessors.map { $0(prompt) }
+}
+
+extension [any LogitsProcessor] {
+    /// Runs the logits through every processor in order.
+    func process(_ logits: MLXArray) -> MLXArray {
+        reduce(logits) { $1.process($0) }
+    }
+
+    /// Records tokens with every processor.
+    func didSample(_ tokens: MLXArray) {
+        for processor in self {
+            processor.didSample(tokens)
+        }
+    }
+
+    /// The first processor's forced tokens, if any.
+    func forcedTokens() -> [Int] {
+        for processor in self {
+            let tokens = processor.forcedTokens()
+            if !tokens.isEmpty {
+                return tokens
+            }
+        }
+        return []
+    }
+}
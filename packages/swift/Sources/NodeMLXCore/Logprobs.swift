@@ -0,0 +1,89 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Log-probabilities of generated tokens and their most likely alternatives.
+
+import MLX
+
+// MARK: - Generation Logprobs
+
+/// Log-probabilities of generated tokens, in generation order.
+///
+/// Values come from the model's logits before penalties, logits processors
+/// and sampling parameters, so they describe the model's own confidence.
+/// Tokens forced by a grammar are not sampled and report log-probability 0
+/// with themselves as the only alternative.
+public struct GenerationLogprobs: Sendable, Equatable {
+    /// Alternatives reported per token.
+    public let topCount: Int
+
+    /// Log-probability of each generated token.
+    public private(set) var tokens: [Float] = []
+
+    /// IDs of the `topCount` most likely tokens at each position, most likely
+    /// first, row-major [tokens.count, topCount]. Unused slots hold -1.
+    public private(set) var topTokens: [Int32] = []
+
+    /// Log-probabilities of `topTokens` (-infinity for unused slots).
+    public private(set) var topLogprobs: [Float] = []
+
+    /// Creates an empty record.
+    ///
+    /// - Parameter topCount: Alternatives reported per token
+    public init(topCount: Int) {
+        self.topCount = topCount
+    }
+
+    /// Number of recorded tokens.
+    public var count: Int { tokens.count }
+
+    /// Appends a row computed by `logprobRows(logits:tokens:topCount:)`.
+    mutating func append(row: ArraySlice<Float>) {
+        tokens.append(row[row.startIndex])
+        let top = row.dropFirst()
+        topTokens += top.prefix(topCount).map { Int32($0) }
+        topLogprobs += top.dropFirst(topCount)
+    }
+
+    /// Appends a token that was forced instead of sampled.
+    mutating func appendForced(_ token: Int) {
+        tokens.append(0)
+        for rank in 0 ..< topCount {
+            topTokens.append(rank == 0 ? Int32(token) : -1)
+            topLogprobs.append(rank == 0 ? 0 : -.infinity)
+        }
+    }
+}
+
+// MARK: - Device Computation
+
+/// Computes, on the device, one row per sampled token: its log-probability,
+/// then the IDs and log-probabilities of the `topCount` most likely tokens,
+/// most likely first.
+///
+/// Everything is packed into a single float32 array so that reading it costs
+/// one small transfer per step. IDs are stored as floats, which is exact for
+/// vocabularies below 2^24 tokens.
+///
+/// - Parameters:
+///   - logits: Logits, shape [rows, vocab_size]
+///   - tokens: Sampled token IDs, shape [rows]
+///   - topCount: Alternatives per row (at most vocab_size)
+/// - Returns: Rows of shape [rows, 1 + 2 * topCount]
+func logprobRows(logits: MLXArray, tokens: MLXArray, topCount: Int) -> MLXArray {
+    let logits = logits.asType(.float32)
+    let logprobs = logits - logSumExp(logits, axis: -1, keepDims: true)
+    let chosen = takeAlong(logprobs, tokens.reshaped([-1, 1]).asType(.int32), axis: -1)
+    guard topCount > 0 else { return chosen }
+
+    // Partition instead of a full sort, then order the few candidates
+    let candidates = argPartition(-logprobs, kth: topCount - 1, axis: -1)[0..., ..<topCount]
+    let candidateLogprobs = takeAlong(logprobs, candidates, axis: -1)
+    let order = argSort(-candidateLogprobs, axis: -1)
+
+    return concatenated([
+        chosen,
+        takeAlong(candidates, order, axis: -1).asType(.float32),
+        takeAlong(candidateLogprobs, order, axis: -1),
+    ], axis: -1)
+}
@@ -27,6 +27,15 @@ public struct GenerationResult: Sendable {
 
     /// Total generation time in seconds.
     public let totalTime: Double
+
+    /// Why generation finished.
+    public let finishReason: FinishReason
+
+    /// Acceptance stats if speculative decoding was used.
+    public var speculative: SpeculativeStats?
+
+    /// Log-probabilities of the generated tokens if requested.
+    public var logprobs: GenerationLogprobs?
 }
 
 // MARK: - LLM Engine
@@ -36,9 +45,30 @@ public struct GenerationResult: Sendable {
 /// This class manages model loading, tokenization, and generation,
 /// providing a high-level API for the Node.js bindings.
 public class LLMEngine {
+    /// Default memory budget for reusing prompt prefixes (1 GiB).
+    public static let defaultPrefixCacheBytes = 1 << 30
+
+    /// Default memory budget for the KV state of batched requests (1 GiB).
+    public static let defaultBatchCacheBytes = 1 << 30
+
     private var model: (any LLMModel)?
+    private var draftModel: (any LLMModel)?
     private var tokenizer: HFTokenizer?
     private var modelPath: String?
+    private var batchGenerator: BatchGenerator?
+    private var prefixCache: PrefixCache?
+    private let prefixCacheBytes: Int
+    private let batchCacheBytes: Int
+    private let compiledCache: CompiledModelCache?
+    private var tokenGrammars: [String: TokenGrammar] = [:]
+    private let grammarLock = NSLock()
+
+    /// Followed by work scheduled since the last `cancelScheduledWork()`.
+    private var scheduledWork = CancellationToken()
+    private let scheduledWorkLock = NSLock()
+
+    /// Number of grammars whose token masks are kept for reuse.
+    static let maxCachedGrammars = 32
 
     /// Whether a model is currently loaded.
     public var isLoaded: Bool { model != nil }
@@ -46,25 +76,158 @@ public class LLMEngine {
     /// Whether this is a vision-language model (VLM).
     public var isVLM: Bool { false } // Not implemented yet
 
+    /// Whether a draft model is loaded for speculative decoding.
+    public var hasDraftModel: Bool { draftModel != nil }
+
+    /// Bytes held by the loaded model: weights of the model and draft model,
+    /// plus the budget of its KV block pool.
+    public var memoryFootprint: Int {
+        weightsFootprint + cacheFootprint
+    }
+
+    /// Bytes of the weights of the model and draft model.
+    ///
+    /// Engines sharing weights each report the full size.
+    public var weightsFootprint: Int {
+        [model, draftModel].compactMap { $0 }.reduce(0) { total, model in
+            model.parameters().flattened().reduce(total) { $0 + $1.1.nbytes }
+        }
+    }
+
+    /// Bytes reserved in this engine's KV block pool for the prefix cache and the batch.
+    ///
+    /// Sessions from `makeSession()` keep caches of their own, which their
+    /// owner has to account for (see `ChatSession.cacheBytes`). Requests that
+    /// run on their own (solo generation, embedding, scoring) use caches that
+    /// are released when the request ends and are not counted.
+    public var cacheFootprint: Int {
+        (prefixCache != nil ? prefixCacheBytes : 0) + (batchGenerator != nil ? batchCacheBytes : 0)
+    }
+
+    /// Estimates the bytes a model will take once loaded, from its weight files.
+    ///
+    /// - Parameters:
+    ///   - path: Local model directory
+    ///   - draftPath: Local directory of the draft model, if any
+    /// - Returns: Total size of the weight files plus the KV block pool budget
+    public func estimatedFootprint(ofModelAt path: String, draftModelAt draftPath: String? = nil) -> Int {
+        let fileManager = FileManager.default
+        let weights = [path, draftPath].compactMap { $0 }.reduce(0) { total, path in
+            let files = (try? fileManager.contentsOfDirectory(
+                at: URL(fileURLWithPath: path), includingPropertiesForKeys: nil
+            )) ?? []
+            return files
+                .filter { ["safetensors", "npz"].contains($0.pathExtension) }
+                .compactMap { try? fileManager.attributesOfItem(atPath: $0.resolvingSymlinksInPath().path)[.size] }
+                .reduce(total) { $0 + (($1 as? NSNumber)?.intValue ?? 0) }
+        }
+        return weights + prefixCacheBytes + batchCacheBytes
+    }
+
     /// Creates an empty engine.
-    public init() {}
+    ///
+    /// - Parameters:
+    ///   - prefixCacheBytes: Memory budget for the KV state of prompt
+    ///     prefixes kept for reuse across requests (0 disables prefix reuse)
+    ///   - batchCacheBytes: Memory budget for the KV state of requests that
+    ///     are decoded together; with the prefix budget it sizes the engine's
+    ///     `KVBlockPool` (0 runs every request on its own)
+    ///   - compiledCacheDir: Directory for compiled models. The first load of
+    ///     a model writes its final weights there; later loads apply them
+    ///     without sanitizing or quantizing (nil disables)
+    public init(
+        prefixCacheBytes: Int = LLMEngine.defaultPrefixCacheBytes,
+        batchCacheBytes: Int = LLMEngine.defaultBatchCacheBytes,
+        compiledCacheDir: URL? = nil
+    ) {
+        self.prefixCacheBytes = prefixCacheBytes
+        self.batchCacheBytes = batchCacheBytes
+        compiledCache = compiledCacheDir.map { CompiledModelCache(directory: $0) }
+    }
+
+    /// Creates an engine over the weights of a loaded engine.
+    ///
+    /// The model, draft model and tokenizer are shared, not copied; the new
+    /// engine gets its own prefix cache and batch. Both run on the compute
+    /// queue, so they never use the weights at the same time. The weights
+    /// are released once every engine sharing them is unloaded.
+    ///
+    /// - Parameters:
+    ///   - engine: Engine with a loaded model
+    ///   - prefixCacheBytes: Memory budget of the new engine's prefix cache
+    ///   - batchCacheBytes: Memory budget of the new engine's batch
+    public init(
+        sharingWeightsOf engine: LLMEngine,
+        prefixCacheBytes: Int = LLMEngine.defaultPrefixCacheBytes,
+        batchCacheBytes: Int = LLMEngine.defaultBatchCacheBytes
+    ) {
+        self.prefixCacheBytes = prefixCacheBytes
+        self.batchCacheBytes = batchCacheBytes
+        compiledCache = engine.compiledCache
+        model = engine.model
+        draftModel = engine.draftModel
+        tokenizer = engine.tokenizer
+        modelPath = engine.modelPath
+
+        if let model {
+            makeCaches(for: model)
+        }
+    }
 
     /// Loads a model from HuggingFace Hub or local directory.
     ///
     /// - Parameter modelId: HuggingFace model ID or local path
     /// - Throws: Error if model cannot be loaded
     public func loadModel(modelId: String) async throws {
+        try await loadModelFromPath(resolvePath(modelId: modelId))
+    }
+
+    /// Loads a smaller model of the same family for speculative decoding.
+    ///
+    /// The draft model proposes `numDraftTokens` tokens per step that the main
+    /// model verifies in one forward pass. Requests are then generated one at a
+    /// time instead of being batched.
+    ///
+    /// - Parameter modelId: HuggingFace model ID or local path of the draft model
+    /// - Throws: `LLMEngineError.invalidConfig` if the models cannot be combined
+    public func loadDraftModel(modelId: String) async throws {
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+        guard supportsSpeculativeDecoding(model) else {
+            throw LLMEngineError.invalidConfig("Speculative decoding needs a model without sliding-window attention")
+        }
+
+        let path = try await resolvePath(modelId: modelId)
+        let (newDraftModel, draftTokenizer) = try await loadComponents(from: path)
+
+        // Proposals are token IDs, so both models must tokenize identically
+        let probe = "The quick brown fox jumps over the lazy dog. 0123456789 \n\t{}[]"
+        guard draftTokenizer.encode(text: probe) == tokenizer.encode(text: probe) else {
+            throw LLMEngineError.invalidConfig("Draft model \(modelId) uses a different tokenizer")
+        }
+
+        // The batch is stepped on the compute queue
+        try await GenerationScheduler.shared.perform {
+            self.batchGenerator?.cancelAll()
+            self.batchGenerator = nil
+            self.draftModel = newDraftModel
+        }
+    }
+
+    /// Returns the local directory of a model, downloading it from HuggingFace Hub if needed.
+    public func resolvePath(modelId: String) async throws -> String {
         // Check if it's a local path
         let fileManager = FileManager.default
         if fileManager.fileExists(atPath: modelId) {
-            try await loadModelFromPath(modelId)
-        } else {
-            // Download from HuggingFace Hub
-            let hubApi = HubApi()
-            let repo = Hub.Repo(id: modelId)
-            let localPath = try await hubApi.snapshot(from: repo, matching: ["*.json", "*.safetensors"])
-            try await loadModelFromPath(localPath.path)
+            return modelId
         }
+
+        // Download from HuggingFace Hub
+        let hubApi = HubApi()
+        let repo = Hub.Repo(id: modelId)
+        let localPath = try await hubApi.snapshot(from: repo, matching: ["*.json", "*.safetensors"])
+        return localPath.path
     }
 
     /// Loads a model from a local directory.
@@ -72,6 +235,34 @@ public class LLMEngine {
     /// - Parameter path: Path to model directory containing config.json and weights
     /// - Throws: Error if model cannot be loaded
     private func loadModelFromPath(_ path: String) async throws {
+        let (newModel, newTokenizer) = try await loadComponents(from: path)
+
+        model = newModel
+        tokenizer = newTokenizer
+        modelPath = path
+        makeCaches(for: newModel)
+    }
+
+    /// Creates the prefix cache and batch generator of a model on one block pool.
+    ///
+    /// The generator is only created without a draft model, which needs
+    /// every request to run on its own.
+    private func makeCaches(for model: any LLMModel) {
+        let budget = prefixCacheBytes + batchCacheBytes
+        guard budget > 0, PrefixCache.supports(model) else {
+            prefixCache = nil
+            batchGenerator = nil
+            return
+        }
+
+        let pool = KVBlockPool(model: model, maxBytes: budget)
+        prefixCache = prefixCacheBytes > 0 ? PrefixCache(pool: pool, maxBytes: prefixCacheBytes) : nil
+        batchGenerator = batchCacheBytes > 0 && draftModel == nil && BatchGenerator.supports(model)
+            ? BatchGenerator(model: model, pool: pool, prefixCache: prefixCache) : nil
+    }
+
+    /// Creates a model with its weights and tokenizer from a local directory.
+    private func loadComponents(from path: String) async throws -> (any LLMModel, HFTokenizer) {
         let url = URL(fileURLWithPath: path)
 
         // Load configuration
@@ -87,12 +278,73 @@ public class LLMEngine {
             throw LLMEngineError.unsupportedModel("Unsupported model type: \(modelType)")
         }
 
-        // Create model
-        let newModel = try ModelFactory.createModel(architecture: architecture, config: config)
+        // Apply weights, from the compiled cache if this model was loaded before
+        let compiledURL = try compiledCache?.url(forModelAt: url)
+        var compiledModel: (any LLMModel)?
+        if let compiledURL, FileManager.default.fileExists(atPath: compiledURL.path) {
+            do {
+                compiledModel = try await loadCompiled(from: compiledURL, architecture: architecture, config: config)
+            } catch {
+                // A broken compiled model must not break every later load
+                try? FileManager.default.removeItem(at: compiledURL)
+            }
+        }
+        let newModel: any LLMModel
+        if let compiledModel {
+            newModel = compiledModel
+        } else {
+            newModel = try await loadOriginal(from: url, architecture: architecture, config: config)
+
+            // A cache that cannot be written only costs the speedup next time
+            if let compiledURL {
+                try? await GenerationScheduler.shared.perform {
+                    try saveCompiledModel(newModel, to: compiledURL)
+                }
+            }
+        }
+
+        // Load tokenizer
+        let newTokenizer = try await HFTokenizer(path: path)
+
+        return (newModel, newTokenizer)
+    }
+
+    // Files are opened on the calling task; creating a model and reading,
+    // transforming and evaluating its weights runs on the compute queue,
+    // between decode steps.
 
-        // Load weights
+    /// Creates a model from the original weights of a model directory.
+    private func loadOriginal(
+        from url: URL,
+        architecture: ModelArchitecture,
+        config: [String: Any]
+    ) async throws -> any LLMModel {
         let weights = try loadWeights(from: url, config: config)
+        return try await GenerationScheduler.shared.perform {
+            let model = try ModelFactory.createModel(architecture: architecture, config: config)
+            self.applyWeights(weights, to: model, config: config)
+            self.evalParameters(of: model)
+            return model
+        }
+    }
+
+    /// Creates a model from its compiled weights.
+    private func loadCompiled(
+        from url: URL,
+        architecture: ModelArchitecture,
+        config: [String: Any]
+    ) async throws -> any LLMModel {
+        let compiled = try await readCompiledModel(from: url)
+        return try await GenerationScheduler.shared.perform {
+            let model = try ModelFactory.createModel(architecture: architecture, config: config)
+            try applyCompiledModel(compiled, to: model)
+            self.evalParameters(of: model)
+            return model
+        }
+    }
 
+    /// Sanitizes and quantizes the original weights of a model and applies them.
+    private func applyWeights(_ weights: [String: MLXArray], to newModel: any LLMModel, config: [String: Any]) {
         // Sanitize weight keys
         let sanitizedWeights = newModel.sanitize(weights: weights)
 
@@ -101,7 +353,7 @@ public class LLMEngine {
            let groupSize = quantConfig["group_size"] as? Int,
            let bits = quantConfig["bits"] as? Int
         {
-            quantize(model: newModel, predicate: { weightPath, _ in
+            quantizeLayers(in: newModel, settings: { weightPath, _ in
                 // Check if this weight has quantization scales
                 if sanitizedWeights["\(weightPath).scales"] != nil {
                     return (groupSize, bits, .affine)
@@ -112,14 +364,18 @@ public class LLMEngine {
 
         // Apply weights
         newModel.update(parameters: ModuleParameters.unflattened(sanitizedWeights))
-        eval(newModel.parameters())
-
-        // Load tokenizer
-        let newTokenizer = try await HFTokenizer(path: path)
+    }
 
-        model = newModel
-        tokenizer = newTokenizer
-        modelPath = path
+    /// Evaluates all parameters of a model.
+    ///
+    /// Loaded tensors are already materialized; evaluating in small groups
+    /// bounds the temporaries of sanitize conversions while keeping the GPU
+    /// busy with more than one conversion at a time.
+    private func evalParameters(of model: any LLMModel) {
+        let parameters = model.parameters().flattened().map(\.1)
+        for start in stride(from: 0, to: parameters.count, by: 32) {
+            eval(Array(parameters[start ..< min(start + 32, parameters.count)]))
+        }
     }
 
     /// Generates text from a prompt.
@@ -141,14 +397,14 @@ public class LLMEngine {
         // Encode prompt
         let inputIds = tokenizer.encode(text: prompt)
 
-        // Set up stop tokens
-        var genConfig = config
+        // Set up grammar and stop tokens
+        var genConfig = try resolvingGrammar(config)
         if let eosId = tokenizer.eosTokenId {
             genConfig.stopTokens.insert(eosId)
         }
 
         // Generate tokens
-        let generatedIds = NodeMLXCore.generate(
+        let output = NodeMLXCore.generate(
             model: model,
             inputIds: inputIds,
             config: genConfig,
@@ -161,7 +417,7 @@ public class LLMEngine {
         )
 
         // Decode result
-        return tokenizer.decode(tokens: generatedIds)
+        return tokenizer.decode(tokens: output.tokens)
     }
 
     /// Generates text with streaming and returns detailed result.
@@ -181,7 +437,35 @@ public class LLMEngine {
         temperature: Float,
         topP: Float,
         repetitionPenalty: Float? = nil,
-        repetitionContextSize _: Int = 20,
+        repetitionContextSize: Int = 20,
+        onToken: @escaping (String) -> Bool
+    ) throws -> GenerationResult {
+        try generateStream(
+            prompt: prompt,
+            config: GenerationConfig(
+                maxTokens: maxTokens,
+                temperature: temperature,
+                topP: topP,
+                repetitionPenalty: repetitionPenalty ?? 1.0,
+                repetitionContextSize: repetitionContextSize
+            ),
+            onToken: onToken
+        )
+    }
+
+    /// Generates text with streaming using a full generation configuration.
+    ///
+    /// Honors the configuration's cancellation token and time limits; the
+    /// result's `finishReason` reports why generation stopped.
+    ///
+    /// - Parameters:
+    ///   - prompt: Input text
+    ///   - config: Generation configuration
+    ///   - onToken: Callback for each generated token (return false to stop)
+    /// - Returns: Generation result with timing information
+    public func generateStream(
+        prompt: String,
+        config: GenerationConfig,
         onToken: @escaping (String) -> Bool
     ) throws -> GenerationResult {
         guard let model, let tokenizer else {
@@ -194,44 +478,321 @@ public class LLMEngine {
         // Encode prompt
         let inputIds = tokenizer.encode(text: prompt)
 
-        // Set up config
-        var config = GenerationConfig(
-            maxTokens: maxTokens,
-            temperature: temperature,
-            topP: topP,
-            repetitionPenalty: repetitionPenalty ?? 1.0
-        )
+        // Set up grammar and stop tokens
+        var config = try resolvingGrammar(config)
         if let eosId = tokenizer.eosTokenId {
             config.stopTokens.insert(eosId)
         }
 
-        // Generate tokens
-        let generatedIds = NodeMLXCore.generate(
-            model: model,
-            inputIds: inputIds,
-            config: config,
-            onToken: { tokenId in
-                if firstTokenTime == nil {
-                    firstTokenTime = CFAbsoluteTimeGetCurrent()
+        // Start from the longest cached prefix of the prompt
+        let promptCache = prefixCache.map { $0.fetch(inputIds)?.cache ?? model.newCache() }
+
+        let tokenCallback: (Int) -> Bool = { tokenId in
+            if firstTokenTime == nil {
+                firstTokenTime = CFAbsoluteTimeGetCurrent()
+            }
+            let text = tokenizer.decode(tokens: [tokenId])
+            return onToken(text)
+        }
+
+        // Generate tokens, speculatively with a draft model or prompt lookup.
+        // Logits processors need every token sampled in order and logprobs are
+        // computed while sampling, so either rules it out.
+        let proposer: DraftProposer? = if !config.logitsProcessors.isEmpty || config.logprobs != nil {
+            nil
+        } else if let draftModel {
+            DraftModelProposer(model: draftModel, config: config)
+        } else if config.promptLookupNgramSize > 0 {
+            PromptLookupProposer(ngramSize: config.promptLookupNgramSize)
+        } else {
+            nil
+        }
+
+        let output = if let proposer {
+            speculativeGenerate(
+                model: model,
+                proposer: proposer,
+                inputIds: inputIds,
+                config: config,
+                promptCache: promptCache,
+                onToken: tokenCallback
+            )
+        } else {
+            NodeMLXCore.generate(
+                model: model,
+                inputIds: inputIds,
+                config: config,
+                promptCache: promptCache,
+                onToken: tokenCallback
+            )
+        }
+
+        // Keep the processed sequence (prompt and fed tokens) for later requests
+        if let prefixCache, let promptCache, let length = promptCache.first?.offset {
+            prefixCache.insert(Array((inputIds + output.tokens).prefix(length)), cache: promptCache)
+        }
+
+        return makeResult(
+            output: output,
+            tokenizer: tokenizer,
+            startTime: startTime,
+            firstTokenTime: firstTokenTime
+        )
+    }
+
+    /// Generates text on a scheduler, batching with other requests when possible.
+    ///
+    /// Models that support batching (see `BatchGenerator.supports(_:)`) decode
+    /// concurrent requests together, one token per scheduler round. Other models,
+    /// engines with a draft model, prompt-lookup requests, requests with a
+    /// quantized KV cache and requests for logprobs run on their own as
+    /// exclusive scheduler jobs.
+    ///
+    /// - Parameters:
+    ///   - prompt: Input text
+    ///   - config: Generation configuration
+    ///   - scheduler: Scheduler that runs the model work
+    ///   - onToken: Callback for each generated token (return false to stop)
+    /// - Returns: Generation result with timing information
+    public func scheduleGeneration(
+        prompt: String,
+        config: GenerationConfig,
+        on scheduler: GenerationScheduler = .shared,
+        onToken: @escaping (String) -> Bool
+    ) async throws -> GenerationResult {
+        let config = cancellable(config)
+        return try await withCheckedThrowingContinuation { continuation in
+            scheduler.submit { [self] in
+                var requestConfig: GenerationConfig
+                do {
+                    requestConfig = try resolvingGrammar(config)
+                } catch {
+                    continuation.resume(throwing: error)
+                    return
+                }
+
+                guard let tokenizer, let batchGenerator, requestConfig.promptLookupNgramSize <= 0,
+                      requestConfig.kvBits == nil, requestConfig.logprobs == nil
+                else {
+                    continuation.resume(with: Result { [requestConfig] in
+                        try generateStream(prompt: prompt, config: requestConfig, onToken: onToken)
+                    })
+                    return
+                }
+
+                let startTime = CFAbsoluteTimeGetCurrent()
+                var firstTokenTime: CFAbsoluteTime?
+
+                if let eosId = tokenizer.eosTokenId {
+                    requestConfig.stopTokens.insert(eosId)
                 }
-                let text = tokenizer.decode(tokens: [tokenId])
-                return onToken(text)
+
+                let request = BatchRequest(
+                    inputIds: tokenizer.encode(text: prompt),
+                    config: requestConfig,
+                    onToken: { tokenId in
+                        if firstTokenTime == nil {
+                            firstTokenTime = CFAbsoluteTimeGetCurrent()
+                        }
+                        return onToken(tokenizer.decode(tokens: [tokenId]))
+                    },
+                    completion: { [self] output in
+                        continuation.resume(returning: makeResult(
+                            output: output,
+                            tokenizer: tokenizer,
+                            startTime: startTime,
+                            firstTokenTime: firstTokenTime
+                        ))
+                    }
+                )
+                // Tokenizer and generator are read on the compute queue, so an
+                // unload job cannot interleave; the request joins next round
+                scheduler.enqueue(request, on: batchGenerator)
             }
+        }
+    }
+
+    /// Makes a configuration stop at the next `cancelScheduledWork()`.
+    ///
+    /// Apply it when the work is scheduled rather than when it starts, so the
+    /// cancellation also reaches work still waiting on the compute queue.
+    public func cancellable(_ config: GenerationConfig) -> GenerationConfig {
+        scheduledWorkLock.lock()
+        let scheduled = scheduledWork
+        scheduledWorkLock.unlock()
+
+        var config = config
+        config.cancellation = CancellationToken(linkedTo: [config.cancellation, scheduled].compactMap { $0 })
+        return config
+    }
+
+    /// Cancels every generation made `cancellable(_:)` so far, whether it is
+    /// running or still queued; later ones are not affected.
+    ///
+    /// Safe to call from any thread. Embedding and scoring jobs are not
+    /// cancelled; they finish within one forward pass per batch.
+    public func cancelScheduledWork() {
+        scheduledWorkLock.lock()
+        let scheduled = scheduledWork
+        scheduledWork = CancellationToken()
+        scheduledWorkLock.unlock()
+
+        scheduled.cancel()
+    }
+
+    /// Binds `config.grammar` to this engine's tokenizer.
+    ///
+    /// The grammar is replaced by a processor appended to
+    /// `config.logitsProcessors`. Token masks are cached per grammar pattern,
+    /// so requests with the same regex or schema reuse them; the vocabulary
+    /// bytes are read once per tokenizer.
+    ///
+    /// - Parameter config: Generation configuration, possibly with a grammar
+    /// - Returns: The configuration without a grammar
+    /// - Throws: `LLMEngineError.modelNotLoaded` if no model is loaded
+    public func resolvingGrammar(_ config: GenerationConfig) throws -> GenerationConfig {
+        guard let grammar = config.grammar else { return config }
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+
+        grammarLock.lock()
+        let tokenGrammar = tokenGrammars[grammar.pattern] ?? TokenGrammar(
+            grammar: grammar,
+            vocabulary: tokenizer.tokenVocabulary(size: model.vocabularySize),
+            stopTokens: Set([tokenizer.eosTokenId].compactMap { $0 }),
+            encode: { tokenizer.encode(text: $0, addSpecialTokens: false) }
+        )
+        if tokenGrammars[grammar.pattern] == nil, tokenGrammars.count >= Self.maxCachedGrammars {
+            tokenGrammars.removeAll()
+        }
+        tokenGrammars[grammar.pattern] = tokenGrammar
+        grammarLock.unlock()
+
+        var config = config
+        config.grammar = nil
+        config.logitsProcessors.append { _ in tokenGrammar.makeProcessor() }
+        return config
+    }
+
+    /// Embeds texts with the hidden states of the loaded model.
+    ///
+    /// Uses the model like generation does, so call it on the compute queue
+    /// (`GenerationScheduler.shared.perform`).
+    ///
+    /// - Parameters:
+    ///   - texts: Texts to embed
+    ///   - config: Pooling, layer and normalization
+    /// - Returns: Float32 embeddings, shape [texts.count, hidden_size]
+    /// - Throws: `LLMEngineError.modelNotLoaded` if no model is loaded,
+    ///   `LLMEngineError.invalidConfig` for empty input or an invalid layer
+    public func embed(texts: [String], config: EmbeddingConfig = EmbeddingConfig()) throws -> MLXArray {
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+        return try NodeMLXCore.embed(
+            model: model,
+            sequences: texts.map { tokenizer.encode(text: $0) },
+            config: config
         )
+    }
+
+    /// Scores continuations of prompts with the loaded model.
+    ///
+    /// Prompts are tokenized like generation prompts; continuations are
+    /// tokenized on their own, without special tokens. Prompts go through
+    /// the engine's prefix cache, so repeated contexts are prefilled once.
+    /// Uses the model like generation does, so call it on the compute queue
+    /// (`GenerationScheduler.shared.perform`).
+    ///
+    /// - Parameters:
+    ///   - prompts: Context of each continuation
+    ///   - continuations: Texts to score, one per prompt
+    ///   - config: Batch limits
+    /// - Returns: Natural-log probabilities of each continuation's tokens
+    /// - Throws: `LLMEngineError.modelNotLoaded` if no model is loaded,
+    ///   `LLMEngineError.invalidConfig` for mismatched or empty input
+    public func score(
+        prompts: [String],
+        continuations: [String],
+        config: ScoringConfig = ScoringConfig()
+    ) throws -> [[Float]] {
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+        guard prompts.count == continuations.count else {
+            throw LLMEngineError.invalidConfig("\(prompts.count) prompts for \(continuations.count) continuations")
+        }
+
+        var promptTokens: [String: [Int]] = [:]
+        let requests = zip(prompts, continuations).map { prompt, continuation in
+            let tokens = promptTokens[prompt] ?? tokenizer.encode(text: prompt)
+            promptTokens[prompt] = tokens
+            return ScoringRequest(
+                prompt: tokens,
+                continuation: tokenizer.encode(text: continuation, addSpecialTokens: false)
+            )
+        }
+        return try NodeMLXCore.score(model: model, requests: requests, config: config, prefixCache: prefixCache)
+    }
 
+    /// Builds a generation result from generated tokens and timing.
+    private func makeResult(
+        output: GenerationOutput,
+        tokenizer: HFTokenizer,
+        startTime: CFAbsoluteTime,
+        firstTokenTime: CFAbsoluteTime?
+    ) -> GenerationResult {
         let endTime = CFAbsoluteTimeGetCurrent()
         let totalTime = endTime - startTime
         let timeToFirst = (firstTokenTime ?? endTime) - startTime
 
+        let generatedIds = output.tokens
+
         return GenerationResult(
             text: tokenizer.decode(tokens: generatedIds),
             tokenCount: generatedIds.count,
             tokensPerSecond: generatedIds.count > 0 ? Float(generatedIds.count) / Float(totalTime) : 0,
             timeToFirstToken: timeToFirst,
-            totalTime: totalTime
+            totalTime: totalTime,
+            finishReason: output.finishReason,
+            speculative: output.speculative,
+            logprobs: output.logprobs
         )
     }
 
+    /// Creates a chat session that keeps its KV cache between turns.
+    ///
+    /// - Returns: New empty session on the loaded model
+    /// - Throws: `LLMEngineError.modelNotLoaded` if no model is loaded
+    public func makeSession() throws -> ChatSession {
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+        return ChatSession(model: model, tokenizer: tokenizer)
+    }
+
+    /// Restores a chat session saved with `ChatSession.save(to:)`.
+    ///
+    /// The restored prefix is also added to the prefix cache, so plain
+    /// `generate` calls whose prompt starts with it skip its prefill too.
+    ///
+    /// - Parameter path: File written by `ChatSession.save(to:)`
+    /// - Returns: Session with the saved tokens and KV cache
+    /// - Throws: `LLMEngineError.modelNotLoaded` if no model is loaded,
+    ///   `PromptCacheError` if the file is invalid or belongs to another model
+    public func loadSession(from path: String) throws -> ChatSession {
+        guard let model, let tokenizer else {
+            throw LLMEngineError.modelNotLoaded
+        }
+        let session = try ChatSession.load(from: URL(fileURLWithPath: path), model: model, tokenizer: tokenizer)
+
+        let (tokens, cache) = session.cachedPrefix
+        prefixCache?.insert(tokens, cache: cache)
+
+        return session
+    }
+
     /// Generates text with an image (VLM).
     ///
     /// - Note: VLM support is not yet implemented.
@@ -249,7 +810,18 @@ public class LLMEngine {
     }
 
     /// Unloads the current model.
+    ///
+    /// Requests still in the batch finish as cancelled. Call
+    /// `cancelScheduledWork()` first, off the compute queue, so solo
+    /// generations queued before this job stop instead of running to the end.
     public func unload() {
+        batchGenerator?.cancelAll()
+        batchGenerator = nil
+        prefixCache = nil
+        grammarLock.lock()
+        tokenGrammars.removeAll()
+        grammarLock.unlock()
+        draftModel = nil
         model = nil
         tokenizer = nil
         modelPath = nil
@@ -260,7 +832,9 @@ public class LLMEngine {
 
 /// Loads model weights from a directory.
 ///
-/// Supports both safetensors and npz formats.
+/// Supports both safetensors and npz formats. Only the file headers are read
+/// here: MLX loads each array lazily, so tensor data is read from disk when
+/// the parameters are evaluated, a few at a time, after sanitizing.
 private func loadWeights(from url: URL, config _: [String: Any]) throws -> [String: MLXArray] {
     // Find weight files
     let fileManager = FileManager.default
@@ -273,12 +847,8 @@ private func loadWeights(from url: URL, config _: [String: Any]) throws -> [Stri
     var weights: [String: MLXArray] = [:]
 
     if !safetensorFiles.isEmpty {
-        // Load all safetensor files
         for file in safetensorFiles.sorted(by: { $0.lastPathComponent < $1.lastPathComponent }) {
-            let fileWeights = try MLX.loadArrays(url: file)
-            for (key, value) in fileWeights {
-                weights[key] = value
-            }
+            weights.merge(try MLX.loadArrays(url: file)) { _, shard in shard }
         }
     } else if !npzFiles.isEmpty {
         // Load first npz file
@@ -300,6 +870,7 @@ public enum LLMEngineError: Error, LocalizedError {
     case invalidConfig(String)
     case unsupportedModel(String)
     case weightsNotFound
+    case invalidWeights(String)
     case generationFailed(String)
 
     public var errorDescription: String? {
@@ -312,6 +883,8 @@ public enum LLMEngineError: Error, LocalizedError {
             "Unsupported model: \(msg)"
         case .weightsNotFound:
             "No weight files found in model directory"
+        case let .invalidWeights(msg):
+            "Invalid weight file: \(msg)"
         case let .generationFailed(msg):
             "Generation failed: \(msg)"
         }
@@ -320,19 +893,27 @@ public enum LLMEngineError: Error, LocalizedError {
 
 // MARK: - Quantization Helper
 
-/// Quantizes model layers that have corresponding scale weights.
-private func quantize(
-    model: Module,
-    predicate: (String, Module) -> (Int, Int, QuantizationMode)?
+/// Replaces the layers of a model for which `settings` returns group size,
+/// bits and mode with their quantized counterparts.
+///
+/// Handles `Linear` and `Embedding` layers; other layers are left as they
+/// are. Named apart from MLXNN's `quantize(model:filter:apply:)` so a
+/// trailing closure cannot resolve to it.
+func quantizeLayers(
+    in model: Module,
+    settings: (String, Module) -> (Int, Int, QuantizationMode)?
 ) {
     model.update(modules: ModuleChildren.unflattened(
         model.leafModules().flattened().compactMap { path, module in
-            guard let (groupSize, bits, mode) = predicate(path, module) else {
+            guard let (groupSize, bits, mode) = settings(path, module) else {
                 return nil
             }
             if let linear = module as? Linear {
                 return (path, QuantizedLinear(linear, groupSize: groupSize, bits: bits, mode: mode))
             }
+            if let embedding = module as? Embedding {
+                return (path, QuantizedEmbedding(embedding, groupSize: groupSize, bits: bits, mode: mode))
+            }
             return nil
         }
     ))
@@ -0,0 +1,484 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Paged KV cache: sequences store keys and values in fixed-size blocks of a
+// shared pool instead of owning contiguous buffers.
+
+import Foundation
+import MLX
+import MLXFast
+
+// MARK: - Block Pool
+
+/// Fixed-size pool of KV blocks shared by the batch and the prefix cache of one model.
+///
+/// Sequences map their positions to blocks through a block table, so memory
+/// is handed out in `blockSize` steps and freed blocks are reused without
+/// fragmentation. Blocks are reference counted: a prefix snapshot and the
+/// sequences that start with it hold the same blocks, and a shared block is
+/// copied before a sequence writes into it.
+///
+/// Each layer's storage grows with the highest block handed out so far,
+/// doubling up to `blockCount` blocks; freed blocks are handed out again
+/// before new ones, so storage only grows when all used blocks are taken.
+/// When no block is free, `reclaim` is asked to release blocks held for
+/// reuse only.
+///
+/// Not thread-safe: all calls must come from the same thread.
+public final class KVBlockPool {
+    /// Tokens per block.
+    public let blockSize: Int
+
+    /// Maximum number of blocks (shared by all layers).
+    public let blockCount: Int
+
+    /// Called when no block is free; releases blocks that are only kept for
+    /// reuse and returns false once there is nothing left to release.
+    var reclaim: (() -> Bool)?
+
+    private var storage: [(keys: MLXArray, values: MLXArray)?]
+    private var freeBlocks: [Int]
+    private var refCounts: [Int]
+
+    /// One past the highest block handed out so far.
+    private var usedBlockCount = 0
+
+    /// Creates a pool.
+    ///
+    /// - Parameters:
+    ///   - numLayers: Number of transformer layers
+    ///   - blockCount: Maximum number of blocks
+    ///   - blockSize: Tokens per block
+    public init(numLayers: Int, blockCount: Int, blockSize: Int = 16) {
+        precondition(blockCount > 0 && blockSize > 0, "KVBlockPool needs at least one non-empty block")
+        self.blockSize = blockSize
+        self.blockCount = blockCount
+        storage = Array(repeating: nil, count: numLayers)
+        // Hand out low block numbers first
+        freeBlocks = Array((0 ..< blockCount).reversed())
+        refCounts = Array(repeating: 0, count: blockCount)
+    }
+
+    /// Creates a pool for a model that fits into a memory budget.
+    ///
+    /// - Parameters:
+    ///   - model: Model whose layer shape sizes the blocks
+    ///   - maxBytes: Memory for keys and values of all layers
+    ///   - blockSize: Tokens per block
+    ///   - dtype: Expected element type of the cached keys and values
+    public convenience init(model: any LLMModel, maxBytes: Int, blockSize: Int = 16, dtype: DType = .float16) {
+        let bytesPerBlock = 2 * model.numLayers * blockSize * model.numKVHeads * model.headDim * dtype.size
+        self.init(
+            numLayers: model.newCache().count,
+            blockCount: max(maxBytes / max(bytesPerBlock, 1), 1),
+            blockSize: blockSize
+        )
+    }
+
+    /// Number of layers with storage in the pool.
+    public var numLayers: Int { storage.count }
+
+    /// Number of blocks not held by any sequence.
+    public var freeBlockCount: Int { freeBlocks.count }
+
+    /// Number of blocks needed to hold `tokens` tokens.
+    public func blocksNeeded(for tokens: Int) -> Int {
+        (tokens + blockSize - 1) / blockSize
+    }
+
+    /// Bytes of one block across all layers written so far.
+    public var blockBytes: Int {
+        storage.reduce(0) { total, layer in
+            guard let layer else { return total }
+            return total + (layer.keys.nbytes + layer.values.nbytes) / (layer.keys.dim(0) / blockSize)
+        }
+    }
+
+    // MARK: - Block Management
+
+    /// Takes a free block, reclaiming blocks if there is none.
+    ///
+    /// - Returns: The block, or nil if the pool is exhausted
+    func allocate() -> Int? {
+        while freeBlocks.isEmpty {
+            guard reclaim?() == true else { return nil }
+        }
+        let block = freeBlocks.removeLast()
+        refCounts[block] = 1
+        usedBlockCount = max(usedBlockCount, block + 1)
+        return block
+    }
+
+    /// Adds one reference to each block.
+    func retain(_ blocks: some Sequence<Int>) {
+        for block in blocks {
+            refCounts[block] += 1
+        }
+    }
+
+    /// Drops one reference to each block, returning unreferenced blocks to the free list.
+    func release(_ blocks: some Sequence<Int>) {
+        for block in blocks {
+            refCounts[block] -= 1
+            if refCounts[block] == 0 {
+                freeBlocks.append(block)
+            }
+        }
+    }
+
+    /// Whether more than one sequence holds a block.
+    func isShared(_ block: Int) -> Bool {
+        refCounts[block] > 1
+    }
+
+    /// Copies the contents of a block in every layer written so far.
+    func copyBlock(_ source: Int, to destination: Int) {
+        let from = MLXArray(Int32(source * blockSize) ..< Int32((source + 1) * blockSize))
+        let to = MLXArray(Int32(destination * blockSize) ..< Int32((destination + 1) * blockSize))
+        for layer in storage.indices {
+            guard let existing = storage[layer] else { continue }
+            let (keys, values) = layerStorage(layer, like: existing.keys, existing.values)
+
+            // A gather, unlike a slice, leaves the storage buffer free to be updated in place
+            keys[to] = take(keys, from, axis: 0)
+            values[to] = take(values, from, axis: 0)
+        }
+    }
+
+    // MARK: - Storage Access
+
+    /// Writes keys and values of shape [N, H, D] to the given slots.
+    func write(layer: Int, slots: MLXArray, keys: MLXArray, values: MLXArray) {
+        let (layerKeys, layerValues) = layerStorage(layer, like: keys, values)
+        layerKeys[slots] = keys
+        layerValues[slots] = values
+    }
+
+    /// Gathers the given slots as keys and values of shape [N, H, D].
+    func read(layer: Int, slots: MLXArray) -> (MLXArray, MLXArray) {
+        guard let layerStorage = storage[layer] else {
+            preconditionFailure("KVBlockPool layer \(layer) was read before it was written")
+        }
+        return (take(layerStorage.keys, slots, axis: 0), take(layerStorage.values, slots, axis: 0))
+    }
+
+    /// Storage arrays of one layer, empty before its first write.
+    func arrays(layer: Int) -> [MLXArray] {
+        storage[layer].map { [$0.keys, $0.values] } ?? []
+    }
+
+    // MARK: - Private
+
+    /// Returns a layer's storage, allocated or grown to cover every block handed out.
+    ///
+    /// Shape and dtype other than the slot axis are taken from `keys` and `values`.
+    private func layerStorage(_ layer: Int, like keys: MLXArray, _ values: MLXArray) -> (MLXArray, MLXArray) {
+        let current = storage[layer]?.keys.dim(0) ?? 0
+        if let existing = storage[layer], current >= usedBlockCount * blockSize {
+            precondition(
+                existing.keys.dim(1) == keys.dim(1) && existing.keys.dim(2) == keys.dim(2),
+                "PagedKVCache layer shape changed between updates"
+            )
+            return existing
+        }
+
+        let slotCount = min(blockCount, max(usedBlockCount, 2 * current / blockSize)) * blockSize
+        func grown(_ array: MLXArray?, like template: MLXArray) -> MLXArray {
+            let added = MLXArray.zeros([slotCount - current, template.dim(1), template.dim(2)], dtype: template.dtype)
+            guard let array else { return added }
+            return concatenated([array, added], axis: 0)
+        }
+        let grownStorage = (grown(storage[layer]?.keys, like: keys), grown(storage[layer]?.values, like: values))
+        storage[layer] = grownStorage
+        return grownStorage
+    }
+}
+
+// MARK: - Sequence Storage
+
+/// Block table of one sequence: the pool blocks holding its positions, in order.
+///
+/// Holds one reference to each of its blocks and drops them on release.
+final class PagedSequence {
+    let pool: KVBlockPool
+    private(set) var blocks: [Int]
+
+    /// Creates a sequence that takes over one reference to each block.
+    init(pool: KVBlockPool, blocks: [Int] = []) {
+        self.pool = pool
+        self.blocks = blocks
+    }
+
+    deinit {
+        pool.release(blocks)
+    }
+
+    /// Creates a sequence that shares the blocks of the first `length` positions.
+    func fork(length: Int) -> PagedSequence {
+        let shared = Array(blocks.prefix(pool.blocksNeeded(for: length)))
+        pool.retain(shared)
+        return PagedSequence(pool: pool, blocks: shared)
+    }
+
+    /// Makes the positions in `range` writable: appends blocks as needed and
+    /// copies shared blocks the range touches.
+    ///
+    /// - Returns: Whether the pool had enough blocks
+    func reserve(_ range: Range<Int>) -> Bool {
+        guard !range.isEmpty else { return true }
+        let blockSize = pool.blockSize
+
+        for index in (range.lowerBound / blockSize) ..< min(blocks.count, pool.blocksNeeded(for: range.upperBound))
+            where pool.isShared(blocks[index])
+        {
+            guard let copy = pool.allocate() else { return false }
+            pool.copyBlock(blocks[index], to: copy)
+            pool.release([blocks[index]])
+            blocks[index] = copy
+        }
+
+        while blocks.count < pool.blocksNeeded(for: range.upperBound) {
+            guard let block = pool.allocate() else { return false }
+            blocks.append(block)
+        }
+        return true
+    }
+
+    /// Pool slot of a reserved position.
+    func slot(_ position: Int) -> Int32 {
+        Int32(blocks[position / pool.blockSize] * pool.blockSize + position % pool.blockSize)
+    }
+
+    /// Pool slots of a range of reserved positions.
+    func slots(_ range: Range<Int>) -> MLXArray {
+        MLXArray(range.map { slot($0) })
+    }
+
+    /// Returns the first `length` positions of a layer, shape [1, H, length, D].
+    func state(layer: Int, length: Int) -> (keys: MLXArray, values: MLXArray) {
+        let (keys, values) = pool.read(layer: layer, slots: slots(0 ..< length))
+        return (
+            keys.transposed(1, 0, 2).expandedDimensions(axis: 0),
+            values.transposed(1, 0, 2).expandedDimensions(axis: 0)
+        )
+    }
+
+    /// Writes keys and values of shape [1, H, S, D] to reserved positions `0 ..< S` of a layer.
+    func write(layer: Int, keys: MLXArray, values: MLXArray) {
+        pool.write(
+            layer: layer,
+            slots: slots(0 ..< keys.dim(2)),
+            keys: keys[0].transposed(1, 0, 2),
+            values: values[0].transposed(1, 0, 2)
+        )
+    }
+}
+
+// MARK: - Paged Batch
+
+/// Rows of a batch stored in a `KVBlockPool`, shared by the caches of all layers.
+///
+/// Like `BatchKVCache`, rows are right-aligned in a common column space so
+/// they share one RoPE offset, and row `r` fills columns `leftPadding[r]`
+/// up to the last. The columns are virtual: each row's positions live in its
+/// own blocks, and attention reads them through a gather that maps padding
+/// columns to an arbitrary slot hidden by the mask. Merging and removing rows
+/// only changes block tables and padding; no keys or values are copied.
+///
+/// Every write must fit into blocks reserved with `reserve(_:row:)` before the
+/// model runs, since a forward pass cannot stop halfway when the pool is out
+/// of blocks. Not thread-safe: all calls must come from the same thread.
+final class PagedBatch {
+    let pool: KVBlockPool
+
+    /// Block tables of the rows.
+    private(set) var rows: [PagedSequence]
+
+    /// Number of padding columns at the start of each row.
+    private(set) var leftPadding: [Int]
+
+    /// Number of filled columns per layer, including padding.
+    fileprivate var columns: [Int]
+
+    /// Column that corresponds to RoPE position 0.
+    fileprivate private(set) var origin: Int
+
+    /// Slot indices per column range; all layers read the same ranges in a step.
+    private var slotCache: [Range<Int>: MLXArray] = [:]
+
+    /// Creates a batch of one row.
+    ///
+    /// - Parameters:
+    ///   - row: Blocks of the row
+    ///   - length: Positions of `row` that are already filled
+    ///   - offset: RoPE position of the row's first position (may be negative)
+    init(row: PagedSequence, length: Int = 0, offset: Int = 0) {
+        pool = row.pool
+        rows = [row]
+        leftPadding = [0]
+        columns = Array(repeating: length, count: row.pool.numLayers)
+        origin = -offset
+    }
+
+    /// Caches to pass to the model, one per layer.
+    var caches: [KVCacheProtocol] {
+        columns.indices.map { PagedKVCache(batch: self, layer: $0) }
+    }
+
+    /// Number of rows in the batch.
+    var batchSize: Int { rows.count }
+
+    /// RoPE position of the next token, shared by all rows.
+    var offset: Int { (columns.first ?? 0) - origin }
+
+    /// Number of filled positions of a row.
+    func length(ofRow row: Int) -> Int {
+        (columns.first ?? 0) - leftPadding[row]
+    }
+
+    /// Reserves blocks for the next `count` positions of a row.
+    ///
+    /// - Returns: Whether the pool had enough blocks
+    func reserve(_ count: Int, row: Int) -> Bool {
+        let start = length(ofRow: row)
+        invalidateSlots()
+        return rows[row].reserve(start ..< start + count)
+    }
+
+    /// Appends the rows of another batch at the same `offset`.
+    ///
+    /// The narrower batch is left-padded so the rows stay aligned on the right.
+    func extend(_ other: PagedBatch) {
+        precondition(offset == other.offset, "PagedBatch.extend requires matching offsets")
+        precondition(other.pool === pool, "PagedBatch.extend requires batches of the same pool")
+
+        let ropeOffset = offset
+        let width = max(columns.first ?? 0, other.columns.first ?? 0)
+        let selfShift = width - (columns.first ?? 0)
+        let otherShift = width - (other.columns.first ?? 0)
+
+        rows += other.rows
+        leftPadding = leftPadding.map { $0 + selfShift } + other.leftPadding.map { $0 + otherShift }
+        columns = columns.map { _ in width }
+        origin = width - ropeOffset
+        invalidateSlots()
+    }
+
+    /// Keeps only the given rows, in the given order.
+    ///
+    /// Padding columns shared by all remaining rows are dropped. Blocks of
+    /// removed rows return to the pool unless something else holds them.
+    func filter(_ keep: [Int]) {
+        rows = keep.map { rows[$0] }
+        leftPadding = keep.map { leftPadding[$0] }
+
+        let shared = leftPadding.min() ?? 0
+        leftPadding = leftPadding.map { $0 - shared }
+        columns = columns.map { $0 - shared }
+        origin -= shared
+        invalidateSlots()
+    }
+
+    /// Pool slots of a column range for all rows, row-major.
+    fileprivate func slots(_ range: Range<Int>) -> MLXArray {
+        if let cached = slotCache[range] {
+            return cached
+        }
+        var slots: [Int32] = []
+        slots.reserveCapacity(rows.count * range.count)
+        for (row, padding) in zip(rows, leftPadding) {
+            for column in range {
+                slots.append(column < padding ? 0 : row.slot(column - padding))
+            }
+        }
+        let array = MLXArray(slots)
+
+        // Only the current step's ranges are worth keeping
+        if slotCache.count >= 4 {
+            slotCache.removeAll()
+        }
+        slotCache[range] = array
+        return array
+    }
+
+    fileprivate func invalidateSlots() {
+        slotCache.removeAll()
+    }
+}
+
+// MARK: - PagedKVCache
+
+/// KV cache for one layer of a `PagedBatch`.
+///
+/// `update` scatters the new keys and values of every row into its blocks and
+/// gathers all columns back for attention, so models use it like a
+/// `BatchKVCache`. The gather is one extra copy of the layer's history per
+/// step, the price of attention that cannot read block tables directly.
+public final class PagedKVCache: KVCacheProtocol {
+    let batch: PagedBatch
+    private let layer: Int
+
+    init(batch: PagedBatch, layer: Int) {
+        self.batch = batch
+        self.layer = layer
+    }
+
+    /// RoPE position of the next token, shared by all rows.
+    public var offset: Int { batch.columns[layer] - batch.origin }
+
+    /// Returns the cached keys and values of all rows, including padding columns.
+    public var state: (keys: MLXArray, values: MLXArray)? {
+        let count = batch.columns[layer]
+        guard count > 0, !batch.pool.arrays(layer: layer).isEmpty else { return nil }
+        return gather(count)
+    }
+
+    public func update(keys newKeys: MLXArray, values newValues: MLXArray) -> (MLXArray, MLXArray) {
+        let start = batch.columns[layer]
+        let end = start + newKeys.dim(2)
+
+        batch.pool.write(
+            layer: layer,
+            slots: batch.slots(start ..< end),
+            keys: newKeys.transposed(0, 2, 1, 3).reshaped([-1, newKeys.dim(1), newKeys.dim(3)]),
+            values: newValues.transposed(0, 2, 1, 3).reshaped([-1, newValues.dim(1), newValues.dim(3)])
+        )
+        batch.columns[layer] = end
+
+        return gather(end)
+    }
+
+    @discardableResult
+    public func trim(_ n: Int) -> Int {
+        let trimmed = min(batch.columns[layer] - (batch.leftPadding.max() ?? 0), n)
+        batch.columns[layer] -= trimmed
+        batch.invalidateSlots()
+        return trimmed
+    }
+
+    public func makeMask(
+        queryLength n: Int,
+        windowSize: Int? = nil,
+        returnArray: Bool = false
+    ) -> MLXFast.ScaledDotProductAttentionMaskMode {
+        createLeftPaddedMask(
+            n: n,
+            offset: batch.columns[layer],
+            leftPadding: batch.leftPadding,
+            windowSize: windowSize,
+            returnArray: returnArray
+        )
+    }
+
+    /// Storage arrays of this layer in the pool.
+    var arrays: [MLXArray] { batch.pool.arrays(layer: layer) }
+
+    /// Gathers the first `count` columns of every row, shape [B, H, count, D].
+    private func gather(_ count: Int) -> (MLXArray, MLXArray) {
+        let (keys, values) = batch.pool.read(layer: layer, slots: batch.slots(0 ..< count))
+        return (
+            keys.reshaped([batch.batchSize, count, keys.dim(1), keys.dim(2)]).transposed(0, 2, 1, 3),
+            values.reshaped([batch.batchSize, count, values.dim(1), values.dim(2)]).transposed(0, 2, 1, 3)
+        )
+    }
+}
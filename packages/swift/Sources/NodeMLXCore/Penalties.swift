@@ -0,0 +1,131 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Repetition, frequency and presence penalties over a window of recent
+// tokens, applied on the device.
+
+import Foundation
+import MLX
+
+// MARK: - Penalty Processor
+
+/// Penalizes the logits of recently generated tokens.
+///
+/// Keeps the last `config.repetitionContextSize` tokens in a ring buffer on
+/// the device. Appending a sampled token writes it into the buffer lazily, so
+/// a token that was sampled but not yet read by the host can be appended and
+/// the decode loop never waits for it. Seed the buffer with the prompt, so
+/// the first tokens are penalized for repeating it.
+public final class PenaltyProcessor {
+    private let config: GenerationConfig
+    private let size: Int
+    private var ring: MLXArray
+    private var written = 0
+
+    /// Creates a processor, or returns nil if `config` sets no penalty.
+    ///
+    /// - Parameters:
+    ///   - config: Penalties and window size
+    ///   - context: Tokens seen so far (usually the prompt); only the last window is kept
+    public init?(config: GenerationConfig, context: [Int] = []) {
+        guard config.hasPenalties, config.repetitionContextSize > 0 else { return nil }
+
+        self.config = config
+        size = config.repetitionContextSize
+        ring = MLXArray.zeros([size], type: Int32.self)
+
+        let recent = context.suffix(size)
+        if !recent.isEmpty {
+            ring[0 ..< recent.count] = MLXArray(recent.map { Int32($0) })
+            written = recent.count
+        }
+    }
+
+    /// Tokens in the window, in no particular order.
+    var recentTokens: MLXArray {
+        written < size ? ring[..<written] : ring
+    }
+
+    /// Applies the penalties to logits of shape [..., vocab_size].
+    ///
+    /// - Returns: Penalized float32 logits of the same shape
+    public func apply(_ logits: MLXArray) -> MLXArray {
+        guard written > 0 else { return logits }
+        return applyPenalties(to: logits, recentTokens: recentTokens, config: config)
+    }
+
+    /// Appends sampled tokens without waiting for them.
+    ///
+    /// - Parameter tokens: Token IDs, shape [n] or a scalar
+    public func append(_ tokens: MLXArray) {
+        let tokens = tokens.reshaped([-1]).asType(.int32)
+        for i in 0 ..< tokens.dim(0) {
+            let slot = written % size
+            ring[slot ..< slot + 1] = tokens[i ..< i + 1]
+            written += 1
+        }
+    }
+
+    /// Appends a token already known on the host.
+    public func append(_ token: Int) {
+        append(MLXArray([Int32(token)]))
+    }
+}
+
+// MARK: - Penalties
+
+extension GenerationConfig {
+    /// Whether any repetition, frequency or presence penalty is set.
+    var hasPenalties: Bool {
+        repetitionPenalty != 1 || frequencyPenalty != 0 || presencePenalty != 0
+    }
+}
+
+/// Penalizes the logits of the given tokens.
+///
+/// Follows mlx-lm: the repetition penalty divides positive logits and
+/// multiplies negative ones; the frequency penalty subtracts once per
+/// occurrence in the window and the presence penalty once per token. Only
+/// the window's entries are gathered and scattered back, so the cost does
+/// not grow with the vocabulary.
+///
+/// - Parameters:
+///   - logits: Logits of shape [..., vocab_size]
+///   - recentTokens: Token IDs in the window, shape [n] (duplicates allowed)
+///   - config: Penalty settings
+/// - Returns: Penalized float32 logits of the same shape
+func applyPenalties(to logits: MLXArray, recentTokens: MLXArray, config: GenerationConfig) -> MLXArray {
+    let penalized = logits.asType(.float32)
+    var selected = penalized[.ellipsis, recentTokens]
+
+    if config.repetitionPenalty != 1 {
+        selected = which(
+            selected .< Float(0),
+            selected * config.repetitionPenalty,
+            selected / config.repetitionPenalty
+        )
+    }
+
+    if config.frequencyPenalty != 0 || config.presencePenalty != 0 {
+        // Occurrences of each entry in the window; duplicates get equal values,
+        // so scattering them back is order independent
+        let tokens = recentTokens.reshaped([-1, 1])
+        let occurrences = (tokens .== tokens.reshaped([1, -1])).asType(.float32).sum(axis: -1)
+        selected = selected - occurrences * config.frequencyPenalty - config.presencePenalty
+    }
+
+    penalized[.ellipsis, recentTokens] = selected
+    return penalized
+}
+
+// MARK: - Logits Processor
+
+extension PenaltyProcessor: LogitsProcessor {
+    public func process(_ logits: MLXArray) -> MLXArray {
+        apply(logits)
+    }
+
+    public func didSample(_ tokens: MLXArray) {
+        append(tokens)
+    }
+}
@@ -0,0 +1,337 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Prompt prefix cache: reuses KV state of previously processed token
+// sequences so repeated prefixes are not prefilled again.
+
+import Foundation
+import MLX
+
+// MARK: - Prefix Cache
+
+/// Radix tree over token IDs holding snapshots of per-layer KV state.
+///
+/// `insert` stores the KV state of a processed token sequence; `fetch` returns
+/// fresh caches holding the longest stored prefix of a new sequence. A stored
+/// sequence also serves every shorter prefix of itself: its state is sliced to
+/// the matching length, so a snapshot replaces the snapshots of its ancestors.
+///
+/// Snapshots live in blocks of a `KVBlockPool`. A `BatchGenerator` on the
+/// same pool stores a finished row by holding on to its blocks and starts a
+/// row from a snapshot by sharing them, so neither copies keys or values;
+/// only the partially filled last block is copied once the row writes into
+/// it. `fetch` and `insert(_:cache:)` copy between the pool and contiguous
+/// `StandardKVCache` buffers for solo generation.
+///
+/// Snapshots are evicted least-recently-used first once the blocks they hold
+/// exceed `maxBytes`, and whenever the pool runs out of blocks for the batch.
+///
+/// Only models whose layers all use `StandardKVCache` are supported (see
+/// `supports(_:)`). Not thread-safe: all calls must come from the same thread.
+public final class PrefixCache {
+    /// Memory budget for all snapshots in bytes.
+    public let maxBytes: Int
+
+    /// Pool holding the snapshots.
+    public let pool: KVBlockPool
+
+    /// Bytes of the blocks currently held by snapshots.
+    ///
+    /// Blocks shared by several snapshots count once per snapshot.
+    public private(set) var totalBytes = 0
+
+    private let root = Node(edge: [])
+    private var entries: [ObjectIdentifier: Node] = [:]
+    private var clock: UInt64 = 0
+
+    /// Creates an empty prefix cache.
+    ///
+    /// The cache releases its oldest snapshots when `pool` runs out of
+    /// blocks, so a pool serves one prefix cache.
+    ///
+    /// - Parameters:
+    ///   - pool: Pool to store snapshots in
+    ///   - maxBytes: Memory budget for all snapshots in bytes
+    public init(pool: KVBlockPool, maxBytes: Int) {
+        self.pool = pool
+        self.maxBytes = maxBytes
+        pool.reclaim = { [weak self] in
+            guard let self, let oldest = leastRecentlyUsed() else { return false }
+            removeSnapshot(oldest)
+            return true
+        }
+    }
+
+    /// Whether a model's caches can be stored in a `PrefixCache`.
+    public static func supports(_ model: any LLMModel) -> Bool {
+        let cache = model.newCache()
+        return !cache.isEmpty && cache.allSatisfy { $0 is StandardKVCache }
+    }
+
+    /// Number of stored snapshots.
+    public var count: Int { entries.count }
+
+    /// Returns caches holding the longest stored prefix of `tokens`.
+    ///
+    /// At least one token is always left for the caller to process, so the
+    /// model produces logits for the last prompt position.
+    ///
+    /// - Parameter tokens: Token sequence about to be processed
+    /// - Returns: One cache per layer and the number of tokens they hold, or nil on a miss
+    public func fetch(_ tokens: [Int]) -> (cache: [KVCacheProtocol], length: Int)? {
+        guard let (sequence, length) = lookup(tokens) else { return nil }
+
+        let cache: [KVCacheProtocol] = (0 ..< pool.numLayers).map { layer in
+            let cache = StandardKVCache()
+            let (keys, values) = sequence.state(layer: layer, length: length)
+            _ = cache.update(keys: keys, values: values)
+            return cache
+        }
+        return (cache, length)
+    }
+
+    /// Returns the blocks of the longest stored prefix of `tokens`.
+    ///
+    /// The returned sequence shares the snapshot's blocks; writing past
+    /// `length` copies the shared last block first.
+    func lookup(_ tokens: [Int]) -> (sequence: PagedSequence, length: Int)? {
+        var node = root
+        var depth = 0
+        var ancestor: (node: Node, depth: Int)?
+        var subtree: Node?
+
+        while depth < tokens.count {
+            guard let child = node.children[tokens[depth]] else { break }
+
+            let common = commonPrefixLength(child.edge, tokens[depth...])
+            depth += common
+            if common < child.edge.count {
+                subtree = child
+                break
+            }
+
+            node = child
+            if node.snapshot != nil {
+                ancestor = (node, depth)
+            }
+        }
+        guard depth > 0 else { return nil }
+
+        // Any snapshot below the match point shares all `depth` matched tokens
+        let subtreeRoot = subtree ?? node
+        let source: Node
+        var length: Int
+        if let best = mostRecent(in: subtreeRoot) {
+            source = best
+            length = depth
+        } else if let ancestor {
+            source = ancestor.node
+            length = ancestor.depth
+        } else {
+            return nil
+        }
+
+        length = min(length, tokens.count - 1)
+        guard length > 0, let snapshot = source.snapshot else { return nil }
+
+        clock += 1
+        snapshot.lastUsed = clock
+
+        return (snapshot.sequence.fork(length: length), length)
+    }
+
+    /// Stores the KV state of a processed token sequence.
+    ///
+    /// Ignored unless every layer is a `StandardKVCache` holding exactly
+    /// `tokens.count` tokens. Snapshots of shorter prefixes of `tokens` are
+    /// dropped since the new snapshot serves them too.
+    ///
+    /// - Parameters:
+    ///   - tokens: Token sequence the caches were filled with
+    ///   - cache: One cache per layer
+    public func insert(_ tokens: [Int], cache: [KVCacheProtocol]) {
+        guard !tokens.isEmpty, !cache.isEmpty else { return }
+
+        var layers: [(MLXArray, MLXArray)] = []
+        for layer in cache {
+            guard layer is StandardKVCache, layer.offset == tokens.count, let state = layer.state else { return }
+            layers.append(state)
+        }
+        insert(tokens, layers: layers)
+    }
+
+    /// Copies per-layer keys and values of shape [1, H, tokens.count, D] into
+    /// the pool and stores them.
+    func insert(_ tokens: [Int], layers: [(MLXArray, MLXArray)]) {
+        guard layers.count == pool.numLayers,
+              pool.blocksNeeded(for: tokens.count) * max(pool.blockBytes, 1) <= maxBytes
+        else { return }
+
+        let sequence = PagedSequence(pool: pool)
+        guard sequence.reserve(0 ..< tokens.count) else { return }
+        for (layer, (keys, values)) in layers.enumerated() {
+            sequence.write(layer: layer, keys: keys, values: values)
+        }
+
+        // Drop the graph that references the source buffers
+        eval((0 ..< pool.numLayers).flatMap { pool.arrays(layer: $0) })
+        insert(tokens, sequence: sequence)
+    }
+
+    /// Stores the first `tokens.count` positions of a sequence in the pool.
+    ///
+    /// The snapshot shares the sequence's blocks instead of copying them.
+    func insert(_ tokens: [Int], sequence: PagedSequence) {
+        guard !tokens.isEmpty, sequence.pool === pool else { return }
+        let snapshotSequence = sequence.fork(length: tokens.count)
+        let bytes = snapshotSequence.blocks.count * pool.blockBytes
+        guard bytes <= maxBytes else { return }
+
+        let node = findOrCreateNode(tokens)
+
+        // Shorter snapshots on the path are covered by this one
+        var parent = node.parent
+        while let current = parent {
+            if current.snapshot != nil {
+                removeSnapshot(current)
+            }
+            parent = current.parent
+        }
+
+        if let replaced = node.snapshot {
+            totalBytes -= replaced.bytes
+        }
+
+        clock += 1
+        node.snapshot = Snapshot(sequence: snapshotSequence, bytes: bytes, lastUsed: clock)
+        entries[ObjectIdentifier(node)] = node
+        totalBytes += bytes
+
+        evict()
+    }
+
+    /// Removes all snapshots.
+    public func removeAll() {
+        root.children.removeAll()
+        entries.removeAll()
+        totalBytes = 0
+    }
+
+    // MARK: - Private
+
+    private func findOrCreateNode(_ tokens: [Int]) -> Node {
+        var node = root
+        var depth = 0
+
+        while depth < tokens.count {
+            guard let child = node.children[tokens[depth]] else {
+                let leaf = Node(edge: Array(tokens[depth...]))
+                node.addChild(leaf)
+                return leaf
+            }
+
+            let common = commonPrefixLength(child.edge, tokens[depth...])
+            if common < child.edge.count {
+                // Split the edge at the divergence point
+                let middle = Node(edge: Array(child.edge[..<common]))
+                node.addChild(middle)
+                child.edge = Array(child.edge[common...])
+                middle.addChild(child)
+                node = middle
+            } else {
+                node = child
+            }
+            depth += common
+        }
+        return node
+    }
+
+    private func mostRecent(in node: Node) -> Node? {
+        var best = node.snapshot != nil ? node : nil
+        for child in node.children.values {
+            if let candidate = mostRecent(in: child),
+               best == nil || candidate.snapshot!.lastUsed > best!.snapshot!.lastUsed
+            {
+                best = candidate
+            }
+        }
+        return best
+    }
+
+    private func leastRecentlyUsed() -> Node? {
+        entries.values.min(by: { $0.snapshot!.lastUsed < $1.snapshot!.lastUsed })
+    }
+
+    private func evict() {
+        while totalBytes > maxBytes {
+            guard let oldest = leastRecentlyUsed() else { return }
+            removeSnapshot(oldest)
+        }
+    }
+
+    private func removeSnapshot(_ node: Node) {
+        guard let snapshot = node.snapshot else { return }
+        node.snapshot = nil
+        entries.removeValue(forKey: ObjectIdentifier(node))
+        totalBytes -= snapshot.bytes
+        prune(node)
+    }
+
+    /// Removes empty leaves and merges pass-through nodes into their child.
+    private func prune(_ node: Node) {
+        var current = node
+        while current !== root, current.snapshot == nil, let parent = current.parent {
+            if current.children.isEmpty {
+                parent.children.removeValue(forKey: current.edge[0])
+                current = parent
+            } else if current.children.count == 1, let child = current.children.values.first {
+                child.edge = current.edge + child.edge
+                parent.addChild(child)
+                return
+            } else {
+                return
+            }
+        }
+    }
+}
+
+// MARK: - Tree Storage
+
+private final class Snapshot {
+    let sequence: PagedSequence
+    let bytes: Int
+    var lastUsed: UInt64
+
+    init(sequence: PagedSequence, bytes: Int, lastUsed: UInt64) {
+        self.sequence = sequence
+        self.bytes = bytes
+        self.lastUsed = lastUsed
+    }
+}
+
+private final class Node {
+    /// Tokens on the edge from the parent to this node.
+    var edge: [Int]
+    var children: [Int: Node] = [:]
+    weak var parent: Node?
+    var snapshot: Snapshot?
+
+    init(edge: [Int]) {
+        self.edge = edge
+    }
+
+    /// Attaches a child, replacing any child that starts with the same token.
+    func addChild(_ child: Node) {
+        child.parent = self
+        children[child.edge[0]] = child
+    }
+}
+
+private func commonPrefixLength(_ a: [Int], _ b: ArraySlice<Int>) -> Int {
+    var count = 0
+    for (x, y) in zip(a, b) {
+        guard x == y else { break }
+        count += 1
+    }
+    return count
+}
@@ -0,0 +1,92 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Memory accounting for loaded models: a global budget and least recently
+// used eviction.
+
+import Foundation
+
+// MARK: - Residency Manager
+
+/// Tracks the memory of loaded models against a budget.
+///
+/// Each model is registered with its footprint and marked as used whenever
+/// it serves a request. Before a new model is loaded, `victims(toFit:pinned:)`
+/// names the least recently used models whose eviction makes room for it.
+/// The manager only does the bookkeeping; the owner unloads the models.
+///
+/// Not thread-safe: all calls must come from the same thread (or actor).
+public struct ResidencyManager {
+    private struct Entry {
+        var bytes: Int
+        var lastUsed: Int
+    }
+
+    /// Maximum bytes all models may take together (nil = unlimited).
+    public var budget: Int?
+
+    private var entries: [Int: Entry] = [:]
+    private var clock = 0
+
+    public init(budget: Int? = nil) {
+        self.budget = budget
+    }
+
+    /// Bytes taken by all registered models.
+    public var residentBytes: Int {
+        entries.values.reduce(0) { $0 + $1.bytes }
+    }
+
+    /// Registered model IDs, least recently used first.
+    public var modelIds: [Int] {
+        entries.sorted { $0.value.lastUsed < $1.value.lastUsed }.map(\.key)
+    }
+
+    /// Registers a model, or updates its footprint, and marks it as used.
+    public mutating func insert(_ id: Int, bytes: Int) {
+        clock += 1
+        entries[id] = Entry(bytes: bytes, lastUsed: clock)
+    }
+
+    /// Bytes registered for a model (0 if unknown).
+    public func footprint(of id: Int) -> Int {
+        entries[id]?.bytes ?? 0
+    }
+
+    /// Updates the footprint of a registered model without marking it as used.
+    public mutating func resize(_ id: Int, bytes: Int) {
+        entries[id]?.bytes = bytes
+    }
+
+    /// Marks a model as used.
+    public mutating func touch(_ id: Int) {
+        guard entries[id] != nil else { return }
+        clock += 1
+        entries[id]?.lastUsed = clock
+    }
+
+    /// Forgets a model.
+    public mutating func remove(_ id: Int) {
+        entries.removeValue(forKey: id)
+    }
+
+    /// Picks models to evict so that `bytes` more fit into the budget.
+    ///
+    /// - Parameters:
+    ///   - bytes: Footprint of the model about to be loaded
+    ///   - pinned: Models that must stay loaded (e.g. serving requests)
+    /// - Returns: Models to evict, least recently used first (empty if it fits
+    ///   already), or nil if it does not fit even after evicting every
+    ///   unpinned model
+    public func victims(toFit bytes: Int, pinned: Set<Int> = []) -> [Int]? {
+        guard let budget else { return [] }
+
+        var excess = residentBytes + bytes - budget
+        var victims: [Int] = []
+        for id in modelIds where excess > 0 && !pinned.contains(id) {
+            victims.append(id)
+            excess -= entries[id]!.bytes
+        }
+        return excess > 0 ? nil : victims
+    }
+}
@@ -0,0 +1,166 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Streaming safetensors reader: parses the header directly and copies
+// tensors out of a memory-mapped file.
+
+import Foundation
+import MLX
+
+// MARK: - Safetensors File
+
+/// A memory-mapped safetensors file.
+///
+/// Only the JSON header is parsed when the file is opened. The tensor data is
+/// mapped rather than read, so each tensor's pages are faulted in when it is
+/// loaded and handed back to the OS together with the mapping once the file
+/// is released.
+///
+/// Immutable after opening, so tensors can be loaded from several threads.
+///
+/// Format: an 8-byte little-endian header length, a JSON header mapping
+/// tensor names to `dtype`, `shape` and `data_offsets` (relative to the end
+/// of the header), then the raw tensor data.
+public final class SafetensorsFile: @unchecked Sendable {
+    /// A tensor described by the header.
+    public struct Entry {
+        public let dtype: DType
+        public let shape: [Int]
+
+        /// Byte range within the data section.
+        public let range: Range<Int>
+    }
+
+    /// Tensors in the file, by name.
+    public let entries: [String: Entry]
+
+    /// String metadata from the header's `__metadata__` entry.
+    public let metadata: [String: String]
+
+    private let data: Data
+    private let dataStart: Int
+
+    /// Maps a file and parses its header.
+    ///
+    /// - Parameter url: Path to a `.safetensors` file
+    /// - Throws: `LLMEngineError.invalidWeights` if the header is malformed
+    public init(url: URL) throws {
+        data = try Data(contentsOf: url, options: .alwaysMapped)
+        let file = url.lastPathComponent
+
+        guard data.count >= 8 else {
+            throw LLMEngineError.invalidWeights("\(file): file too short")
+        }
+        let headerLength = data.prefix(8).enumerated().reduce(0) { $0 | Int($1.element) << (8 * $1.offset) }
+        guard headerLength > 0, headerLength <= data.count - 8,
+              let header = try? JSONSerialization.jsonObject(with: data[8 ..< 8 + headerLength]) as? [String: Any]
+        else {
+            throw LLMEngineError.invalidWeights("\(file): invalid header")
+        }
+        dataStart = 8 + headerLength
+
+        var entries: [String: Entry] = [:]
+        for (name, value) in header where name != "__metadata__" {
+            guard let info = value as? [String: Any],
+                  let dtypeName = info["dtype"] as? String,
+                  let shape = info["shape"] as? [Int],
+                  let offsets = info["data_offsets"] as? [Int], offsets.count == 2
+            else {
+                throw LLMEngineError.invalidWeights("\(file): invalid entry for \(name)")
+            }
+            guard let dtype = Self.dtype(dtypeName) else {
+                throw LLMEngineError.invalidWeights("\(file): unsupported dtype \(dtypeName) for \(name)")
+            }
+            // Checked before building the range, which traps on reversed bounds
+            guard offsets[0] >= 0, offsets[0] <= offsets[1], offsets[1] <= data.count - dataStart,
+                  offsets[1] - offsets[0] == Self.byteCount(shape: shape, size: dtype.size)
+            else {
+                throw LLMEngineError.invalidWeights("\(file): data of \(name) out of bounds")
+            }
+            entries[name] = Entry(dtype: dtype, shape: shape, range: offsets[0] ..< offsets[1])
+        }
+        self.entries = entries
+        metadata = header["__metadata__"] as? [String: String] ?? [:]
+    }
+
+    /// Copies a tensor out of the mapping into a new array.
+    ///
+    /// Only the tensor's own pages are touched, so loading tensors one by
+    /// one keeps the resident part of the mapping small.
+    public func load(_ name: String) -> MLXArray? {
+        guard let entry = entries[name] else { return nil }
+        guard !entry.range.isEmpty else {
+            return MLXArray.zeros(entry.shape, dtype: entry.dtype)
+        }
+
+        return data.withUnsafeBytes { raw in
+            let start = raw.baseAddress! + dataStart + entry.range.lowerBound
+            let view = Data(
+                bytesNoCopy: UnsafeMutableRawPointer(mutating: start),
+                count: entry.range.count,
+                deallocator: .none
+            )
+            return MLXArray(view, entry.shape, dtype: entry.dtype)
+        }
+    }
+
+    /// Loads all tensors of the file.
+    ///
+    /// Up to `maxConcurrency` tensors are copied at once, so reading from a
+    /// fast disk is not limited by the speed of a single core.
+    ///
+    /// - Parameter maxConcurrency: Maximum number of tensors copied in parallel
+    /// - Returns: All tensors, by name
+    public func loadAll(
+        maxConcurrency: Int = ProcessInfo.processInfo.activeProcessorCount
+    ) async -> [String: MLXArray] {
+        // Largest first, so the last tensors do not leave most workers idle
+        var pending = entries.sorted { $0.value.range.count > $1.value.range.count }.map(\.key)[...]
+
+        return await withTaskGroup(of: (String, MLXArray?).self) { group in
+            for _ in 0 ..< max(maxConcurrency, 1) {
+                guard let name = pending.popFirst() else { break }
+                group.addTask { (name, self.load(name)) }
+            }
+
+            var arrays: [String: MLXArray] = [:]
+            for await (name, array) in group {
+                arrays[name] = array
+                if let next = pending.popFirst() {
+                    group.addTask { (next, self.load(next)) }
+                }
+            }
+            return arrays
+        }
+    }
+
+    // MARK: - Private
+
+    /// Bytes of a tensor, or nil for negative dimensions or on overflow.
+    private static func byteCount(shape: [Int], size: Int) -> Int? {
+        shape.reduce(Optional(size)) { count, dimension in
+            guard let count, dimension >= 0 else { return nil }
+            let (product, overflow) = count.multipliedReportingOverflow(by: dimension)
+            return overflow ? nil : product
+        }
+    }
+
+    private static func dtype(_ name: String) -> DType? {
+        switch name {
+        case "BOOL": .bool
+        case "U8": .uint8
+        case "U16": .uint16
+        case "U32": .uint32
+        case "U64": .uint64
+        case "I8": .int8
+        case "I16": .int16
+        case "I32": .int32
+        case "I64": .int64
+        case "F16": .float16
+        case "BF16": .bfloat16
+        case "F32": .float32
+        case "F64": .float64
+        default: nil
+        }
+    }
+}
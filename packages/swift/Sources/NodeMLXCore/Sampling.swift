@@ -0,0 +1,112 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Fused token sampling: temperature, top-k, top-p and min-p in one compiled
+// pass over sorted candidates.
+
+import Foundation
+import MLX
+
+// MARK: - Fused Sampling
+
+/// Samples one token per row, honoring each row's temperature, top-k, top-p
+/// and min-p, without waiting for the result.
+///
+/// `SamplingUtils.applyTopP` sorts the whole vocabulary, masks it and sorts
+/// again to restore the original order, which costs several full-vocabulary
+/// passes per token. Here the candidates are sorted once: with top-k only
+/// the k best logits (found by partition) are sorted, otherwise the whole
+/// vocabulary. All filters then run in a single compiled function over the
+/// sorted candidates, and the sampled position is mapped back to its token
+/// ID with one gather instead of unsorting the logits.
+///
+/// - Parameters:
+///   - logits: Logits of the last position, shape [batch, vocab_size]
+///   - configs: Generation configuration per row
+/// - Returns: Sampled token IDs, shape [batch]
+public func sample(logits: MLXArray, configs: [GenerationConfig]) -> MLXArray {
+    let greedy = argMax(logits, axis: -1)
+
+    let temperatures = configs.map(\.temperature)
+    if temperatures.allSatisfy({ $0 == 0 }) {
+        return greedy
+    }
+
+    let batchSize = configs.count
+    let vocabularySize = logits.dim(-1)
+    let safeTemperatures = temperatures.map { $0 == 0 ? Float(1) : $0 }
+    let scaled = logits.asType(.float32) / MLXArray(safeTemperatures).reshaped([batchSize, 1])
+
+    let topKs = configs.map { $0.topK > 0 ? min($0.topK, vocabularySize) : vocabularySize }
+    let isFiltered = topKs.contains { $0 < vocabularySize } || configs.contains { $0.topP < 1 || $0.minP > 0 }
+
+    var sampled: MLXArray
+    if isFiltered {
+        // Only the candidates of the widest top-k can be sampled
+        let candidateCount = topKs.max() ?? vocabularySize
+        var candidates: MLXArray?
+        var candidateLogits = scaled
+        if candidateCount < vocabularySize {
+            candidates = argPartition(-scaled, kth: candidateCount - 1, axis: -1)[0..., ..<candidateCount]
+            candidateLogits = takeAlong(scaled, candidates!, axis: -1)
+        }
+
+        let order = argSort(-candidateLogits, axis: -1)
+        let sortedLogits = takeAlong(candidateLogits, order, axis: -1)
+        let sortedTokens = candidates.map { takeAlong($0, order, axis: -1) } ?? order
+
+        let position = sampleSortedCandidates([
+            sortedLogits,
+            MLXArray(topKs.map { Int32($0) }).reshaped([batchSize, 1]),
+            MLXArray(configs.map { $0.topP < 1 ? $0.topP : Float.infinity }).reshaped([batchSize, 1]),
+            MLXArray(configs.map { $0.minP > 0 ? log($0.minP) : -Float.infinity }).reshaped([batchSize, 1]),
+        ])[0]
+        sampled = takeAlong(sortedTokens, position.reshaped([batchSize, 1]), axis: -1).squeezed(axis: -1)
+    } else {
+        sampled = categorical(scaled, axis: -1)
+    }
+
+    if temperatures.contains(0) {
+        sampled = which(MLXArray(temperatures.map { $0 == 0 }), greedy, sampled)
+    }
+    return sampled
+}
+
+/// Samples one token per row, honoring each row's sampling settings.
+///
+/// Synchronizes with the device once for the whole batch.
+///
+/// - Parameters:
+///   - logits: Logits of the last position, shape [batch, vocab_size]
+///   - configs: Generation configuration per row
+/// - Returns: Sampled token ID per row
+func sampleTokens(logits: MLXArray, configs: [GenerationConfig]) -> [Int] {
+    sample(logits: logits, configs: configs).asArray(Int32.self).map { Int($0) }
+}
+
+/// Masks sorted candidate logits and samples a position per row.
+///
+/// Arguments: logits sorted descending [batch, candidates], then per row
+/// (shape [batch, 1]) the top-k count, the top-p threshold (infinity when
+/// disabled) and the log of min-p (-infinity when disabled). Filters apply
+/// in the order top-k, top-p, min-p; the best candidate is always kept.
+/// Compiled with the random state so the whole step fuses into one graph.
+private let sampleSortedCandidates = compile(
+    inputs: [MLXRandom.globalState], outputs: [MLXRandom.globalState]
+) { (arguments: [MLXArray]) -> [MLXArray] in
+    let (logits, topK, topP, logMinP) = (arguments[0], arguments[1], arguments[2], arguments[3])
+    let negativeInfinity = MLXArray(-Float.infinity)
+
+    let positions = MLXArray(0 ..< Int32(logits.dim(-1)))
+    let topKLogits = which(positions .< topK, logits, negativeInfinity)
+
+    // Probability mass ranked above each candidate, within the top k
+    let probs = softmax(topKLogits, axis: -1)
+    let massAbove = cumsum(probs, axis: -1) - probs
+
+    // Min-p compares against the best candidate: p / p_max < min_p in log space
+    let belowMinP = (logits - logits[0..., ..<1]) .< logMinP
+
+    let filtered = which(logicalOr(massAbove .> topP, belowMinP), negativeInfinity, topKLogits)
+    return [categorical(filtered, axis: -1)]
+}
@@ -0,0 +1,300 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Log-probabilities of continuations given prompts, for reranking and evals.
+
+import Foundation
+import MLX
+
+// MARK: - Scoring Configuration
+
+/// Configuration for `score(model:requests:config:prefixCache:)`.
+public struct ScoringConfig: Sendable {
+    /// Upper bound on tokens per forward pass, counting every row's prompt
+    /// and padded continuation. Bounds both the copied KV state and the logits.
+    public var maxBatchTokens: Int
+
+    /// Maximum prompt tokens per forward pass
+    public var prefillStepSize: Int
+
+    public init(maxBatchTokens: Int = 4096, prefillStepSize: Int = 2048) {
+        self.maxBatchTokens = maxBatchTokens
+        self.prefillStepSize = prefillStepSize
+    }
+}
+
+/// A continuation whose tokens are scored after a prompt.
+public struct ScoringRequest: Hashable, Sendable {
+    /// Context tokens (not scored, at least one)
+    public var prompt: [Int]
+
+    /// Tokens to score (at least one)
+    public var continuation: [Int]
+
+    public init(prompt: [Int], continuation: [Int]) {
+        self.prompt = prompt
+        self.continuation = continuation
+    }
+}
+
+// MARK: - Scoring
+
+/// Computes the log-probability of every continuation token given the
+/// prompt and the continuation tokens before it.
+///
+/// Requests with the same prompt share one prefill: the prompt runs once
+/// (reusing and updating `prefixCache`), its last logits score the first
+/// token of every continuation, and the remaining tokens run in right-padded
+/// batches that each start from a copy of the prompt's KV cache. A
+/// classification over single-token labels therefore costs one prefill.
+///
+/// Prompts that fit into one prefill step are prefilled together in
+/// right-padded batches, so many short prompts cost few forward passes.
+/// A prompt runs alone when at least half of it is in `prefixCache` or
+/// when it needs several prefill steps.
+///
+/// Models with other caches than `StandardKVCache` (sliding window) run
+/// prompt and continuation together in right-padded batches instead. Causal
+/// attention keeps real tokens from attending to the padding after them,
+/// so padding never changes a score.
+///
+/// - Parameters:
+///   - model: The model
+///   - requests: Prompt and continuation token IDs
+///   - config: Batch limits
+///   - prefixCache: Cache of prompt prefixes to reuse and extend
+/// - Returns: Natural-log probabilities of each request's continuation tokens, in input order
+/// - Throws: `LLMEngineError.invalidConfig` for empty input or a request with an empty prompt or continuation
+public func score(
+    model: any LLMModel,
+    requests: [ScoringRequest],
+    config: ScoringConfig = ScoringConfig(),
+    prefixCache: PrefixCache? = nil
+) throws -> [[Float]] {
+    guard !requests.isEmpty else {
+        throw LLMEngineError.invalidConfig("nothing to score")
+    }
+    if let empty = requests.firstIndex(where: { $0.prompt.isEmpty || $0.continuation.isEmpty }) {
+        throw LLMEngineError.invalidConfig("request \(empty) has no prompt or continuation tokens")
+    }
+    guard PrefixCache.supports(model) else {
+        return scoreWithPrompt(model: model, requests: requests, config: config)
+    }
+
+    // Group by prompt, in order of first appearance
+    var groups: [[Int]: [Int]] = [:]
+    var prompts: [[Int]] = []
+    for (index, request) in requests.enumerated() {
+        if groups[request.prompt] == nil {
+            prompts.append(request.prompt)
+        }
+        groups[request.prompt, default: []].append(index)
+    }
+
+    var results = [[Float]](repeating: [], count: requests.count)
+    func scoreGroup(_ prompt: PromptState) {
+        let indices = groups[prompt.tokens]!
+        let continuations = indices.map { requests[$0].continuation }
+        let scores = scoreAfterPrompt(model: model, prompt: prompt, continuations: continuations, config: config)
+        for (index, logprobs) in zip(indices, scores) {
+            results[index] = logprobs
+        }
+    }
+
+    // Prompts the prefix cache barely covers are cheaper to prefill together from scratch
+    var batched: [[Int]] = []
+    for prompt in prompts {
+        let cachedLength = prefixCache?.lookup(prompt)?.length ?? 0
+        if prompt.count <= config.prefillStepSize, cachedLength * 2 < prompt.count {
+            batched.append(prompt)
+        } else {
+            scoreGroup(prefillPrompt(model: model, prompt: prompt, config: config, prefixCache: prefixCache))
+        }
+    }
+
+    let lengths = batched.map(\.count)
+    for batch in scoringBatches(lengths: lengths, promptLength: 0, maxBatchTokens: config.maxBatchTokens) {
+        let states = prefillPrompts(model: model, prompts: batch.map { batched[$0] }, prefixCache: prefixCache)
+        for state in states {
+            scoreGroup(state)
+        }
+    }
+    return results
+}
+
+/// A prefilled prompt: its KV cache and the logits after its last token.
+private struct PromptState {
+    let tokens: [Int]
+
+    /// Keys and values per layer, shape [1, H, tokens.count, D]
+    let layers: [(keys: MLXArray, values: MLXArray)]
+
+    /// Float32 logits predicting the first continuation token, shape [1, vocab_size]
+    let last: MLXArray
+}
+
+/// Prefills one prompt, starting from its longest prefix in `prefixCache`.
+private func prefillPrompt(
+    model: any LLMModel,
+    prompt: [Int],
+    config: ScoringConfig,
+    prefixCache: PrefixCache?
+) -> PromptState {
+    let hit = prefixCache?.fetch(prompt)
+    var cache: [KVCacheProtocol]? = hit?.cache ?? model.newCache()
+    let logits = prefill(
+        model: model,
+        inputIds: prompt[(hit?.length ?? 0)...],
+        cache: &cache,
+        stepSize: config.prefillStepSize
+    )!
+    let promptCache = cache ?? []
+    let state = PromptState(
+        tokens: prompt,
+        layers: promptCache.compactMap(\.state),
+        last: logits[0..., -1, 0...].asType(.float32)
+    )
+    eval([state.last] + state.layers.flatMap { [$0.keys, $0.values] })
+    prefixCache?.insert(prompt, cache: promptCache)
+    return state
+}
+
+/// Prefills prompts together in one right-padded forward pass and stores
+/// each in `prefixCache`.
+private func prefillPrompts(model: any LLMModel, prompts: [[Int]], prefixCache: PrefixCache?) -> [PromptState] {
+    var cache: [KVCacheProtocol]? = model.newCache()
+    let width = prompts.map(\.count).max() ?? 0
+    let logits = model(paddedTokens(prompts.map { $0[...] }, width: width), cache: &cache)
+    let layers = (cache ?? []).compactMap(\.state)
+
+    // Each row's padding comes after its prompt, so its first columns hold the prompt alone
+    let states = prompts.enumerated().map { row, prompt in
+        PromptState(
+            tokens: prompt,
+            layers: layers.map { keys, values in
+                (
+                    keys: keys[row ..< row + 1, 0..., ..<prompt.count, 0...],
+                    values: values[row ..< row + 1, 0..., ..<prompt.count, 0...]
+                )
+            },
+            last: logits[row ..< row + 1, prompt.count - 1, 0...].asType(.float32)
+        )
+    }
+    eval(states.flatMap { state in [state.last] + state.layers.flatMap { [$0.keys, $0.values] } })
+    for state in states {
+        prefixCache?.insert(state.tokens, layers: state.layers.map { ($0.keys, $0.values) })
+    }
+    return states
+}
+
+/// Scores continuations from copies of the prompt's KV cache.
+private func scoreAfterPrompt(
+    model: any LLMModel,
+    prompt: PromptState,
+    continuations: [[Int]],
+    config: ScoringConfig
+) -> [[Float]] {
+    // The last prompt position predicts the first token of every continuation
+    let firstTokens = MLXArray(continuations.map { Int32($0[0]) })
+    let first = take(prompt.last, firstTokens, axis: -1) - logSumExp(prompt.last, axis: -1, keepDims: true)
+
+    var results = first.asArray(Float.self).map { [$0] }
+    let promptLength = prompt.tokens.count
+    let tails = continuations.map { $0.count - 1 }
+
+    // Single-token continuations are done; the rest run from copies of the prompt's cache
+    for batch in scoringBatches(lengths: tails, promptLength: promptLength, maxBatchTokens: config.maxBatchTokens) {
+        let width = tails[batch[0]]
+        var rowCache: [KVCacheProtocol]? = prompt.layers.map { keys, values in
+            let layer = StandardKVCache()
+            layer.reserve(promptLength + width)
+            _ = layer.update(
+                keys: broadcast(keys, to: [batch.count] + keys.shape.dropFirst()),
+                values: broadcast(values, to: [batch.count] + values.shape.dropFirst())
+            )
+            return layer
+        }
+        let inputs = paddedTokens(batch.map { continuations[$0].dropLast() }, width: width)
+        let targets = paddedTokens(batch.map { continuations[$0].dropFirst() }, width: width)
+
+        let values = tokenLogprobs(model(inputs, cache: &rowCache), targets: targets).asArray(Float.self)
+        for (row, index) in batch.enumerated() {
+            results[index] += values[(row * width) ..< (row * width + tails[index])]
+        }
+    }
+    return results
+}
+
+/// Scores requests by running each prompt and continuation together, with
+/// rows of different prompts in the same batch.
+private func scoreWithPrompt(model: any LLMModel, requests: [ScoringRequest], config: ScoringConfig) -> [[Float]] {
+    var results = [[Float]](repeating: [], count: requests.count)
+
+    // The last continuation token is only a target, never an input
+    let lengths = requests.map { $0.prompt.count + $0.continuation.count - 1 }
+
+    for batch in scoringBatches(lengths: lengths, promptLength: 0, maxBatchTokens: config.maxBatchTokens) {
+        let width = lengths[batch[0]]
+        let inputs = paddedTokens(
+            batch.map { requests[$0].prompt[...] + requests[$0].continuation.dropLast() },
+            width: width
+        )
+        let targets = paddedTokens(
+            batch.map { requests[$0].prompt.dropFirst() + requests[$0].continuation[...] },
+            width: width
+        )
+
+        var cache: [KVCacheProtocol]?
+        let values = tokenLogprobs(model(inputs, cache: &cache), targets: targets).asArray(Float.self)
+
+        // Positions from the last prompt token on predict the continuation
+        for (row, index) in batch.enumerated() {
+            let start = row * width + requests[index].prompt.count - 1
+            results[index] = Array(values[start ..< start + requests[index].continuation.count])
+        }
+    }
+    return results
+}
+
+/// Splits rows into batches, longest first, so that each batch's rows of
+/// `promptLength` plus its longest length stay within `maxBatchTokens`.
+/// A row that exceeds the budget on its own runs alone; rows of length 0
+/// are left out.
+///
+/// - Returns: Indices into `lengths`, one array per batch
+func scoringBatches(lengths: [Int], promptLength: Int, maxBatchTokens: Int) -> [[Int]] {
+    let order = lengths.indices.filter { lengths[$0] > 0 }.sorted { lengths[$0] > lengths[$1] }
+
+    var batches: [[Int]] = []
+    var start = 0
+    while start < order.count {
+        let rowTokens = max(1, promptLength + lengths[order[start]])
+        let rows = max(1, min(order.count - start, maxBatchTokens / rowTokens))
+        batches.append(Array(order[start ..< start + rows]))
+        start += rows
+    }
+    return batches
+}
+
+/// Right-pads token sequences with 0 into a [rows, width] array.
+private func paddedTokens(_ rows: [ArraySlice<Int>], width: Int) -> MLXArray {
+    var ids = [Int32](repeating: 0, count: rows.count * width)
+    for (row, tokens) in rows.enumerated() {
+        for (column, token) in tokens.enumerated() {
+            ids[row * width + column] = Int32(token)
+        }
+    }
+    return MLXArray(ids).reshaped([rows.count, width])
+}
+
+/// Log-probabilities of target tokens.
+///
+/// - Parameters:
+///   - logits: Logits, shape [batch, seq, vocab_size]
+///   - targets: Token IDs, shape [batch, seq]
+/// - Returns: Float32 log-probabilities, shape [batch, seq]
+func tokenLogprobs(_ logits: MLXArray, targets: MLXArray) -> MLXArray {
+    let logits = logits.asType(.float32)
+    let selected = takeAlong(logits, targets.expandedDimensions(axis: -1), axis: -1).squeezed(axis: -1)
+    return selected - logSumExp(logits, axis: -1)
+}
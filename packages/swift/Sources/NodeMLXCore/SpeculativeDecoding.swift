@@ -0,0 +1,357 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Speculative decoding: a cheap proposer drafts tokens that the target
+// model verifies in a single forward pass.
+
+import Foundation
+import MLX
+
+// MARK: - Draft Proposer
+
+/// Proposes tokens that are likely to follow a sequence.
+///
+/// Proposals are only a guess: the target model verifies them and keeps the
+/// prefix it agrees with, so a poor proposer costs speed but does not change
+/// greedy output.
+public protocol DraftProposer: AnyObject {
+    /// Proposes up to `count` tokens that follow `context`.
+    ///
+    /// - Parameters:
+    ///   - context: Prompt and accepted tokens so far
+    ///   - count: Maximum number of tokens to propose
+    /// - Returns: Proposed token IDs (may be fewer than `count`)
+    func propose(context: [Int], count: Int) -> [Int]
+}
+
+// MARK: - Speculative Stats
+
+/// How many proposed tokens the target model accepted during one generation.
+public struct SpeculativeStats: Sendable, Equatable {
+    /// Tokens proposed for verification.
+    public var proposedTokens = 0
+
+    /// Proposed tokens the target model agreed with.
+    public var acceptedTokens = 0
+
+    /// Target forward passes (each verifies one batch of proposals).
+    public var verificationSteps = 0
+
+    /// Fraction of proposed tokens that were accepted.
+    public var acceptanceRate: Double {
+        proposedTokens > 0 ? Double(acceptedTokens) / Double(proposedTokens) : 0
+    }
+
+    /// Creates empty stats.
+    public init() {}
+}
+
+// MARK: - Draft Model
+
+/// Proposes tokens by decoding with a smaller model that shares the target's tokenizer.
+///
+/// The draft model keeps its KV cache across proposals. Positions that no
+/// longer match the context (rejected drafts) are trimmed before the next one.
+public final class DraftModelProposer: DraftProposer {
+    private let model: any LLMModel
+    private let config: GenerationConfig
+    private var cache: [KVCacheProtocol]
+    private var processed: [Int] = []
+
+    /// Creates a proposer for one generation.
+    ///
+    /// - Parameters:
+    ///   - model: Draft model
+    ///   - config: Target generation config (temperature and prefill step size are used)
+    public init(model: any LLMModel, config: GenerationConfig = GenerationConfig()) {
+        self.model = model
+        self.config = config
+        cache = model.newCache()
+    }
+
+    public func propose(context: [Int], count: Int) -> [Int] {
+        guard count > 0, !context.isEmpty else { return [] }
+        syncCache(to: context)
+
+        var layerCaches: [KVCacheProtocol]? = cache
+        guard var logits = prefill(
+            model: model,
+            inputIds: context[processed.count...],
+            cache: &layerCaches,
+            stepSize: config.prefillStepSize
+        ) else { return [] }
+        processed = context
+
+        // Each draft token feeds the next step without a device round trip
+        var drafts: [MLXArray] = []
+        for i in 0 ..< count {
+            let token = sample(logits[0..., -1, 0...])
+            asyncEval(token)
+            drafts.append(token)
+
+            guard i < count - 1 else { break }
+            logits = model(token.reshaped([1, 1]), cache: &layerCaches)
+        }
+
+        let tokens = concatenated(drafts).asArray(Int32.self).map { Int($0) }
+        // The last draft has not been fed to the draft model
+        processed += tokens.dropLast()
+        return tokens
+    }
+
+    // MARK: - Private
+
+    /// Drops cached positions that diverge from `context`, leaving at least one token to process.
+    private func syncCache(to context: [Int]) {
+        let common = min(zip(processed, context).prefix(while: { $0.0 == $0.1 }).count, context.count - 1)
+        let excess = processed.count - common
+        guard excess > 0 else { return }
+
+        if canTrimPromptCache(cache), trimPromptCache(cache, numTokens: excess) == excess {
+            processed.removeLast(excess)
+        } else {
+            cache = model.newCache()
+            processed = []
+        }
+    }
+
+    private func sample(_ logits: MLXArray) -> MLXArray {
+        if config.temperature == 0 {
+            return argMax(logits, axis: -1)
+        }
+        return categorical(logits / config.temperature, axis: -1)
+    }
+}
+
+// MARK: - Prompt Lookup
+
+/// Proposes tokens by copying what followed the last n-gram earlier in the context.
+///
+/// Needs no draft model and works well when the output repeats spans of the
+/// prompt, as in code editing, extraction or summarization with quotes.
+/// The most recent earlier occurrence of the context's last `ngramSize`
+/// tokens wins. An index of n-gram positions is extended as the context grows.
+public final class PromptLookupProposer: DraftProposer {
+    /// Length of the n-gram matched against the context.
+    public let ngramSize: Int
+
+    private var indexed: [Int] = []
+    private var lastEnd: [[Int]: Int] = [:]
+
+    /// Creates a proposer matching n-grams of the given length.
+    public init(ngramSize: Int = 3) {
+        self.ngramSize = max(ngramSize, 1)
+    }
+
+    public func propose(context: [Int], count: Int) -> [Int] {
+        guard count > 0, context.count > ngramSize else { return [] }
+        updateIndex(context)
+
+        let suffix = Array(context[(context.count - ngramSize)...])
+        guard let end = lastEnd[suffix] else { return [] }
+        return Array(context[end ..< min(end + count, context.count)])
+    }
+
+    // MARK: - Private
+
+    /// Indexes every n-gram that is followed by at least one token.
+    private func updateIndex(_ context: [Int]) {
+        // Contexts normally only grow; anything else starts a fresh index
+        if indexed.count >= context.count || !context.starts(with: indexed) {
+            indexed = []
+            lastEnd = [:]
+        }
+
+        // N-grams ending at or before indexed.count are already in the index
+        for end in stride(from: max(indexed.count + 1, ngramSize), to: context.count, by: 1) {
+            lastEnd[Array(context[(end - ngramSize) ..< end])] = end
+        }
+        indexed += context[indexed.count ..< (context.count - 1)]
+    }
+}
+
+// MARK: - Speculative Generation
+
+/// Whether a model's cache can be rolled back as speculative decoding requires.
+///
+/// Sliding-window caches stop being trimmable once they wrap, so they are excluded.
+public func supportsSpeculativeDecoding(_ model: any LLMModel) -> Bool {
+    let cache = model.newCache()
+    return !cache.isEmpty && cache.allSatisfy { !($0 is RotatingKVCache) && $0.isTrimmable }
+}
+
+/// Generates text, verifying proposed tokens in batches.
+///
+/// Each step runs the target model once on the pending token plus up to
+/// `config.numDraftTokens` proposed tokens. The proposals it agrees with are
+/// accepted together with the target's own next token; the KV cache positions
+/// of rejected proposals are trimmed. With temperature 0 the output matches
+/// `generate`; with sampling, a proposal is accepted when the target samples
+/// the same token.
+///
+/// Falls back to `generate` for models that do not `supportsSpeculativeDecoding`.
+///
+/// - Parameters:
+///   - model: Target model
+///   - proposer: Source of draft tokens
+///   - inputIds: Initial token IDs
+///   - config: Generation configuration
+///   - promptCache: Per-layer caches as in `generate`
+///   - onToken: Callback for each generated token (return false to stop)
+/// - Returns: Generated token IDs (excluding input), the finish reason and acceptance stats
+public func speculativeGenerate(
+    model: any LLMModel,
+    proposer: DraftProposer,
+    inputIds: [Int],
+    config: GenerationConfig = GenerationConfig(),
+    promptCache: [KVCacheProtocol]? = nil,
+    onToken: ((Int) -> Bool)? = nil
+) -> GenerationOutput {
+    guard supportsSpeculativeDecoding(model) else {
+        return generate(model: model, inputIds: inputIds, config: config, promptCache: promptCache, onToken: onToken)
+    }
+
+    let startTime = CFAbsoluteTimeGetCurrent()
+    let deadline = config.timeLimit.map { startTime + $0 }
+
+    func interruption() -> FinishReason? {
+        if config.cancellation?.isCancelled == true {
+            return .cancelled
+        }
+        if let deadline, CFAbsoluteTimeGetCurrent() >= deadline {
+            return .timeout
+        }
+        return nil
+    }
+
+    func prefillInterruption() -> FinishReason? {
+        if let maxPrefillTime = config.maxPrefillTime, CFAbsoluteTimeGetCurrent() - startTime > maxPrefillTime {
+            return .timeout
+        }
+        return interruption()
+    }
+
+    if let reason = interruption() {
+        return GenerationOutput(tokens: [], finishReason: reason)
+    }
+
+    var cache = promptCache ?? model.newCache()
+    let cachedCount = cache.first?.offset ?? 0
+    precondition(cachedCount == 0 || cachedCount < inputIds.count, "promptCache must leave a token to process")
+
+    // Prefill all but the last prompt token; it is verified with the first proposals
+    if cachedCount < inputIds.count - 1 {
+        var layerCaches: [KVCacheProtocol]? = cache
+        var stopReason: FinishReason?
+        let logits = prefill(
+            model: model,
+            inputIds: inputIds[cachedCount ..< inputIds.count - 1],
+            cache: &layerCaches,
+            stepSize: config.prefillStepSize,
+            quantizeCache: { maybeQuantizeKVCache(&$0, config: config) },
+            shouldStop: {
+                stopReason = prefillInterruption()
+                return stopReason != nil
+            }
+        )
+        guard logits != nil, let layerCaches else {
+            return GenerationOutput(tokens: [], finishReason: stopReason ?? .cancelled)
+        }
+        cache = layerCaches
+        evalCache(cache)
+    }
+
+    if let maxPrefillTime = config.maxPrefillTime, CFAbsoluteTimeGetCurrent() - startTime > maxPrefillTime {
+        return GenerationOutput(tokens: [], finishReason: .timeout)
+    }
+
+    var context = inputIds
+    var generatedTokens: [Int] = []
+    var finishReason = FinishReason.length
+    var stats = SpeculativeStats()
+
+    while generatedTokens.count < config.maxTokens {
+        if let reason = interruption() {
+            finishReason = reason
+            break
+        }
+
+        // The target's own token completes every step, so propose at most one less than remaining
+        let budget = min(config.numDraftTokens, config.maxTokens - generatedTokens.count - 1)
+        let drafts = budget > 0 ? Array(proposer.propose(context: context, count: budget).prefix(budget)) : []
+
+        // Verify the pending token and all proposals in one forward pass
+        let inputs = MLXArray(([context[context.count - 1]] + drafts).map { Int32($0) })
+            .reshaped([1, drafts.count + 1])
+        var layerCaches: [KVCacheProtocol]? = cache
+        let logits = model(inputs, cache: &layerCaches)
+        maybeQuantizeKVCache(&layerCaches, config: config)
+        cache = layerCaches ?? cache
+        let verified = sampleTokens(
+            logits: penalize(logits[0], context: context, drafts: drafts, config: config),
+            configs: Array(repeating: config, count: drafts.count + 1)
+        )
+
+        var accepted = 0
+        while accepted < drafts.count, drafts[accepted] == verified[accepted] {
+            accepted += 1
+        }
+        stats.proposedTokens += drafts.count
+        stats.acceptedTokens += accepted
+        stats.verificationSteps += 1
+
+        var emitted = 0
+        var done = false
+        for token in verified.prefix(accepted + 1) {
+            if config.stopTokens.contains(token) {
+                finishReason = .stop
+                done = true
+                break
+            }
+
+            generatedTokens.append(token)
+            context.append(token)
+            emitted += 1
+
+            if let onToken, !onToken(token) {
+                finishReason = .cancelled
+                done = true
+                break
+            }
+            if generatedTokens.count >= config.maxTokens {
+                done = true
+                break
+            }
+        }
+
+        // Keep the cache in step with the context: drop rejected proposals and
+        // anything past the last emitted token
+        trimPromptCache(cache, numTokens: drafts.count - min(accepted, emitted))
+
+        if done {
+            break
+        }
+    }
+
+    return GenerationOutput(tokens: generatedTokens, finishReason: finishReason, speculative: stats)
+}
+
+/// Applies the penalties to the logits of a verification step.
+///
+/// Row i predicts the token after `drafts[..<i]`, so its window ends with
+/// those proposals, exactly as if the tokens had been generated one by one.
+/// The context is on the host here, so the windows are built from it
+/// instead of a `PenaltyProcessor`.
+private func penalize(_ logits: MLXArray, context: [Int], drafts: [Int], config: GenerationConfig) -> MLXArray {
+    guard config.hasPenalties, config.repetitionContextSize > 0 else { return logits }
+
+    let rows = (0 ... drafts.count).map { row in
+        let window = (context + drafts.prefix(row)).suffix(config.repetitionContextSize)
+        return applyPenalties(
+            to: logits[row ..< row + 1],
+            recentTokens: MLXArray(window.map { Int32($0) }),
+            config: config
+        )
+    }
+    return concatenated(rows, axis: 0)
+}
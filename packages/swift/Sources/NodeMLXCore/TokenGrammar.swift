@@ -0,0 +1,291 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Grammars bound to a tokenizer vocabulary: per-state token masks, applied
+// as packed bitmasks on the device, and fast-forwarding of forced text.
+
+import Foundation
+import MLX
+
+// MARK: - Token Vocabulary
+
+/// The bytes every token of a vocabulary stands for, indexed for grammar walks.
+///
+/// Tokens are kept sorted by their bytes, so finding the tokens a grammar
+/// state allows walks each shared prefix once (like a trie) and skips every
+/// token below a prefix the grammar rejects.
+public final class TokenVocabulary {
+    /// Number of token IDs, i.e. the length of the model's logits.
+    public let size: Int
+
+    /// Bytes of each token; nil for special tokens, which never match a grammar.
+    let tokenBytes: [[UInt8]?]
+
+    /// Token IDs with bytes, sorted by their bytes.
+    private let sortedTokens: [Int]
+
+    /// Length of the prefix each sorted token shares with the one before.
+    private let sharedPrefixes: [Int]
+
+    /// Word and bit of each token ID in a packed mask, for unpacking on the device.
+    private let wordIndices: MLXArray
+    private let bitValues: MLXArray
+
+    /// Creates a vocabulary.
+    ///
+    /// - Parameters:
+    ///   - tokenBytes: Bytes of each token ID (nil or empty: never allowed by a grammar)
+    ///   - size: Number of token IDs, at least `tokenBytes.count` (default: `tokenBytes.count`)
+    public init(tokenBytes: [[UInt8]?], size: Int? = nil) {
+        let size = max(size ?? tokenBytes.count, tokenBytes.count)
+        self.size = size
+        self.tokenBytes = tokenBytes
+
+        sortedTokens = tokenBytes.indices
+            .filter { !(tokenBytes[$0]?.isEmpty ?? true) }
+            .sorted { tokenBytes[$0]!.lexicographicallyPrecedes(tokenBytes[$1]!) }
+        var sharedPrefixes = [Int](repeating: 0, count: sortedTokens.count)
+        for index in sortedTokens.indices.dropFirst() {
+            let previous = tokenBytes[sortedTokens[index - 1]]!
+            let current = tokenBytes[sortedTokens[index]]!
+            sharedPrefixes[index] = zip(previous, current).prefix { $0 == $1 }.count
+        }
+        self.sharedPrefixes = sharedPrefixes
+
+        wordIndices = MLXArray((0 ..< Int32(size)).map { $0 >> 5 })
+        bitValues = MLXArray((0 ..< UInt32(size)).map { UInt32(1) << ($0 & 31) })
+    }
+
+    /// Tokens whose bytes the automaton accepts from `state` (sorted by ID).
+    func allowedTokens(in automaton: ByteAutomaton, from state: Int) -> [Int] {
+        var allowed: [Int] = []
+        var states = [state]
+        // Bytes of the previous token walked; whether the walk stopped at a rejected byte
+        var walked = 0
+        var rejected = false
+
+        for (index, token) in sortedTokens.enumerated() {
+            let shared = sharedPrefixes[index]
+            // Shares the rejected prefix of the previous token
+            if rejected, shared > walked {
+                continue
+            }
+
+            let bytes = tokenBytes[token]!
+            walked = min(shared, walked)
+            states.removeSubrange((walked + 1)...)
+            rejected = false
+
+            while walked < bytes.count {
+                guard let next = automaton.next(states[walked], bytes[walked]) else {
+                    rejected = true
+                    break
+                }
+                states.append(next)
+                walked += 1
+            }
+            if !rejected {
+                allowed.append(token)
+            }
+        }
+        return allowed.sorted()
+    }
+
+    /// Packs token IDs into a bitmask: bit `id % 32` of word `id / 32`.
+    func packedMask(_ tokens: some Sequence<Int>) -> MLXArray {
+        var words = [UInt32](repeating: 0, count: (size + 31) / 32)
+        for token in tokens where token < size {
+            words[token >> 5] |= 1 << UInt32(token & 31)
+        }
+        return MLXArray(words)
+    }
+
+    /// Unpacks a bitmask into one boolean per token ID, on the device.
+    func unpack(_ mask: MLXArray) -> MLXArray {
+        bitwiseAnd(mask[wordIndices], bitValues) .!= 0
+    }
+}
+
+// MARK: - Token Grammar
+
+/// A grammar bound to a vocabulary: which tokens each state allows.
+///
+/// Masks are computed the first time a state is reached and cached, so
+/// requests with the same grammar share them. Each is stored as a packed
+/// bitmask (one bit per token) and expanded on the device when applied.
+/// Once the text matches the grammar, the stop tokens are allowed too; once
+/// nothing else is allowed, only they are. Thread-safe.
+public final class TokenGrammar {
+    /// Upper bound on the bytes fast-forwarded at once.
+    static let maxForcedBytes = 256
+
+    public let grammar: Grammar
+    public let vocabulary: TokenVocabulary
+
+    /// Tokens allowed once the text matches the grammar (usually EOS).
+    public let stopTokens: Set<Int>
+
+    private let encode: (String) -> [Int]
+    private let lock = NSLock()
+    private var masks: [Int: MLXArray?] = [:]
+    private var forced: [Int: [Int]] = [:]
+
+    /// Creates a grammar over a vocabulary.
+    ///
+    /// - Parameters:
+    ///   - grammar: The compiled grammar
+    ///   - vocabulary: Token bytes of the model's vocabulary
+    ///   - stopTokens: Tokens that end generation
+    ///   - encode: Tokenizes text without special tokens; used to fast-forward
+    ///     text the grammar forces (default: no fast-forwarding)
+    public init(
+        grammar: Grammar,
+        vocabulary: TokenVocabulary,
+        stopTokens: Set<Int>,
+        encode: @escaping (String) -> [Int] = { _ in [] }
+    ) {
+        self.grammar = grammar
+        self.vocabulary = vocabulary
+        self.stopTokens = stopTokens
+        self.encode = encode
+    }
+
+    /// Creates a processor for one request.
+    public func makeProcessor() -> GrammarProcessor {
+        GrammarProcessor(grammar: self)
+    }
+
+    /// Tokens allowed in `state` (nil: the grammar has ended), sorted by ID.
+    func allowedTokens(in state: Int?) -> [Int] {
+        guard let state else { return stopTokens.sorted() }
+
+        let automaton = grammar.automaton
+        var allowed = vocabulary.allowedTokens(in: automaton, from: state)
+        if automaton.accepting[state] {
+            allowed = Array(Set(allowed).union(stopTokens)).sorted()
+        }
+        return allowed
+    }
+
+    /// Packed mask of the tokens allowed in `state`, or nil if no token is
+    /// allowed (the logits are then left unconstrained).
+    func mask(for state: Int?) -> MLXArray? {
+        let key = state ?? -1
+
+        lock.lock()
+        if let mask = masks[key] {
+            lock.unlock()
+            return mask
+        }
+        lock.unlock()
+
+        let allowed = allowedTokens(in: state)
+        let mask = allowed.isEmpty ? nil : vocabulary.packedMask(allowed)
+
+        lock.lock()
+        masks[key] = mask
+        lock.unlock()
+        return mask
+    }
+
+    /// The state after `token`, or nil if the token leaves the grammar or ends it.
+    func advance(_ state: Int, by token: Int) -> Int? {
+        guard token < vocabulary.tokenBytes.count, let bytes = vocabulary.tokenBytes[token] else {
+            return nil
+        }
+        return grammar.automaton.walk(from: state, bytes)
+    }
+
+    /// Tokens spelling the text that must follow `state`, if the grammar
+    /// allows exactly one continuation for at least one character.
+    ///
+    /// Returns no tokens if the tokenizer does not spell the forced text
+    /// exactly (e.g. because it adds a prefix space).
+    func forcedTokens(from state: Int) -> [Int] {
+        lock.lock()
+        if let tokens = forced[state] {
+            lock.unlock()
+            return tokens
+        }
+        lock.unlock()
+
+        let automaton = grammar.automaton
+        var bytes: [UInt8] = []
+        var current = state
+        while bytes.count < Self.maxForcedBytes, let byte = automaton.forcedByte(current) {
+            bytes.append(byte)
+            current = automaton.next(current, byte)!
+        }
+
+        // End at a character boundary
+        var text = String(bytes: bytes, encoding: .utf8)
+        while text == nil, !bytes.isEmpty {
+            bytes.removeLast()
+            text = String(bytes: bytes, encoding: .utf8)
+        }
+
+        var tokens = text.map { $0.isEmpty ? [] : encode($0) } ?? []
+        let spelled = tokens.flatMap { token in
+            token < vocabulary.tokenBytes.count ? vocabulary.tokenBytes[token] ?? [] : []
+        }
+        if spelled != bytes {
+            tokens = []
+        }
+
+        lock.lock()
+        forced[state] = tokens
+        lock.unlock()
+        return tokens
+    }
+}
+
+// MARK: - Grammar Processor
+
+/// Constrains one request to a `TokenGrammar`.
+///
+/// Masks every token that would leave the grammar, and reports the tokens
+/// of text the grammar forces so the generation loop can skip sampling them
+/// (see `LogitsProcessor.forcedTokens()`). Sampled tokens are read on the
+/// host when the next mask is needed, which is the only point where
+/// constrained decoding waits for the device.
+public final class GrammarProcessor: LogitsProcessor {
+    private let grammar: TokenGrammar
+    private var state: Int?
+    private var pending: [MLXArray] = []
+
+    init(grammar: TokenGrammar) {
+        self.grammar = grammar
+        state = grammar.grammar.automaton.start
+    }
+
+    /// Whether the tokens so far form a complete match.
+    public var isComplete: Bool {
+        resolvePending()
+        return state.map { grammar.grammar.automaton.accepting[$0] } ?? false
+    }
+
+    public func process(_ logits: MLXArray) -> MLXArray {
+        resolvePending()
+        guard let mask = grammar.mask(for: state) else { return logits }
+        return which(grammar.vocabulary.unpack(mask), logits, MLXArray(-Float.infinity))
+    }
+
+    public func didSample(_ tokens: MLXArray) {
+        pending.append(tokens)
+    }
+
+    public func forcedTokens() -> [Int] {
+        resolvePending()
+        return state.map { grammar.forcedTokens(from: $0) } ?? []
+    }
+
+    /// Advances the state over the tokens sampled since the last call.
+    private func resolvePending() {
+        for tokens in pending {
+            for token in tokens.reshaped([-1]).asArray(Int32.self) {
+                state = state.flatMap { grammar.advance($0, by: Int(token)) }
+            }
+        }
+        pending.removeAll()
+    }
+}
@@ -26,6 +26,15 @@ public protocol TokenizerProtocol {
 
     /// Beginning of sequence token ID.
     var bosTokenId: Int? { get }
+
+    /// Encodes text, optionally without special tokens (e.g. when continuing a sequence).
+    func encode(text: String, addSpecialTokens: Bool) -> [Int]
+}
+
+public extension TokenizerProtocol {
+    func encode(text: String, addSpecialTokens _: Bool) -> [Int] {
+        encode(text: text)
+    }
 }
 
 // MARK: - HuggingFace Tokenizer
@@ -34,6 +43,8 @@ public protocol TokenizerProtocol {
 public class HFTokenizer: TokenizerProtocol {
     private let tokenizer: Tokenizer
     private let config: TokenizerConfig?
+    private let vocabularyLock = NSLock()
+    private var vocabulary: TokenVocabulary?
 
     public let vocabularySize: Int
     public let eosTokenId: Int?
@@ -67,11 +78,78 @@ public class HFTokenizer: TokenizerProtocol {
         tokenizer.encode(text: text)
     }
 
+    public func encode(text: String, addSpecialTokens: Bool) -> [Int] {
+        tokenizer.encode(text: text, addSpecialTokens: addSpecialTokens)
+    }
+
     public func decode(tokens: [Int]) -> String {
         tokenizer.decode(tokens: tokens)
     }
+
+    /// The bytes of every token, for grammar-constrained generation.
+    ///
+    /// Built on first use and cached. Byte-level BPE tokens are mapped back
+    /// from their printable form; SentencePiece tokens get their spaces and
+    /// byte-fallback tokens (`<0x0A>`) restored. Special tokens map to nil.
+    ///
+    /// - Parameter size: Number of token IDs (the model's vocabulary size)
+    public func tokenVocabulary(size: Int) -> TokenVocabulary {
+        vocabularyLock.lock()
+        defer { vocabularyLock.unlock() }
+
+        if let vocabulary, vocabulary.size == size {
+            return vocabulary
+        }
+
+        let isSentencePiece = tokenizer.convertTokenToId("\u{2581}") != nil
+        let tokenBytes: [[UInt8]?] = (0 ..< size).map { id in
+            guard let token = tokenizer.convertIdToToken(id), !token.isEmpty else { return nil }
+
+            if isSentencePiece, token.count == 6, token.hasPrefix("<0x"), token.hasSuffix(">") {
+                return UInt8(token.dropFirst(3).dropLast(), radix: 16).map { [$0] }
+            }
+            // Special tokens vanish when skipped in decoding
+            if token.hasPrefix("<"), token.hasSuffix(">"),
+               tokenizer.decode(tokens: [id], skipSpecialTokens: true).isEmpty
+            {
+                return nil
+            }
+
+            if isSentencePiece {
+                return Array(token.replacingOccurrences(of: "\u{2581}", with: " ").utf8)
+            }
+            var bytes: [UInt8] = []
+            for scalar in token.unicodeScalars {
+                guard let byte = byteLevelDecoder[scalar] else { return Array(token.utf8) }
+                bytes.append(byte)
+            }
+            return bytes
+        }
+
+        let vocabulary = TokenVocabulary(tokenBytes: tokenBytes, size: size)
+        self.vocabulary = vocabulary
+        return vocabulary
+    }
 }
 
+/// Byte behind each character of a byte-level BPE vocabulary (the inverse of
+/// GPT-2's `bytes_to_unicode`: printable bytes stand for themselves, the
+/// others are shifted to U+0100 and up).
+private let byteLevelDecoder: [Unicode.Scalar: UInt8] = {
+    let printable = Set(Array(33 ... 126) + Array(161 ... 172) + Array(174 ... 255))
+    var decoder: [Unicode.Scalar: UInt8] = [:]
+    var shifted: UInt32 = 256
+    for byte in 0 ... 255 {
+        if printable.contains(byte) {
+            decoder[Unicode.Scalar(UInt8(byte))] = UInt8(byte)
+        } else {
+            decoder[Unicode.Scalar(shifted)!] = UInt8(byte)
+            shifted += 1
+        }
+    }
+    return decoder
+}()
+
 // MARK: - Tokenizer Config
 
 /// Configuration for tokenizer special tokens.
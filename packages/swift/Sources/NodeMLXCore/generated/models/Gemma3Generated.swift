@@ -277,7 +277,8 @@ class Gemma3ModelInner: Module {
         _norm.wrappedValue = Gemma3RMSNorm(dimensions: config.hiddenSize, eps: config.rmsNormEps)
     }
 
-    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+    /// Runs only the first `depth` layers (skipping the final norm) if set.
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
         var hiddenStates = embedTokens(inputIds)
         let scale = MLXArray(sqrt(Float(hiddenSize)))
         hiddenStates = hiddenStates * scale.asType(hiddenStates.dtype)
@@ -292,12 +293,12 @@ class Gemma3ModelInner: Module {
         } else {
             slidingMask = globalMask
         }
-        for i in 0 ..< layers.count {
+        for i in 0 ..< (depth ?? layers.count) {
             let isGlobal = (i % slidingWindowPattern) == (slidingWindowPattern - 1)
             let mask = isGlobal ? globalMask : slidingMask
             hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
         }
-        return norm(hiddenStates)
+        return depth == nil ? norm(hiddenStates) : hiddenStates
     }
 }
 
@@ -340,6 +341,11 @@ public class Gemma3Model: Module, LLMModel {
         return lmHead(h)
     }
 
+    public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+        return model(inputIds, cache: &cache, depth: depth)
+    }
+
     public func newCache() -> [KVCache] {
         (0 ..< numLayers).map { i in
             let isGlobal = (i % config.slidingWindowPattern) == (config.slidingWindowPattern - 1)
@@ -561,7 +561,8 @@ class Gemma3nLanguageModel: Module {
         return (projection + perLayerInputs) * sqrtTwoInv
     }
 
-    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+    /// Runs only the first `depth` layers (returning the main AltUp stream) if set.
+    func hiddenStates(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
         var h = embedTokens(inputIds)
         h = h * sqrt(Float(hiddenSize))
 
@@ -588,7 +589,7 @@ class Gemma3nLanguageModel: Module {
         let slidingOffset = slidingCache?.offset ?? 0
         let slidingMask = createAttentionMask(n: h0.dim(1), offset: slidingOffset, windowSize: config.slidingWindow)
 
-        for i in 0 ..< layers.count {
+        for i in 0 ..< (depth ?? layers.count) {
             let isGlobal = config.isGlobalLayer(i)
             let mask = isGlobal ? globalMask : slidingMask
             let perLayerInput = perLayerInputs[0..., 0..., i, 0...]
@@ -600,6 +601,7 @@ class Gemma3nLanguageModel: Module {
                 hiddenStates = layers[i](hiddenStates, perLayerInput: perLayerInput, mask: mask, cache: &nilCache)
             }
         }
+        if depth != nil { return hiddenStates[0] }
 
         let finalTargetMagnitude = pow(mean(hiddenStates[0].pow(2), axis: -1, keepDims: true), 0.5)
         var unembedded: [MLXArray] = [hiddenStates[0]]
@@ -612,10 +614,12 @@ class Gemma3nLanguageModel: Module {
         let normalizedFinal = finalStates[1...] * (finalTargetMagnitude / maximum(finalMags, minVal))
         finalStates = concatenated([finalStates[0 ..< 1], normalizedFinal], axis: 0)
 
-        var output = mean(finalStates, axis: 0)
-        output = norm(output)
+        let output = mean(finalStates, axis: 0)
+        return norm(output)
+    }
 
-        let logits = embedTokens.asLinear(output)
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+        let logits = embedTokens.asLinear(hiddenStates(inputIds, cache: &cache))
         if let cap = finalLogitSoftcapping { return cap * tanh(logits / cap) }
         return logits
     }
@@ -670,6 +674,11 @@ public class Gemma3nModel: Module, LLMModel {
         return output
     }
 
+    public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+        return model.languageModel.hiddenStates(inputIds, cache: &cache, depth: depth)
+    }
+
     public func newCache() -> [KVCache] {
         let numCaches = config.firstKVSharedLayerIdx
         return (0 ..< numCaches).map { i in
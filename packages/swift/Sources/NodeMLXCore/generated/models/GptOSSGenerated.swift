@@ -305,7 +305,8 @@ class GptOSSModelInner: Module {
         _norm.wrappedValue = GptOSSRMSNorm(dimensions: config.hiddenSize, eps: config.rmsNormEps)
     }
 
-    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+    /// Runs only the first `depth` layers (skipping the final norm) if set.
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
         var hiddenStates = embedTokens(inputIds)
         // Find first global layer for mask creation
         var firstGlobalIdx = 0
@@ -317,13 +318,13 @@ class GptOSSModelInner: Module {
         let globalMask = createAttentionMask(n: hiddenStates.dim(1), offset: globalOffset, windowSize: nil)
         let slidingOffset = cache.first??.offset ?? 0
         let slidingMask = createAttentionMask(n: hiddenStates.dim(1), offset: slidingOffset, windowSize: slidingWindow)
-        for i in 0 ..< layers.count {
+        for i in 0 ..< (depth ?? layers.count) {
             let layerType = i < layerTypes.count ? layerTypes[i] : "sliding_attention"
             let isGlobal = layerType == "full_attention"
             let mask = isGlobal ? globalMask : slidingMask
             hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
         }
-        return norm(hiddenStates)
+        return depth == nil ? norm(hiddenStates) : hiddenStates
     }
 }
 
@@ -367,6 +368,11 @@ public class GptOSSModel: Module, LLMModel {
         return lmHead(hidden)
     }
 
+    public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+        return model(inputIds, cache: &cache, depth: depth)
+    }
+
     public func newCache() -> [KVCache] {
         (0 ..< numLayers).map { i in
             let layerType = i < configuration.layerTypes.count ? configuration.layerTypes[i] : "sliding_attention"
@@ -130,14 +130,14 @@ class LlamaModelInner: Module {
         _norm.wrappedValue = LlamaRMSNorm(dimensions: config.hiddenSize, eps: config.rmsNormEps)
     }
 
-    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+    /// Runs only the first `depth` layers (skipping the final norm) if set.
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
         var hiddenStates = embedTokens(inputIds)
-        let offset = cache.first??.offset ?? 0
-        let mask = createAttentionMask(n: hiddenStates.dim(1), offset: offset, windowSize: nil)
-        for i in 0 ..< layers.count {
+        let mask = createAttentionMask(n: hiddenStates.dim(1), cache: cache.first ?? nil)
+        for i in 0 ..< (depth ?? layers.count) {
             hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
         }
-        return norm(hiddenStates)
+        return depth == nil ? norm(hiddenStates) : hiddenStates
     }
 }
 
@@ -180,6 +180,11 @@ public class LlamaModel: Module, LLMModel {
         return lmHead(h)
     }
 
+    public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+        return model(inputIds, cache: &cache, depth: depth)
+    }
+
     public func newCache() -> [KVCache] {
         (0 ..< numLayers).map { _ in KVCacheSimple() }
     }
@@ -242,7 +242,8 @@ class MistralModelInner: Module {
         _norm.wrappedValue = MistralRMSNorm(dimensions: config.hiddenSize, eps: config.rmsNormEps)
     }
 
-    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?]) -> MLXArray {
+    /// Runs only the first `depth` layers (skipping the final norm) if set.
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCache?], depth: Int? = nil) -> MLXArray {
         var hiddenStates = embedTokens(inputIds)
         let globalLayerIdx = slidingWindowPattern - 1
         let globalCache = globalLayerIdx < cache.count ? cache[globalLayerIdx] : nil
@@ -255,12 +256,12 @@ class MistralModelInner: Module {
         } else {
             slidingMask = globalMask
         }
-        for i in 0 ..< layers.count {
+        for i in 0 ..< (depth ?? layers.count) {
             let isGlobal = (i % slidingWindowPattern) == (slidingWindowPattern - 1)
             let mask = isGlobal ? globalMask : slidingMask
             hiddenStates = layers[i](hiddenStates, mask: mask, cache: &cache[i])
         }
-        return norm(hiddenStates)
+        return depth == nil ? norm(hiddenStates) : hiddenStates
     }
 }
 
@@ -303,6 +304,11 @@ public class MistralModel: Module, LLMModel {
         return lmHead(h)
     }
 
+    public func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        var cache: [KVCache?] = Array(repeating: nil, count: numLayers)
+        return model(inputIds, cache: &cache, depth: depth)
+    }
+
     public func newCache() -> [KVCache] {
         (0 ..< numLayers).map { i in
             let isGlobal = (i % config.slidingWindowPattern) == (config.slidingWindowPattern - 1)
@@ -72,6 +72,29 @@ public func createAttentionMask(
     }
 }
 
+/// Creates an attention mask from a layer's cache.
+///
+/// Defers to the cache's `makeMask` so caches with extra masking needs (such as
+/// the left padding of a `BatchKVCache`) can supply their own mask.
+///
+/// - Parameters:
+///   - n: Query sequence length
+///   - cache: Cache of the layer the mask is built for (nil = no cache)
+///   - windowSize: Optional sliding window size
+///   - returnArray: If true, always returns array mask
+/// - Returns: Mask mode for MLXFast scaled dot product attention
+public func createAttentionMask(
+    n: Int,
+    cache: KVCacheProtocol?,
+    windowSize: Int? = nil,
+    returnArray: Bool = false
+) -> MLXFast.ScaledDotProductAttentionMaskMode {
+    guard let cache else {
+        return createAttentionMask(n: n, offset: 0, returnArray: returnArray, windowSize: windowSize)
+    }
+    return cache.makeMask(queryLength: n, windowSize: windowSize, returnArray: returnArray)
+}
+
 // MARK: - KVCache Protocol
 
 /// Protocol for all KV cache implementations.
@@ -140,8 +163,11 @@ public extension KVCacheProtocol {
 
 /// Standard KV cache with grow-in-place strategy for efficient memory use.
 ///
-/// Uses a step-based allocation strategy to avoid frequent reallocations.
-/// The internal buffer grows in steps of `step` (256) tokens.
+/// The internal buffer is allocated in multiples of `step` (256) tokens.
+/// Unlike mlx-lm, which grows by just enough steps for each update, the
+/// capacity at least doubles whenever it runs out, so the history is copied
+/// O(log n) times instead of on every growth. `reserve(_:)` allocates the
+/// expected length up front and avoids copies altogether.
 ///
 /// Ported from: mlx_lm/models/cache.py::KVCache
 public final class StandardKVCache: KVCacheProtocol {
@@ -152,18 +178,37 @@ public final class StandardKVCache: KVCacheProtocol {
     private var values: MLXArray?
     public private(set) var offset: Int = 0
 
+    /// Capacity requested with `reserve(_:)` before the first update.
+    private var reservedCapacity = 0
+
     public init() {}
 
+    /// Number of tokens the buffer holds before it has to grow.
+    public var capacity: Int { keys?.dim(2) ?? 0 }
+
     /// Returns the current cached keys and values.
     public var state: (keys: MLXArray, values: MLXArray)? {
         guard let k = keys, let v = values, offset > 0 else { return nil }
         return (k[.ellipsis, ..<offset, 0...], v[.ellipsis, ..<offset, 0...])
     }
 
+    /// Makes room for at least `tokens` tokens in total.
+    ///
+    /// Before the first update only the capacity is recorded, since the
+    /// shape of keys and values is not known yet.
+    public func reserve(_ tokens: Int) {
+        guard tokens > capacity else { return }
+        if let keys, let values {
+            grow(to: tokens, like: keys, values)
+        } else {
+            reservedCapacity = max(reservedCapacity, tokens)
+        }
+    }
+
     /// Updates the cache with new key/value pairs and returns the full sequence.
     ///
-    /// Uses a grow-in-place strategy: the internal buffer grows in steps of
-    /// `Self.step` (256) to avoid frequent reallocations.
+    /// The buffer grows geometrically in multiples of `Self.step` (256), so
+    /// appending n tokens costs O(n) copying in total.
     ///
     /// - Parameters:
     ///   - keys: New keys to add, shape [B, H, S, D]
@@ -174,36 +219,10 @@ public final class StandardKVCache: KVCacheProtocol {
         let numSteps = newKeys.dim(2)
 
         // Check if we need to grow the buffer
-        if keys == nil || (prev + numSteps) > keys!.dim(2) {
-            let batchSize = newKeys.dim(0)
-            let numKvHeads = newKeys.dim(1)
-            let keyHeadDim = newKeys.dim(3)
-            let valueHeadDim = newValues.dim(3)
-
-            // Calculate new buffer size (round up to step boundary)
-            let nBufferSteps = (Self.step + numSteps - 1) / Self.step
-            let bufferSize = nBufferSteps * Self.step
-
-            let kShape = [batchSize, numKvHeads, bufferSize, keyHeadDim]
-            let vShape = [batchSize, numKvHeads, bufferSize, valueHeadDim]
-
-            let newK = MLXArray.zeros(kShape, dtype: newKeys.dtype)
-            let newV = MLXArray.zeros(vShape, dtype: newValues.dtype)
-
-            if let existingKeys = keys, let existingValues = values {
-                // Trim existing buffer if not aligned to step
-                var trimmedKeys = existingKeys
-                var trimmedValues = existingValues
-                if prev % Self.step != 0 {
-                    trimmedKeys = existingKeys[.ellipsis, ..<prev, 0...]
-                    trimmedValues = existingValues[.ellipsis, ..<prev, 0...]
-                }
-                keys = concatenated([trimmedKeys, newK], axis: 2)
-                values = concatenated([trimmedValues, newV], axis: 2)
-            } else {
-                keys = newK
-                values = newV
-            }
+        if prev + numSteps > capacity {
+            let needed = max(prev + numSteps, 2 * capacity, reservedCapacity)
+            grow(to: needed, like: newKeys, newValues)
+            reservedCapacity = 0
         }
 
         // Update offset and assign new values
@@ -215,6 +234,28 @@ public final class StandardKVCache: KVCacheProtocol {
         return (keys![.ellipsis, ..<offset, 0...], values![.ellipsis, ..<offset, 0...])
     }
 
+    /// Reallocates the buffer with room for `tokens` tokens (rounded up to a
+    /// step), copying the cached entries once. Shape and dtype other than the
+    /// sequence axis are taken from `templateKeys` and `templateValues`.
+    private func grow(to tokens: Int, like templateKeys: MLXArray, _ templateValues: MLXArray) {
+        let bufferSize = (tokens + Self.step - 1) / Self.step * Self.step
+
+        var kShape = templateKeys.shape
+        var vShape = templateValues.shape
+        kShape[2] = bufferSize - offset
+        vShape[2] = bufferSize - offset
+        let newK = MLXArray.zeros(kShape, dtype: templateKeys.dtype)
+        let newV = MLXArray.zeros(vShape, dtype: templateValues.dtype)
+
+        if let existingKeys = keys, let existingValues = values, offset > 0 {
+            keys = concatenated([existingKeys[.ellipsis, ..<offset, 0...], newK], axis: 2)
+            values = concatenated([existingValues[.ellipsis, ..<offset, 0...], newV], axis: 2)
+        } else {
+            keys = newK
+            values = newV
+        }
+    }
+
     @discardableResult
     public func trim(_ n: Int) -> Int {
         let trimmed = min(offset, n)
@@ -421,6 +462,23 @@ public final class RotatingKVCache: KVCacheProtocol {
         return trimmed
     }
 
+    /// Buffers in storage order and the write index, as saved by `savePromptCache`.
+    var rawState: (keys: MLXArray, values: MLXArray, idx: Int)? {
+        guard let k = keys, let v = values else { return nil }
+        if offset < k.dim(2) {
+            return (k[.ellipsis, ..<offset, 0...], v[.ellipsis, ..<offset, 0...], idx)
+        }
+        return (k, v, idx)
+    }
+
+    /// Restores buffers saved from `rawState`.
+    func restore(keys: MLXArray, values: MLXArray, offset: Int, idx: Int) {
+        self.keys = keys
+        self.values = values
+        self.offset = offset
+        self.idx = idx
+    }
+
     public func makeMask(
         queryLength n: Int,
         windowSize: Int? = nil,
@@ -501,7 +559,28 @@ public final class QuantizedKVCache: KVCacheProtocol {
         return (dequantK[.ellipsis, ..<offset, 0...], dequantV[.ellipsis, ..<offset, 0...])
     }
 
+    /// Updates the cache and returns all cached keys and values, dequantized.
+    ///
+    /// Attention implementations that support quantized inputs should call
+    /// `updateQuantized(keys:values:)` instead and skip the dequantization.
     public func update(keys newKeys: MLXArray, values newValues: MLXArray) -> (MLXArray, MLXArray) {
+        let (k, v) = updateQuantized(keys: newKeys, values: newValues)
+        return (
+            MLX.dequantized(k.0, scales: k.1, biases: k.2, groupSize: groupSize, bits: bits),
+            MLX.dequantized(v.0, scales: v.1, biases: v.2, groupSize: groupSize, bits: bits)
+        )
+    }
+
+    /// Updates the cache and returns all cached keys and values in quantized form.
+    ///
+    /// - Parameters:
+    ///   - keys: New keys to add, shape [B, H, S, D]
+    ///   - values: New values to add, shape [B, H, S, D]
+    /// - Returns: (quantized, scales, biases) for keys and values, covering all cached tokens
+    public func updateQuantized(
+        keys newKeys: MLXArray,
+        values newValues: MLXArray
+    ) -> (keys: (MLXArray, MLXArray, MLXArray?), values: (MLXArray, MLXArray, MLXArray?)) {
         let batchSize = newKeys.dim(0)
         let numKvHeads = newKeys.dim(1)
         let numSteps = newKeys.dim(2)
@@ -586,9 +665,15 @@ public final class QuantizedKVCache: KVCacheProtocol {
             values!.2.map { $0[.ellipsis, ..<offset, 0...] }
         )
 
-        // Note: Returns quantized tuples, not dequantized arrays
-        // The caller must handle dequantization if needed
-        return (returnKeys.0, returnValues.0)
+        return (returnKeys, returnValues)
+    }
+
+    /// Quantized buffers of keys and values, for evaluation.
+    public var arrays: [MLXArray] {
+        [keys, values].flatMap { buffer -> [MLXArray] in
+            guard let buffer else { return [] }
+            return [buffer.0, buffer.1] + (buffer.2.map { [$0] } ?? [])
+        }
     }
 
     @discardableResult
@@ -599,6 +684,293 @@ public final class QuantizedKVCache: KVCacheProtocol {
     }
 }
 
+// MARK: - Quantized Attention
+
+/// Scaled dot product attention over a quantized KV cache.
+///
+/// Multiplies directly with the quantized keys and values via
+/// `quantizedMatmul`, so the cache is never dequantized as a whole.
+///
+/// - Parameters:
+///   - queries: Queries, shape [B, numHeads, L, D]
+///   - keys: Quantized keys from `QuantizedKVCache.updateQuantized`
+///   - values: Quantized values from `QuantizedKVCache.updateQuantized`
+///   - scale: Attention scale
+///   - mask: Attention mask
+///   - groupSize: Quantization group size of the cache
+///   - bits: Bits per element of the cache
+/// - Returns: Attention output, shape [B, numHeads, L, D]
+///
+/// Ported from: mlx_lm/models/base.py::quantized_scaled_dot_product_attention
+public func quantizedScaledDotProductAttention(
+    queries: MLXArray,
+    keys: (MLXArray, MLXArray, MLXArray?),
+    values: (MLXArray, MLXArray, MLXArray?),
+    scale: Float,
+    mask: MLXFast.ScaledDotProductAttentionMaskMode,
+    groupSize: Int,
+    bits: Int
+) -> MLXArray {
+    let (B, numHeads, L, D) = (queries.dim(0), queries.dim(1), queries.dim(2), queries.dim(3))
+    let numKVHeads = keys.0.dim(-3)
+    let repeats = numHeads / numKVHeads
+
+    var queries = queries * scale
+    var keys = keys
+    var values = values
+    if repeats > 1 {
+        // Grouped query attention: one group of query heads per KV head
+        queries = queries.reshaped([B, numKVHeads, repeats, L, D])
+        func expand(_ x: (MLXArray, MLXArray, MLXArray?)) -> (MLXArray, MLXArray, MLXArray?) {
+            (
+                x.0.expandedDimensions(axis: -3),
+                x.1.expandedDimensions(axis: -3),
+                x.2.map { $0.expandedDimensions(axis: -3) }
+            )
+        }
+        keys = expand(keys)
+        values = expand(values)
+    }
+
+    var scores = quantizedMatmul(
+        queries, keys.0, scales: keys.1, biases: keys.2, transpose: true, groupSize: groupSize, bits: bits
+    )
+
+    switch mask {
+    case .causal:
+        let (qL, kL) = (scores.dim(-2), scores.dim(-1))
+        let causal = createCausalMask(n: qL, offset: kL - qL)
+        scores = which(causal, scores, MLXArray(-Float.infinity).asType(scores.dtype))
+    case let .array(maskArray):
+        if maskArray.dtype == .bool {
+            scores = which(maskArray, scores, MLXArray(-Float.infinity).asType(scores.dtype))
+        } else {
+            scores = scores + maskArray
+        }
+    default:
+        break
+    }
+
+    scores = softmax(scores, axis: -1, precise: true)
+    var output = quantizedMatmul(
+        scores, values.0, scales: values.1, biases: values.2, transpose: false, groupSize: groupSize, bits: bits
+    )
+    if repeats > 1 {
+        output = output.reshaped([B, numHeads, L, -1])
+    }
+    return output
+}
+
+// MARK: - BatchKVCache
+
+/// Creates an attention mask for right-aligned rows with left padding.
+///
+/// - Parameters:
+///   - n: Query sequence length
+///   - offset: Number of filled columns, including padding
+///   - leftPadding: Padding columns at the start of each row
+///   - windowSize: Optional sliding window size
+///   - returnArray: If true, always returns array mask
+/// - Returns: The causal mask if no row is padded, else a [B, 1, n, offset + n] mask
+func createLeftPaddedMask(
+    n: Int,
+    offset: Int,
+    leftPadding: [Int],
+    windowSize: Int?,
+    returnArray: Bool
+) -> MLXFast.ScaledDotProductAttentionMaskMode {
+    let isPadded = leftPadding.contains { $0 > 0 }
+    if !isPadded {
+        return createAttentionMask(n: n, offset: offset, returnArray: returnArray, windowSize: windowSize)
+    }
+
+    // Causal (and windowed) in column space, minus each row's padding
+    var mask = createCausalMask(n: n, offset: offset, windowSize: windowSize)
+        .reshaped([1, 1, n, offset + n])
+    let columns = MLXArray(0 ..< Int32(offset + n)).reshaped([1, 1, 1, offset + n])
+    let padding = MLXArray(leftPadding.map { Int32($0) }).reshaped([leftPadding.count, 1, 1, 1])
+    mask = logicalAnd(mask, columns .>= padding)
+    return .array(mask)
+}
+
+/// KV cache for a batch of left-padded sequences that decode in lockstep.
+///
+/// Rows are aligned on the right: every row writes its next token to the same
+/// column, and shorter rows carry left padding that `makeMask` hides. Rows join
+/// with `extend(_:)` and leave with `filter(_:)` between steps, which is what
+/// makes continuous batching possible.
+///
+/// mlx-lm gives every row its own RoPE offset. Here all rows share one scalar
+/// `offset`: RoPE only depends on the distance between query and key, so a
+/// constant shift per row leaves attention unchanged. A row that joins a running
+/// batch is prefilled at positions ending at the batch's offset (which may start
+/// below zero), so both caches use the same frame when they are merged.
+///
+/// Ported from: mlx_lm/models/cache.py::BatchKVCache
+public final class BatchKVCache: KVCacheProtocol {
+    /// Growth step size for buffer allocation
+    public static let step = 256
+
+    private var keys: MLXArray?
+    private var values: MLXArray?
+
+    /// Number of filled columns, including padding.
+    public private(set) var idx: Int = 0
+
+    /// Column that corresponds to RoPE position 0.
+    private var origin: Int
+
+    /// Number of padding columns at the start of each row.
+    public private(set) var leftPadding: [Int]
+
+    /// Creates an empty batch cache.
+    ///
+    /// - Parameters:
+    ///   - leftPadding: Padding columns per row of the first update
+    ///   - offset: RoPE position of the first column (may be negative)
+    public init(leftPadding: [Int] = [0], offset: Int = 0) {
+        self.leftPadding = leftPadding
+        origin = -offset
+    }
+
+    /// Number of rows in the batch.
+    public var batchSize: Int { leftPadding.count }
+
+    /// RoPE position of the next token, shared by all rows.
+    public var offset: Int { idx - origin }
+
+    /// Returns the cached keys and values, including padding columns.
+    public var state: (keys: MLXArray, values: MLXArray)? {
+        guard let k = keys, let v = values, idx > 0 else { return nil }
+        return (k[.ellipsis, ..<idx, 0...], v[.ellipsis, ..<idx, 0...])
+    }
+
+    public func update(keys newKeys: MLXArray, values newValues: MLXArray) -> (MLXArray, MLXArray) {
+        let prev = idx
+        let numSteps = newKeys.dim(2)
+
+        if keys == nil || (prev + numSteps) > keys!.dim(2) {
+            let nBufferSteps = (Self.step + numSteps - 1) / Self.step
+            let bufferSize = nBufferSteps * Self.step
+
+            let kShape = [newKeys.dim(0), newKeys.dim(1), bufferSize, newKeys.dim(3)]
+            let vShape = [newValues.dim(0), newValues.dim(1), bufferSize, newValues.dim(3)]
+            let newK = MLXArray.zeros(kShape, dtype: newKeys.dtype)
+            let newV = MLXArray.zeros(vShape, dtype: newValues.dtype)
+
+            if let existingKeys = keys, let existingValues = values {
+                keys = concatenated([existingKeys[.ellipsis, ..<prev, 0...], newK], axis: 2)
+                values = concatenated([existingValues[.ellipsis, ..<prev, 0...], newV], axis: 2)
+            } else {
+                keys = newK
+                values = newV
+            }
+        }
+
+        idx += numSteps
+        keys![.ellipsis, prev ..< idx, 0...] = newKeys
+        values![.ellipsis, prev ..< idx, 0...] = newValues
+
+        return (keys![.ellipsis, ..<idx, 0...], values![.ellipsis, ..<idx, 0...])
+    }
+
+    @discardableResult
+    public func trim(_ n: Int) -> Int {
+        let trimmed = min(idx - (leftPadding.max() ?? 0), n)
+        idx -= trimmed
+        return trimmed
+    }
+
+    public func makeMask(
+        queryLength n: Int,
+        windowSize: Int? = nil,
+        returnArray: Bool = false
+    ) -> MLXFast.ScaledDotProductAttentionMaskMode {
+        createLeftPaddedMask(
+            n: n, offset: idx, leftPadding: leftPadding, windowSize: windowSize, returnArray: returnArray
+        )
+    }
+
+    /// Appends the rows of another batch cache.
+    ///
+    /// Both caches must be at the same `offset`. The shorter one is left-padded
+    /// so that the rows stay aligned on the right.
+    public func extend(_ other: BatchKVCache) {
+        precondition(offset == other.offset, "BatchKVCache.extend requires matching offsets")
+
+        guard let otherState = other.state else {
+            leftPadding += other.leftPadding.map { $0 + idx }
+            return
+        }
+        guard let selfState = state else {
+            keys = otherState.keys
+            values = otherState.values
+            leftPadding = leftPadding.map { $0 + other.idx } + other.leftPadding
+            origin = other.origin
+            idx = other.idx
+            return
+        }
+
+        let ropeOffset = offset
+        let newIdx = max(idx, other.idx)
+
+        func alignRight(_ array: MLXArray, by shift: Int) -> MLXArray {
+            guard shift > 0 else { return array }
+            var shape = array.shape
+            shape[2] = shift
+            return concatenated([MLXArray.zeros(shape, dtype: array.dtype), array], axis: 2)
+        }
+
+        let selfShift = newIdx - idx
+        let otherShift = newIdx - other.idx
+
+        keys = concatenated([
+            alignRight(selfState.keys, by: selfShift), alignRight(otherState.keys, by: otherShift),
+        ], axis: 0)
+        values = concatenated([
+            alignRight(selfState.values, by: selfShift), alignRight(otherState.values, by: otherShift),
+        ], axis: 0)
+        leftPadding = leftPadding.map { $0 + selfShift } + other.leftPadding.map { $0 + otherShift }
+        idx = newIdx
+        origin = newIdx - ropeOffset
+    }
+
+    /// Returns the last `length` columns of one row, shape [1, H, length, D].
+    public func rowState(_ row: Int, length: Int) -> (keys: MLXArray, values: MLXArray)? {
+        guard let k = keys, let v = values, length > 0, length <= idx - leftPadding[row] else { return nil }
+        return (
+            k[row ..< row + 1, 0..., (idx - length) ..< idx, 0...],
+            v[row ..< row + 1, 0..., (idx - length) ..< idx, 0...]
+        )
+    }
+
+    /// Keeps only the given rows, in the given order.
+    ///
+    /// Padding columns shared by all remaining rows are dropped.
+    public func filter(_ rows: [Int]) {
+        leftPadding = rows.map { leftPadding[$0] }
+
+        guard let k = keys, let v = values, !rows.isEmpty else {
+            keys = nil
+            values = nil
+            return
+        }
+
+        let indices = MLXArray(rows.map { Int32($0) })
+        keys = take(k[.ellipsis, ..<idx, 0...], indices, axis: 0)
+        values = take(v[.ellipsis, ..<idx, 0...], indices, axis: 0)
+
+        let shared = leftPadding.min() ?? 0
+        if shared > 0 {
+            keys = keys![.ellipsis, shared..., 0...]
+            values = values![.ellipsis, shared..., 0...]
+            idx -= shared
+            origin -= shared
+            leftPadding = leftPadding.map { $0 - shared }
+        }
+    }
+}
+
 // MARK: - Factory Functions
 
 /// Creates prompt caches for a model.
@@ -641,3 +1013,133 @@ public func trimPromptCache(_ cache: [any KVCacheProtocol], numTokens: Int) -> I
     guard canTrimPromptCache(cache), !cache.isEmpty else { return 0 }
     return cache.map { $0.trim(numTokens) }.first ?? 0
 }
+
+// MARK: - Serialization
+
+/// Errors raised when saving or loading prompt caches.
+public enum PromptCacheError: Error, LocalizedError {
+    case unsupportedCache(String)
+    case invalidFile(String)
+    case modelMismatch
+
+    public var errorDescription: String? {
+        switch self {
+        case let .unsupportedCache(type):
+            "Cannot serialize cache of type \(type)"
+        case let .invalidFile(msg):
+            "Invalid prompt cache file: \(msg)"
+        case .modelMismatch:
+            "Prompt cache was saved for a different model"
+        }
+    }
+}
+
+/// Saves prompt caches to a safetensors file.
+///
+/// Supports `StandardKVCache`, `RotatingKVCache` and `QuantizedKVCache`.
+/// Layer `i` is stored as arrays `i.keys` / `i.values` (quantized layers add
+/// `.scales` / `.biases`); cache types and their settings go into the file
+/// metadata next to the caller's `metadata`.
+///
+/// - Parameters:
+///   - url: Destination file
+///   - cache: One cache per layer
+///   - metadata: Extra string metadata (keys starting with `cache.` are reserved)
+///
+/// Ported from: mlx_lm/models/cache.py::save_prompt_cache
+public func savePromptCache(
+    url: URL,
+    cache: [any KVCacheProtocol],
+    metadata: [String: String] = [:]
+) throws {
+    var arrays: [String: MLXArray] = [:]
+    var metadata = metadata
+    metadata["cache.count"] = String(cache.count)
+
+    for (i, layer) in cache.enumerated() {
+        let info: [Int]
+        switch layer {
+        case let layer as StandardKVCache:
+            metadata["cache.\(i).type"] = "StandardKVCache"
+            info = []
+            if let (keys, values) = layer.state {
+                arrays["\(i).keys"] = keys
+                arrays["\(i).values"] = values
+            }
+        case let layer as RotatingKVCache:
+            metadata["cache.\(i).type"] = "RotatingKVCache"
+            let raw = layer.rawState
+            info = [layer.keep, layer.maxSize, layer.offset, raw?.idx ?? 0]
+            if let raw {
+                arrays["\(i).keys"] = raw.keys
+                arrays["\(i).values"] = raw.values
+            }
+        case let layer as QuantizedKVCache:
+            metadata["cache.\(i).type"] = "QuantizedKVCache"
+            info = [layer.groupSize, layer.bits, layer.offset]
+            let offset = layer.offset
+            for (name, buffer) in [("keys", layer.keys), ("values", layer.values)] {
+                guard let buffer, offset > 0 else { continue }
+                arrays["\(i).\(name)"] = buffer.0[.ellipsis, ..<offset, 0...]
+                arrays["\(i).\(name).scales"] = buffer.1[.ellipsis, ..<offset, 0...]
+                arrays["\(i).\(name).biases"] = buffer.2?[.ellipsis, ..<offset, 0...]
+            }
+        default:
+            throw PromptCacheError.unsupportedCache(String(describing: type(of: layer)))
+        }
+        metadata["cache.\(i).info"] = info.map(String.init).joined(separator: ",")
+    }
+
+    try MLX.save(arrays: arrays, metadata: metadata, url: url)
+}
+
+/// Loads prompt caches saved with `savePromptCache`.
+///
+/// - Parameter url: File written by `savePromptCache`
+/// - Returns: One cache per layer and the file's metadata
+///
+/// Ported from: mlx_lm/models/cache.py::load_prompt_cache
+public func loadPromptCache(url: URL) throws -> (cache: [any KVCacheProtocol], metadata: [String: String]) {
+    let (arrays, metadata) = try MLX.loadArraysAndMetadata(url: url)
+    guard let count = metadata["cache.count"].flatMap(Int.init) else {
+        throw PromptCacheError.invalidFile("missing cache.count")
+    }
+
+    let cache: [any KVCacheProtocol] = try (0 ..< count).map { i in
+        let info = (metadata["cache.\(i).info"] ?? "").split(separator: ",").compactMap { Int($0) }
+        let keys = arrays["\(i).keys"]
+        let values = arrays["\(i).values"]
+
+        switch metadata["cache.\(i).type"] {
+        case "StandardKVCache":
+            let layer = StandardKVCache()
+            if let keys, let values {
+                _ = layer.update(keys: keys, values: values)
+            }
+            return layer
+        case "RotatingKVCache":
+            guard info.count == 4 else { throw PromptCacheError.invalidFile("bad info for layer \(i)") }
+            let layer = RotatingKVCache(maxSize: info[1], keep: info[0])
+            if let keys, let values {
+                layer.restore(keys: keys, values: values, offset: info[2], idx: info[3])
+            }
+            return layer
+        case "QuantizedKVCache":
+            guard info.count == 3 else { throw PromptCacheError.invalidFile("bad info for layer \(i)") }
+            let layer = QuantizedKVCache(groupSize: info[0], bits: info[1])
+            if let keys, let values,
+               let keyScales = arrays["\(i).keys.scales"], let valueScales = arrays["\(i).values.scales"]
+            {
+                layer.keys = (keys, keyScales, arrays["\(i).keys.biases"])
+                layer.values = (values, valueScales, arrays["\(i).values.biases"])
+                layer.offset = info[2]
+            }
+            return layer
+        case let type:
+            throw PromptCacheError.invalidFile("unknown cache type \(type ?? "nil") for layer \(i)")
+        }
+    }
+
+    let userMetadata = metadata.filter { !$0.key.hasPrefix("cache.") }
+    return (cache, userMetadata)
+}
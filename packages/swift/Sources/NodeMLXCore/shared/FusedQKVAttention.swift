@@ -70,19 +70,34 @@ public class FusedQKVAttention<C: AttentionConfiguration>: Module {
         queries = rope(queries, offset: offset)
         keys = rope(keys, offset: offset)
 
-        // Update cache (class-based protocol, reference is modified in place)
-        if let c = cache {
-            (keys, values) = c.update(keys: keys, values: values)
-        }
+        let output: MLXArray
+        if let quantized = cache as? QuantizedKVCache {
+            // Attend over the quantized cache without dequantizing it
+            let (quantizedKeys, quantizedValues) = quantized.updateQuantized(keys: keys, values: values)
+            output = quantizedScaledDotProductAttention(
+                queries: queries,
+                keys: quantizedKeys,
+                values: quantizedValues,
+                scale: scale,
+                mask: mask,
+                groupSize: quantized.groupSize,
+                bits: quantized.bits
+            )
+        } else {
+            // Update cache (class-based protocol, reference is modified in place)
+            if let c = cache {
+                (keys, values) = c.update(keys: keys, values: values)
+            }
 
-        // Attention using MLXFast (handles GQA automatically)
-        let output = MLXFast.scaledDotProductAttention(
-            queries: queries,
-            keys: keys,
-            values: values,
-            scale: scale,
-            mask: mask
-        )
+            // Attention using MLXFast (handles GQA automatically)
+            output = MLXFast.scaledDotProductAttention(
+                queries: queries,
+                keys: keys,
+                values: values,
+                scale: scale,
+                mask: mask
+            )
+        }
 
         // Reshape back: [B, heads, L, headDim] -> [B, L, hidden]
         let outputReshaped = output.transposed(0, 2, 1, 3).reshaped([B, L, -1])
@@ -26,6 +26,16 @@ public enum SamplingUtils {
     ///   - p: Probability threshold (0.0-1.0)
     /// - Returns: Filtered logits with low-probability tokens masked to -inf
     public static func applyTopP(_ logits: MLXArray, p: Float) -> MLXArray {
+        applyTopP(logits, p: MLXArray(p))
+    }
+
+    /// Applies top-p (nucleus) sampling with a threshold per row.
+    ///
+    /// - Parameters:
+    ///   - logits: Input logits, shape [batch, vocab_size]
+    ///   - p: Thresholds broadcastable against the logits, e.g. shape [batch, 1]
+    /// - Returns: Filtered logits with low-probability tokens masked to -inf
+    public static func applyTopP(_ logits: MLXArray, p: MLXArray) -> MLXArray {
         // Get probabilities
         let probs = softmax(logits, axis: -1)
 
@@ -43,7 +53,7 @@ public enum SamplingUtils {
         let shiftedCumProbs = concatenated([zeros, cumProbs[.ellipsis, ..<(-1)]], axis: -1)
 
         // Find cutoff: positions where shifted cumsum > p should be masked
-        let topPMask = shiftedCumProbs .> MLXArray(p)
+        let topPMask = shiftedCumProbs .> p
 
         // Apply mask: set excluded tokens to -inf
         let sortedLogits = takeAlong(logits, sortedIndices, axis: -1)
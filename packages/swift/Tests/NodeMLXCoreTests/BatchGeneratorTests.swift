@@ -0,0 +1,320 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for BatchGenerator.swift and GenerationScheduler.swift
+// (including prefix reuse through PrefixCache.swift)
+
+import Foundation
+import MLX
+import MLXNN
+import XCTest
+
+@testable import NodeMLXCore
+
+final class BatchGeneratorTests: XCTestCase {
+    // MARK: - Helpers
+
+    /// Runs requests through a generator until all are finished.
+    private func runBatch(
+        _ generator: BatchGenerator,
+        prompts: [[Int]],
+        config: GenerationConfig
+    ) -> [GenerationOutput?] {
+        var outputs = [GenerationOutput?](repeating: nil, count: prompts.count)
+        for (i, prompt) in prompts.enumerated() {
+            generator.insert(BatchRequest(
+                inputIds: prompt,
+                config: config,
+                onToken: { _ in true },
+                completion: { outputs[i] = $0 }
+            ))
+        }
+        while generator.hasWork {
+            generator.step()
+        }
+        return outputs
+    }
+
+    // MARK: - Support Tests
+
+    func testSupportsStandardCacheModels() throws {
+        XCTAssertTrue(BatchGenerator.supports(try makeTinyLlama()))
+    }
+
+    // MARK: - Batched Decoding Tests
+
+    func testBatchedGreedyMatchesSolo() throws {
+        let model = try makeTinyLlama()
+        let prompts = [[1, 2, 3, 4, 5, 6], [7, 8], [9, 10, 11, 12]]
+
+        let solo = prompts.map { generate(model: model, inputIds: $0, config: greedy(maxTokens: 8)).tokens }
+        let batched = runBatch(BatchGenerator(model: model), prompts: prompts, config: greedy(maxTokens: 8))
+
+        for (i, output) in batched.enumerated() {
+            XCTAssertEqual(output?.tokens, solo[i], "Row \(i) diverged from solo generation")
+            XCTAssertEqual(output?.finishReason, .length)
+        }
+    }
+
+    func testRequestJoinsRunningBatch() throws {
+        let model = try makeTinyLlama()
+        let generator = BatchGenerator(model: model)
+        let first = [3, 1, 4, 1, 5]
+        let second = [9, 2, 6]
+
+        var firstOutput: GenerationOutput?
+        var secondOutput: GenerationOutput?
+        generator.insert(BatchRequest(
+            inputIds: first, config: greedy(maxTokens: 10),
+            onToken: { _ in true }, completion: { firstOutput = $0 }
+        ))
+        for _ in 0 ..< 3 {
+            generator.step()
+        }
+
+        generator.insert(BatchRequest(
+            inputIds: second, config: greedy(maxTokens: 4),
+            onToken: { _ in true }, completion: { secondOutput = $0 }
+        ))
+        generator.step()
+        XCTAssertEqual(generator.batchSize, 2)
+
+        while generator.hasWork {
+            generator.step()
+        }
+
+        XCTAssertEqual(firstOutput?.tokens, generate(model: model, inputIds: first, config: greedy(maxTokens: 10)).tokens)
+        XCTAssertEqual(secondOutput?.tokens, generate(model: model, inputIds: second, config: greedy(maxTokens: 4)).tokens)
+    }
+
+    func testCallbackStopLeavesOtherRowsRunning() throws {
+        let model = try makeTinyLlama()
+        let generator = BatchGenerator(model: model)
+
+        var stopped: GenerationOutput?
+        var running: GenerationOutput?
+        generator.insert(BatchRequest(
+            inputIds: [1, 2, 3], config: greedy(maxTokens: 6),
+            onToken: { _ in false }, completion: { stopped = $0 }
+        ))
+        generator.insert(BatchRequest(
+            inputIds: [4, 5, 6], config: greedy(maxTokens: 6),
+            onToken: { _ in true }, completion: { running = $0 }
+        ))
+        while generator.hasWork {
+            generator.step()
+        }
+
+        XCTAssertEqual(stopped?.finishReason, .cancelled)
+        XCTAssertEqual(stopped?.tokens.count, 1)
+        XCTAssertEqual(running?.finishReason, .length)
+        XCTAssertEqual(running?.tokens.count, 6)
+    }
+
+    func testCancelAllFinishesEveryRequest() throws {
+        let generator = try BatchGenerator(model: makeTinyLlama())
+
+        var reasons: [FinishReason] = []
+        for prompt in [[1, 2], [3, 4]] {
+            generator.insert(BatchRequest(
+                inputIds: prompt, config: greedy(maxTokens: 50),
+                onToken: { _ in true }, completion: { reasons.append($0.finishReason) }
+            ))
+        }
+        generator.step()
+        generator.insert(BatchRequest(
+            inputIds: [5], config: greedy(maxTokens: 50),
+            onToken: { _ in true }, completion: { reasons.append($0.finishReason) }
+        ))
+
+        generator.cancelAll()
+
+        XCTAssertEqual(reasons, [.cancelled, .cancelled, .cancelled])
+        XCTAssertFalse(generator.hasWork)
+    }
+
+    // MARK: - Chunked Prefill Tests
+
+    func testChunkedPrefillMatchesSolo() throws {
+        let model = try makeTinyLlama()
+        let prompt = [5, 4, 3, 2, 1, 9, 8, 7, 6]
+        var config = greedy(maxTokens: 6)
+        config.prefillStepSize = 2
+
+        let solo = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 6)).tokens
+        XCTAssertEqual(generate(model: model, inputIds: prompt, config: config).tokens, solo)
+
+        let batched = runBatch(BatchGenerator(model: model), prompts: [prompt], config: config)
+        XCTAssertEqual(batched[0]?.tokens, solo)
+    }
+
+    func testLongPromptPrefillsBetweenDecodeSteps() throws {
+        let model = try makeTinyLlama()
+        let generator = BatchGenerator(model: model)
+        let first = [3, 1, 4]
+        let second = [2, 7, 1, 8, 2, 8, 1]
+
+        var firstTokens: [Int] = []
+        var secondOutput: GenerationOutput?
+        generator.insert(BatchRequest(
+            inputIds: first, config: greedy(maxTokens: 12),
+            onToken: { firstTokens.append($0); return true }, completion: { _ in }
+        ))
+        generator.step()
+
+        var config = greedy(maxTokens: 4)
+        config.prefillStepSize = 2
+        generator.insert(BatchRequest(
+            inputIds: second, config: config,
+            onToken: { _ in true }, completion: { secondOutput = $0 }
+        ))
+
+        // Four chunks: the running row keeps decoding while the first three are processed
+        for expectedTokens in 3 ... 5 {
+            generator.step()
+            XCTAssertEqual(generator.batchSize, 1)
+            XCTAssertEqual(firstTokens.count, expectedTokens)
+        }
+        generator.step()
+        XCTAssertEqual(generator.batchSize, 2)
+
+        while generator.hasWork {
+            generator.step()
+        }
+
+        XCTAssertEqual(firstTokens, generate(model: model, inputIds: first, config: greedy(maxTokens: 12)).tokens)
+        XCTAssertEqual(secondOutput?.tokens, generate(model: model, inputIds: second, config: greedy(maxTokens: 4)).tokens)
+    }
+
+    // MARK: - Block Pool Tests
+
+    func testFinishedRowsReturnBlocks() throws {
+        let model = try makeTinyLlama()
+        let pool = KVBlockPool(numLayers: 2, blockCount: 16, blockSize: 4)
+
+        _ = runBatch(
+            BatchGenerator(model: model, pool: pool),
+            prompts: [[1, 2, 3, 4, 5, 6], [7, 8]],
+            config: greedy(maxTokens: 8)
+        )
+
+        XCTAssertEqual(pool.freeBlockCount, 16)
+    }
+
+    func testPreemptedRowResumesWithSameTokens() throws {
+        let model = try makeTinyLlama()
+        let prompts = [[1, 2, 3, 4, 5, 6], [7, 8, 9, 10, 11, 12]]
+        let solo = prompts.map { generate(model: model, inputIds: $0, config: greedy(maxTokens: 8)).tokens }
+
+        // Each row needs four blocks by its last step, so the second is sent back once
+        let pool = KVBlockPool(numLayers: 2, blockCount: 5, blockSize: 4)
+        let batched = runBatch(BatchGenerator(model: model, pool: pool), prompts: prompts, config: greedy(maxTokens: 8))
+
+        for (i, output) in batched.enumerated() {
+            XCTAssertEqual(output?.tokens, solo[i], "Row \(i) diverged from solo generation")
+            XCTAssertEqual(output?.finishReason, .length)
+        }
+        XCTAssertEqual(pool.freeBlockCount, 5)
+    }
+
+    func testRowOutgrowingPoolFinishesWithLength() throws {
+        let model = try makeTinyLlama()
+        let pool = KVBlockPool(numLayers: 2, blockCount: 2, blockSize: 4)
+
+        let generator = BatchGenerator(model: model, pool: pool)
+
+        let output = runBatch(generator, prompts: [[1, 2, 3]], config: greedy(maxTokens: 20))
+
+        // Eight positions hold the prompt and five fed tokens; the sixth is sampled but never fed
+        let expected = generate(model: model, inputIds: [1, 2, 3], config: greedy(maxTokens: 6)).tokens
+        XCTAssertEqual(output[0]?.tokens, expected)
+        XCTAssertEqual(output[0]?.finishReason, .length)
+    }
+
+    func testPromptLargerThanPoolFinishesWithLength() throws {
+        let model = try makeTinyLlama()
+        let pool = KVBlockPool(numLayers: 2, blockCount: 1, blockSize: 4)
+
+        let generator = BatchGenerator(model: model, pool: pool)
+
+        let output = runBatch(generator, prompts: [[1, 2, 3, 4, 5]], config: greedy(maxTokens: 4))
+
+        XCTAssertEqual(output[0]?.tokens, [])
+        XCTAssertEqual(output[0]?.finishReason, .length)
+    }
+
+    // MARK: - Prefix Cache Tests
+
+    func testPrefixCacheReuseMatchesFullPrefill() throws {
+        let model = try makeTinyLlama()
+        let prefixCache = PrefixCache(pool: KVBlockPool(model: model, maxBytes: 1 << 24), maxBytes: 1 << 24)
+        let generator = BatchGenerator(model: model, prefixCache: prefixCache)
+
+        _ = runBatch(generator, prompts: [[1, 2, 3, 4, 5, 6]], config: greedy(maxTokens: 4))
+        XCTAssertEqual(prefixCache.count, 1)
+
+        let prompt = [1, 2, 3, 4, 5, 6, 7, 8]
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 6)).tokens
+
+        let batched = runBatch(generator, prompts: [prompt], config: greedy(maxTokens: 6))
+        XCTAssertEqual(batched[0]?.tokens, expected)
+
+        let hit = try XCTUnwrap(prefixCache.fetch(prompt))
+        XCTAssertGreaterThanOrEqual(hit.length, 6)
+        let solo = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 6), promptCache: hit.cache)
+        XCTAssertEqual(solo.tokens, expected)
+    }
+
+    func testNewRowsReclaimPrefixBlocks() throws {
+        let model = try makeTinyLlama()
+        let pool = KVBlockPool(numLayers: 2, blockCount: 4, blockSize: 4)
+        let prefixCache = PrefixCache(pool: pool, maxBytes: 1 << 24)
+        let generator = BatchGenerator(model: model, prefixCache: prefixCache)
+
+        _ = runBatch(generator, prompts: [[1, 2, 3, 4, 5, 6]], config: greedy(maxTokens: 4))
+        XCTAssertEqual(pool.freeBlockCount, 1)
+
+        // The snapshot holds three of four blocks and gives them up for the new prompt
+        let prompt = [20, 21, 22, 23, 24, 25]
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 4)).tokens
+        let batched = runBatch(generator, prompts: [prompt], config: greedy(maxTokens: 4))
+
+        XCTAssertEqual(batched[0]?.tokens, expected)
+        XCTAssertEqual(prefixCache.count, 1)
+        XCTAssertNil(prefixCache.fetch([1, 2, 3, 4, 5, 6]))
+    }
+
+    // MARK: - Batched Sampling Tests
+
+    func testSampleTokensMixesGreedyRows() {
+        let logits = MLXArray([Float(0), 5, 1, 9, 0, 2]).reshaped([2, 3])
+        let tokens = sampleTokens(
+            logits: logits,
+            configs: [GenerationConfig(temperature: 0), GenerationConfig(temperature: 0)]
+        )
+        XCTAssertEqual(tokens, [1, 0])
+    }
+
+    // MARK: - Scheduler Tests
+
+    func testSchedulerRunsConcurrentRequests() throws {
+        let model = try makeTinyLlama()
+        let generator = BatchGenerator(model: model)
+        let scheduler = GenerationScheduler()
+
+        let done = expectation(description: "all requests finished")
+        done.expectedFulfillmentCount = 3
+        for prompt in [[1, 2, 3], [4, 5], [6]] {
+            scheduler.enqueue(BatchRequest(
+                inputIds: prompt, config: greedy(maxTokens: 5),
+                onToken: { _ in true },
+                completion: { output in
+                    XCTAssertEqual(output.tokens.count, 5)
+                    done.fulfill()
+                }
+            ), on: generator)
+        }
+
+        wait(for: [done], timeout: 30)
+    }
+}
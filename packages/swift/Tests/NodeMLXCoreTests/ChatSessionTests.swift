@@ -0,0 +1,168 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for ChatSession.swift
+
+import Foundation
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class ChatSessionTests: XCTestCase {
+    // MARK: - Turn Tests
+
+    func testAppendUsesSpecialTokensOnlyOnce() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+
+        XCTAssertEqual(session.append("12"), 3)
+        XCTAssertEqual(session.append("34"), 2)
+        XCTAssertEqual(session.tokens, [DigitTokenizer.bos, 1, 2, 3, 4])
+        XCTAssertEqual(session.cachedTokenCount, 0)
+    }
+
+    func testTurnsMatchOneShotGeneration() throws {
+        let model = try makeTinyLlama()
+        let session = ChatSession(model: model, tokenizer: DigitTokenizer())
+
+        session.append("123")
+        _ = session.generate(config: greedy(maxTokens: 4)) { _ in true }
+        XCTAssertGreaterThan(session.cachedTokenCount, 0)
+
+        session.append("45")
+        let history = session.tokens
+        let cachedBefore = session.cachedTokenCount
+        let result = session.generate(config: greedy(maxTokens: 4)) { _ in true }
+
+        let expected = generate(model: model, inputIds: history, config: greedy(maxTokens: 4))
+        XCTAssertEqual(Array(session.tokens.suffix(from: history.count)), expected.tokens)
+        XCTAssertEqual(result.tokenCount, expected.tokens.count)
+        XCTAssertGreaterThanOrEqual(session.cachedTokenCount, cachedBefore)
+    }
+
+    func testGenerateAfterFullyCachedHistory() throws {
+        let model = try makeTinyLlama()
+        let session = ChatSession(model: model, tokenizer: DigitTokenizer())
+        session.append("1234")
+
+        // Stopping from the callback leaves the last token unprocessed; rewinding
+        // it makes the cache cover the whole history
+        _ = session.generate(config: greedy(maxTokens: 3)) { _ in false }
+        session.rewind(1)
+        XCTAssertEqual(session.cachedTokenCount, session.tokens.count)
+
+        let history = session.tokens
+        _ = session.generate(config: greedy(maxTokens: 3)) { _ in true }
+        let expected = generate(model: model, inputIds: history, config: greedy(maxTokens: 3))
+        XCTAssertEqual(Array(session.tokens.suffix(from: history.count)), expected.tokens)
+    }
+
+    func testCacheBytesFollowCachedTokens() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+        XCTAssertEqual(session.cacheBytes, 0)
+
+        session.append("123")
+        _ = session.generate(config: greedy(maxTokens: 4)) { _ in true }
+
+        // Keys and values of 2 layers, 2 KV heads of 16 float32 dimensions
+        XCTAssertEqual(session.cacheBytes, session.cachedTokenCount * 2 * 2 * 2 * 16 * 4)
+    }
+
+    // MARK: - Rewind Tests
+
+    func testRewindTrimsCache() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+        session.append("123456")
+        _ = session.generate(config: greedy(maxTokens: 2)) { _ in true }
+
+        let remaining = session.rewind(4)
+        XCTAssertEqual(remaining, session.tokens.count)
+        XCTAssertLessThanOrEqual(session.cachedTokenCount, remaining)
+    }
+
+    func testRewindClampsToLength() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+        session.append("12")
+
+        XCTAssertEqual(session.rewind(10), 0)
+        XCTAssertEqual(session.cachedTokenCount, 0)
+    }
+
+    func testReset() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+        session.append("123")
+        _ = session.generate(config: greedy(maxTokens: 2)) { _ in true }
+
+        session.reset()
+        XCTAssertTrue(session.tokens.isEmpty)
+        XCTAssertEqual(session.cachedTokenCount, 0)
+    }
+
+    // MARK: - Persistence Tests
+
+    func testSavedSessionContinuesLikeOriginal() throws {
+        let model = try makeTinyLlama()
+        let session = ChatSession(model: model, tokenizer: DigitTokenizer())
+        session.append("123456")
+        _ = session.generate(config: greedy(maxTokens: 3)) { _ in true }
+
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).safetensors")
+        defer { try? FileManager.default.removeItem(at: url) }
+        try session.save(to: url)
+
+        let restored = try ChatSession.load(from: url, model: model, tokenizer: DigitTokenizer())
+        XCTAssertEqual(restored.tokens, session.tokens)
+        XCTAssertEqual(restored.cachedTokenCount, session.cachedTokenCount)
+
+        session.append("7")
+        restored.append("7")
+        _ = session.generate(config: greedy(maxTokens: 4)) { _ in true }
+        _ = restored.generate(config: greedy(maxTokens: 4)) { _ in true }
+        XCTAssertEqual(restored.tokens, session.tokens)
+    }
+
+    func testLoadRejectsOtherModel() throws {
+        let session = try ChatSession(model: makeTinyLlama(), tokenizer: DigitTokenizer())
+        session.append("123")
+        _ = session.generate(config: greedy(maxTokens: 2)) { _ in true }
+
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).safetensors")
+        defer { try? FileManager.default.removeItem(at: url) }
+        try session.save(to: url)
+
+        // Same architecture, different weights
+        let other = try makeTinyLlama()
+        other.update(parameters: other.parameters().mapValues { $0 + 1 })
+        eval(other.parameters())
+
+        XCTAssertThrowsError(try ChatSession.load(from: url, model: other, tokenizer: DigitTokenizer())) { error in
+            guard case PromptCacheError.modelMismatch = error else {
+                return XCTFail("Expected modelMismatch, got \(error)")
+            }
+        }
+    }
+}
+
+// MARK: - Test Tokenizer
+
+/// Maps each digit character to its value; BOS is added as a special token.
+private struct DigitTokenizer: TokenizerProtocol {
+    static let bos = 99
+
+    let vocabularySize = 100
+    let eosTokenId: Int? = nil
+    let bosTokenId: Int? = DigitTokenizer.bos
+
+    func encode(text: String) -> [Int] {
+        encode(text: text, addSpecialTokens: true)
+    }
+
+    func encode(text: String, addSpecialTokens: Bool) -> [Int] {
+        let digits = text.compactMap(\.wholeNumberValue)
+        return addSpecialTokens ? [Self.bos] + digits : digits
+    }
+
+    func decode(tokens: [Int]) -> String {
+        tokens.map(String.init).joined(separator: " ")
+    }
+}
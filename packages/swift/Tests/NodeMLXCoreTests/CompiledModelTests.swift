@@ -0,0 +1,116 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for CompiledModel.swift
+
+import Foundation
+import MLX
+import MLXNN
+import XCTest
+
+@testable import NodeMLXCore
+
+final class CompiledModelTests: XCTestCase {
+    // MARK: - Helpers
+
+    private var directory: URL!
+
+    override func setUpWithError() throws {
+        directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true)
+    }
+
+    override func tearDown() {
+        try? FileManager.default.removeItem(at: directory)
+        super.tearDown()
+    }
+
+    private func logits(_ model: LlamaModel) -> MLXArray {
+        var cache: [KVCacheProtocol]? = nil
+        return model(MLXArray([1, 2, 3, 4] as [Int32]).reshaped([1, 4]), cache: &cache)
+    }
+
+    // MARK: - Round Trip Tests
+
+    func testCompiledModelReproducesQuantizedModel() async throws {
+        let original = try makeTinyLlama(seed: 0)
+        quantizeLayers(in: original, settings: { path, _ in
+            path.contains("mlp") || path.contains("embed_tokens") ? (64, 4, .affine) : nil
+        })
+        XCTAssertTrue(original.model.embedTokens is QuantizedEmbedding)
+        eval(original.parameters())
+
+        let url = directory.appendingPathComponent("model.safetensors")
+        try saveCompiledModel(original, to: url)
+
+        let restored = try makeTinyLlama(seed: 1)
+        try await loadCompiledModel(restored, from: url)
+        eval(restored.parameters())
+
+        let layers = restored.leafModules().flattened()
+        XCTAssertEqual(layers.filter { $0.1 is QuantizedLinear }.count, 2 * 3)
+        XCTAssertEqual(layers.filter { $0.1 is QuantizedEmbedding }.map(\.0), ["model.embed_tokens"])
+        XCTAssertTrue(allClose(logits(restored), logits(original)).item(Bool.self))
+    }
+
+    func testSharedArraysAreStoredOnce() async throws {
+        let original = try makeTinyLlama(seed: 0)
+        let layers = original.parameters().flattened()
+        let (sharedName, sharedValue) = try XCTUnwrap(layers.first { $0.0.hasSuffix("input_layernorm.weight") })
+        let aliasName = try XCTUnwrap(layers.first { $0.0.hasSuffix("post_attention_layernorm.weight") }).0
+        original.update(parameters: ModuleParameters.unflattened([aliasName: sharedValue]))
+
+        let url = directory.appendingPathComponent("model.safetensors")
+        try saveCompiledModel(original, to: url)
+        XCTAssertNil(try SafetensorsFile(url: url).entries[aliasName])
+
+        let restored = try makeTinyLlama(seed: 1)
+        try await loadCompiledModel(restored, from: url)
+        let restoredParameters = Dictionary(uniqueKeysWithValues: restored.parameters().flattened())
+        XCTAssertTrue(restoredParameters[aliasName] === restoredParameters[sharedName])
+    }
+
+    func testRejectsPlainSafetensors() async throws {
+        let url = directory.appendingPathComponent("plain.safetensors")
+        try MLX.save(arrays: ["w": MLXArray.zeros([2])], url: url)
+
+        do {
+            try await loadCompiledModel(makeTinyLlama(seed: 0), from: url)
+            XCTFail("Expected an error")
+        } catch {}
+    }
+
+    // MARK: - Cache Key Tests
+
+    func testCacheKeyFollowsConfigAndWeights() throws {
+        let modelDirectory = directory.appendingPathComponent("model")
+        try FileManager.default.createDirectory(at: modelDirectory, withIntermediateDirectories: true)
+        try Data(tinyLlamaConfigJSON().utf8).write(to: modelDirectory.appendingPathComponent("config.json"))
+        try MLX.save(arrays: ["w": MLXArray.zeros([4])], url: modelDirectory.appendingPathComponent("model.safetensors"))
+
+        let cache = CompiledModelCache(directory: directory.appendingPathComponent("compiled"))
+        let first = try cache.url(forModelAt: modelDirectory)
+        XCTAssertEqual(try cache.url(forModelAt: modelDirectory), first)
+        XCTAssertEqual(first.deletingLastPathComponent(), cache.directory)
+
+        try MLX.save(arrays: ["w": MLXArray.zeros([8])], url: modelDirectory.appendingPathComponent("model.safetensors"))
+        let changedWeights = try cache.url(forModelAt: modelDirectory)
+        XCTAssertNotEqual(changedWeights, first)
+
+        try Data(tinyLlamaConfigJSON().replacingOccurrences(of: "128", with: "256").utf8)
+            .write(to: modelDirectory.appendingPathComponent("config.json"))
+        XCTAssertNotEqual(try cache.url(forModelAt: modelDirectory), changedWeights)
+    }
+
+    func testRevisionIgnoresNonWeightFiles() throws {
+        try Data(tinyLlamaConfigJSON().utf8).write(to: directory.appendingPathComponent("config.json"))
+        try MLX.save(arrays: ["w": MLXArray.zeros([4])], url: directory.appendingPathComponent("model.safetensors"))
+        let revision = try modelRevision(at: directory)
+
+        try Data("{}".utf8).write(to: directory.appendingPathComponent("tokenizer.json"))
+        XCTAssertEqual(try modelRevision(at: directory), revision)
+
+        try MLX.save(arrays: ["w": MLXArray.zeros([4])], url: directory.appendingPathComponent("extra.safetensors"))
+        XCTAssertNotEqual(try modelRevision(at: directory), revision)
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Embeddings.swift
+
+import MLX
+import MLXNN
+import XCTest
+
+@testable import NodeMLXCore
+
+final class EmbeddingsTests: XCTestCase {
+    // MARK: - Pooling Tests
+
+    func testPoolingSkipsPadding() {
+        // Two rows of [token, 1] states; the second row has one padded position
+        let hidden = MLXArray([Float(3), 1, 5, 1, 7, 1, 2, 1, 0, 0, 0, 0]).reshaped([2, 3, 2])
+        let lengths = [3, 1]
+
+        XCTAssertEqual(poolHiddenStates(hidden, lengths: lengths, pooling: .mean).asArray(Float.self), [5, 1, 2, 1])
+        XCTAssertEqual(poolHiddenStates(hidden, lengths: lengths, pooling: .last).asArray(Float.self), [7, 1, 2, 1])
+        XCTAssertEqual(poolHiddenStates(hidden, lengths: lengths, pooling: .cls).asArray(Float.self), [3, 1, 2, 1])
+    }
+
+    // MARK: - Embedding Tests
+
+    func testEmbedKeepsInputOrder() throws {
+        let model = TokenStateModel()
+        let config = EmbeddingConfig(pooling: .last, normalize: false)
+
+        let embeddings = try embed(model: model, sequences: [[1], [2, 3, 4], [5, 6]], config: config)
+
+        XCTAssertEqual(embeddings.shape, [3, 2])
+        XCTAssertEqual(embeddings.asArray(Float.self), [1, 1, 4, 1, 6, 1])
+    }
+
+    func testEmbedBatchesByTokenBudget() throws {
+        let model = TokenStateModel()
+        let config = EmbeddingConfig(maxBatchTokens: 6)
+
+        _ = try embed(model: model, sequences: [[1], [2, 3, 4], [5, 6], [7, 8, 9, 10, 11, 12, 13]], config: config)
+
+        // Longest first; a sequence longer than the budget runs alone
+        XCTAssertEqual(model.batchShapes, [[1, 7], [2, 3], [1, 1]])
+    }
+
+    func testEmbedNormalizes() throws {
+        let embeddings = try embed(model: TokenStateModel(), sequences: [[3], [4, 2]])
+
+        let values = embeddings.asArray(Float.self)
+        XCTAssertEqual(values[0] * values[0] + values[1] * values[1], 1, accuracy: 1e-5)
+        XCTAssertEqual(values[2] * values[2] + values[3] * values[3], 1, accuracy: 1e-5)
+        XCTAssertEqual(values[2] / values[3], 3, accuracy: 1e-4)
+    }
+
+    func testLayerSelectsDepth() throws {
+        let model = TokenStateModel()
+
+        for layer in [-1, 2, 0, -3, 1] {
+            _ = try embed(model: model, sequences: [[1]], config: EmbeddingConfig(layer: layer))
+        }
+
+        XCTAssertEqual(model.depths, [nil, nil, 0, 0, 1])
+    }
+
+    func testInvalidInputThrows() {
+        let model = TokenStateModel()
+
+        XCTAssertThrowsError(try embed(model: model, sequences: []))
+        XCTAssertThrowsError(try embed(model: model, sequences: [[1], []]))
+        XCTAssertThrowsError(try embed(model: model, sequences: [[1]], config: EmbeddingConfig(layer: 3)))
+        XCTAssertThrowsError(try embed(model: model, sequences: [[1]], config: EmbeddingConfig(layer: -4)))
+    }
+}
+
+// MARK: - Test Model
+
+/// Two-layer model whose hidden state at each position is [token, 1].
+private final class TokenStateModel: Module, LLMModel {
+    let vocabularySize = 16
+    let numLayers = 2
+    let numKVHeads = 1
+    let headDim = 1
+
+    /// Input shape and depth of every hidden state pass, in call order.
+    private(set) var batchShapes: [[Int]] = []
+    private(set) var depths: [Int?] = []
+
+    func callAsFunction(_ inputIds: MLXArray, cache _: inout [KVCacheProtocol]?) -> MLXArray {
+        MLXArray.zeros([inputIds.dim(0), inputIds.dim(1), vocabularySize])
+    }
+
+    func hiddenStates(_ inputIds: MLXArray, depth: Int?) -> MLXArray {
+        batchShapes.append(inputIds.shape)
+        depths.append(depth)
+        let tokens = inputIds.asType(.float32).expandedDimensions(axis: -1)
+        return concatenated([tokens, MLXArray.zeros(like: tokens) + 1], axis: -1)
+    }
+
+    func newCache() -> [any KVCacheProtocol] {
+        []
+    }
+
+    func sanitize(weights: [String: MLXArray]) -> [String: MLXArray] {
+        weights
+    }
+}
@@ -8,6 +8,7 @@
 // Git Hash: 7585c142a6be9c9245f4ce61d087839776cb8275 (2026-01-12)
 
 import MLX
+import MLXNN
 import XCTest
 
 @testable import NodeMLXCore
@@ -23,6 +24,10 @@ final class GenerateTests: XCTestCase {
         XCTAssertEqual(config.topP, 0.9, accuracy: 1e-5)
         XCTAssertEqual(config.repetitionPenalty, 1.0, accuracy: 1e-5)
         XCTAssertTrue(config.stopTokens.isEmpty)
+        XCTAssertNil(config.timeLimit)
+        XCTAssertNil(config.maxPrefillTime)
+        XCTAssertNil(config.cancellation)
+        XCTAssertEqual(config.prefillStepSize, 2048)
     }
 
     func testCustomConfig() {
@@ -85,6 +90,23 @@ final class GenerateTests: XCTestCase {
         XCTAssertEqual(token, 2)
     }
 
+    func testSampleStaysOnDevice() {
+        let logits = MLXArray([Float(1.0), 2.0, 5.0, 3.0]).reshaped([1, 4])
+
+        let token = sample(logits: logits, temperature: 0)
+        XCTAssertEqual(token.shape, [1])
+        XCTAssertEqual(token.item(Int.self), 2)
+    }
+
+    func testTopPDropsTail() {
+        // Index 2 holds 97% of the mass, so top-p 0.5 leaves nothing else to sample
+        let logits = log(MLXArray([Float(0.01), 0.01, 0.97, 0.01]))
+
+        for _ in 0 ..< 10 {
+            XCTAssertEqual(sampleToken(logits: logits, temperature: 1.0, topP: 0.5), 2)
+        }
+    }
+
     // MARK: - Streaming Generator Tests
 
     func testGenerationStepStructure() {
@@ -103,6 +125,184 @@ final class GenerateTests: XCTestCase {
         XCTAssertNil(step.text)
     }
 
+    // MARK: - Cancellation Tests
+
+    func testCancellationToken() {
+        let token = CancellationToken()
+        XCTAssertFalse(token.isCancelled)
+
+        token.cancel()
+        XCTAssertTrue(token.isCancelled)
+    }
+
+    func testCancellationTokenExternalFlag() {
+        let flag = UnsafeMutablePointer<Int32>.allocate(capacity: 1)
+        defer { flag.deallocate() }
+        flag.pointee = 0
+
+        let token = CancellationToken(externalFlag: UnsafePointer(flag))
+        XCTAssertFalse(token.isCancelled)
+
+        flag.pointee = 1
+        XCTAssertTrue(token.isCancelled)
+    }
+
+    func testCancellationTokenFollowsLinkedTokens() {
+        let request = CancellationToken()
+        let engine = CancellationToken()
+        let token = CancellationToken(linkedTo: [request, engine])
+        XCTAssertFalse(token.isCancelled)
+
+        engine.cancel()
+        XCTAssertTrue(token.isCancelled)
+        XCTAssertFalse(request.isCancelled)
+    }
+
+    func testGenerateFinishesWithLength() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+
+        let output = generate(model: model, inputIds: [1, 2], config: GenerationConfig(maxTokens: 4, temperature: 0))
+
+        XCTAssertEqual(output.tokens, [3, 3, 3, 3])
+        XCTAssertEqual(output.finishReason, .length)
+    }
+
+    func testGenerateQueuesOnlyNeededSteps() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+
+        _ = generate(model: model, inputIds: [1, 2], config: GenerationConfig(maxTokens: 4, temperature: 0))
+
+        // Prompt, then one decode step per token after the first
+        XCTAssertEqual(model.inputLengths, [2, 1, 1, 1])
+    }
+
+    func testGenerateFinishesWithStopToken() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let config = GenerationConfig(maxTokens: 4, temperature: 0, stopTokens: [3])
+
+        let output = generate(model: model, inputIds: [1], config: config)
+
+        XCTAssertTrue(output.tokens.isEmpty)
+        XCTAssertEqual(output.finishReason, .stop)
+    }
+
+    func testLogitsProcessorAdjustsSampling() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        var prompts: [[Int]] = []
+        let config = GenerationConfig(maxTokens: 2, temperature: 0, logitsProcessors: [{ prompt in
+            prompts.append(prompt)
+            return ScriptedProcessor(boost: 5)
+        }])
+
+        let output = generate(model: model, inputIds: [1, 2], config: config)
+
+        XCTAssertEqual(output.tokens, [5, 5])
+        XCTAssertEqual(prompts, [[1, 2]])
+    }
+
+    func testForcedTokensSkipSampling() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let processor = ScriptedProcessor(forced: [5, 6])
+        let config = GenerationConfig(maxTokens: 4, temperature: 0, logitsProcessors: [{ _ in processor }])
+
+        let output = generate(model: model, inputIds: [1, 2], config: config)
+
+        XCTAssertEqual(output.tokens, [5, 6, 3, 3])
+        // Both forced tokens are fed in one forward pass
+        XCTAssertEqual(model.inputLengths, [2, 2, 1])
+        XCTAssertEqual(processor.sampled, [5, 6, 3, 3])
+    }
+
+    func testForcedTokensRespectMaxTokens() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let config = GenerationConfig(
+            maxTokens: 3, temperature: 0, logitsProcessors: [{ _ in ScriptedProcessor(forced: [5, 6, 7, 4]) }]
+        )
+
+        let output = generate(model: model, inputIds: [1], config: config)
+
+        XCTAssertEqual(output.tokens, [5, 6, 7])
+        XCTAssertEqual(output.finishReason, .length)
+        XCTAssertEqual(model.inputLengths, [1])
+    }
+
+    func testGenerateStopsWhenCancelled() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let cancellation = CancellationToken()
+        let config = GenerationConfig(maxTokens: 100, temperature: 0, cancellation: cancellation)
+
+        let output = generate(model: model, inputIds: [1], config: config) { _ in
+            cancellation.cancel()
+            return true
+        }
+
+        // Cancellation is observed before the next step
+        XCTAssertEqual(output.tokens.count, 1)
+        XCTAssertEqual(output.finishReason, .cancelled)
+    }
+
+    func testGenerateAlreadyCancelled() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let cancellation = CancellationToken()
+        cancellation.cancel()
+
+        let output = generate(model: model, inputIds: [1], config: GenerationConfig(cancellation: cancellation))
+
+        XCTAssertTrue(output.tokens.isEmpty)
+        XCTAssertEqual(output.finishReason, .cancelled)
+    }
+
+    func testGenerateCallbackStop() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+
+        let output = generate(model: model, inputIds: [1], config: GenerationConfig(maxTokens: 100)) { _ in false }
+
+        XCTAssertEqual(output.tokens.count, 1)
+        XCTAssertEqual(output.finishReason, .cancelled)
+    }
+
+    func testGenerateTimeLimit() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+
+        let output = generate(model: model, inputIds: [1], config: GenerationConfig(maxTokens: 100, timeLimit: 0))
+
+        XCTAssertTrue(output.tokens.isEmpty)
+        XCTAssertEqual(output.finishReason, .timeout)
+    }
+
+    // MARK: - Chunked Prefill Tests
+
+    func testPrefillSplitsPromptIntoChunks() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        var cache: [KVCacheProtocol]? = nil
+
+        let logits = prefill(model: model, inputIds: Array(0 ..< 10)[...], cache: &cache, stepSize: 4)
+
+        XCTAssertEqual(model.inputLengths, [4, 4, 2])
+        XCTAssertEqual(logits?.shape, [1, 2, 8])
+    }
+
+    func testPrefillStopsBetweenChunks() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        var cache: [KVCacheProtocol]? = nil
+
+        let logits = prefill(model: model, inputIds: Array(0 ..< 10)[...], cache: &cache, stepSize: 4) { true }
+
+        XCTAssertNil(logits)
+        XCTAssertEqual(model.inputLengths, [4])
+    }
+
+    func testGeneratePrefillTimeoutBetweenChunks() {
+        let model = ConstantLogitsModel(vocabularySize: 8, favoredToken: 3)
+        let config = GenerationConfig(maxTokens: 4, temperature: 0, maxPrefillTime: 0, prefillStepSize: 1)
+
+        let output = generate(model: model, inputIds: [1, 2, 3], config: config)
+
+        XCTAssertTrue(output.tokens.isEmpty)
+        XCTAssertEqual(output.finishReason, .timeout)
+        XCTAssertEqual(model.inputLengths, [1])
+    }
+
     // MARK: - Edge Cases
 
     func testSamplingUniformLogits() {
@@ -132,3 +332,75 @@ final class GenerateTests: XCTestCase {
         XCTAssertEqual(token, 5000)
     }
 }
+
+// MARK: - Test Processor
+
+/// Processor that boosts one token and forces a fixed sequence once.
+private final class ScriptedProcessor: LogitsProcessor {
+    private let boost: Int?
+    private var forced: [Int]
+
+    /// Every token passed to `didSample`.
+    private(set) var sampled: [Int] = []
+
+    init(boost: Int? = nil, forced: [Int] = []) {
+        self.boost = boost
+        self.forced = forced
+    }
+
+    func process(_ logits: MLXArray) -> MLXArray {
+        guard let boost else { return logits }
+        let bonus = MLXArray((0 ..< logits.dim(-1)).map { Float($0 == boost ? 100 : 0) })
+        return logits + bonus
+    }
+
+    func didSample(_ tokens: MLXArray) {
+        sampled += tokens.asArray(Int32.self).map { Int($0) }
+    }
+
+    func forcedTokens() -> [Int] {
+        defer { forced = [] }
+        return forced
+    }
+}
+
+// MARK: - Test Model
+
+/// Minimal model that always predicts the same token, for exercising the generation loop.
+private final class ConstantLogitsModel: Module, LLMModel {
+    let vocabularySize: Int
+    let numLayers = 0
+    let numKVHeads = 1
+    let headDim = 1
+
+    private let favoredToken: Int
+
+    /// Sequence length of every forward pass, in call order.
+    private(set) var inputLengths: [Int] = []
+
+    init(vocabularySize: Int, favoredToken: Int) {
+        self.vocabularySize = vocabularySize
+        self.favoredToken = favoredToken
+        super.init()
+    }
+
+    func callAsFunction(_ inputIds: MLXArray, cache _: inout [KVCacheProtocol]?) -> MLXArray {
+        inputLengths.append(inputIds.dim(1))
+        var row = [Float](repeating: 0, count: vocabularySize)
+        row[favoredToken] = 10
+        let logits = MLXArray(row).reshaped([1, 1, vocabularySize])
+        return broadcast(logits, to: [inputIds.dim(0), inputIds.dim(1), vocabularySize])
+    }
+
+    func hiddenStates(_ inputIds: MLXArray, depth _: Int?) -> MLXArray {
+        MLXArray.zeros([inputIds.dim(0), inputIds.dim(1), 1])
+    }
+
+    func newCache() -> [any KVCacheProtocol] {
+        []
+    }
+
+    func sanitize(weights: [String: MLXArray]) -> [String: MLXArray] {
+        weights
+    }
+}
@@ -0,0 +1,77 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Grammar.swift
+
+import XCTest
+
+@testable import NodeMLXCore
+
+final class GrammarTests: XCTestCase {
+    // MARK: - Matching Tests
+
+    func testLiteralsAndQuantifiers() throws {
+        let grammar = try Grammar(regex: "ab+c?d{2,3}")
+
+        XCTAssertTrue(grammar.matches("abdd"))
+        XCTAssertTrue(grammar.matches("abbbcddd"))
+        XCTAssertFalse(grammar.matches("acdd"))
+        XCTAssertFalse(grammar.matches("abdddd"))
+        XCTAssertFalse(grammar.matches("abd"))
+    }
+
+    func testGroupsAndAlternation() throws {
+        let grammar = try Grammar(regex: "^(?:yes|no)(, (maybe))*$")
+
+        XCTAssertTrue(grammar.matches("yes"))
+        XCTAssertTrue(grammar.matches("no, maybe, maybe"))
+        XCTAssertFalse(grammar.matches("yes, no"))
+    }
+
+    func testCharacterClasses() throws {
+        let grammar = try Grammar(regex: #"[a-c_]\d[^x]\w\s"#)
+
+        XCTAssertTrue(grammar.matches("a1yZ "))
+        XCTAssertTrue(grammar.matches("_9-0\t"))
+        XCTAssertFalse(grammar.matches("d1yZ "))
+        XCTAssertFalse(grammar.matches("a1xZ "))
+    }
+
+    func testNonASCIICharacters() throws {
+        let grammar = try Grammar(regex: #"(?:é|[^"])+"#)
+
+        XCTAssertTrue(grammar.matches("héllo wörld"))
+        XCTAssertTrue(grammar.matches("日本"))
+        XCTAssertFalse(grammar.matches("say \"hi\""))
+    }
+
+    func testEscapes() throws {
+        let grammar = try Grammar(regex: #"\{\x41é\.\}"#)
+
+        XCTAssertTrue(grammar.matches("{Aé.}"))
+        XCTAssertFalse(grammar.matches("{Aéx}"))
+    }
+
+    // MARK: - Error Tests
+
+    func testInvalidPatternsThrow() {
+        for pattern in ["(ab", "ab)", "*a", "a{3,2}", "[abc", #"\b"#, "(?=a)"] {
+            XCTAssertThrowsError(try Grammar(regex: pattern), pattern)
+        }
+    }
+
+    // MARK: - Automaton Tests
+
+    func testForcedBytes() throws {
+        let automaton = try Grammar(regex: "key: (?:1|2)").automaton
+
+        var state = automaton.start
+        var forced: [UInt8] = []
+        while let byte = automaton.forcedByte(state) {
+            forced.append(byte)
+            state = automaton.next(state, byte)!
+        }
+
+        XCTAssertEqual(String(decoding: forced, as: UTF8.self), "key: ")
+    }
+}
@@ -181,6 +181,27 @@ final class IntegrationTests: XCTestCase {
         engine.unload()
     }
 
+    func testSharedWeightsEngine() async throws {
+        try skipIfNoMetal()
+
+        let engine = LLMEngine()
+        try await engine.loadModel(modelId: defaultTestModelId)
+        let shared = LLMEngine(sharingWeightsOf: engine, prefixCacheBytes: 0)
+
+        XCTAssertTrue(shared.isLoaded)
+        XCTAssertEqual(shared.weightsFootprint, engine.weightsFootprint)
+        XCTAssertEqual(shared.cacheFootprint, 0)
+
+        // The weights outlive the engine that loaded them
+        let config = GenerationConfig(maxTokens: 10, temperature: 0)
+        let expected = try engine.generate(prompt: "Say hello:", config: config)
+        engine.unload()
+
+        XCTAssertEqual(try shared.generate(prompt: "Say hello:", config: config), expected)
+
+        shared.unload()
+    }
+
     func testEarlyStopGeneration() async throws {
         try skipIfNoMetal()
 
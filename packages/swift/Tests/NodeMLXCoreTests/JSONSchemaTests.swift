@@ -0,0 +1,105 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for JSONSchema.swift
+
+import XCTest
+
+@testable import NodeMLXCore
+
+final class JSONSchemaTests: XCTestCase {
+    // MARK: - Object Tests
+
+    func testObjectKeepsPropertyOrder() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"type": "object", "properties": {"name": {"type": "string"}, "age": {"type": "integer"}},
+         "required": ["name", "age"]}
+        """)
+
+        XCTAssertTrue(grammar.matches(#"{"name": "Ann \"Jr\"", "age": 42}"#))
+        XCTAssertFalse(grammar.matches(#"{"age": 42, "name": "Ann"}"#))
+        XCTAssertFalse(grammar.matches(#"{"name": "Ann"}"#))
+        XCTAssertFalse(grammar.matches(#"{"name":"Ann","age":42}"#))
+    }
+
+    func testOptionalProperties() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"properties": {"a": {"type": "boolean"}, "b": {"type": "null"}, "c": {"type": "number"}},
+         "required": ["b"]}
+        """)
+
+        XCTAssertTrue(grammar.matches(#"{"b": null}"#))
+        XCTAssertTrue(grammar.matches(#"{"a": true, "b": null, "c": -1.5e3}"#))
+        XCTAssertTrue(grammar.matches(#"{"b": null, "c": 0}"#))
+        XCTAssertFalse(grammar.matches(#"{"a": false}"#))
+    }
+
+    func testAllPropertiesOptional() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"type": "object", "properties": {"a": {"type": "integer"}, "b": {"type": "integer"}}}
+        """)
+
+        XCTAssertTrue(grammar.matches("{}"))
+        XCTAssertTrue(grammar.matches(#"{"b": 2}"#))
+        XCTAssertTrue(grammar.matches(#"{"a": 1, "b": 2}"#))
+        XCTAssertFalse(grammar.matches(#"{, "b": 2}"#))
+    }
+
+    // MARK: - Value Tests
+
+    func testArraysHonorItemLimits() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"type": "array", "items": {"type": "integer"}, "minItems": 1, "maxItems": 2}
+        """)
+
+        XCTAssertTrue(grammar.matches("[1]"))
+        XCTAssertTrue(grammar.matches("[1, 2]"))
+        XCTAssertFalse(grammar.matches("[]"))
+        XCTAssertFalse(grammar.matches("[1, 2, 3]"))
+    }
+
+    func testEnumAndConstAreLiteral() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"anyOf": [{"enum": ["a.b", 1, null]}, {"const": {"k": [true]}}]}
+        """)
+
+        XCTAssertTrue(grammar.matches(#""a.b""#))
+        XCTAssertTrue(grammar.matches("null"))
+        XCTAssertTrue(grammar.matches(#"{"k": [true]}"#))
+        XCTAssertFalse(grammar.matches(#""axb""#))
+    }
+
+    func testStringLengthAndFormat() throws {
+        let short = try Grammar(jsonSchema: #"{"type": "string", "maxLength": 2}"#)
+        XCTAssertTrue(short.matches(#""ab""#))
+        XCTAssertFalse(short.matches(#""abc""#))
+
+        let date = try Grammar(jsonSchema: #"{"type": "string", "format": "date"}"#)
+        XCTAssertTrue(date.matches(#""2024-05-01""#))
+        XCTAssertFalse(date.matches(#""May 1""#))
+    }
+
+    func testLocalReferences() throws {
+        let grammar = try Grammar(jsonSchema: """
+        {"type": "array", "items": {"$ref": "#/$defs/flag"}, "$defs": {"flag": {"type": "boolean"}}}
+        """)
+
+        XCTAssertTrue(grammar.matches("[true, false]"))
+    }
+
+    // MARK: - Error Tests
+
+    func testRecursiveSchemaThrows() {
+        let schema = """
+        {"type": "object", "properties": {"child": {"$ref": "#"}}}
+        """
+
+        XCTAssertThrowsError(try Grammar(jsonSchema: schema))
+    }
+
+    func testInvalidSchemasThrow() {
+        for schema in ["{", #"{"type": "tuple"}"#, #"{"type": "array"}"#, "{}", "[1]"] {
+            XCTAssertThrowsError(try Grammar(jsonSchema: schema), schema)
+        }
+    }
+}
@@ -3,7 +3,9 @@
 //
 // Tests for ported/KVCache.swift
 
+import Foundation
 import MLX
+import MLXFast
 import XCTest
 
 @testable import NodeMLXCore
@@ -83,6 +85,69 @@ final class KVCacheTests: XCTestCase {
         XCTAssertEqual(cache.offset, 7)
     }
 
+    func testStandardKVCacheGrowsGeometrically() {
+        let cache = StandardKVCache()
+        var capacities: [Int] = []
+
+        // 40 prefill chunks of 100 tokens, as in a long multi-turn chat
+        for _ in 0 ..< 40 {
+            _ = cache.update(keys: MLXArray.ones([1, 2, 100, 8]), values: MLXArray.ones([1, 2, 100, 8]))
+            if capacities.last != cache.capacity {
+                capacities.append(cache.capacity)
+            }
+        }
+
+        XCTAssertEqual(cache.offset, 4000)
+        XCTAssertEqual(capacities, [256, 512, 1024, 2048, 4096])
+    }
+
+    func testStandardKVCacheKeepsContentsWhenGrowing() {
+        let cache = StandardKVCache()
+        for position in 0 ..< 300 {
+            let kv = MLXArray.full([1, 1, 1, 2], values: MLXArray(Float(position)))
+            _ = cache.update(keys: kv, values: kv)
+        }
+
+        let keys = cache.state!.keys[0, 0, 0..., 0].asArray(Float.self)
+        XCTAssertEqual(keys, (0 ..< 300).map { Float($0) })
+    }
+
+    func testStandardKVCacheReserve() {
+        let cache = StandardKVCache()
+        cache.reserve(1000)
+        XCTAssertEqual(cache.capacity, 0, "Nothing is allocated before the shape is known")
+
+        _ = cache.update(keys: MLXArray.ones([1, 2, 10, 8]), values: MLXArray.ones([1, 2, 10, 8]))
+        XCTAssertEqual(cache.capacity, 1024)
+
+        for _ in 0 ..< 990 {
+            _ = cache.update(keys: MLXArray.ones([1, 2, 1, 8]), values: MLXArray.ones([1, 2, 1, 8]))
+        }
+        XCTAssertEqual(cache.capacity, 1024)
+
+        // Reserving on a filled cache keeps its contents
+        cache.reserve(2000)
+        XCTAssertEqual(cache.capacity, 2048)
+        XCTAssertEqual(cache.state?.keys.dim(2), 1000)
+    }
+
+    func testStandardKVCacheChunkedPrefillGrowsGeometrically() {
+        // Chunked prefill onto a growing cache: each growth used to copy the whole history
+        let cache = StandardKVCache()
+        let chunk = MLXArray.ones([1, 1, 512, 2])
+
+        var capacities: [Int] = []
+        for _ in 0 ..< 64 {
+            _ = cache.update(keys: chunk, values: chunk)
+            if capacities.last != cache.capacity {
+                capacities.append(cache.capacity)
+            }
+        }
+
+        XCTAssertEqual(cache.offset, 64 * 512)
+        XCTAssertEqual(capacities, [512, 1024, 2048, 4096, 8192, 16384, 32768])
+    }
+
     func testStandardKVCacheMakeMask() {
         let cache = StandardKVCache()
 
@@ -185,14 +250,117 @@ final class KVCacheTests: XCTestCase {
         let (updatedKeys, updatedValues) = cache.update(keys: keys, values: values)
 
         XCTAssertEqual(cache.offset, 8)
-        // Quantized output has compressed dimensions due to quantization
-        // The actual shape depends on bits and groupSize
-        XCTAssertEqual(updatedKeys.dim(0), 1)
-        XCTAssertEqual(updatedKeys.dim(1), 4)
-        XCTAssertEqual(updatedKeys.dim(2), 8)
-        XCTAssertEqual(updatedValues.dim(0), 1)
-        XCTAssertEqual(updatedValues.dim(1), 4)
-        XCTAssertEqual(updatedValues.dim(2), 8)
+        // update returns dequantized keys and values, like any other cache
+        XCTAssertEqual(updatedKeys.shape, [1, 4, 8, 64])
+        XCTAssertEqual(updatedValues.shape, [1, 4, 8, 64])
+        XCTAssertTrue(allClose(updatedKeys, keys).item(Bool.self))
+    }
+
+    func testQuantizedKVCacheUpdateQuantized() {
+        let cache = QuantizedKVCache(groupSize: 64, bits: 4)
+
+        let (keys, values) = cache.updateQuantized(
+            keys: MLXArray.ones([1, 2, 5, 128]),
+            values: MLXArray.ones([1, 2, 5, 128])
+        )
+
+        // 8 four-bit values per UInt32, one scale per group of 64
+        XCTAssertEqual(keys.0.shape, [1, 2, 5, 16])
+        XCTAssertEqual(keys.1.shape, [1, 2, 5, 2])
+        XCTAssertEqual(values.0.shape, [1, 2, 5, 16])
+    }
+
+    func testQuantizedAttentionMatchesDequantized() {
+        MLXRandom.seed(0)
+        let cache = QuantizedKVCache(groupSize: 64, bits: 8)
+        let queries = MLXRandom.normal([1, 4, 3, 64])
+
+        _ = cache.update(keys: MLXRandom.normal([1, 2, 5, 64]), values: MLXRandom.normal([1, 2, 5, 64]))
+        let (keys, values) = cache.updateQuantized(
+            keys: MLXRandom.normal([1, 2, 3, 64]),
+            values: MLXRandom.normal([1, 2, 3, 64])
+        )
+        let state = cache.state!
+
+        let output = quantizedScaledDotProductAttention(
+            queries: queries, keys: keys, values: values, scale: 0.125, mask: .causal, groupSize: 64, bits: 8
+        )
+        let expected = MLXFast.scaledDotProductAttention(
+            queries: queries, keys: state.keys, values: state.values, scale: 0.125, mask: .causal
+        )
+
+        XCTAssertEqual(output.shape, [1, 4, 3, 64])
+        XCTAssertTrue(allClose(output, expected, atol: 1e-3).item(Bool.self))
+    }
+
+    func testMaybeQuantizeKVCacheAfterThreshold() {
+        let short = StandardKVCache()
+        let long = StandardKVCache()
+        _ = short.update(keys: MLXArray.ones([1, 2, 2, 64]), values: MLXArray.ones([1, 2, 2, 64]))
+        _ = long.update(keys: MLXArray.ones([1, 2, 6, 64]), values: MLXArray.ones([1, 2, 6, 64]))
+
+        var cache: [KVCacheProtocol]? = [short, long]
+        maybeQuantizeKVCache(&cache, config: GenerationConfig(kvBits: 4, quantizedKvStart: 4))
+
+        XCTAssertTrue(cache?[0] is StandardKVCache)
+        let quantized = cache?[1] as? QuantizedKVCache
+        XCTAssertEqual(quantized?.bits, 4)
+        XCTAssertEqual(quantized?.offset, 6)
+    }
+
+    // MARK: - BatchKVCache Tests
+
+    func testBatchKVCacheOffsetStartsAtGivenPosition() {
+        let cache = BatchKVCache(offset: -3)
+        XCTAssertEqual(cache.offset, -3)
+
+        _ = cache.update(keys: MLXArray.ones([1, 4, 5, 64]), values: MLXArray.ones([1, 4, 5, 64]))
+        XCTAssertEqual(cache.offset, 2)
+        XCTAssertEqual(cache.idx, 5)
+    }
+
+    func testBatchKVCacheExtendAlignsRows() {
+        let batch = BatchKVCache()
+        _ = batch.update(keys: MLXArray.ones([1, 4, 6, 64]), values: MLXArray.ones([1, 4, 6, 64]))
+
+        // Shorter prompt prefilled at positions ending at the batch offset
+        let row = BatchKVCache(offset: 6 - 2)
+        _ = row.update(keys: MLXArray.ones([1, 4, 2, 64]), values: MLXArray.ones([1, 4, 2, 64]))
+
+        batch.extend(row)
+
+        XCTAssertEqual(batch.batchSize, 2)
+        XCTAssertEqual(batch.leftPadding, [0, 4])
+        XCTAssertEqual(batch.offset, 6)
+        XCTAssertEqual(batch.state?.keys.shape, [2, 4, 6, 64])
+    }
+
+    func testBatchKVCacheMaskHidesPadding() {
+        let cache = BatchKVCache(leftPadding: [0, 2])
+        _ = cache.update(keys: MLXArray.ones([2, 4, 4, 64]), values: MLXArray.ones([2, 4, 4, 64]))
+
+        guard case let .array(mask) = cache.makeMask(queryLength: 1) else {
+            XCTFail("Expected .array for padded batch")
+            return
+        }
+
+        XCTAssertEqual(mask.shape, [2, 1, 1, 5])
+        XCTAssertEqual(mask[0].asArray(Bool.self), [true, true, true, true, true])
+        XCTAssertEqual(mask[1].asArray(Bool.self), [false, false, true, true, true])
+    }
+
+    func testBatchKVCacheFilterDropsSharedPadding() {
+        let cache = BatchKVCache(leftPadding: [0, 2, 3])
+        _ = cache.update(keys: MLXArray.ones([3, 4, 5, 64]), values: MLXArray.ones([3, 4, 5, 64]))
+        let offset = cache.offset
+
+        cache.filter([2, 1])
+
+        XCTAssertEqual(cache.batchSize, 2)
+        XCTAssertEqual(cache.leftPadding, [1, 0])
+        XCTAssertEqual(cache.idx, 3)
+        XCTAssertEqual(cache.offset, offset)
+        XCTAssertEqual(cache.state?.keys.shape, [2, 4, 3, 64])
     }
 
     // MARK: - Helper Function Tests
@@ -276,4 +444,70 @@ final class KVCacheTests: XCTestCase {
         XCTAssertEqual(trimmed, 3)
         XCTAssertEqual(cache.offset, 7)
     }
+
+    // MARK: - Serialization Tests
+
+    private func temporaryURL() -> URL {
+        FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).safetensors")
+    }
+
+    func testSavePromptCacheRoundTrip() throws {
+        let standard = StandardKVCache()
+        _ = standard.update(keys: MLXRandom.normal([1, 2, 5, 64]), values: MLXRandom.normal([1, 2, 5, 64]))
+
+        // Rotated past its window, so storage order differs from temporal order
+        let rotating = RotatingKVCache(maxSize: 8, keep: 2)
+        _ = rotating.update(keys: MLXRandom.normal([1, 2, 6, 64]), values: MLXRandom.normal([1, 2, 6, 64]))
+        for _ in 0 ..< 5 {
+            _ = rotating.update(keys: MLXRandom.normal([1, 2, 1, 64]), values: MLXRandom.normal([1, 2, 1, 64]))
+        }
+
+        let quantized = QuantizedKVCache(groupSize: 64, bits: 4)
+        _ = quantized.update(keys: MLXRandom.normal([1, 2, 5, 64]), values: MLXRandom.normal([1, 2, 5, 64]))
+
+        let url = temporaryURL()
+        defer { try? FileManager.default.removeItem(at: url) }
+
+        let cache: [KVCacheProtocol] = [standard, rotating, quantized, StandardKVCache()]
+        try savePromptCache(url: url, cache: cache, metadata: ["note": "test"])
+        let (loaded, metadata) = try loadPromptCache(url: url)
+
+        XCTAssertEqual(metadata, ["note": "test"])
+        XCTAssertEqual(loaded.map(\.offset), [5, 11, 5, 0])
+        XCTAssertTrue(loaded[0] is StandardKVCache)
+        XCTAssertEqual((loaded[1] as? RotatingKVCache)?.maxSize, 8)
+        XCTAssertEqual((loaded[2] as? QuantizedKVCache)?.bits, 4)
+        XCTAssertNil(loaded[3].state)
+
+        for (original, restored) in zip(cache.prefix(3), loaded) {
+            let (keys, values) = try XCTUnwrap(original.state)
+            let (loadedKeys, loadedValues) = try XCTUnwrap(restored.state)
+            XCTAssertTrue(allClose(loadedKeys, keys).item(Bool.self))
+            XCTAssertTrue(allClose(loadedValues, values).item(Bool.self))
+        }
+    }
+
+    func testLoadedRotatingCacheContinuesRotation() throws {
+        let original = RotatingKVCache(maxSize: 4)
+        _ = original.update(keys: MLXRandom.normal([1, 1, 3, 8]), values: MLXRandom.normal([1, 1, 3, 8]))
+        _ = original.update(keys: MLXRandom.normal([1, 1, 1, 8]), values: MLXRandom.normal([1, 1, 1, 8]))
+
+        let url = temporaryURL()
+        defer { try? FileManager.default.removeItem(at: url) }
+        try savePromptCache(url: url, cache: [original])
+        let restored = try XCTUnwrap(loadPromptCache(url: url).cache.first)
+
+        let next = MLXRandom.normal([1, 1, 1, 8])
+        let (expected, _) = original.update(keys: next, values: next)
+        let (keys, _) = restored.update(keys: next, values: next)
+
+        XCTAssertEqual(restored.offset, original.offset)
+        XCTAssertTrue(allClose(keys, expected).item(Bool.self))
+    }
+
+    func testSavePromptCacheRejectsUnsupportedCache() {
+        let cache: [KVCacheProtocol] = [BatchKVCache(leftPadding: [0, 2])]
+
+        XCTAssertThrowsError(try savePromptCache(url: temporaryURL(), cache: cache))
+    }
 }
@@ -0,0 +1,144 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Logprobs.swift
+
+import Foundation
+import MLX
+import MLXNN
+import XCTest
+
+@testable import NodeMLXCore
+
+final class LogprobsTests: XCTestCase {
+    /// Log-probabilities `FavoredTokenModel` assigns to its favored token and to every other one.
+    private let favored = 10 - log(exp(Float(10)) + 7)
+    private let other = -log(exp(Float(10)) + 7)
+
+    // MARK: - Row Tests
+
+    func testRowsHoldChosenAndSortedAlternatives() {
+        let logits = MLXArray([Float(1), 3, 2, 0, 1, 0, 0, 4]).reshaped([2, 4])
+        let rows = logprobRows(logits: logits, tokens: MLXArray([Int32(0), 3]), topCount: 2)
+
+        XCTAssertEqual(rows.shape, [2, 5])
+        let values = rows.asArray(Float.self)
+        let first = log(exp(Float(0)) + exp(1) + exp(2) + exp(3))
+        let second = log(exp(Float(1)) + 2 + exp(4))
+        let expected: [Float] = [
+            1 - first, 1, 2, 3 - first, 2 - first,
+            4 - second, 3, 0, 4 - second, 1 - second,
+        ]
+        for (actual, value) in zip(values, expected) {
+            XCTAssertEqual(actual, value, accuracy: 1e-4)
+        }
+    }
+
+    func testZeroTopCountReturnsChosenOnly() {
+        let logits = MLXArray([Float(0), 0]).reshaped([1, 2])
+        let rows = logprobRows(logits: logits, tokens: MLXArray([Int32(1)]), topCount: 0)
+
+        XCTAssertEqual(rows.shape, [1, 1])
+        XCTAssertEqual(rows.asArray(Float.self)[0], -log(2), accuracy: 1e-5)
+    }
+
+    // MARK: - Record Tests
+
+    func testAppendSplitsRow() {
+        var logprobs = GenerationLogprobs(topCount: 2)
+
+        logprobs.append(row: [-0.5, 4, 1, -0.25, -2][...])
+        logprobs.appendForced(7)
+
+        XCTAssertEqual(logprobs.count, 2)
+        XCTAssertEqual(logprobs.tokens, [-0.5, 0])
+        XCTAssertEqual(logprobs.topTokens, [4, 1, 7, -1])
+        XCTAssertEqual(logprobs.topLogprobs, [-0.25, -2, 0, -.infinity])
+    }
+
+    // MARK: - Generation Tests
+
+    func testGenerateRecordsEveryToken() throws {
+        let config = GenerationConfig(maxTokens: 3, temperature: 0, logprobs: 2)
+
+        let output = generate(model: FavoredTokenModel(), inputIds: [1, 2], config: config)
+
+        XCTAssertEqual(output.tokens, [3, 3, 3])
+        let logprobs = try XCTUnwrap(output.logprobs)
+        XCTAssertEqual(logprobs.count, 3)
+        XCTAssertEqual(logprobs.topTokens.enumerated().filter { $0.offset % 2 == 0 }.map(\.element), [3, 3, 3])
+        for value in logprobs.tokens {
+            XCTAssertEqual(value, favored, accuracy: 1e-4)
+        }
+        for value in logprobs.topLogprobs.enumerated().filter({ $0.offset % 2 == 1 }).map(\.element) {
+            XCTAssertEqual(value, other, accuracy: 1e-4)
+        }
+    }
+
+    func testLogprobsIgnoreProcessorsAndForcedTokens() throws {
+        let config = GenerationConfig(
+            maxTokens: 3, temperature: 0, logitsProcessors: [{ _ in BoostingProcessor() }], logprobs: 1
+        )
+
+        let output = generate(model: FavoredTokenModel(), inputIds: [1], config: config)
+
+        // Forced first, then sampled from boosted logits but scored on the model's own
+        XCTAssertEqual(output.tokens, [6, 5, 5])
+        let logprobs = try XCTUnwrap(output.logprobs)
+        XCTAssertEqual(logprobs.topTokens, [6, 3, 3])
+        XCTAssertEqual(logprobs.tokens[0], 0)
+        XCTAssertEqual(logprobs.tokens[1], other, accuracy: 1e-4)
+        XCTAssertEqual(logprobs.topLogprobs[2], favored, accuracy: 1e-4)
+    }
+
+    func testNoLogprobsByDefault() {
+        let output = generate(model: FavoredTokenModel(), inputIds: [1], config: GenerationConfig(maxTokens: 2))
+
+        XCTAssertNil(output.logprobs)
+    }
+}
+
+// MARK: - Test Processor
+
+/// Processor that forces token 6 once, then makes token 5 win sampling.
+private final class BoostingProcessor: LogitsProcessor {
+    private var forced = [6]
+
+    func process(_ logits: MLXArray) -> MLXArray {
+        logits + MLXArray((0 ..< logits.dim(-1)).map { Float($0 == 5 ? 100 : 0) })
+    }
+
+    func didSample(_: MLXArray) {}
+
+    func forcedTokens() -> [Int] {
+        defer { forced = [] }
+        return forced
+    }
+}
+
+// MARK: - Test Model
+
+/// Model that gives token 3 a logit of 10 and every other token 0.
+private final class FavoredTokenModel: Module, LLMModel {
+    let vocabularySize = 8
+    let numLayers = 0
+    let numKVHeads = 1
+    let headDim = 1
+
+    func callAsFunction(_ inputIds: MLXArray, cache _: inout [KVCacheProtocol]?) -> MLXArray {
+        let row = MLXArray((0 ..< vocabularySize).map { Float($0 == 3 ? 10 : 0) }).reshaped([1, 1, vocabularySize])
+        return broadcast(row, to: [inputIds.dim(0), inputIds.dim(1), vocabularySize])
+    }
+
+    func hiddenStates(_ inputIds: MLXArray, depth _: Int?) -> MLXArray {
+        MLXArray.zeros([inputIds.dim(0), inputIds.dim(1), 1])
+    }
+
+    func newCache() -> [any KVCacheProtocol] {
+        []
+    }
+
+    func sanitize(weights: [String: MLXArray]) -> [String: MLXArray] {
+        weights
+    }
+}
@@ -0,0 +1,196 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for PagedKVCache.swift
+
+import Foundation
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class PagedKVCacheTests: XCTestCase {
+    // MARK: - Helpers
+
+    /// Keys and values for positions `range` of one row, each equal to its position.
+    private func positions(_ range: Range<Int>) -> MLXArray {
+        let values = MLXArray(Int32(range.lowerBound) ..< Int32(range.upperBound)).asType(.float32)
+        return broadcast(values.reshaped([1, 1, range.count, 1]), to: [1, 2, range.count, 4])
+    }
+
+    /// Position stored at each non-padding column of a row.
+    private func storedPositions(_ cache: KVCacheProtocol, row: Int = 0, padding: Int = 0) -> [Float] {
+        guard let keys = cache.state?.keys else { return [] }
+        return keys[row, 0, padding..., 0].asArray(Float.self)
+    }
+
+    /// Batch of one row that writes `range` to every layer.
+    private func filledBatch(_ pool: KVBlockPool, _ range: Range<Int>, offset: Int = 0) -> PagedBatch {
+        let batch = PagedBatch(row: PagedSequence(pool: pool), offset: offset)
+        XCTAssertTrue(batch.reserve(range.count, row: 0))
+        for layer in batch.caches {
+            _ = layer.update(keys: positions(range), values: positions(range))
+        }
+        return batch
+    }
+
+    // MARK: - Update Tests
+
+    func testUpdateAcrossBlocksMatchesStandardCache() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 8, blockSize: 4)
+        let batch = PagedBatch(row: PagedSequence(pool: pool))
+        let standard = StandardKVCache()
+
+        for range in [0 ..< 6, 6 ..< 7, 7 ..< 13] {
+            XCTAssertTrue(batch.reserve(range.count, row: 0))
+            let kv = positions(range)
+            let (pagedKeys, pagedValues) = batch.caches[0].update(keys: kv, values: kv)
+            let (standardKeys, standardValues) = standard.update(keys: kv, values: kv)
+
+            XCTAssertEqual(pagedKeys.shape, standardKeys.shape)
+            XCTAssertTrue(allClose(pagedKeys, standardKeys).item(Bool.self))
+            XCTAssertTrue(allClose(pagedValues, standardValues).item(Bool.self))
+        }
+        XCTAssertEqual(batch.caches[0].offset, 13)
+        XCTAssertEqual(batch.rows[0].blocks.count, 4)
+    }
+
+    func testLayersShareBlockTable() {
+        let pool = KVBlockPool(numLayers: 2, blockCount: 8, blockSize: 4)
+        let batch = filledBatch(pool, 0 ..< 5)
+
+        XCTAssertEqual(pool.freeBlockCount, 6)
+        XCTAssertEqual(storedPositions(batch.caches[1]), [0, 1, 2, 3, 4])
+    }
+
+    // MARK: - Block Lifetime Tests
+
+    func testReserveFailsWhenPoolIsExhausted() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 2, blockSize: 4)
+        let batch = filledBatch(pool, 0 ..< 8)
+
+        XCTAssertFalse(batch.reserve(1, row: 0))
+        XCTAssertEqual(pool.freeBlockCount, 0)
+        XCTAssertEqual(batch.rows[0].blocks.count, 2)
+    }
+
+    func testExhaustedPoolReclaimsBlocks() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 2, blockSize: 4)
+        var held: PagedBatch? = filledBatch(pool, 0 ..< 4)
+        pool.reclaim = {
+            guard held != nil else { return false }
+            held = nil
+            return true
+        }
+
+        let batch = filledBatch(pool, 0 ..< 8)
+
+        XCTAssertNil(held)
+        XCTAssertEqual(storedPositions(batch.caches[0]), [0, 1, 2, 3, 4, 5, 6, 7])
+    }
+
+    func testReleasingBatchFreesBlocks() {
+        let pool = KVBlockPool(numLayers: 2, blockCount: 8, blockSize: 4)
+
+        do {
+            let batch = filledBatch(pool, 0 ..< 9)
+            XCTAssertEqual(pool.freeBlockCount, 5)
+            XCTAssertEqual(batch.batchSize, 1)
+        }
+
+        XCTAssertEqual(pool.freeBlockCount, 8)
+    }
+
+    func testStorageGrowsByDoubling() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 8, blockSize: 4)
+        let batch = PagedBatch(row: PagedSequence(pool: pool))
+
+        var storedBlocks: [Int] = []
+        for _ in 0 ..< 3 {
+            XCTAssertTrue(batch.reserve(4, row: 0))
+            _ = batch.caches[0].update(keys: positions(0 ..< 4), values: positions(0 ..< 4))
+            storedBlocks.append(pool.arrays(layer: 0)[0].dim(0) / pool.blockSize)
+        }
+
+        XCTAssertEqual(storedBlocks, [1, 2, 4])
+        XCTAssertEqual(pool.blockBytes, 2 * 4 * 2 * 4 * 4)
+    }
+
+    // MARK: - Sharing Tests
+
+    func testForkSharesPrefixBlocks() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 8, blockSize: 4)
+        let source = filledBatch(pool, 0 ..< 8)
+
+        let fork = PagedBatch(row: source.rows[0].fork(length: 8), length: 8)
+
+        XCTAssertEqual(pool.freeBlockCount, 6)
+        XCTAssertEqual(fork.caches[0].offset, 8)
+        XCTAssertEqual(storedPositions(fork.caches[0]), storedPositions(source.caches[0]))
+    }
+
+    func testWriteToSharedBlockCopiesIt() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 8, blockSize: 4)
+        let source = filledBatch(pool, 0 ..< 6)
+
+        // Share the first five positions, then diverge inside the second block
+        let fork = PagedBatch(row: source.rows[0].fork(length: 5), length: 5)
+        XCTAssertTrue(fork.reserve(2, row: 0))
+        _ = fork.caches[0].update(keys: positions(50 ..< 52), values: positions(50 ..< 52))
+
+        XCTAssertEqual(storedPositions(source.caches[0]), [0, 1, 2, 3, 4, 5])
+        XCTAssertEqual(storedPositions(fork.caches[0]), [0, 1, 2, 3, 4, 50, 51])
+        XCTAssertEqual(source.rows[0].blocks[0], fork.rows[0].blocks[0])
+        XCTAssertNotEqual(source.rows[0].blocks[1], fork.rows[0].blocks[1])
+    }
+
+    // MARK: - Batch Tests
+
+    func testExtendAndFilterMatchBatchKVCache() {
+        let pool = KVBlockPool(numLayers: 1, blockCount: 8, blockSize: 4)
+        let paged = filledBatch(pool, 0 ..< 6)
+        let contiguous = BatchKVCache()
+        _ = contiguous.update(keys: positions(0 ..< 6), values: positions(0 ..< 6))
+
+        // A shorter row prefilled to end at the same offset
+        paged.extend(filledBatch(pool, 100 ..< 102, offset: 6 - 2))
+        let row = BatchKVCache(offset: 6 - 2)
+        _ = row.update(keys: positions(100 ..< 102), values: positions(100 ..< 102))
+        contiguous.extend(row)
+
+        XCTAssertEqual(paged.leftPadding, contiguous.leftPadding)
+        XCTAssertEqual(paged.caches[0].offset, contiguous.offset)
+
+        // One decode step for both rows
+        XCTAssertTrue(paged.reserve(1, row: 0))
+        XCTAssertTrue(paged.reserve(1, row: 1))
+        let next = concatenated([positions(6 ..< 7), positions(102 ..< 103)], axis: 0)
+        _ = paged.caches[0].update(keys: next, values: next)
+        _ = contiguous.update(keys: next, values: next)
+
+        for (row, padding) in paged.leftPadding.enumerated() {
+            XCTAssertEqual(
+                storedPositions(paged.caches[0], row: row, padding: padding),
+                storedPositions(contiguous, row: row, padding: padding)
+            )
+        }
+
+        paged.filter([1])
+        contiguous.filter([1])
+
+        XCTAssertEqual(paged.leftPadding, [0])
+        XCTAssertEqual(paged.caches[0].offset, contiguous.offset)
+        XCTAssertEqual(pool.freeBlockCount, 7)
+        XCTAssertEqual(storedPositions(paged.caches[0]), [100, 101, 102])
+    }
+
+    // MARK: - Pool Tests
+
+    func testBlocksNeededRoundsUp() {
+        let pool = KVBlockPool(numLayers: 2, blockCount: 3)
+        XCTAssertEqual(pool.blockSize, 16)
+        XCTAssertEqual(pool.blocksNeeded(for: 0), 0)
+        XCTAssertEqual(pool.blocksNeeded(for: 16), 1)
+        XCTAssertEqual(pool.blocksNeeded(for: 17), 2)
+    }
+}
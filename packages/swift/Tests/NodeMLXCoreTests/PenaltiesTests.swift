@@ -0,0 +1,80 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Penalties.swift
+
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class PenaltiesTests: XCTestCase {
+    // MARK: - Helpers
+
+    private let logits = MLXArray([Float(2), -2, 1, 4, 0.5]).reshaped([1, 5])
+
+    private func values(_ array: MLXArray) -> [Float] {
+        array.reshaped([-1]).asArray(Float.self)
+    }
+
+    // MARK: - Penalty Tests
+
+    func testRepetitionPenaltyScalesTowardsZero() throws {
+        let config = GenerationConfig(repetitionPenalty: 2)
+        let penalties = try XCTUnwrap(PenaltyProcessor(config: config, context: [0, 1]))
+
+        XCTAssertEqual(values(penalties.apply(logits)), [1, -4, 1, 4, 0.5])
+    }
+
+    func testFrequencyAndPresencePenalties() throws {
+        let config = GenerationConfig(frequencyPenalty: 0.5, presencePenalty: 0.25)
+        let penalties = try XCTUnwrap(PenaltyProcessor(config: config, context: [3, 2, 3]))
+
+        XCTAssertEqual(values(penalties.apply(logits)), [2, -2, 0.25, 2.75, 0.5])
+    }
+
+    func testNoPenaltyCreatesNoProcessor() {
+        XCTAssertNil(PenaltyProcessor(config: GenerationConfig(repetitionPenalty: 1), context: [1, 2]))
+    }
+
+    // MARK: - Window Tests
+
+    func testWindowKeepsMostRecentTokens() throws {
+        let config = GenerationConfig(repetitionPenalty: 2, repetitionContextSize: 2)
+        let penalties = try XCTUnwrap(PenaltyProcessor(config: config, context: [0, 1, 2]))
+        XCTAssertEqual(values(penalties.apply(logits)), [2, -4, 0.5, 4, 0.5])
+
+        // Appending overwrites the oldest entry
+        penalties.append(MLXArray([Int32(3)]))
+        penalties.append(4)
+        XCTAssertEqual(values(penalties.apply(logits)), [2, -2, 1, 2, 0.25])
+    }
+
+    func testAppendAcceptsLazyTokens() throws {
+        let config = GenerationConfig(presencePenalty: 1)
+        let penalties = try XCTUnwrap(PenaltyProcessor(config: config))
+        XCTAssertEqual(values(penalties.apply(logits)), values(logits))
+
+        penalties.append(argMax(logits, axis: -1))
+
+        XCTAssertEqual(values(penalties.apply(logits)), [2, -2, 1, 3, 0.5])
+    }
+
+    // MARK: - Generation Tests
+
+    func testPenaltyBreaksGreedyRepetition() {
+        // Token 3 always wins without a penalty
+        let config = GenerationConfig(temperature: 0, repetitionPenalty: 10, repetitionContextSize: 4)
+        let penalties = PenaltyProcessor(config: config)
+
+        var tokens: [Int] = []
+        for _ in 0 ..< 3 {
+            let rowLogits = penalties?.apply(logits) ?? logits
+            let token = sample(logits: rowLogits, configs: [config])
+            penalties?.append(token)
+            tokens.append(token.item(Int.self))
+        }
+
+        XCTAssertEqual(tokens, [3, 0, 2])
+    }
+}
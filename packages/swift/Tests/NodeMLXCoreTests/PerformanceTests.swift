@@ -3,6 +3,7 @@
 //
 // Performance tests for MLX operations.
 
+import Foundation
 import MLX
 import MLXFast
 @testable import NodeMLXCore
@@ -65,6 +66,20 @@ final class PerformanceTests: XCTestCase {
         XCTAssertEqual(cache.offset, 9)
     }
 
+    func testKVCacheLongChatGrowth() throws {
+        // Chunked prefill of a 32K-token chat onto a growing cache
+        let chunk = MLXArray.ones([1, 8, 512, 128], dtype: .float16)
+
+        measure {
+            let cache = StandardKVCache()
+            for _ in 0 ..< 64 {
+                let (keys, values) = cache.update(keys: chunk, values: chunk)
+                eval(keys, values)
+            }
+            XCTAssertEqual(cache.offset, 64 * 512)
+        }
+    }
+
     func testMatmulPerformance() throws {
         // Test basic matmul performance
         let a = MLXArray.ones([256, 512])
@@ -90,4 +105,56 @@ final class PerformanceTests: XCTestCase {
         XCTAssertEqual(result.shape, [1, 32, 128, 128])
         XCTAssertLessThan(elapsed, 0.5, "Softmax should be fast!")
     }
+
+    func testDecodeThroughput() throws {
+        let model = try makeTinyLlama()
+        let prompt = [1, 2, 3]
+        let maxTokens = 128
+
+        // Warm up so neither loop pays for kernel compilation
+        _ = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 8))
+
+        var pipelined: [Int] = []
+        let pipelinedRate = tokensPerSecond(tokens: maxTokens) {
+            pipelined = generate(model: model, inputIds: prompt, config: greedy(maxTokens: maxTokens)).tokens
+        }
+        var synchronous: [Int] = []
+        let synchronousRate = tokensPerSecond(tokens: maxTokens) {
+            synchronous = synchronousDecode(model: model, prompt: prompt, maxTokens: maxTokens)
+        }
+        print(String(format: "Decode: %.0f tok/s pipelined, %.0f tok/s synchronous", pipelinedRate, synchronousRate))
+
+        XCTAssertEqual(pipelined, synchronous)
+        // The pipelined loop overlaps host work with the next step; allow some timer noise
+        XCTAssertGreaterThan(pipelinedRate, synchronousRate * 0.9, "Pipelined decoding should not be slower!")
+    }
+
+    // MARK: - Helpers
+
+    /// Best decode rate of a few runs of `body`, which generates `tokens` tokens.
+    private func tokensPerSecond(tokens: Int, runs: Int = 3, _ body: () -> Void) -> Double {
+        var best = Double.infinity
+        for _ in 0 ..< runs {
+            let start = Date()
+            body()
+            best = min(best, Date().timeIntervalSince(start))
+        }
+        return Double(tokens) / best
+    }
+
+    /// Greedy decoding that reads every token before building the next step,
+    /// as `generate()` did before its loop was pipelined.
+    private func synchronousDecode(model: LlamaModel, prompt: [Int], maxTokens: Int) -> [Int] {
+        var cache: [KVCacheProtocol]? = model.newCache()
+        var logits = model(MLXArray(prompt.map { Int32($0) }).reshaped([1, -1]), cache: &cache)
+        var tokens: [Int] = []
+        while tokens.count < maxTokens {
+            let token = argMax(logits[0..., -1, 0...], axis: -1).item(Int.self)
+            tokens.append(token)
+            if tokens.count < maxTokens {
+                logits = model(MLXArray([Int32(token)]).reshaped([1, 1]), cache: &cache)
+            }
+        }
+        return tokens
+    }
 }
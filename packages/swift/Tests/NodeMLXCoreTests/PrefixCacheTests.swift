@@ -0,0 +1,145 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for PrefixCache.swift
+
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class PrefixCacheTests: XCTestCase {
+    // MARK: - Helpers
+
+    /// Two-layer cache filled with `count` positions whose values equal their index.
+    private func makeCache(count: Int) -> [KVCacheProtocol] {
+        (0 ..< 2).map { _ in
+            let cache = StandardKVCache()
+            let positions = MLXArray(0 ..< Int32(count)).asType(.float32).reshaped([1, 1, count, 1])
+            let kv = broadcast(positions, to: [1, 2, count, 8])
+            _ = cache.update(keys: kv, values: kv)
+            return cache
+        }
+    }
+
+    /// Bytes of a `makeCache(count:)` cache, and of each block of `makePrefixCache`.
+    private func bytes(count: Int) -> Int {
+        2 * 2 * (2 * count * 8 * 4)
+    }
+
+    /// Prefix cache on a pool of four-token blocks for `makeCache(count:)` caches.
+    private func makePrefixCache(maxBytes: Int) -> PrefixCache {
+        PrefixCache(pool: KVBlockPool(numLayers: 2, blockCount: 64, blockSize: 4), maxBytes: maxBytes)
+    }
+
+    // MARK: - Lookup Tests
+
+    func testMissOnEmptyCache() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        XCTAssertNil(prefixCache.fetch([1, 2, 3]))
+    }
+
+    func testFetchReturnsLongestPrefix() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3, 4], cache: makeCache(count: 4))
+
+        let hit = prefixCache.fetch([1, 2, 3, 4, 5, 6])
+        XCTAssertEqual(hit?.length, 4)
+        XCTAssertEqual(hit?.cache.first?.offset, 4)
+    }
+
+    func testFetchSlicesLongerSnapshot() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3, 4, 5, 6], cache: makeCache(count: 6))
+
+        // Diverges inside the stored edge
+        let hit = prefixCache.fetch([1, 2, 3, 9])
+        XCTAssertEqual(hit?.length, 3)
+
+        let keys = hit?.cache.first?.state?.keys
+        XCTAssertEqual(keys?.shape, [1, 2, 3, 8])
+        XCTAssertEqual(keys?[0, 0, 0..., 0].asArray(Float.self), [0, 1, 2])
+    }
+
+    func testFetchLeavesOneTokenToProcess() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3], cache: makeCache(count: 3))
+
+        XCTAssertEqual(prefixCache.fetch([1, 2, 3])?.length, 2)
+        XCTAssertNil(prefixCache.fetch([1]))
+    }
+
+    func testMissOnDifferentFirstToken() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3], cache: makeCache(count: 3))
+
+        XCTAssertNil(prefixCache.fetch([2, 2, 3]))
+    }
+
+    // MARK: - Insert Tests
+
+    func testInsertIgnoresMismatchedLength() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3], cache: makeCache(count: 4))
+
+        XCTAssertEqual(prefixCache.count, 0)
+        XCTAssertEqual(prefixCache.totalBytes, 0)
+    }
+
+    func testLongerSnapshotReplacesItsPrefix() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2], cache: makeCache(count: 2))
+        prefixCache.insert([1, 2, 3, 4], cache: makeCache(count: 4))
+
+        XCTAssertEqual(prefixCache.count, 1)
+        XCTAssertEqual(prefixCache.totalBytes, bytes(count: 4))
+        XCTAssertEqual(prefixCache.fetch([1, 2, 7])?.length, 2)
+    }
+
+    func testBranchesKeepBothSnapshots() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3, 4], cache: makeCache(count: 4))
+        prefixCache.insert([1, 2, 5, 6], cache: makeCache(count: 4))
+
+        XCTAssertEqual(prefixCache.count, 2)
+        XCTAssertEqual(prefixCache.fetch([1, 2, 3, 4, 9])?.length, 4)
+        XCTAssertEqual(prefixCache.fetch([1, 2, 5, 6, 9])?.length, 4)
+        XCTAssertEqual(prefixCache.fetch([1, 2, 9])?.length, 2)
+    }
+
+    // MARK: - Eviction Tests
+
+    func testEvictsLeastRecentlyUsed() {
+        let prefixCache = makePrefixCache(maxBytes: 2 * bytes(count: 4))
+        prefixCache.insert([1, 1, 1, 1], cache: makeCache(count: 4))
+        prefixCache.insert([2, 2, 2, 2], cache: makeCache(count: 4))
+
+        // Touch the first snapshot so the second becomes the oldest
+        XCTAssertNotNil(prefixCache.fetch([1, 1, 1, 1, 5]))
+
+        prefixCache.insert([3, 3, 3, 3], cache: makeCache(count: 4))
+
+        XCTAssertEqual(prefixCache.count, 2)
+        XCTAssertLessThanOrEqual(prefixCache.totalBytes, prefixCache.maxBytes)
+        XCTAssertNotNil(prefixCache.fetch([1, 1, 1, 1, 5]))
+        XCTAssertNil(prefixCache.fetch([2, 2, 2, 2, 5]))
+        XCTAssertNotNil(prefixCache.fetch([3, 3, 3, 3, 5]))
+    }
+
+    func testSkipsSnapshotLargerThanBudget() {
+        let prefixCache = makePrefixCache(maxBytes: bytes(count: 4) - 1)
+        prefixCache.insert([1, 2, 3, 4], cache: makeCache(count: 4))
+
+        XCTAssertEqual(prefixCache.count, 0)
+    }
+
+    func testRemoveAll() {
+        let prefixCache = makePrefixCache(maxBytes: 1 << 20)
+        prefixCache.insert([1, 2, 3], cache: makeCache(count: 3))
+        prefixCache.removeAll()
+
+        XCTAssertEqual(prefixCache.count, 0)
+        XCTAssertEqual(prefixCache.totalBytes, 0)
+        XCTAssertNil(prefixCache.fetch([1, 2, 3, 4]))
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for ResidencyManager.swift
+
+import XCTest
+
+@testable import NodeMLXCore
+
+final class ResidencyManagerTests: XCTestCase {
+    // MARK: - Accounting Tests
+
+    func testTracksResidentBytes() {
+        var residency = ResidencyManager()
+        residency.insert(1, bytes: 100)
+        residency.insert(2, bytes: 50)
+        XCTAssertEqual(residency.residentBytes, 150)
+
+        residency.insert(1, bytes: 80)
+        XCTAssertEqual(residency.residentBytes, 130)
+
+        residency.remove(2)
+        XCTAssertEqual(residency.residentBytes, 80)
+        XCTAssertEqual(residency.modelIds, [1])
+    }
+
+    func testTouchMovesModelToMostRecentlyUsed() {
+        var residency = ResidencyManager()
+        residency.insert(1, bytes: 10)
+        residency.insert(2, bytes: 10)
+        residency.insert(3, bytes: 10)
+
+        residency.touch(1)
+        residency.touch(4)
+
+        XCTAssertEqual(residency.modelIds, [2, 3, 1])
+    }
+
+    func testResizeKeepsRecency() {
+        var residency = ResidencyManager()
+        residency.insert(1, bytes: 10)
+        residency.insert(2, bytes: 10)
+
+        residency.resize(1, bytes: 30)
+        residency.resize(3, bytes: 5)
+
+        XCTAssertEqual(residency.footprint(of: 1), 30)
+        XCTAssertEqual(residency.footprint(of: 3), 0)
+        XCTAssertEqual(residency.modelIds, [1, 2])
+    }
+
+    // MARK: - Eviction Tests
+
+    func testNoBudgetNeverEvicts() {
+        var residency = ResidencyManager()
+        residency.insert(1, bytes: 1 << 40)
+
+        XCTAssertEqual(residency.victims(toFit: 1 << 40), [])
+    }
+
+    func testEvictsLeastRecentlyUsedUntilItFits() {
+        var residency = ResidencyManager(budget: 100)
+        residency.insert(1, bytes: 40)
+        residency.insert(2, bytes: 30)
+        residency.insert(3, bytes: 20)
+        residency.touch(1)
+
+        XCTAssertEqual(residency.victims(toFit: 10), [])
+        XCTAssertEqual(residency.victims(toFit: 20), [2])
+        XCTAssertEqual(residency.victims(toFit: 60), [2, 3])
+    }
+
+    func testSkipsPinnedModels() {
+        var residency = ResidencyManager(budget: 100)
+        residency.insert(1, bytes: 50)
+        residency.insert(2, bytes: 50)
+
+        XCTAssertEqual(residency.victims(toFit: 40, pinned: [1]), [2])
+        XCTAssertNil(residency.victims(toFit: 60, pinned: [1]))
+    }
+
+    func testRejectsModelLargerThanBudget() {
+        let residency = ResidencyManager(budget: 100)
+
+        XCTAssertNil(residency.victims(toFit: 101))
+    }
+}
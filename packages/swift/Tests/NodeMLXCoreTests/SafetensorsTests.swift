@@ -0,0 +1,121 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Safetensors.swift
+
+import Foundation
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class SafetensorsTests: XCTestCase {
+    // MARK: - Helpers
+
+    private var files: [URL] = []
+
+    override func tearDown() {
+        for file in files {
+            try? FileManager.default.removeItem(at: file)
+        }
+        files.removeAll()
+        super.tearDown()
+    }
+
+    private func temporaryURL() -> URL {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent("\(UUID().uuidString).safetensors")
+        files.append(url)
+        return url
+    }
+
+    // MARK: - Header Tests
+
+    func testReadsFilesWrittenByMLX() throws {
+        let arrays: [String: MLXArray] = [
+            "a.weight": MLXRandom.normal([3, 4]).asType(.float16),
+            "b.weight": MLXRandom.normal([2, 3, 5]).asType(.bfloat16),
+            "c.indices": MLXArray([1, 2, 3] as [Int32]),
+            "d.packed": MLXArray([7, 8] as [UInt32]),
+        ]
+        let url = temporaryURL()
+        try MLX.save(arrays: arrays, metadata: ["format": "mlx"], url: url)
+
+        let file = try SafetensorsFile(url: url)
+
+        XCTAssertEqual(Set(file.entries.keys), Set(arrays.keys))
+        XCTAssertEqual(file.metadata, ["format": "mlx"])
+        for (name, expected) in arrays {
+            let loaded = try XCTUnwrap(file.load(name))
+            XCTAssertEqual(loaded.dtype, expected.dtype, name)
+            XCTAssertEqual(loaded.shape, expected.shape, name)
+            XCTAssertTrue(arrayEqual(loaded, expected).item(Bool.self), name)
+        }
+        XCTAssertNil(file.load("missing"))
+    }
+
+    func testLoadAllMatchesSerialLoads() async throws {
+        let arrays = (0 ..< 20).reduce(into: [String: MLXArray]()) { arrays, i in
+            arrays["layers.\(i).weight"] = MLXRandom.normal([i + 1, 16])
+        }
+        let url = temporaryURL()
+        try MLX.save(arrays: arrays, url: url)
+        let file = try SafetensorsFile(url: url)
+
+        let loaded = await file.loadAll(maxConcurrency: 4)
+
+        XCTAssertEqual(Set(loaded.keys), Set(arrays.keys))
+        for (name, expected) in arrays {
+            XCTAssertTrue(arrayEqual(try XCTUnwrap(loaded[name]), expected).item(Bool.self), name)
+        }
+    }
+
+    func testLoadedArraysOutliveTheFile() async throws {
+        let expected = MLXRandom.normal([8, 8])
+        let url = temporaryURL()
+        try MLX.save(arrays: ["w": expected], url: url)
+
+        let loaded = try await XCTUnwrap(SafetensorsFile(url: url).loadAll()["w"])
+        try FileManager.default.removeItem(at: url)
+
+        XCTAssertTrue(arrayEqual(loaded, expected).item(Bool.self))
+    }
+
+    func testRejectsMalformedHeader() throws {
+        let url = temporaryURL()
+        var data = Data([32, 0, 0, 0, 0, 0, 0, 0])
+        data.append(Data("{\"w\": {\"dtype\": \"F32\"".utf8))
+        try data.write(to: url)
+
+        XCTAssertThrowsError(try SafetensorsFile(url: url))
+    }
+
+    func testRejectsOutOfBoundsData() throws {
+        let invalidEntries = [
+            #"{"dtype":"F32","shape":[4],"data_offsets":[0,16]}"#, // past the end
+            #"{"dtype":"F32","shape":[0],"data_offsets":[8,0]}"#, // reversed
+            #"{"dtype":"F32","shape":[2],"data_offsets":[-8,0]}"#, // negative
+            #"{"dtype":"F32","shape":[2],"data_offsets":[0,9223372036854775807]}"#, // overflowing end
+            #"{"dtype":"F32","shape":[4611686018427387904,4],"data_offsets":[0,8]}"#, // overflowing size
+            #"{"dtype":"F32","shape":[-2,-1],"data_offsets":[0,8]}"#, // negative dimensions
+        ]
+        for entry in invalidEntries {
+            let header = Data("{\"w\":\(entry)}".utf8)
+            var data = withUnsafeBytes(of: UInt64(header.count).littleEndian) { Data($0) }
+            data.append(header)
+            data.append(Data(count: 8))
+            let url = temporaryURL()
+            try data.write(to: url)
+
+            XCTAssertThrowsError(try SafetensorsFile(url: url), entry)
+        }
+    }
+
+    func testRejectsOverflowingHeaderLength() throws {
+        let url = temporaryURL()
+        var data = Data([0xF8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F])
+        data.append(Data("{}".utf8))
+        try data.write(to: url)
+
+        XCTAssertThrowsError(try SafetensorsFile(url: url))
+    }
+}
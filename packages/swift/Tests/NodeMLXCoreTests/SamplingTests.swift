@@ -0,0 +1,90 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Sampling.swift
+
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class SamplingTests: XCTestCase {
+    // MARK: - Helpers
+
+    /// Distinct tokens sampled from one row over many draws.
+    private func sampledTokens(_ probabilities: [Float], config: GenerationConfig, draws: Int = 200) -> Set<Int> {
+        let logits = log(MLXArray(probabilities)).reshaped([1, -1])
+        let rows = broadcast(logits, to: [draws, probabilities.count])
+        let configs = Array(repeating: config, count: draws)
+        return Set(sampleTokens(logits: rows, configs: configs))
+    }
+
+    // MARK: - Filter Tests
+
+    func testTopKKeepsMostLikelyTokens() {
+        let probabilities: [Float] = [0.1, 0.3, 0.05, 0.25, 0.3]
+
+        let tokens = sampledTokens(probabilities, config: GenerationConfig(temperature: 1, topP: 1, topK: 2))
+
+        XCTAssertEqual(tokens, [1, 4])
+    }
+
+    func testTopPKeepsSmallestSetAboveThreshold() {
+        let probabilities: [Float] = [0.05, 0.5, 0.05, 0.3, 0.1]
+
+        let tokens = sampledTokens(probabilities, config: GenerationConfig(temperature: 1, topP: 0.7))
+
+        XCTAssertEqual(tokens, [1, 3])
+    }
+
+    func testTopPAppliesWithinTopK() {
+        // Token 1 holds 40% of all mass, but 0.4 / 0.8 = 50% within the top 3
+        let probabilities: [Float] = [0.2, 0.4, 0.1, 0.2, 0.1]
+
+        let tokens = sampledTokens(probabilities, config: GenerationConfig(temperature: 1, topP: 0.45, topK: 3))
+
+        XCTAssertEqual(tokens, [1])
+    }
+
+    func testMinPDropsUnlikelyTokens() {
+        let probabilities: [Float] = [0.4, 0.02, 0.3, 0.08, 0.2]
+
+        let tokens = sampledTokens(probabilities, config: GenerationConfig(temperature: 1, topP: 1, minP: 0.4))
+
+        XCTAssertEqual(tokens, [0, 2, 4])
+    }
+
+    func testUnfilteredSamplingCoversVocabulary() {
+        let probabilities: [Float] = [0.25, 0.25, 0.25, 0.25]
+
+        let tokens = sampledTokens(probabilities, config: GenerationConfig(temperature: 1, topP: 1))
+
+        XCTAssertEqual(tokens, [0, 1, 2, 3])
+    }
+
+    // MARK: - Batch Tests
+
+    func testRowsUseTheirOwnSettings() {
+        let logits = broadcast(log(MLXArray([Float(0.1), 0.6, 0.3])).reshaped([1, 3]), to: [3, 3])
+        let configs = [
+            GenerationConfig(temperature: 0),
+            GenerationConfig(temperature: 1, topP: 1, topK: 1),
+            GenerationConfig(temperature: 1, topP: 1, topK: 3, minP: 0.6),
+        ]
+
+        for _ in 0 ..< 20 {
+            let tokens = sample(logits: logits, configs: configs)
+            XCTAssertEqual(tokens.shape, [3])
+            XCTAssertEqual(tokens.asArray(Int32.self), [1, 1, 1])
+        }
+    }
+
+    func testSampleKeepsLeadingShape() {
+        let logits = log(MLXArray([Float(0.1), 0.8, 0.1])).reshaped([1, 1, 3])
+
+        let token = sample(logits: logits, temperature: 1, topP: 1, topK: 1)
+
+        XCTAssertEqual(token.shape, [1, 1])
+        XCTAssertEqual(token.item(Int.self), 1)
+    }
+}
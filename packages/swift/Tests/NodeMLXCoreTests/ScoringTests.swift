@@ -0,0 +1,182 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for Scoring.swift
+
+import Foundation
+import MLX
+import MLXNN
+import XCTest
+
+@testable import NodeMLXCore
+
+final class ScoringTests: XCTestCase {
+    private let requests = [
+        ScoringRequest(prompt: [1, 2], continuation: [3]),
+        ScoringRequest(prompt: [1, 2], continuation: [5, 3, 1]),
+        ScoringRequest(prompt: [4], continuation: [4, 7]),
+        ScoringRequest(prompt: [1, 2], continuation: [2, 6]),
+    ]
+
+    // MARK: - Scoring Tests
+
+    func testScoresMatchModel() throws {
+        for sharesCache in [true, false] {
+            let scores = try score(model: ContextSumModel(sharesCache: sharesCache), requests: requests)
+
+            XCTAssertEqual(scores.count, requests.count)
+            for (request, logprobs) in zip(requests, scores) {
+                let expected = expectedLogprobs(request)
+                XCTAssertEqual(logprobs.count, expected.count)
+                for (actual, value) in zip(logprobs, expected) {
+                    XCTAssertEqual(actual, value, accuracy: 1e-4)
+                }
+            }
+        }
+    }
+
+    func testPromptIsPrefilledOnce() throws {
+        let model = ContextSumModel(sharesCache: true)
+
+        _ = try score(model: model, requests: requests)
+
+        // Both prompts in one prefill, then one batch per prompt for the continuations longer than a token
+        XCTAssertEqual(model.batchShapes, [[2, 2], [2, 2], [1, 1]])
+    }
+
+    func testPromptsWithoutSharedCacheRunInOneBatch() throws {
+        let model = ContextSumModel(sharesCache: false)
+
+        _ = try score(model: model, requests: requests)
+
+        // Every request's prompt and continuation, padded to the longest
+        XCTAssertEqual(model.batchShapes, [[4, 4]])
+    }
+
+    func testSingleTokenContinuationsNeedOnlyThePrompt() throws {
+        let model = ContextSumModel(sharesCache: true)
+        let labels = (0 ..< 8).map { ScoringRequest(prompt: [1, 2, 3], continuation: [$0]) }
+
+        let scores = try score(model: model, requests: labels)
+
+        XCTAssertEqual(model.batchShapes, [[1, 3]])
+        XCTAssertEqual(scores.map { $0.count }, Array(repeating: 1, count: 8))
+        XCTAssertEqual(scores.indices.max { scores[$0][0] < scores[$1][0] }, 6)
+    }
+
+    func testPrefixCacheSkipsKnownPrompt() throws {
+        let model = ContextSumModel(sharesCache: true)
+        let prefixCache = PrefixCache(pool: KVBlockPool(model: model, maxBytes: 1 << 20), maxBytes: 1 << 20)
+        let request = ScoringRequest(prompt: [1, 2, 3, 4], continuation: [2])
+
+        let first = try score(model: model, requests: [request], prefixCache: prefixCache)
+        let second = try score(model: model, requests: [request], prefixCache: prefixCache)
+
+        XCTAssertEqual(model.batchShapes, [[1, 4], [1, 1]])
+        XCTAssertEqual(first, second)
+    }
+
+    func testMostlyCachedPromptRunsAlone() throws {
+        let model = ContextSumModel(sharesCache: true)
+        let prefixCache = PrefixCache(pool: KVBlockPool(model: model, maxBytes: 1 << 20), maxBytes: 1 << 20)
+        let known = ScoringRequest(prompt: [1, 2, 3, 4], continuation: [2])
+        _ = try score(model: model, requests: [known], prefixCache: prefixCache)
+        model.batchShapes = []
+        let requests = [
+            ScoringRequest(prompt: [1, 2, 3, 5], continuation: [3]),
+            ScoringRequest(prompt: [1, 7, 7], continuation: [6]),
+            ScoringRequest(prompt: [6], continuation: [1]),
+        ]
+
+        let scores = try score(model: model, requests: requests, prefixCache: prefixCache)
+
+        // The first prompt continues from its cached prefix; sharing one token is too little
+        XCTAssertEqual(model.batchShapes, [[1, 1], [2, 3]])
+        for (request, logprobs) in zip(requests, scores) {
+            XCTAssertEqual(logprobs[0], expectedLogprobs(request)[0], accuracy: 1e-4)
+        }
+        XCTAssertEqual(prefixCache.fetch([1, 7, 7, 1])?.length, 3)
+    }
+
+    func testInvalidInputThrows() {
+        let model = ContextSumModel(sharesCache: true)
+
+        XCTAssertThrowsError(try score(model: model, requests: []))
+        XCTAssertThrowsError(try score(model: model, requests: [ScoringRequest(prompt: [], continuation: [1])]))
+        XCTAssertThrowsError(try score(model: model, requests: [ScoringRequest(prompt: [1], continuation: [])]))
+    }
+
+    // MARK: - Batching Tests
+
+    func testBatchesRespectTokenBudget() {
+        let batches = scoringBatches(lengths: [1, 3, 0, 2, 7], promptLength: 2, maxBatchTokens: 12)
+
+        // Longest first; a row longer than the budget runs alone, empty rows are skipped
+        XCTAssertEqual(batches, [[4], [1, 3], [0]])
+    }
+
+    // MARK: - Helpers
+
+    /// Log-probabilities `ContextSumModel` assigns to a request's continuation.
+    private func expectedLogprobs(_ request: ScoringRequest) -> [Float] {
+        let vocabularySize = ContextSumModel.vocabularySize
+        let normalizer = log(exp(Float(2)) + Float(vocabularySize - 1))
+
+        var sum = request.prompt.reduce(0, +)
+        return request.continuation.map { token in
+            defer { sum += token }
+            return (sum % vocabularySize == token ? 2 : 0) - normalizer
+        }
+    }
+}
+
+// MARK: - Test Model
+
+/// Model that predicts the sum of all tokens so far (modulo the vocabulary
+/// size), reading earlier tokens from its cache.
+private final class ContextSumModel: Module, LLMModel {
+    static let vocabularySize = 8
+
+    let vocabularySize = ContextSumModel.vocabularySize
+    let numLayers = 1
+    let numKVHeads = 1
+    let headDim = 1
+
+    /// Without a `StandardKVCache`, scoring runs prompt and continuation together.
+    private let sharesCache: Bool
+
+    /// Input shape of every forward pass, in call order.
+    var batchShapes: [[Int]] = []
+
+    init(sharesCache: Bool) {
+        self.sharesCache = sharesCache
+    }
+
+    func callAsFunction(_ inputIds: MLXArray, cache: inout [KVCacheProtocol]?) -> MLXArray {
+        batchShapes.append(inputIds.shape)
+        let length = inputIds.dim(1)
+        let tokens = inputIds.asType(.float32).reshaped([inputIds.dim(0), 1, length, 1])
+
+        var history = tokens
+        if let layer = cache?.first {
+            history = layer.update(keys: tokens, values: tokens).0
+        }
+        let sums = cumsum(history, axis: 2)[0..., 0, (history.dim(2) - length)..., 0].asType(.int32)
+
+        let predicted = (sums % Int32(vocabularySize)).expandedDimensions(axis: -1)
+        let vocabulary = MLXArray(Array(0 ..< Int32(vocabularySize)))
+        return (predicted .== vocabulary).asType(.float32) * 2
+    }
+
+    func hiddenStates(_ inputIds: MLXArray, depth _: Int?) -> MLXArray {
+        inputIds.asType(.float32).expandedDimensions(axis: -1)
+    }
+
+    func newCache() -> [any KVCacheProtocol] {
+        sharesCache ? [StandardKVCache()] : []
+    }
+
+    func sanitize(weights: [String: MLXArray]) -> [String: MLXArray] {
+        weights
+    }
+}
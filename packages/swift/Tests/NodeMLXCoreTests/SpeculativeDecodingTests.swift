@@ -0,0 +1,234 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for SpeculativeDecoding.swift
+
+import Foundation
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class SpeculativeDecodingTests: XCTestCase {
+    // MARK: - Helpers
+
+    private let prompt = [1, 2, 3, 4, 5, 6, 7]
+
+    // MARK: - Draft Model Tests
+
+    func testIdenticalDraftMatchesGreedy() throws {
+        let model = try makeTinyLlama()
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 12))
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: DraftModelProposer(model: model, config: greedy(maxTokens: 12)),
+            inputIds: prompt,
+            config: greedy(maxTokens: 12)
+        )
+
+        XCTAssertEqual(output.tokens, expected.tokens)
+        XCTAssertEqual(output.finishReason, .length)
+    }
+
+    func testDifferentDraftMatchesGreedy() throws {
+        let model = try makeTinyLlama()
+        let draft = try makeTinyLlama(seed: 7, layers: 1)
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 12))
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: DraftModelProposer(model: draft, config: greedy(maxTokens: 12)),
+            inputIds: prompt,
+            config: greedy(maxTokens: 12, draftTokens: 4)
+        )
+
+        XCTAssertEqual(output.tokens, expected.tokens)
+    }
+
+    // MARK: - Verification Tests
+
+    func testRejectedProposalsAreRolledBack() throws {
+        let model = try makeTinyLlama()
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 10))
+        let cache = model.newCache()
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: FixedProposer(tokens: [99, 98, 97]),
+            inputIds: prompt,
+            config: greedy(maxTokens: 10),
+            promptCache: cache
+        )
+
+        XCTAssertEqual(output.tokens, expected.tokens)
+        XCTAssertLessThanOrEqual(cache.first?.offset ?? 0, prompt.count + output.tokens.count)
+    }
+
+    func testStopTokenInsideAcceptedRun() throws {
+        let model = try makeTinyLlama()
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 8)).tokens
+        let stopToken = expected[3]
+
+        var config = greedy(maxTokens: 8, draftTokens: 6)
+        config.stopTokens = [stopToken]
+        let cache = model.newCache()
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: DraftModelProposer(model: model, config: config),
+            inputIds: prompt,
+            config: config,
+            promptCache: cache
+        )
+
+        XCTAssertEqual(output.tokens, Array(expected.prefix { $0 != stopToken }))
+        XCTAssertEqual(output.finishReason, .stop)
+        XCTAssertEqual(cache.first?.offset, prompt.count + output.tokens.count)
+    }
+
+    func testMaxTokensCapsProposals() throws {
+        let model = try makeTinyLlama()
+        let proposer = FixedProposer(tokens: [1, 2, 3, 4, 5, 6])
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: proposer,
+            inputIds: prompt,
+            config: greedy(maxTokens: 3, draftTokens: 6)
+        )
+
+        XCTAssertEqual(output.tokens.count, 3)
+        XCTAssertTrue(proposer.requestedCounts.allSatisfy { $0 <= 2 })
+    }
+
+    func testCallbackStop() throws {
+        let model = try makeTinyLlama()
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: DraftModelProposer(model: model, config: greedy(maxTokens: 10)),
+            inputIds: prompt,
+            config: greedy(maxTokens: 10)
+        ) { _ in false }
+
+        XCTAssertEqual(output.tokens.count, 1)
+        XCTAssertEqual(output.finishReason, .cancelled)
+    }
+
+    // MARK: - Prompt Lookup Tests
+
+    func testPromptLookupCopiesContinuation() {
+        let proposer = PromptLookupProposer(ngramSize: 2)
+
+        XCTAssertEqual(proposer.propose(context: [5, 6, 7, 8, 9, 1, 5, 6], count: 3), [7, 8, 9])
+        XCTAssertEqual(proposer.propose(context: [5, 6, 7, 8, 9, 1, 5, 6], count: 10), [7, 8, 9, 1, 5, 6])
+    }
+
+    func testPromptLookupPrefersMostRecentMatch() {
+        let proposer = PromptLookupProposer(ngramSize: 1)
+
+        XCTAssertEqual(proposer.propose(context: [4, 1, 4, 2, 4], count: 1), [2])
+    }
+
+    func testPromptLookupMiss() {
+        let proposer = PromptLookupProposer(ngramSize: 3)
+
+        XCTAssertEqual(proposer.propose(context: [1, 2, 3, 4, 5], count: 3), [])
+        XCTAssertEqual(proposer.propose(context: [1, 2], count: 3), [])
+    }
+
+    func testPromptLookupIndexFollowsGrowingContext() {
+        let proposer = PromptLookupProposer(ngramSize: 2)
+
+        XCTAssertEqual(proposer.propose(context: [1, 2, 3, 4], count: 2), [])
+        XCTAssertEqual(proposer.propose(context: [1, 2, 3, 4, 1, 2], count: 2), [3, 4])
+
+        // A context that is not an extension rebuilds the index
+        XCTAssertEqual(proposer.propose(context: [9, 8, 7, 9, 8], count: 2), [7, 9])
+    }
+
+    func testPromptLookupGenerationMatchesGreedy() throws {
+        let model = try makeTinyLlama()
+        let repeating = [1, 2, 3, 4, 1, 2, 3, 4, 1, 2, 3]
+        let expected = generate(model: model, inputIds: repeating, config: greedy(maxTokens: 10))
+
+        let output = speculativeGenerate(
+            model: model,
+            proposer: PromptLookupProposer(ngramSize: 2),
+            inputIds: repeating,
+            config: greedy(maxTokens: 10)
+        )
+
+        XCTAssertEqual(output.tokens, expected.tokens)
+    }
+
+    // MARK: - Stats Tests
+
+    func testStatsCountAcceptedProposals() throws {
+        let model = try makeTinyLlama()
+
+        let identical = speculativeGenerate(
+            model: model,
+            proposer: DraftModelProposer(model: model, config: greedy(maxTokens: 9)),
+            inputIds: prompt,
+            config: greedy(maxTokens: 9)
+        )
+        let stats = try XCTUnwrap(identical.speculative)
+        XCTAssertEqual(stats.acceptedTokens, stats.proposedTokens)
+        XCTAssertEqual(stats.acceptanceRate, 1)
+        XCTAssertEqual(stats.verificationSteps, 3)
+
+        // Always proposes a token the target will not pick
+        let expected = generate(model: model, inputIds: prompt, config: greedy(maxTokens: 4)).tokens
+        let wrong = TestProposer { context, _ in
+            [(expected[context.count - self.prompt.count] + 1) % 100]
+        }
+        let rejected = speculativeGenerate(
+            model: model,
+            proposer: wrong,
+            inputIds: prompt,
+            config: greedy(maxTokens: 4, draftTokens: 2)
+        )
+        XCTAssertEqual(rejected.tokens, expected)
+        XCTAssertEqual(rejected.speculative?.acceptedTokens, 0)
+        XCTAssertEqual(rejected.speculative?.verificationSteps, 4)
+        XCTAssertEqual(rejected.speculative?.acceptanceRate, 0)
+    }
+
+    // MARK: - Support Tests
+
+    func testSupportsStandardCacheModels() throws {
+        XCTAssertTrue(supportsSpeculativeDecoding(try makeTinyLlama()))
+    }
+}
+
+// MARK: - Test Proposers
+
+/// Always proposes the same tokens and records how many were requested.
+private final class FixedProposer: DraftProposer {
+    let tokens: [Int]
+    private(set) var requestedCounts: [Int] = []
+
+    init(tokens: [Int]) {
+        self.tokens = tokens
+    }
+
+    func propose(context _: [Int], count: Int) -> [Int] {
+        requestedCounts.append(count)
+        return Array(tokens.prefix(count))
+    }
+}
+
+/// Proposes whatever a closure returns.
+private final class TestProposer: DraftProposer {
+    private let body: ([Int], Int) -> [Int]
+
+    init(_ body: @escaping ([Int], Int) -> [Int]) {
+        self.body = body
+    }
+
+    func propose(context: [Int], count: Int) -> [Int] {
+        body(context, count)
+    }
+}
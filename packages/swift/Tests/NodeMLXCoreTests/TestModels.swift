@@ -0,0 +1,40 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Shared fixtures for tests that run a real model.
+
+import Foundation
+import MLX
+import MLXNN
+
+@testable import NodeMLXCore
+
+/// Configuration of the tiny Llama model returned by `makeTinyLlama`.
+func tinyLlamaConfigJSON(layers: Int = 2) -> String {
+    """
+    {
+        "model_type": "llama",
+        "hidden_size": 64,
+        "num_hidden_layers": \(layers),
+        "num_attention_heads": 4,
+        "num_key_value_heads": 2,
+        "intermediate_size": 128,
+        "vocab_size": 100
+    }
+    """
+}
+
+/// Tiny randomly initialized Llama model (float32).
+func makeTinyLlama(seed: UInt64 = 0, layers: Int = 2) throws -> LlamaModel {
+    MLXRandom.seed(seed)
+    let json = tinyLlamaConfigJSON(layers: layers)
+    let config = try JSONDecoder().decode(LlamaConfiguration.self, from: Data(json.utf8))
+    let model = LlamaModel(config)
+    eval(model.parameters())
+    return model
+}
+
+/// Greedy decoding, so outputs of different generation paths can be compared.
+func greedy(maxTokens: Int, draftTokens: Int = 3) -> GenerationConfig {
+    GenerationConfig(maxTokens: maxTokens, temperature: 0, numDraftTokens: draftTokens)
+}
@@ -0,0 +1,95 @@
+// Copyright © 2024 Sebastian Software GmbH. All rights reserved.
+// SPDX-License-Identifier: MIT
+//
+// Tests for TokenGrammar.swift
+
+import MLX
+import XCTest
+
+@testable import NodeMLXCore
+
+final class TokenGrammarTests: XCTestCase {
+    /// Token 0 is a special (stop) token without bytes.
+    private let tokens = ["", "{", "\"key\": ", "\"", "key", ": ", "yes", "no", "}", "y", "x", "es"]
+
+    private func makeGrammar(encode: Bool = true) throws -> TokenGrammar {
+        let vocabulary = TokenVocabulary(tokenBytes: tokens.map { $0.isEmpty ? nil : Array($0.utf8) })
+        return try TokenGrammar(
+            grammar: Grammar(regex: #"\{"key": (?:yes|no)\}"#),
+            vocabulary: vocabulary,
+            stopTokens: [0],
+            encode: encode ? greedyEncode : { _ in [] }
+        )
+    }
+
+    /// Longest-match tokenization over the test vocabulary.
+    private func greedyEncode(_ text: String) -> [Int] {
+        var rest = Array(text.utf8)[...]
+        var ids: [Int] = []
+        while !rest.isEmpty {
+            let match = tokens.indices
+                .filter { !tokens[$0].isEmpty && rest.starts(with: tokens[$0].utf8) }
+                .max { tokens[$0].utf8.count < tokens[$1].utf8.count }
+            guard let match else { break }
+            ids.append(match)
+            rest = rest.dropFirst(tokens[match].utf8.count)
+        }
+        return ids
+    }
+
+    // MARK: - Mask Tests
+
+    func testAllowedTokens() throws {
+        let grammar = try makeGrammar()
+        let automaton = grammar.grammar.automaton
+
+        XCTAssertEqual(grammar.allowedTokens(in: automaton.start), [1])
+
+        let value = automaton.walk(from: automaton.start, Array(#"{"key": "#.utf8))
+        XCTAssertEqual(grammar.allowedTokens(in: value), [6, 7, 9])
+    }
+
+    func testStopTokensAllowedOnceComplete() throws {
+        let grammar = try makeGrammar()
+        let automaton = grammar.grammar.automaton
+
+        let end = automaton.walk(from: automaton.start, Array(#"{"key": no}"#.utf8))
+        XCTAssertEqual(grammar.allowedTokens(in: end), [0])
+        XCTAssertEqual(grammar.allowedTokens(in: nil), [0])
+    }
+
+    func testProcessorMasksLogits() throws {
+        let processor = try makeGrammar().makeProcessor()
+
+        let values = processor.process(MLXArray.zeros([1, tokens.count])).asArray(Float.self)
+
+        XCTAssertEqual(values[1], 0)
+        for (index, value) in values.enumerated() where index != 1 {
+            XCTAssertEqual(value, -Float.infinity, "token \(index)")
+        }
+    }
+
+    // MARK: - Forced Token Tests
+
+    func testForcedTokensSpellForcedText() throws {
+        let processor = try makeGrammar().makeProcessor()
+
+        XCTAssertEqual(processor.forcedTokens(), [1, 2])
+
+        processor.didSample(MLXArray([1, 2] as [Int32]))
+        XCTAssertEqual(processor.forcedTokens(), [])
+
+        processor.didSample(MLXArray([9] as [Int32]))
+        XCTAssertEqual(processor.forcedTokens(), [11, 8])
+        XCTAssertFalse(processor.isComplete)
+
+        processor.didSample(MLXArray([11, 8] as [Int32]))
+        XCTAssertTrue(processor.isComplete)
+    }
+
+    func testForcedTokensRequireExactSpelling() throws {
+        let processor = try makeGrammar(encode: false).makeProcessor()
+
+        XCTAssertEqual(processor.forcedTokens(), [])
+    }
+}